@@ -0,0 +1,132 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_RUNS   20
+#define BENCH_SIZE   (16 * 1024 * 1024)
+#define BENCH_RC     "/.cs543rc"
+#define BENCH_DATA   "/data"
+#define BENCH_SCRIPT "/runs.sh"
+
+/**
+  * Writes the script the shell is run on: the checksum of the data, the given number of times, with
+  * or without the cache prefix
+  * @param script the path of the script
+  * @param prefix "cache " or ""
+  * @param data   the path of the data
+  */
+void write_script(const char *script, const char *prefix, const char *data);
+
+/**
+  * Runs ./osh on a script, with its output thrown away and the home directory set
+  * @param home   the home directory to run the shell with
+  * @param script the path of the script
+  * @return the number of seconds the shell took
+  */
+double run(const char *home, const char *script);
+
+/**
+  * Returns the current time in seconds
+  * @return the time in seconds
+  */
+double now(void);
+
+int main(void)
+{
+	char home[] = "/tmp/osh_cache_bench_XXXXXX";
+	char rc[sizeof home + sizeof BENCH_RC];
+	char data[sizeof home + sizeof BENCH_DATA];
+	char script[sizeof home + sizeof BENCH_SCRIPT];
+	FILE *file = NULL;
+	FILE *contents = NULL;
+	if (mkdtemp(home) != NULL && access("./osh", X_OK) == 0)
+	{
+		snprintf(rc, sizeof rc, "%s%s", home, BENCH_RC);
+		snprintf(data, sizeof data, "%s%s", home, BENCH_DATA);
+		snprintf(script, sizeof script, "%s%s", home, BENCH_SCRIPT);
+		file = fopen(rc, "w");
+		contents = fopen(data, "w");
+	}
+	if (file == NULL || contents == NULL)
+	{
+		fprintf(stderr, "Error: Could not set up the benchmark (is ./osh built?).\n");
+		return 1;
+	}
+	fprintf(file, "set path = (/usr/bin /bin)\n");
+	fclose(file);
+	int i;
+	for (i = 0; i < BENCH_SIZE / 16; i++)
+	{
+		fprintf(contents, "%015d\n", i);
+	}
+	fclose(contents);
+
+	printf("%-26s %10s %10s\n", "sha256sum of 16 MB", "seconds", "runs/s");
+	const char *prefixes[] = { "", "cache " };
+	const char *names[] = { "uncached", "cache (1 miss, 19 hits)" };
+	size_t j;
+	for (j = 0; j < sizeof prefixes / sizeof *prefixes; j++)
+	{
+		write_script(script, prefixes[j], data);
+		double elapsed = run(home, script);
+		printf("%-26s %10.2f %10.1f\n", names[j], elapsed, BENCH_RUNS / elapsed);
+	}
+
+	//the store is in the home directory, so it goes with it
+	char command[sizeof home + 16];
+	snprintf(command, sizeof command, "rm -rf %s", home);
+	if (system(command) != 0)
+	{
+		fprintf(stderr, "Error: Could not remove %s.\n", home);
+	}
+	return 0;
+}
+
+void write_script(const char *script, const char *prefix, const char *data)
+{
+	FILE *file = fopen(script, "w");
+	if (file == NULL)
+	{
+		fprintf(stderr, "Error: Could not write the script.\n");
+		exit(1);
+	}
+
+	int i;
+	for (i = 0; i < BENCH_RUNS; i++)
+	{
+		fprintf(file, "%ssha256sum %s\n", prefix, data);
+	}
+	fprintf(file, "exit\n");
+	fclose(file);
+}
+
+double run(const char *home, const char *script)
+{
+	double start = now();
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		int input = open(script, O_RDONLY);
+		int output = open("/dev/null", O_WRONLY);
+		dup2(input, STDIN_FILENO);
+		dup2(output, STDOUT_FILENO);
+		dup2(output, STDERR_FILENO);
+		setenv("HOME", home, 1);
+		execl("./osh", "osh", (char *) NULL);
+		_exit(127);
+	}
+
+	waitpid(pid, NULL, 0);
+	return now() - start;
+}
+
+double now(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
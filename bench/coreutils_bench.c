@@ -0,0 +1,128 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_COMMANDS 20000
+#define BENCH_SCRIPT   "/tmp/osh_coreutils_bench.sh"
+#define BENCH_RC       "/.cs543rc"
+
+/**
+  * Writes the script the shell is run on: the setting, then a mix of echo, printf, test, [ and
+  * true, mostly echo, as a generated script would have them
+  * @param setting "on" or "off", for set builtin-coreutils
+  */
+void write_script(const char *setting);
+
+/**
+  * Runs ./osh on the script, with its output thrown away and a home directory whose initialization
+  * file only sets the path, and reports how many commands it got through per second
+  * @param setting the setting the script was written with
+  * @param home    the home directory to run the shell with
+  * @return the number of seconds the shell took
+  */
+double run(const char *setting, const char *home);
+
+/**
+  * Returns the current time in seconds
+  * @return the time in seconds
+  */
+double now(void);
+
+int main(void)
+{
+	char home[] = "/tmp/osh_coreutils_bench_XXXXXX";
+	char rc[sizeof home + sizeof BENCH_RC];
+	FILE *file = NULL;
+	if (mkdtemp(home) != NULL && access("./osh", X_OK) == 0)
+	{
+		snprintf(rc, sizeof rc, "%s%s", home, BENCH_RC);
+		file = fopen(rc, "w");
+	}
+	if (file == NULL)
+	{
+		fprintf(stderr, "Error: Could not set up the benchmark (is ./osh built?).\n");
+		return 1;
+	}
+	fprintf(file, "set path = (/usr/bin /bin)\n");
+	fclose(file);
+
+	printf("%-18s %10s %14s\n", "builtin-coreutils", "seconds", "commands/s");
+	double off = run("off", home);
+	double on = run("on", home);
+	printf("speedup: %.1fx\n", off / on);
+
+	unlink(BENCH_SCRIPT);
+	unlink(rc);
+	rmdir(home);
+	return 0;
+}
+
+void write_script(const char *setting)
+{
+	FILE *script = fopen(BENCH_SCRIPT, "w");
+	if (script == NULL)
+	{
+		fprintf(stderr, "Error: Could not write the script.\n");
+		exit(1);
+	}
+
+	fprintf(script, "set builtin-coreutils %s\n", setting);
+	int i;
+	for (i = 0; i < BENCH_COMMANDS; i++)
+	{
+		switch (i % 8)
+		{
+			case 0:
+				fprintf(script, "printf %%s-%%d\\n line %d\n", i);
+				break;
+			case 1:
+				fprintf(script, "test -n %d\n", i);
+				break;
+			case 2:
+				fprintf(script, "[ %d -gt 0 ]\n", i);
+				break;
+			case 3:
+				fprintf(script, "true\n");
+				break;
+			default:
+				fprintf(script, "echo building target %d of %d\n", i, BENCH_COMMANDS);
+		}
+	}
+	fprintf(script, "exit\n");
+	fclose(script);
+}
+
+double run(const char *setting, const char *home)
+{
+	write_script(setting);
+	double start = now();
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		int input = open(BENCH_SCRIPT, O_RDONLY);
+		int output = open("/dev/null", O_WRONLY);
+		dup2(input, STDIN_FILENO);
+		dup2(output, STDOUT_FILENO);
+		dup2(output, STDERR_FILENO);
+		setenv("HOME", home, 1);
+		execl("./osh", "osh", (char *) NULL);
+		_exit(127);
+	}
+
+	int status;
+	waitpid(pid, &status, 0);
+	double elapsed = now() - start;
+	printf("%-18s %10.2f %14.0f\n", setting, elapsed, BENCH_COMMANDS / elapsed);
+	return elapsed;
+}
+
+double now(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
@@ -0,0 +1,157 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_LINES   4000000
+#define BENCH_REPEATS 5
+#define BENCH_INPUT   "/tmp/osh_filter_bench.txt"
+#define BENCH_SCRIPT  "/tmp/osh_filter_bench.sh"
+#define BENCH_RC      "/.cs543rc"
+
+/**
+  * The pipelines compared, each run once with the programs in the path and once with the built in
+  * filters
+  */
+const char *PIPELINES[][2] =
+{
+	{ "grep -F 99 | wc -l", "@grep 99 | @wc -l" },
+	{ "grep -v -F 5 | tail -n 5", "@grep -v 5 | @tail -n 5" },
+	{ "wc", "@wc" },
+};
+
+/**
+  * Writes the input the pipelines read: numbered lines of a log-like text
+  */
+void write_input(void);
+
+/**
+  * Writes the script the shell is run on, which feeds the input through a pipeline a few times
+  * @param pipeline the stages after cat
+  */
+void write_script(const char *pipeline);
+
+/**
+  * Runs ./osh on the script, with its output thrown away and a home directory whose initialization
+  * file only sets the path, and reports the megabytes of input it got through per second
+  * @param pipeline the pipeline the script was written with
+  * @param home     the home directory to run the shell with
+  * @param size     the size of the input, in bytes
+  * @return the number of seconds the shell took
+  */
+double run(const char *pipeline, const char *home, double size);
+
+/**
+  * Returns the current time in seconds
+  * @return the time in seconds
+  */
+double now(void);
+
+int main(void)
+{
+	char home[] = "/tmp/osh_filter_bench_XXXXXX";
+	char rc[sizeof home + sizeof BENCH_RC];
+	FILE *file = NULL;
+	if (mkdtemp(home) != NULL && access("./osh", X_OK) == 0)
+	{
+		snprintf(rc, sizeof rc, "%s%s", home, BENCH_RC);
+		file = fopen(rc, "w");
+	}
+	if (file == NULL)
+	{
+		fprintf(stderr, "Error: Could not set up the benchmark (is ./osh built?).\n");
+		return 1;
+	}
+	fprintf(file, "set path = (/usr/bin /bin)\n");
+	fclose(file);
+
+	write_input();
+	FILE *input = fopen(BENCH_INPUT, "r");
+	fseek(input, 0, SEEK_END);
+	double size = ftell(input) * (double) BENCH_REPEATS;
+	fclose(input);
+
+	printf("%-28s %10s %10s\n", "pipeline (after cat)", "seconds", "MB/s");
+	size_t i;
+	for (i = 0; i < sizeof PIPELINES / sizeof *PIPELINES; i++)
+	{
+		double programs = run(PIPELINES[i][0], home, size);
+		double filters = run(PIPELINES[i][1], home, size);
+		printf("speedup: %.1fx\n", programs / filters);
+	}
+
+	unlink(BENCH_INPUT);
+	unlink(BENCH_SCRIPT);
+	unlink(rc);
+	rmdir(home);
+	return 0;
+}
+
+void write_input(void)
+{
+	FILE *input = fopen(BENCH_INPUT, "w");
+	if (input == NULL)
+	{
+		fprintf(stderr, "Error: Could not write the input.\n");
+		exit(1);
+	}
+
+	int i;
+	for (i = 0; i < BENCH_LINES; i++)
+	{
+		fprintf(input, "%d request served in %d ms by worker %d\n", i, i % 997, i % 13);
+	}
+	fclose(input);
+}
+
+void write_script(const char *pipeline)
+{
+	FILE *script = fopen(BENCH_SCRIPT, "w");
+	if (script == NULL)
+	{
+		fprintf(stderr, "Error: Could not write the script.\n");
+		exit(1);
+	}
+
+	int i;
+	for (i = 0; i < BENCH_REPEATS; i++)
+	{
+		fprintf(script, "cat %s | %s\n", BENCH_INPUT, pipeline);
+	}
+	fprintf(script, "exit\n");
+	fclose(script);
+}
+
+double run(const char *pipeline, const char *home, double size)
+{
+	write_script(pipeline);
+	double start = now();
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		int input = open(BENCH_SCRIPT, O_RDONLY);
+		int output = open("/dev/null", O_WRONLY);
+		dup2(input, STDIN_FILENO);
+		dup2(output, STDOUT_FILENO);
+		dup2(output, STDERR_FILENO);
+		setenv("HOME", home, 1);
+		execl("./osh", "osh", (char *) NULL);
+		_exit(127);
+	}
+
+	int status;
+	waitpid(pid, &status, 0);
+	double elapsed = now() - start;
+	printf("%-28s %10.2f %10.0f\n", pipeline, elapsed, size / elapsed / 1e6);
+	return elapsed;
+}
+
+double now(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
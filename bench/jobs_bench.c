@@ -0,0 +1,117 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_JOBS   4
+#define BENCH_SIZE   (64 * 1024 * 1024)
+#define BENCH_RC     "/.cs543rc"
+#define BENCH_SCRIPT "/jobs.sh"
+
+/**
+  * Writes the script the shell is run on: the background jobs, each writing the given number of
+  * bytes, then the wait for them
+  * @param script   the path of the script
+  * @param redirect what follows each job's command ("> /dev/null" or "")
+  * @param wait     the wait command ("wait" or "wait -o")
+  */
+void write_script(const char *script, const char *redirect, const char *wait);
+
+/**
+  * Runs ./osh on a script, with its output thrown away and the home directory set
+  * @param home   the home directory to run the shell with
+  * @param script the path of the script
+  * @return the number of seconds the shell took
+  */
+double run(const char *home, const char *script);
+
+/**
+  * Returns the current time in seconds
+  * @return the time in seconds
+  */
+double now(void);
+
+int main(void)
+{
+	char home[] = "/tmp/osh_jobs_bench_XXXXXX";
+	char rc[sizeof home + sizeof BENCH_RC];
+	char script[sizeof home + sizeof BENCH_SCRIPT];
+	FILE *file = NULL;
+	if (mkdtemp(home) != NULL && access("./osh", X_OK) == 0)
+	{
+		snprintf(rc, sizeof rc, "%s%s", home, BENCH_RC);
+		snprintf(script, sizeof script, "%s%s", home, BENCH_SCRIPT);
+		file = fopen(rc, "w");
+	}
+	if (file == NULL)
+	{
+		fprintf(stderr, "Error: Could not set up the benchmark (is ./osh built?).\n");
+		return 1;
+	}
+	fprintf(file, "set path = (/usr/bin /bin)\n");
+	fclose(file);
+
+	printf("%-30s %10s %10s\n", "4 jobs writing 64 MB each", "seconds", "MB/s");
+	const char *redirects[] = { "> /dev/null", "", "" };
+	const char *waits[] = { "wait", "wait", "wait -o" };
+	const char *names[] = { "redirected to /dev/null", "captured", "captured, then wait -o" };
+	size_t j;
+	for (j = 0; j < sizeof redirects / sizeof *redirects; j++)
+	{
+		write_script(script, redirects[j], waits[j]);
+		double elapsed = run(home, script);
+		printf("%-30s %10.2f %10.1f\n", names[j], elapsed, BENCH_JOBS * (BENCH_SIZE / 1e6) / elapsed);
+	}
+
+	unlink(script);
+	unlink(rc);
+	rmdir(home);
+	return 0;
+}
+
+void write_script(const char *script, const char *redirect, const char *wait)
+{
+	FILE *file = fopen(script, "w");
+	if (file == NULL)
+	{
+		fprintf(stderr, "Error: Could not write the script.\n");
+		exit(1);
+	}
+
+	int i;
+	for (i = 0; i < BENCH_JOBS; i++)
+	{
+		fprintf(file, "head -c %d /dev/zero %s &\n", BENCH_SIZE, redirect);
+	}
+	fprintf(file, "%s\nexit\n", wait);
+	fclose(file);
+}
+double run(const char *home, const char *script)
+{
+	double start = now();
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		int input = open(script, O_RDONLY);
+		int output = open("/dev/null", O_WRONLY);
+		dup2(input, STDIN_FILENO);
+		dup2(output, STDOUT_FILENO);
+		dup2(output, STDERR_FILENO);
+		setenv("HOME", home, 1);
+		execl("./osh", "osh", (char *) NULL);
+		_exit(127);
+	}
+
+	waitpid(pid, NULL, 0);
+	return now() - start;
+}
+
+double now(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
@@ -0,0 +1,94 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/misc/include/libosh.h"
+
+#define BENCH_STEPS 500
+#define BENCH_STEP  "ls / | wc -l"
+
+/**
+  * Counts the bytes of output it is given, so that the captured output goes nowhere
+  * @param context the count
+  * @param script  the index of the script that wrote the output
+  * @param data    the output
+  * @param size    the number of bytes
+  */
+void count_output(void *context, size_t script, const char *data, size_t size);
+
+/**
+  * Returns the current time in seconds
+  * @return the time in seconds
+  */
+double now(void);
+
+int main(void)
+{
+	osh_env_t *env;
+	size_t bytes = 0;
+	int status;
+	if (osh_env_create(&env) != SUCCESS || osh_run(env, "set path = (/usr/bin /bin)", &status) != SUCCESS)
+	{
+		fprintf(stderr, "Error: Could not set up the benchmark.\n");
+		return 1;
+	}
+	osh_set_output(env, count_output, count_output, &bytes);
+
+	const char **steps = malloc(BENCH_STEPS * sizeof *steps);
+	int *statuses = malloc(BENCH_STEPS * sizeof *statuses);
+	if (steps == NULL || statuses == NULL)
+	{
+		fprintf(stderr, "Error: Could not set up the benchmark.\n");
+		return 1;
+	}
+	int i;
+	for (i = 0; i < BENCH_STEPS; i++)
+	{
+		steps[i] = BENCH_STEP;
+	}
+
+	printf("%-26s %10s %10s\n", "each step run by", "seconds", "steps/s");
+	double start = now();
+	for (i = 0; i < BENCH_STEPS; i++)
+	{
+		if (system(BENCH_STEP " > /dev/null") < 0)
+		{
+			break;
+		}
+	}
+	double elapsed = now() - start;
+	printf("%-26s %10.2f %10.0f\n", "system()", elapsed, BENCH_STEPS / elapsed);
+
+	start = now();
+	for (i = 0; i < BENCH_STEPS; i++)
+	{
+		osh_run(env, BENCH_STEP, &status);
+	}
+	elapsed = now() - start;
+	printf("%-26s %10.2f %10.0f\n", "osh_run", elapsed, BENCH_STEPS / elapsed);
+
+	start = now();
+	osh_run_batch(env, steps, BENCH_STEPS, statuses);
+	elapsed = now() - start;
+	printf("%-26s %10.2f %10.0f\n", "osh_run_batch", elapsed, BENCH_STEPS / elapsed);
+
+	free(steps);
+	free(statuses);
+	osh_env_destroy(env);
+	return 0;
+}
+
+void count_output(void *context, size_t script, const char *data, size_t size)
+{
+	(void) script;
+	(void) data;
+	*(size_t *) context += size;
+}
+
+double now(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
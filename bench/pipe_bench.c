@@ -0,0 +1,115 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_BYTES  (2048UL * 1024 * 1024)
+#define BENCH_SCRIPT "/tmp/osh_pipe_bench.sh"
+#define BENCH_RC     "/.cs543rc"
+
+/**
+  * Writes the script the shell is run on: the pipe size, then a two stage pipeline moving the bytes
+  * from head to cat, whose output is thrown away
+  * @param setting the value for set pipesize
+  */
+void write_script(const char *setting);
+
+/**
+  * Runs ./osh on the script, with its output thrown away and a home directory whose initialization
+  * file only sets the path, and reports the throughput and the context switches of the shell and
+  * the pipeline it ran
+  * @param setting the value for set pipesize
+  * @param home    the home directory to run the shell with
+  */
+void run(const char *setting, const char *home);
+
+/**
+  * Returns the current time in seconds
+  * @return the time in seconds
+  */
+double now(void);
+
+int main(void)
+{
+	char home[] = "/tmp/osh_pipe_bench_XXXXXX";
+	char rc[sizeof home + sizeof BENCH_RC];
+	FILE *file = NULL;
+	if (mkdtemp(home) != NULL && access("./osh", X_OK) == 0)
+	{
+		snprintf(rc, sizeof rc, "%s%s", home, BENCH_RC);
+		file = fopen(rc, "w");
+	}
+	if (file == NULL)
+	{
+		fprintf(stderr, "Error: Could not set up the benchmark (is ./osh built?).\n");
+		return 1;
+	}
+	fprintf(file, "set path = (/usr/bin /bin)\n");
+	fclose(file);
+
+	printf("%-10s %10s %14s %14s\n", "pipesize", "MB/s", "voluntary cs", "involuntary cs");
+	run("0", home);
+	run("262144", home);
+	run("1048576", home);
+	run("auto", home);
+
+	unlink(BENCH_SCRIPT);
+	unlink(rc);
+	rmdir(home);
+	return 0;
+}
+
+void write_script(const char *setting)
+{
+	FILE *script = fopen(BENCH_SCRIPT, "w");
+	if (script == NULL)
+	{
+		fprintf(stderr, "Error: Could not write the script.\n");
+		exit(1);
+	}
+
+	fprintf(script, "set pipesize %s\n", setting);
+	fprintf(script, "head -c %lu /dev/zero | cat > /dev/null\n", BENCH_BYTES);
+	fprintf(script, "exit\n");
+	fclose(script);
+}
+
+void run(const char *setting, const char *home)
+{
+	write_script(setting);
+	struct rusage before;
+	getrusage(RUSAGE_CHILDREN, &before);
+	double start = now();
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		int input = open(BENCH_SCRIPT, O_RDONLY);
+		int output = open("/dev/null", O_WRONLY);
+		dup2(input, STDIN_FILENO);
+		dup2(output, STDOUT_FILENO);
+		dup2(output, STDERR_FILENO);
+		setenv("HOME", home, 1);
+		execl("./osh", "osh", (char *) NULL);
+		_exit(127);
+	}
+
+	//the stages are the shell's children, and it waits for them, so they are counted here too
+	int status;
+	waitpid(pid, &status, 0);
+	double elapsed = now() - start;
+	struct rusage after;
+	getrusage(RUSAGE_CHILDREN, &after);
+	printf("%-10s %10.1f %14ld %14ld\n", setting, BENCH_BYTES / elapsed / 1e6,
+		after.ru_nvcsw - before.ru_nvcsw, after.ru_nivcsw - before.ru_nivcsw);
+}
+
+double now(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
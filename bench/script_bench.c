@@ -0,0 +1,163 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/misc/include/lz.h"
+#include "../src/misc/include/script_log.h"
+
+#define BENCH_BYTES (256 * 1024 * 1024)
+#define BENCH_CHUNK (32 * 1024)
+#define BENCH_FILE  "/tmp/osh_script_bench.log"
+
+/**
+  * Fills a buffer with one of the kinds of output the benchmark is run on: counting like seq, lines
+  * like a build or server log, or random bytes that cannot be compressed
+  * @param buffer where the output goes
+  * @param length the number of bytes of output
+  * @param kind   0, 1, or 2, for the kinds above in that order
+  */
+void fill(char *buffer, size_t length, int kind);
+
+/**
+  * Runs the output through a script log, as the tee engine would, as fast as the log will take it,
+  * and reports how quickly the log kept up, how big the script file ended up, and how much output was
+  * dropped because the writer thread fell behind
+  * @param name     the name of the kind of output
+  * @param buffer   the output
+  * @param length   the number of bytes of output
+  * @param compress whether the script file is compressed
+  */
+void run(const char *name, char *buffer, size_t length, unsigned short compress);
+
+/**
+  * Returns the current time in seconds
+  * @return the time in seconds
+  */
+double now(void);
+
+int main(void)
+{
+	const char *names[] = { "seq", "log", "random" };
+	char *buffer = malloc(BENCH_BYTES);
+	unsigned char *packed = malloc(LZ_BOUND(SCRIPT_BLOCK));
+	if (buffer == NULL || packed == NULL)
+	{
+		fprintf(stderr, "Error: Could not allocate memory.\n");
+		return 1;
+	}
+
+	printf("%-8s %-12s %10s %10s %8s %10s\n", "output", "mode", "MB/s", "file MB", "ratio", "dropped MB");
+	int kind;
+	for (kind = 0; kind < 3; kind++)
+	{
+		fill(buffer, BENCH_BYTES, kind);
+		run(names[kind], buffer, BENCH_BYTES, 0);
+		run(names[kind], buffer, BENCH_BYTES, 1);
+
+		//the compressor on its own, without the ring or the file in the way
+		double start = now();
+		size_t stored = 0;
+		size_t offset;
+		for (offset = 0; offset < BENCH_BYTES; offset += SCRIPT_BLOCK)
+		{
+			stored += lz_compress((unsigned char *) buffer + offset, SCRIPT_BLOCK, packed);
+		}
+		double elapsed = now() - start;
+		printf("%-8s %-12s %10.1f %10.1f %8.2f\n", names[kind], "lz only", BENCH_BYTES / elapsed / 1e6,
+			stored / 1e6, (double) BENCH_BYTES / stored);
+	}
+
+	unlink(BENCH_FILE);
+	free(buffer);
+	free(packed);
+	return 0;
+}
+
+void fill(char *buffer, size_t length, int kind)
+{
+	static const char *levels[] = { "INFO", "DEBUG", "WARN", "INFO", "ERROR" };
+	static const char *messages[] = { "request served", "cache miss for key", "connection opened",
+		"retrying upstream", "compiled object file", "connection closed" };
+	size_t used = 0;
+	unsigned long n = 1;
+	unsigned int seed = 543;
+	char line[128];
+	while (used < length)
+	{
+		int line_length;
+		if (kind == 0)
+		{
+			line_length = snprintf(line, sizeof line, "%lu\n", n);
+		}
+		else if (kind == 1)
+		{
+			line_length = snprintf(line, sizeof line, "2024-05-%02lu 12:%02lu:%02lu [%s] worker-%u: %s %u\n",
+				n / 86400 % 28 + 1, n / 60 % 60, n % 60, levels[rand_r(&seed) % 5],
+				rand_r(&seed) % 16, messages[rand_r(&seed) % 6], rand_r(&seed) % 100000);
+		}
+		else
+		{
+			line_length = sizeof line;
+			size_t i;
+			for (i = 0; i < sizeof line; i++)
+			{
+				line[i] = rand_r(&seed);
+			}
+		}
+
+		size_t taken = (size_t) line_length < length - used ? (size_t) line_length : length - used;
+		memcpy(buffer + used, line, taken);
+		used += taken;
+		n++;
+	}
+}
+
+void run(const char *name, char *buffer, size_t length, unsigned short compress)
+{
+	int fd = open(BENCH_FILE, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0600);
+	int pipefd[2];
+	script_log_t *log;
+	if (fd < 0 || pipe(pipefd) < 0 || create_script_log(&log, fd, SCRIPT_SYNC_NONE, compress) != SUCCESS)
+	{
+		fprintf(stderr, "Error: Could not set up the script log.\n");
+		exit(1);
+	}
+
+	double start = now();
+	size_t offset;
+	for (offset = 0; offset < length; offset += BENCH_CHUNK)
+	{
+		size_t chunk = length - offset < BENCH_CHUNK ? length - offset : BENCH_CHUNK;
+		write(pipefd[1], buffer + offset, chunk);
+		log_output(log, pipefd[0], chunk);
+
+		//end a "command" every megabyte, so compressed blocks are cut the way they would be in use
+		if ((offset + chunk) % (1024 * 1024) == 0)
+		{
+			log_command_end(log);
+		}
+	}
+	uint64_t dropped = log->dropped_bytes;
+	release_script_log(log);
+	double elapsed = now() - start;
+
+	struct stat info;
+	stat(BENCH_FILE, &info);
+	//output the log had no room for is dropped rather than waited on, so only what was kept counts
+	size_t kept = length - dropped;
+	printf("%-8s %-12s %10.1f %10.1f %8.2f %10.1f\n", name, compress ? "compressed" : "plain", kept / elapsed / 1e6,
+		info.st_size / 1e6, (double) kept / info.st_size, dropped / 1e6);
+	close(pipefd[0]);
+	close(pipefd[1]);
+}
+
+double now(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
@@ -0,0 +1,145 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_STEPS   500
+#define BENCH_STEP    "ls / | wc -l"
+#define BENCH_WORKERS "4"
+#define BENCH_RC      "/.cs543rc"
+#define BENCH_SOCKET  "/osh.sock"
+#define BENCH_SCRIPT  "/step.sh"
+
+/**
+  * Runs a program with its output thrown away and the home directory set, and waits for it
+  * @param home      the home directory to run the program with
+  * @param input     the file to use as its stdin, or NULL for /dev/null
+  * @param arguments the NULL terminated arguments, the first being the program
+  */
+void run(const char *home, const char *input, char **arguments);
+
+/**
+  * Starts ./osh as a server on a socket in the home directory
+  * @param home   the home directory to run the server with
+  * @param socket the path of the socket
+  * @return the server's pid
+  */
+pid_t start_server(const char *home, char *socket);
+
+/**
+  * Returns the current time in seconds
+  * @return the time in seconds
+  */
+double now(void);
+
+int main(void)
+{
+	char home[] = "/tmp/osh_server_bench_XXXXXX";
+	char rc[sizeof home + sizeof BENCH_RC];
+	char socket[sizeof home + sizeof BENCH_SOCKET];
+	char script[sizeof home + sizeof BENCH_SCRIPT];
+	FILE *file = NULL;
+	FILE *step = NULL;
+	if (mkdtemp(home) != NULL && access("./osh", X_OK) == 0)
+	{
+		snprintf(rc, sizeof rc, "%s%s", home, BENCH_RC);
+		snprintf(socket, sizeof socket, "%s%s", home, BENCH_SOCKET);
+		snprintf(script, sizeof script, "%s%s", home, BENCH_SCRIPT);
+		file = fopen(rc, "w");
+		step = fopen(script, "w");
+	}
+	if (file == NULL || step == NULL)
+	{
+		fprintf(stderr, "Error: Could not set up the benchmark (is ./osh built?).\n");
+		return 1;
+	}
+	fprintf(file, "set path = (/usr/bin /bin)\n");
+	fclose(file);
+	fprintf(step, "%s\nexit\n", BENCH_STEP);
+	fclose(step);
+
+	printf("%-26s %10s %10s\n", "each step run by", "seconds", "steps/s");
+	char *sh[] = { "/bin/sh", "-c", BENCH_STEP, NULL };
+	char *fresh[] = { "./osh", NULL };
+	char *client[] = { "./osh", "--client", socket, BENCH_STEP, NULL };
+
+	struct
+	{
+		const char *name;
+		char **arguments;
+		const char *input;
+	} runs[] = { { "a new /bin/sh -c", sh, NULL }, { "a new ./osh", fresh, script }, { "./osh --client", client, NULL } };
+
+	pid_t server = start_server(home, socket);
+	size_t i;
+	for (i = 0; i < sizeof runs / sizeof *runs; i++)
+	{
+		double start = now();
+		int j;
+		for (j = 0; j < BENCH_STEPS; j++)
+		{
+			run(home, runs[i].input, runs[i].arguments);
+		}
+		double elapsed = now() - start;
+		printf("%-26s %10.2f %10.0f\n", runs[i].name, elapsed, BENCH_STEPS / elapsed);
+	}
+
+	kill(server, SIGTERM);
+	waitpid(server, NULL, 0);
+	unlink(socket);
+	unlink(script);
+	unlink(rc);
+	rmdir(home);
+	return 0;
+}
+
+void run(const char *home, const char *input, char **arguments)
+{
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		int in = open(input != NULL ? input : "/dev/null", O_RDONLY);
+		int output = open("/dev/null", O_WRONLY);
+		dup2(in, STDIN_FILENO);
+		dup2(output, STDOUT_FILENO);
+		dup2(output, STDERR_FILENO);
+		setenv("HOME", home, 1);
+		execv(arguments[0], arguments);
+		_exit(127);
+	}
+
+	waitpid(pid, NULL, 0);
+}
+
+pid_t start_server(const char *home, char *socket)
+{
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		int nothing = open("/dev/null", O_RDWR);
+		dup2(nothing, STDIN_FILENO);
+		dup2(nothing, STDOUT_FILENO);
+		dup2(nothing, STDERR_FILENO);
+		setenv("HOME", home, 1);
+		execl("./osh", "osh", "--server", socket, BENCH_WORKERS, (char *) NULL);
+		_exit(127);
+	}
+
+	//the socket shows up once the server has read its initialization file and is listening
+	while (access(socket, F_OK) != 0)
+	{
+		usleep(1000);
+	}
+	return pid;
+}
+
+double now(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
@@ -0,0 +1,142 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_LAUNCHES  2000
+#define BENCH_VARIABLES 40000
+#define BENCH_VALUE     1000
+#define BENCH_SCRIPT    "/tmp/osh_zygote_bench.sh"
+#define BENCH_RC        "/.cs543rc"
+
+/**
+  * Writes the script the shell is run on: the setting, then, for a large shell, enough long
+  * variables to grow its memory, then the launches, each of a program that does nothing
+  * @param setting   "on" or "off", for set zygote
+  * @param variables the number of variables to set first
+  * @param launches  the number of programs to launch
+  */
+void write_script(const char *setting, int variables, int launches);
+
+/**
+  * Runs ./osh on the script, with its output thrown away and a home directory whose initialization
+  * file only sets the path
+  * @param home the home directory to run the shell with
+  * @return the number of seconds the shell took
+  */
+double run(const char *home);
+
+/**
+  * Measures how many programs a shell launches per second: the time of a script with the launches,
+  * less that of the same script without them
+  * @param setting   the zygote setting
+  * @param variables the number of variables the shell is grown by first
+  * @param home      the home directory to run the shell with
+  * @return the number of launches per second
+  */
+double measure(const char *setting, int variables, const char *home);
+
+/**
+  * Returns the current time in seconds
+  * @return the time in seconds
+  */
+double now(void);
+
+int main(void)
+{
+	char home[] = "/tmp/osh_zygote_bench_XXXXXX";
+	char rc[sizeof home + sizeof BENCH_RC];
+	FILE *file = NULL;
+	if (mkdtemp(home) != NULL && access("./osh", X_OK) == 0)
+	{
+		snprintf(rc, sizeof rc, "%s%s", home, BENCH_RC);
+		file = fopen(rc, "w");
+	}
+	if (file == NULL)
+	{
+		fprintf(stderr, "Error: Could not set up the benchmark (is ./osh built?).\n");
+		return 1;
+	}
+	fprintf(file, "set path = (/usr/bin /bin)\n");
+	fclose(file);
+
+	printf("%-12s %-8s %14s\n", "shell", "zygote", "launches/s");
+	int sizes[] = { 0, BENCH_VARIABLES };
+	size_t i;
+	for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+	{
+		const char *shell = sizes[i] == 0 ? "small" : "large";
+		double off = measure("off", sizes[i], home);
+		printf("%-12s %-8s %14.0f\n", shell, "off", off);
+		double on = measure("on", sizes[i], home);
+		printf("%-12s %-8s %14.0f\n", shell, "on", on);
+	}
+
+	unlink(BENCH_SCRIPT);
+	unlink(rc);
+	rmdir(home);
+	return 0;
+}
+
+void write_script(const char *setting, int variables, int launches)
+{
+	FILE *script = fopen(BENCH_SCRIPT, "w");
+	if (script == NULL)
+	{
+		fprintf(stderr, "Error: Could not write the script.\n");
+		exit(1);
+	}
+
+	fprintf(script, "set zygote %s\n", setting);
+	int i;
+	for (i = 0; i < variables; i++)
+	{
+		fprintf(script, "set v%d = %0*d\n", i, BENCH_VALUE, i);
+	}
+	for (i = 0; i < launches; i++)
+	{
+		fprintf(script, "/bin/true\n");
+	}
+	fprintf(script, "exit\n");
+	fclose(script);
+}
+
+double run(const char *home)
+{
+	double start = now();
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		int input = open(BENCH_SCRIPT, O_RDONLY);
+		int output = open("/dev/null", O_WRONLY);
+		dup2(input, STDIN_FILENO);
+		dup2(output, STDOUT_FILENO);
+		dup2(output, STDERR_FILENO);
+		setenv("HOME", home, 1);
+		execl("./osh", "osh", (char *) NULL);
+		_exit(127);
+	}
+
+	int status;
+	waitpid(pid, &status, 0);
+	return now() - start;
+}
+
+double measure(const char *setting, int variables, const char *home)
+{
+	write_script(setting, variables, 0);
+	double setup = run(home);
+	write_script(setting, variables, BENCH_LAUNCHES);
+	double total = run(home);
+	return BENCH_LAUNCHES / (total - setup);
+}
+
+double now(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
@@ -0,0 +1,58 @@
+#ifndef __ARENA__H__
+#define __ARENA__H__
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_READ_SIZE  (64 * 1024)
+
+/**
+  * One block of an arena; what has been handed out is the first used bytes of data
+  */
+typedef struct arena_block_t
+{
+	struct arena_block_t *next;
+	size_t size;
+	size_t used;
+	alignas(max_align_t) char data[];
+} arena_block_t;
+
+/**
+  * A region of memory things are allocated from one after another and freed all at once, for the
+  * memory a single command line needs while it is being expanded and run. Anything too big for a
+  * block gets a block of its own
+  */
+typedef struct
+{
+	arena_block_t *blocks;
+} arena_t;
+
+/**
+  * Allocates size bytes from the arena, aligned for any type
+  * @param arena the arena to allocate from
+  * @param size  the number of bytes needed
+  * @return the memory, or NULL if it could not be allocated
+  */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/**
+  * Reads everything from fd until end of file into one contiguous, nul terminated run of bytes in the
+  * arena. Reads go straight into the arena, at least ARENA_READ_SIZE bytes at a time, and once the
+  * output outgrows the current block it moves to a block of its own, which is grown with realloc (so
+  * large outputs are remapped rather than copied)
+  * @param arena  the arena the bytes are placed in
+  * @param fd     the descriptor to read from
+  * @param length out param; the number of bytes read
+  * @return the bytes, or NULL if they could not be read or allocated
+  */
+char *arena_read_fd(arena_t *arena, int fd, size_t *length);
+
+/**
+  * Frees everything allocated from the arena, leaving it empty and ready for reuse
+  * @param arena the arena to be freed
+  */
+void arena_free(arena_t *arena);
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef __CACHE__H__
+#define __CACHE__H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../types/include/command.h"
+#include "../../types/include/status.h"
+#include "../../types/include/string_t.h"
+
+#define CACHE_COMMAND   "cache"
+#define CACHE_INPUT     "-i"
+#define CACHE_STATS     "stats"
+#define CACHE_DIRECTORY "/.osh_cache"
+#define CACHE_LIMIT     (64 * 1024 * 1024)
+
+/**
+  * The shell's side of the command cache: the directory holding the store (found from $HOME the
+  * first time it is needed), how many bytes the store may hold before the least recently used
+  * entries are evicted, and this shell's hits, misses and evictions
+  */
+typedef struct
+{
+	char *directory;
+	size_t limit;
+	size_t hits;
+	size_t misses;
+	size_t evictions;
+} cache_t;
+
+/**
+  * What the store keeps for one key: when it was last used, in nanoseconds (file times are too coarse
+  * to order commands run back to back), the exit status, and the hash and size of the stdout and
+  * stderr objects, which are files named by their hash and size, shared by every entry with the same
+  * output. In the entry's file it is followed by the key itself, so that a hash collision is a miss
+  */
+typedef struct
+{
+	uint64_t used;
+	int32_t status;
+	uint64_t output_hash;
+	uint64_t output_size;
+	uint64_t error_hash;
+	uint64_t error_size;
+	uint64_t key_size;
+} cache_record_t;
+
+/**
+  * Builds the key a command is cached under: the current directory's path, then every word of every
+  * stage and the file each < reads from, then the declared inputs. Each word that names a file or
+  * directory is followed by its device, inode, size and mtime, so that changing the file changes the
+  * key
+  * @param command  the command, without the cache prefix
+  * @param inputs   the words between cache and the command (-i path pairs)
+  * @param count    the number of those words
+  * @param key      out param (initialized); the key
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t make_cache_key(command_t *command, char **inputs, size_t count, string_t *key);
+
+/**
+  * Looks a key up in the store, marking the entry as just used if it is there and both of its
+  * objects are still in the store
+  * @param cache  the cache
+  * @param key    the key
+  * @param record out param; the entry, if found
+  * @param hit    out param; whether the entry was found
+  * @return a status code indicating whether an error occurred during execution of the function;
+  *         CACHE_ERROR if the store could not be created
+  */
+status_t find_cached(cache_t *cache, string_t *key, cache_record_t *record, unsigned short *hit);
+
+/**
+  * Writes an entry's stored stdout and stderr to the given descriptors
+  * @param cache  the cache
+  * @param record the entry, from find_cached
+  * @param output where the stdout goes
+  * @param error  where the stderr goes
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t replay_cached(cache_t *cache, cache_record_t *record, int output, int error);
+
+/**
+  * Adds an entry to the store, writing whichever of its objects are not there already, then evicts
+  * the least recently used entries, and any objects no entry uses any more, until the store is back
+  * under its limit
+  * @param cache  the cache
+  * @param key    the key
+  * @param status the command's exit status
+  * @param output a descriptor holding everything the command wrote to stdout, read from its start
+  * @param error  a descriptor holding everything the command wrote to stderr, read from its start
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t store_cached(cache_t *cache, string_t *key, int status, int output, int error);
+
+/**
+  * Copies everything in a descriptor, from its start, to another descriptor
+  * @param from the descriptor to copy from, which must allow pread
+  * @param to   the descriptor to copy to
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t copy_cached(int from, int to);
+
+/**
+  * Prints the number of entries and objects in the store, the bytes they take up against the limit,
+  * and this shell's hits, misses and evictions
+  * @param cache the cache
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t print_cache_stats(cache_t *cache);
+
+/**
+  * Frees the memory held by the cache; the store itself stays on disk
+  * @param cache the cache
+  */
+void clear_cache(cache_t *cache);
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef __CONTROL__H__
+#define __CONTROL__H__
+
+#include "substitute.h"
+#include "../../types/include/command.h"
+#include "../../types/include/status.h"
+#include "../../types/include/variables.h"
+
+#define NODE_COMMAND 0
+#define NODE_AND     1
+#define NODE_OR      2
+#define NODE_IF      3
+#define NODE_WHILE   4
+#define NODE_UNTIL   5
+#define NODE_FOR     6
+
+/**
+  * One statement of a compiled script. A command is parsed once, when the script is compiled, into
+  * command, whose arguments point into text; running it expands a shallow copy, so the same node can
+  * run any number of times. For && and ||, condition is the left side and body the right. An if runs
+  * body when its condition succeeds and otherwise (an elif being another if) when it does not; a
+  * while or until runs body for as long as its condition succeeds or fails; a for sets the variable
+  * name to each of the words in command, expanded once when the loop starts, and runs body. The
+  * statements of a list are chained through next
+  */
+typedef struct script_node_t
+{
+	unsigned short type;
+	command_t command;
+	char *text;
+	char *name;
+	struct script_node_t *condition;
+	struct script_node_t *body;
+	struct script_node_t *otherwise;
+	struct script_node_t *next;
+} script_node_t;
+
+/**
+  * Runs a single command of a script, expanded or not as the runner sees fit, and sets the exit
+  * status. Errors it can carry on from it reports itself, returning SUCCESS
+  * @param context whatever the runner needs to run the command
+  * @param command the command, as it was compiled; the runner must not change it
+  * @return SUCCESS to carry on with the script, anything else to stop it and return that
+  */
+typedef status_t (*statement_runner_t)(void *context, command_t *command);
+
+/**
+  * Everything running a compiled script needs: how to run a command, how to expand the words of a
+  * for (with expansion's context and status, the status being the one commands set and conditions
+  * test; its arena is replaced by one for each loop), and where a for sets its variable
+  */
+typedef struct
+{
+	statement_runner_t run;
+	expansion_t expansion;
+	variable_table_t *variables;
+} interpreter_t;
+
+/**
+  * Determines whether a line is more than a single pipeline: it starts with if, while, until or
+  * for, or has a ;, && or || outside quotes and $(...)
+  * @param line the line to be checked
+  * @return nonzero if it is, zero otherwise
+  */
+int is_compound(const char *line);
+
+/**
+  * Determines whether the text of a script stops partway through, so more lines must be read before
+  * it can be compiled: an if, while, until or for is not yet closed, or it ends in && or ||
+  * @param text the script so far
+  * @return nonzero if it is incomplete, zero otherwise
+  */
+int script_incomplete(const char *text);
+
+/**
+  * Compiles a script into a tree of statements, parsing each command once. Statements are separated
+  * by newlines or ;, and may be joined by && and ||. The control flow is that of sh:
+  * if list; then list; [elif list; then list;]... [else list;] fi, while list; do list; done (or
+  * until), and for name in words; do list; done. Here-documents cannot be used in a script, since
+  * their bodies would be read as statements; here-strings can
+  * @param text   the script, which is not changed
+  * @param script out param; the first statement, or NULL if there are none
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t compile_script(const char *text, script_node_t **script);
+
+/**
+  * Runs a compiled script. The exit status of an if or loop is that of the last command it ran in
+  * its body, or zero if it ran none, and that of a && or || that of the last side it ran
+  * @param script      the first statement to run
+  * @param interpreter how to run it
+  * @return a status code indicating whether an error occurred during execution of the function;
+  *         anything other than SUCCESS returned by the runner stops the script and is returned
+  */
+status_t run_script(script_node_t *script, interpreter_t *interpreter);
+
+/**
+  * Frees a compiled script, with every statement in it
+  * @param script the first statement of the script
+  */
+void free_script(script_node_t *script);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef __COREUTILS__H__
+#define __COREUTILS__H__
+
+/**
+  * Determines whether a command is one of the trivial utilities the shell can run itself, without
+  * an exec: echo, true, false, test, [ and printf
+  * @param name the name the command was run by
+  * @return nonzero if it is, zero otherwise
+  */
+int is_coreutil(const char *name);
+
+/**
+  * Runs one of the trivial utilities, behaving as the coreutils program of the same name does with
+  * the same arguments (echo takes -n, -e and -E; test and [ take the POSIX unary and binary
+  * operators, !, ( ), -a and -o; printf takes the usual conversions, %b, and reuses its format
+  * while arguments remain). Output goes to stdout and errors to stderr, through stdio, so the caller
+  * must flush stdout once it is done
+  * @param arguments the NULL terminated arguments, the first being the utility's name
+  * @return the utility's exit status
+  */
+int run_coreutil(char **arguments);
+
+#endif
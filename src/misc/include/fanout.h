@@ -0,0 +1,21 @@
+#ifndef __FANOUT__H__
+#define __FANOUT__H__
+
+#include <stddef.h>
+
+#define FANOUT_CHUNK (1024 * 1024)
+
+/**
+  * Copies everything from the pipe source to each of the pipes in branches until source reaches end
+  * of file, then closes them all. Each chunk is duplicated into all but one branch with tee(2) and
+  * spliced into the last, so the data never passes through userspace. Every branch must take a chunk
+  * before the next is read, so the slowest branch holds the producer back, as a single pipe would.
+  * If a tee only fits part of a chunk, that chunk is read out of source and the rest is written
+  * normally instead. A branch that exits early is dropped, and the others carry on
+  * @param source       the read end of the pipe the producer writes to
+  * @param branches     the write ends of the pipes the branches read from
+  * @param num_branches the number of elements in branches
+  */
+void distribute(int source, int *branches, size_t num_branches);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef __FILTER__H__
+#define __FILTER__H__
+
+#include <stddef.h>
+
+#include "../../types/include/status.h"
+
+#define FILTER_GREP 0
+#define FILTER_WC   1
+#define FILTER_HEAD 2
+#define FILTER_TAIL 3
+
+#define FILTER_BUFFER (1024 * 1024)
+#define FILTER_QUEUE  4
+
+/**
+  * One of the filters that can run inside the shell as a pipeline stage, selected by name: @grep
+  * [-F] [-v] [-c] pattern (the pattern is always a fixed string), @wc [-l] [-w] [-c], @head [-n N]
+  * and @tail [-n N]. Only the options of the filter's own type are used
+  */
+typedef struct
+{
+	unsigned short type;
+	char *pattern;
+	size_t pattern_length;
+	unsigned short invert;
+	unsigned short count_only;
+	unsigned short lines;
+	unsigned short words;
+	unsigned short bytes;
+	size_t limit;
+} filter_t;
+
+/**
+  * Determines whether a command is one of the built in filters, which are always named with an @
+  * so they are never mistaken for the programs they stand in for
+  * @param name the name the command was run by
+  * @return nonzero if it is, zero otherwise
+  */
+int is_filter(const char *name);
+
+/**
+  * Reads a filter's options and operands from its arguments
+  * @param arguments the NULL terminated arguments, the first being the filter's name
+  * @param filter    out param; the filter
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t parse_filter(char **arguments, filter_t *filter);
+
+/**
+  * Runs a chain of filters, each in a thread of its own, from input to output. The input is read
+  * with large reads into blocks of whole lines, which are handed from each filter to the next
+  * through short queues, so no data crosses a pipe between them. Lines are found with memchr and
+  * matched with memmem, and newlines counted a word at a time. A filter that needs no more input
+  * (a @head that has its lines, or any filter whose output has gone) stops the ones before it,
+  * and reading stops once the first has stopped
+  * @param filters the filters, in pipeline order
+  * @param count   the number of filters
+  * @param input   the descriptor the first filter reads
+  * @param output  the descriptor the last filter writes
+  * @return the exit status of the last filter: for @grep, 0 if any line was selected and 1
+  *         otherwise; 0 for the others
+  */
+int run_filters(filter_t *filters, size_t count, int input, int output);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef __HERE_DOCUMENT__H__
+#define __HERE_DOCUMENT__H__
+
+#include <sys/types.h>
+
+#include "../../types/include/command.h"
+#include "../../types/include/status.h"
+
+/**
+  * Reads the next line of input, newline included, into *line, growing it as getline does
+  * @param context whatever the reader needs to find its input
+  * @param line    in/out param; the buffer the line is placed in
+  * @param size    in/out param; the size of the buffer
+  * @return the number of characters read, or -1 at the end of the input
+  */
+typedef ssize_t (*line_reader_t)(void *context, char **line, size_t *size);
+
+/**
+  * Reads the body of every here-document in a command, in the order they appear on the line (along
+  * its pipes, then through each of its branches), each up to a line holding only its delimiter or
+  * the end of the input. Each line is written straight into a memfd as it is read, so a document is
+  * never held in memory more than once, and the memfd is sealed against any change before it is
+  * kept in the stage's here_document
+  * @param command   the command whose here-documents are read
+  * @param read_line reads the lines of the documents
+  * @param context   passed to read_line
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t read_here_documents(command_t *command, line_reader_t read_line, void *context);
+
+/**
+  * Creates a sealed memfd holding a here-string's word and a newline, positioned at its start
+  * @param word the here-string's word
+  * @return the memfd, or -1 if it could not be created
+  */
+int make_here_string(char *word);
+
+/**
+  * Determines whether any stage of a command, or of its branches, takes a here-document
+  * @param command the command to be checked
+  * @return nonzero if one does, zero otherwise
+  */
+int has_here_document(command_t *command);
+
+/**
+  * Closes the memfds holding the here-documents of every stage of a command and its branches
+  * @param command the command whose here-documents are closed
+  */
+void close_here_documents(command_t *command);
+
+#endif
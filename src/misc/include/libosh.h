@@ -0,0 +1,84 @@
+#ifndef __LIBOSH__H__
+#define __LIBOSH__H__
+
+#include <stddef.h>
+
+#include "../../types/include/status.h"
+
+/**
+  * A shell embedded in another program, built as libosh.a: its path, variables, aliases, history
+  * and current directory, which last from one osh_run to the next, and where the output of its
+  * commands goes. Every function here may be called from any thread, with any number of shells.
+  * Since the shell's stdout, stderr and current directory are the program's own while it runs, calls
+  * are serialized by a lock of the library's: a script waits for any script running in another
+  * shell, or from another thread, to finish. A shell's current directory is put in place only while
+  * its scripts run, so cd in one shell moves neither the program nor any other shell
+  */
+typedef struct osh_env osh_env_t;
+
+/**
+  * Receives output the commands of an embedded shell wrote, as it arrives
+  * @param context the context given to osh_set_output
+  * @param script  the index of the script that wrote it in its batch (0 for osh_run)
+  * @param data    the bytes written
+  * @param size    the number of bytes
+  */
+typedef void (*osh_output_t)(void *context, size_t script, const char *data, size_t size);
+
+/**
+  * Creates an embedded shell, with the program's environment imported as its exported variables.
+  * The path starts out empty, and no initialization file is read, so a program usually runs a set
+  * path first. The zygote cannot be started in an embedded shell, as it is the osh program itself
+  * @param env out param; the new shell
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t osh_env_create(osh_env_t **env);
+
+/**
+  * Destroys an embedded shell, ending any script it has open
+  * @param env the shell to be destroyed
+  */
+void osh_env_destroy(osh_env_t *env);
+
+/**
+  * Sets where the output of the shell's commands goes. With a callback, everything written to that
+  * descriptor while a script runs (by builtins, and by the programs the shell starts) is passed to
+  * it instead, and all of a script's output has been passed by the time the next script starts. NULL
+  * leaves the program's own stdout or stderr in place, which is the default. The callbacks are run
+  * on a thread of their own while the pipes are in place and the library's lock is held, so they
+  * must not write to stdout or stderr, or call into the library
+  * @param env     the shell
+  * @param out     the callback for stdout, or NULL
+  * @param err     the callback for stderr, or NULL
+  * @param context passed to both callbacks
+  */
+void osh_set_output(osh_env_t *env, osh_output_t out, osh_output_t err, void *context);
+
+/**
+  * Runs a script in the shell: one or more lines, as they would be typed, including control flow
+  * and here-documents. Errors in its commands are reported on its stderr, as in osh, and the script
+  * carries on. Nothing here exits the calling program: a command that cannot be run only ends the
+  * child forked for it. Waits for any script already running in the program, in any shell, to
+  * finish first. While output is being captured, whatever other threads of the program write to
+  * stdout or stderr is captured along with it, and while the script runs, the program's current
+  * directory is the shell's
+  * @param env    the shell
+  * @param script the text of the script, NUL terminated
+  * @param status out param; the exit status of the last command, or NULL
+  * @return a status code indicating whether an error occurred during execution of the function;
+  *         SHELL_EXIT if the script ran exit or quit, after which the shell can still be used
+  */
+status_t osh_run(osh_env_t *env, const char *script, int *status);
+
+/**
+  * Runs several scripts one after another, as osh_run would, with the output callbacks set up once
+  * for the whole batch. Stops after a script that runs exit or quit, returning SHELL_EXIT
+  * @param env      the shell
+  * @param scripts  the texts of the scripts
+  * @param count    the number of scripts
+  * @param statuses out param; the exit status each script that ran ended with, or NULL
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t osh_run_batch(osh_env_t *env, const char **scripts, size_t count, int *statuses);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef __LINE_EDITOR__H__
+#define __LINE_EDITOR__H__
+
+#include <sys/types.h>
+
+#include "../../types/include/environment.h"
+
+/**
+  * Prints the prompt and reads a line from standard input into *line, which is reallocated as needed
+  * in the same way getline does, and which ends in a newline just as getline's would. If standard
+  * input is a terminal, the line is read with the terminal in raw mode, allowing the line to be
+  * edited, commands from the history to be recalled with the up and down arrows, and commands to be
+  * completed with tab. Every redraw is sent to the terminal in a single write, and only the part of
+  * the line that changed is redrawn. Otherwise, the line is simply read with getline
+  * @param environment the current environment, supplying the history and the completions
+  * @param prompt      the prompt to print before the line
+  * @param line        in/out param; the buffer the line is placed in, as with getline
+  * @param size        in/out param; the size of the buffer, as with getline
+  * @return the number of characters read, including the newline, or -1 on end of file
+  */
+ssize_t edit_line(environment_t *environment, char *prompt, char **line, size_t *size);
+
+#endif
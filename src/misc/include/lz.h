@@ -0,0 +1,46 @@
+#ifndef __LZ__H__
+#define __LZ__H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+  * The most bytes lz_compress can produce from length bytes of input (incompressible input grows
+  * slightly, by the lengths of its runs of literals)
+  */
+#define LZ_BOUND(length) ((length) + (length) / 255 + 16)
+
+/**
+  * Compresses length bytes from in into out, which must have room for LZ_BOUND(length) bytes. The
+  * format is a series of sequences, each a token (the number of literals in the high four bits, the
+  * length of the match less four in the low four bits, either extended by bytes of 255 when it is 15),
+  * the literals, and a two byte little endian offset back to the match; the last sequence has
+  * literals only. Matches are found with a single hash table of four byte prefixes, favouring speed
+  * over ratio, and never refer to anything before in, so each call's output stands alone
+  * @param in     the data to be compressed
+  * @param length the number of bytes in in
+  * @param out    where the compressed data goes
+  * @return the number of bytes placed in out
+  */
+size_t lz_compress(const unsigned char *in, size_t length, unsigned char *out);
+
+/**
+  * Decompresses length bytes of lz_compress output from in into out, checking every length and
+  * offset against the bounds of both buffers
+  * @param in       the compressed data
+  * @param length   the number of bytes in in
+  * @param out      where the decompressed data goes
+  * @param capacity the number of bytes out has room for
+  * @return the number of bytes placed in out, or -1 if in is not valid compressed data
+  */
+ssize_t lz_decompress(const unsigned char *in, size_t length, unsigned char *out, size_t capacity);
+
+/**
+  * Computes the Adler-32 checksum of a buffer
+  * @param data   the data to be checksummed
+  * @param length the number of bytes in data
+  * @return the checksum
+  */
+uint32_t lz_checksum(const unsigned char *data, size_t length);
+
+#endif
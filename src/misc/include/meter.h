@@ -0,0 +1,23 @@
+#ifndef __METER__H__
+#define __METER__H__
+
+#define METER_CHUNK       (1024 * 1024)
+#define METER_INTERVAL_MS 1000
+
+/**
+  * Relays everything from the pipe in to the pipe out with splice(2), so the data never passes
+  * through userspace, until in reaches end of file or out is closed. While doing so, counts the bytes
+  * moved and the time spent waiting on each side: waiting for in to have data is time the downstream
+  * stage spent blocked reading, and waiting for out to have room is time the upstream stage spent
+  * blocked writing. A summary is written to report_fd at the end and, if live is set, a progress line
+  * every METER_INTERVAL_MS as well
+  * @param in        the read end of the pipe the upstream stage writes to
+  * @param out       the write end of the pipe the downstream stage reads from
+  * @param from      the name of the upstream stage
+  * @param to        the name of the downstream stage
+  * @param report_fd where the reports go
+  * @param live      whether to report progress while relaying
+  */
+void run_meter(int in, int out, const char *from, const char *to, int report_fd, unsigned short live);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef __OPTIMIZE__H__
+#define __OPTIMIZE__H__
+
+#include "../../types/include/command.h"
+
+/**
+  * Rewrites a pipeline (as set up by setup_pipes) into an equivalent one that needs fewer processes.
+  * A leading "cat file" or "cat < file" of a readable regular file becomes a < redirection of the
+  * next stage, and a "cat" with no arguments or redirections between two other stages is dropped.
+  * The head command itself is never changed, so that its arguments array can still be freed; if the
+  * head is dropped, the returned command is where the pipeline now starts. Stages dropped from the
+  * middle of the pipeline are freed
+  * @param command the head of the pipeline to be rewritten
+  * @return the head of the rewritten pipeline
+  */
+command_t *optimize_pipeline(command_t *command);
+
+#endif
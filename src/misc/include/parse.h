@@ -31,5 +31,16 @@ status_t parse_line(char *line, size_t chars_read, command_t *command);
   */
 status_t setup_pipes(command_t *command);
 
+/**
+  * Given an initially set up command, if that command fans out (producer |+ branch |+ branch), cuts
+  * the command's arguments off at the first |+ and makes each branch a separately allocated command,
+  * with its own pipes set up, chained from command->fanout through next_branch. As with setup_pipes,
+  * the branches' arguments all point into command's original array, so only the branch commands
+  * themselves need to be freed (free_branches does so). Pipes in command itself are not set up
+  * @param command the command to split into a producer and its branches
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t setup_fanout(command_t *command);
+
 
 #endif
@@ -0,0 +1,28 @@
+#ifndef __PIPE_SIZE__H__
+#define __PIPE_SIZE__H__
+
+#include <stddef.h>
+
+#define PIPE_MAX_SIZE_FILE "/proc/sys/fs/pipe-max-size"
+#define PIPE_AUTO_LIMIT    (1024 * 1024)
+
+/**
+  * Creates a pipe, as pipe2 does, then sets its buffer to size bytes with F_SETPIPE_SZ if size is
+  * nonzero. A size the kernel will not allow (over pipe-max-size, or over the user's limit on pipe
+  * memory) leaves the pipe at its default size rather than failing
+  * @param fds   out param; the read and write ends of the pipe, in that order
+  * @param flags the flags to pass to pipe2
+  * @param size  the size of the pipe's buffer in bytes, or zero for the kernel's default
+  * @return zero on success, -1 if the pipe could not be created
+  */
+int make_pipe(int fds[2], int flags, size_t size);
+
+/**
+  * Chooses a pipe size for "set pipesize auto": the largest size an unprivileged process may set,
+  * from /proc/sys/fs/pipe-max-size, but no more than PIPE_AUTO_LIMIT, since every pipe in a pipeline
+  * counts against the user's limit on pipe memory
+  * @return the chosen size in bytes, or zero (the kernel's default) if the maximum cannot be read
+  */
+size_t auto_pipe_size(void);
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef __SCRIPT_LOG__H__
+#define __SCRIPT_LOG__H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "../../types/include/status.h"
+#include "../../types/include/string_t.h"
+
+#define SCRIPT_LOG_RING     (4 * 1024 * 1024)
+#define SCRIPT_LOG_BATCH    64
+#define SCRIPT_LOG_WAIT_MS  20
+#define SCRIPT_LOG_SYNC_MS  1000
+#define SCRIPT_BLOCK        (64 * 1024)
+
+/**
+  * A compressed script file starts with SCRIPT_FILE_MAGIC and a version, and is followed by blocks,
+  * each a header of SCRIPT_BLOCK_MAGIC, the length of the block's output (with SCRIPT_BLOCK_COMMAND
+  * set if the block starts with a command's header), the length stored (with SCRIPT_BLOCK_STORED set
+  * if the output did not compress and is stored as it is), the Adler-32 checksum of the output, and
+  * the time the block's first record was queued in nanoseconds since the epoch, all little endian,
+  * then the stored bytes. Version 1 files have no time in their block headers. Blocks are compressed
+  * independently, so any block can be read on its own, and a damaged or truncated block only loses
+  * that block's output
+  */
+#define SCRIPT_FILE_MAGIC      "OSHZ"
+#define SCRIPT_FILE_VERSION    2
+#define SCRIPT_FILE_HEADER     8
+#define SCRIPT_BLOCK_MAGIC     "OZBK"
+#define SCRIPT_BLOCK_HEADER    24
+#define SCRIPT_BLOCK_HEADER_V1 16
+#define SCRIPT_BLOCK_STORED    0x80000000U
+#define SCRIPT_BLOCK_COMMAND   0x80000000U
+
+/**
+  * When the script file is fsynced: never, after every command's output has been written, or at
+  * most once every SCRIPT_LOG_SYNC_MS milliseconds
+  */
+#define SCRIPT_SYNC_NONE     0
+#define SCRIPT_SYNC_COMMAND  1
+#define SCRIPT_SYNC_INTERVAL 2
+
+/**
+  * The minimal state needed to submit writes through io_uring without liburing: the shared
+  * submission and completion rings, mapped from the kernel
+  */
+typedef struct
+{
+	int fd;
+	void *sq_map;
+	size_t sq_map_size;
+	void *cq_map;
+	size_t cq_map_size;
+	void *sqes_map;
+	size_t sqes_map_size;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	void *sqes;
+	void *cqes;
+} uring_t;
+
+/**
+  * A script file written by a background thread. Records (command headers, chunks of output, and
+  * the ends of commands, each with a timestamp) are placed in a single-producer/single-consumer
+  * ring by the tee engine's thread and written out in batches, with io_uring if the kernel allows
+  * it and writev otherwise.
+  * If the ring fills up, the producer waits at most SCRIPT_LOG_WAIT_MS for room before dropping the
+  * output, so a slow disk never holds a command up for long. The log is reference counted, since
+  * background commands may still be writing to it after endscript. If the log is compressed, the
+  * writer thread gathers output into blocks of up to SCRIPT_BLOCK bytes and compresses each before
+  * writing it, ending a block at the end of each command (or after SCRIPT_LOG_SYNC_MS without new
+  * output) so that a crash loses as little as possible, and starting one at each command's header.
+  * Each block carries the timestamp of its first record
+  */
+typedef struct
+{
+	int fd;
+	char *ring;
+	size_t head;
+	size_t tail;
+	unsigned short sync_policy;
+	unsigned short stopping;
+	unsigned short writer_waiting;
+	unsigned short producer_waiting;
+	size_t references;
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t has_records;
+	pthread_cond_t has_room;
+	uint64_t written_bytes;
+	uint64_t dropped_bytes;
+	uint64_t backpressured_bytes;
+	uint64_t stored_bytes;
+	uring_t uring;
+	unsigned short use_uring;
+	unsigned short compress;
+	unsigned short report;
+	unsigned char *block;
+	size_t block_length;
+	uint64_t block_time;
+	unsigned short block_command;
+	unsigned char *packed;
+} script_log_t;
+
+/**
+  * Creates a log writing to the file descriptor fd, which the log takes ownership of, and starts its
+  * writer thread. The log starts with one reference, held by the caller
+  * @param log         out param; the new log
+  * @param fd          the descriptor of the script file
+  * @param sync_policy one of the SCRIPT_SYNC_ constants
+  * @param compress    whether to write a compressed script file
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t create_script_log(script_log_t **log, int fd, unsigned short sync_policy, unsigned short compress);
+
+/**
+  * Adds a reference to the log
+  * @param log the log to be retained
+  */
+void retain_script_log(script_log_t *log);
+
+/**
+  * Removes a reference to the log. When the last reference is removed, everything in the ring is
+  * written out, the writer thread is stopped, the log's counters are printed if its report field is
+  * set, the file is closed, and the log is freed
+  * @param log the log to be released
+  */
+void release_script_log(script_log_t *log);
+
+/**
+  * Changes when the log's file is fsynced
+  * @param log         the log to be changed
+  * @param sync_policy one of the SCRIPT_SYNC_ constants
+  */
+void set_script_log_sync(script_log_t *log, unsigned short sync_policy);
+
+/**
+  * Queues a command header to be written. May only be called from the producer thread
+  * @param log    the log to write to
+  * @param header the header to be written
+  */
+void log_header(script_log_t *log, string_t *header);
+
+/**
+  * Reads exactly length bytes of a command's output from the descriptor fd straight into the ring,
+  * queueing them to be written. If there is no room, the bytes are still read, but are dropped. May
+  * only be called from the producer thread
+  * @param log    the log to write to
+  * @param fd     the descriptor holding at least length bytes of output
+  * @param length the number of bytes to be read
+  */
+void log_output(script_log_t *log, int fd, size_t length);
+
+/**
+  * Queues the end of a command's output, after which the file is fsynced under SCRIPT_SYNC_COMMAND.
+  * May only be called from the producer thread
+  * @param log the log to write to
+  */
+void log_command_end(script_log_t *log);
+
+/**
+  * Prints how many bytes the log has written, dropped, and had to wait for room for
+  * @param log the log whose counters are to be printed
+  */
+void print_script_log_stats(script_log_t *log);
+
+/**
+  * Writes the output held in a script file to out, decompressing it if it is a compressed script file
+  * and copying it as it is otherwise. Damaged blocks are skipped, with a count of them printed to
+  * stderr, and everything readable around them is still written
+  * @param fd         the descriptor of the script file
+  * @param out        where the output goes
+  * @param timestamps whether to put the time each command started before it, where the file has one
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t cat_script_log(int fd, int out, unsigned short timestamps);
+
+#endif
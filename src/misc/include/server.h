@@ -0,0 +1,80 @@
+#ifndef __SERVER__H__
+#define __SERVER__H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../types/include/status.h"
+
+#define SERVER_FLAG "--server"
+#define CLIENT_FLAG "--client"
+
+#define FRAME_COMMAND 'C'
+#define FRAME_STDOUT  'O'
+#define FRAME_STDERR  'E'
+#define FRAME_RESULT  'R'
+
+#define FRAME_MAX     (1024 * 1024)
+
+/**
+  * Runs one command line for a client, in a worker forked from the server for the job, with stdin
+  * /dev/null and stdout and stderr going back to the client
+  * @param context whatever the runner needs to run the line
+  * @param line    the command line, ending with a newline
+  * @return the exit status of the line
+  */
+typedef int (*job_runner_t)(void *context, char *line);
+
+/**
+  * Brings the state the workers are forked with up to date, in the server, before each job
+  * @param context whatever the runner needs to run a line
+  */
+typedef void (*job_refresher_t)(void *context);
+
+/**
+  * A command server: how to run a line, how to bring the shared state up to date first, and how many
+  * jobs may run at once
+  */
+typedef struct
+{
+	job_runner_t run;
+	job_refresher_t refresh;
+	void *context;
+	size_t workers;
+} server_t;
+
+/**
+  * The last frame of a job, once its command line has finished: its exit status, and the resources
+  * the line and everything it waited for used
+  */
+typedef struct
+{
+	int32_t status;
+	int64_t user_usec;
+	int64_t system_usec;
+	int64_t max_rss_kb;
+} job_result_t;
+
+/**
+  * Serves jobs on a Unix domain socket until the server is killed. Each connection is one job: the
+  * client sends a command frame, and gets back stdout and stderr frames as the output arrives, then a
+  * result frame. A frame is a type byte and a uint32_t length, then that many bytes. Each job is run
+  * by a worker forked from the server, so every job starts from the server's warm state (the path,
+  * the command index, aliases and variables) and nothing a job changes reaches the others; at most
+  * workers jobs run at once, and any more wait to be accepted
+  * @param path   the path of the socket, replacing anything already there
+  * @param server the server
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t run_server(const char *path, server_t *server);
+
+/**
+  * Sends a command line to a server and copies what comes back to stdout and stderr. With -t as the
+  * first word, the job's CPU time and peak memory are printed to stderr at the end as well
+  * @param path  the path of the server's socket
+  * @param words the NULL terminated words of the command line, joined with spaces
+  * @return the job's exit status, or 2 if there is no answer from the server
+  */
+int run_client(const char *path, char **words);
+
+#endif
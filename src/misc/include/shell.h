@@ -0,0 +1,84 @@
+#ifndef __SHELL__H__
+#define __SHELL__H__
+
+#include <stddef.h>
+
+#include "cache.h"
+#include "zygote.h"
+#include "../../types/include/alias.h"
+#include "../../types/include/command.h"
+#include "../../types/include/completion.h"
+#include "../../types/include/environment.h"
+#include "../../types/include/exec_index.h"
+#include "../../types/include/history.h"
+#include "../../types/include/jobs.h"
+#include "../../types/include/path.h"
+#include "../../types/include/status.h"
+#include "../../types/include/string_t.h"
+#include "../../types/include/variables.h"
+
+/**
+  * A whole shell: its environment and everything the environment points to, in one allocation, so
+  * that the osh program and a program embedding the shell through libosh set it up the same way
+  */
+typedef struct
+{
+	environment_t environment;
+	path_t path;
+	history_t history;
+	alias_table_t aliases;
+	string_t prompt;
+	completion_t completion;
+	exec_index_t exec_index;
+	tee_engine_t tee;
+	variable_table_t variables;
+	wildcard_cache_t wildcards;
+	zygote_t zygote;
+	cache_t cache;
+	job_table_t jobs;
+} shell_t;
+
+/**
+  * Creates a shell with an empty path, the default prompt, the builtins offered for completion, and
+  * the given environment variables imported as exported shell variables
+  * @param shell     out param; the new shell
+  * @param variables the NULL terminated environment to import, as with environ
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t create_shell(shell_t **shell, char **variables);
+
+/**
+  * Clears a shell's environment, stopping its zygote and closing any script, and frees it
+  * @param shell the shell to be destroyed
+  */
+void destroy_shell(shell_t *shell);
+
+/**
+  * Given a line of a particular size, evaluates/executes the resulting command in the given
+  * environment, returning whether the program should continue or not after this function as a
+  * boolean value
+  * @param line        the line to be evaluated
+  * @param size        the size of the line
+  * @param environment the current environment in which to evaluate
+  * @return whether the program should continue executing
+  */
+unsigned short eval_print(char *line, size_t size, environment_t *environment);
+
+/**
+  * If command is a builtin command, this function will execute it, setting is_builtin appropriately
+  * @param environment the current environment in which to execute the command
+  * @param command     the command to be executed
+  * @param is_builtin  out param; is set to true if the command is actually a builtin, false if not
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t execute_builtin(environment_t *environment, command_t *command, unsigned short *is_builtin);
+
+/**
+  * Executes the command indicated by command, in the current environment
+  * @param environment the current environment in which to execute the command
+  * @param command     the command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t execute_external(environment_t *environment, command_t *command);
+
+#endif
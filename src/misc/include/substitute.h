@@ -0,0 +1,60 @@
+#ifndef __SUBSTITUTE__H__
+#define __SUBSTITUTE__H__
+
+#include "arena.h"
+#include "wildcard.h"
+#include "../../types/include/command.h"
+#include "../../types/include/status.h"
+
+/**
+  * Runs the text inside a $(...) as a command line, in a forked child whose stdout is already the
+  * pipe the output is captured from; it must exit rather than return, with the command's status
+  * @param context whatever the runner needs to run the command
+  * @param text    the command line, without the $( and )
+  */
+typedef void (*substitution_runner_t)(void *context, char *text);
+
+/**
+  * Finds the value of a variable for $name or ${name}
+  * @param context whatever the lookup needs to find the variable
+  * @param name    the name of the variable
+  * @return the value, or NULL if there is no such variable (which expands to nothing)
+  */
+typedef char *(*variable_lookup_t)(void *context, char *name);
+
+/**
+  * Everything expanding a command line needs: where the results are kept, how to run a $(...) and
+  * look up a $name, the last exit status, which $? expands to and each $(...) updates, the
+  * directory listings globs are matched against, and the size set pipesize gives the pipe each
+  * $(...) is captured through
+  */
+typedef struct
+{
+	arena_t *arena;
+	substitution_runner_t run;
+	variable_lookup_t lookup;
+	void *context;
+	int *status;
+	wildcard_cache_t *wildcards;
+	size_t *pipe_size;
+} expansion_t;
+
+/**
+  * Expands every $(...), $name, ${name} and $? in the arguments and redirection targets of every
+  * stage of a command, along its pipes and through each of its branches; an argument in single
+  * quotes is left alone. Each $(...) runs in a child, and its stdout is read into the arena with
+  * large reads, trailing newlines removed. An argument that is a single $(...) becomes the words of
+  * its output, split on white space in place, so the output is never copied; anything else is
+  * joined into a new string in the arena first. An argument in double quotes, or a redirection
+  * target, is not split. Each unquoted word with a wildcard, once expanded and split, is then
+  * replaced by the sorted paths it matches, or left as it is if it matches none; redirection targets
+  * are never globbed. A stage whose arguments change gets a new arguments array, from the arena,
+  * so the original array (which the caller frees) is left alone. A command may expand to nothing at
+  * all (argc of 1), in which case there is nothing to run, but any other stage that does is an error
+  * @param command   the command whose arguments are expanded
+  * @param expansion how to expand it, and where to keep the results until the command is done
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t expand_command(command_t *command, expansion_t *expansion);
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef __TEE__H__
+#define __TEE__H__
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "../../types/include/command.h"
+#include "../../types/include/status.h"
+#include "../../types/include/string_t.h"
+#include "script_log.h"
+
+#define TEE_CHUNK (64 * 1024)
+
+/**
+  * A command whose output is being copied to both the terminal and the script log. The header (the
+  * command itself) is logged before any of the command's output
+  */
+typedef struct tee_job_t
+{
+	script_log_t *log;
+	string_t header;
+	size_t open_streams;
+	unsigned short done;
+	unsigned short detached;
+} tee_job_t;
+
+/**
+  * One of the output streams (stdout or stderr) of a command being copied. source is the read end of
+  * the pipe the command writes to, terminal is where the shell's own copy of that stream goes, and
+  * scratch is the pipe the data is duplicated into with tee(2), at most chunk bytes at a time
+  */
+typedef struct tee_stream_t
+{
+	int source;
+	int terminal;
+	int scratch[2];
+	size_t chunk;
+	tee_job_t *job;
+	struct tee_stream_t *next;
+} tee_stream_t;
+
+/**
+  * A thread that copies the output of commands to the terminal and to the script log, using tee(2)
+  * and splice(2) to duplicate it for the terminal, and reading the original straight into the log's
+  * ring, from which the log's own writer thread writes it to the script file
+  */
+typedef struct
+{
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t finished;
+	int wakeup[2];
+	tee_stream_t *streams;
+	tee_stream_t *pending;
+	pid_t owner;
+	size_t pipe_size;
+	unsigned short running;
+	unsigned short stopping;
+} tee_engine_t;
+
+/**
+  * Starts the engine's thread, if it is not already running
+  * @param engine the engine to be started
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t start_tee_engine(tee_engine_t *engine);
+
+/**
+  * Sets up the copying of a command's output to the script log. The descriptors the command should
+  * use as its stdout and stderr are placed in fds; the caller must close them once the command has
+  * been forked
+  * @param engine  the engine that will copy the output
+  * @param log     the script log; the job holds a reference to it until it is freed
+  * @param command the command, which is written to the script file as a header
+  * @param fds     out param; the descriptors for the command's stdout and stderr, in that order
+  * @param job     out param; the job to pass to wait_tee_job or detach_tee_job
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t tee_command(tee_engine_t *engine, script_log_t *log, command_t *command, int fds[2], tee_job_t **job);
+
+/**
+  * Waits until all of a job's output has been copied, then frees the job
+  * @param engine the engine copying the job's output
+  * @param job    the job to wait for
+  */
+void wait_tee_job(tee_engine_t *engine, tee_job_t *job);
+
+/**
+  * Lets a job's output continue to be copied without anyone waiting for it (as for a background
+  * command); the engine frees the job when it is done
+  * @param engine the engine copying the job's output
+  * @param job    the job to detach
+  */
+void detach_tee_job(tee_engine_t *engine, tee_job_t *job);
+
+/**
+  * Stops the engine's thread, abandoning any output still being copied. Does nothing in any process
+  * other than the one that started the engine (i.e., in a forked child)
+  * @param engine the engine to be stopped
+  */
+void stop_tee_engine(tee_engine_t *engine);
+
+#endif
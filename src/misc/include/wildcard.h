@@ -0,0 +1,111 @@
+#ifndef __WILDCARD__H__
+#define __WILDCARD__H__
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "arena.h"
+#include "../../types/include/status.h"
+
+#define WILDCARD_CACHE_SIZE  16
+#define WILDCARD_CACHE_TTL   5
+#define WILDCARD_MAX_PATTERN 63
+#define WILDCARD_READ_SIZE   (256 * 1024)
+
+/**
+  * A pattern for a single path component, compiled into a bit-parallel automaton: state i is set
+  * while the first i elements have matched, and each element is a set of characters or a *. For each
+  * character, matches has bit i set if element i (not a *) accepts it, so a step is a shift and a
+  * mask, whatever the pattern, with no backtracking
+  */
+typedef struct
+{
+	uint64_t matches[256];
+	uint64_t stars;
+	uint64_t accept;
+	unsigned short leading_dot;
+} wildcard_pattern_t;
+
+/**
+  * The names in a directory, read in large getdents64 batches, with what it was when they were read
+  */
+typedef struct
+{
+	dev_t device;
+	ino_t inode;
+	struct timespec mtime;
+	time_t read_at;
+	char *names;
+	size_t *offsets;
+	unsigned char *types;
+	size_t count;
+	size_t last_used;
+} wildcard_listing_t;
+
+/**
+  * A short-lived cache of directory listings, keyed by the directory's device, inode and mtime, so
+  * that repeated globs in the same directory do not read it again. A listing is used for at most
+  * WILDCARD_CACHE_TTL seconds, and a directory changed in the same second it was read is never
+  * cached, since a later change in that second would not show in its mtime
+  */
+typedef struct
+{
+	wildcard_listing_t listings[WILDCARD_CACHE_SIZE];
+	size_t clock;
+} wildcard_cache_t;
+
+/**
+  * Determines whether a word has any wildcards: *, ?, or a [ with a ] after it
+  * @param word the word to be checked
+  * @return nonzero if it does, zero otherwise
+  */
+int has_wildcards(char *word);
+
+/**
+  * Expands a glob pattern into the paths that match it, component by component. * and ? match any
+  * run of characters and any single character, [abc], [a-z] and [!abc] (or [^abc]) a set of
+  * characters. A leading . must be matched by a . in the pattern. A component longer than
+  * WILDCARD_MAX_PATTERN elements matches nothing. The matches are sorted bytewise with a radix sort
+  * @param cache   the directory listing cache
+  * @param arena   where the matching paths and the array of them are kept
+  * @param pattern the pattern to be expanded
+  * @param matches out param; the matching paths, in order
+  * @param count   out param; the number of matching paths (zero if none)
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t expand_wildcards(wildcard_cache_t *cache, arena_t *arena, char *pattern, char ***matches, size_t *count);
+
+/**
+  * Compiles a single path component's pattern
+  * @param text    the pattern, up to its end or length characters
+  * @param length  the number of characters in the pattern
+  * @param pattern out param; the compiled pattern
+  * @return zero if the pattern is too long to compile, nonzero otherwise
+  */
+int compile_wildcard(const char *text, size_t length, wildcard_pattern_t *pattern);
+
+/**
+  * Matches a name against a compiled pattern
+  * @param pattern the compiled pattern
+  * @param name    the name to be matched
+  * @return nonzero if it matches, zero otherwise
+  */
+int match_wildcard(wildcard_pattern_t *pattern, const char *name);
+
+/**
+  * Sorts an array of strings bytewise with a most significant digit first radix sort
+  * @param strings the strings to be sorted
+  * @param count   the number of strings
+  * @return zero if there was no memory for the sort (leaving the strings as they were), nonzero
+  *         otherwise
+  */
+int radix_sort_strings(char **strings, size_t count);
+
+/**
+  * Frees the listings held in the cache
+  * @param cache the cache to be cleared
+  */
+void clear_wildcard_cache(wildcard_cache_t *cache);
+
+#endif
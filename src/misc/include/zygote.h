@@ -0,0 +1,76 @@
+#ifndef __ZYGOTE__H__
+#define __ZYGOTE__H__
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "../../types/include/status.h"
+
+#define ZYGOTE_FLAG       "--zygote"
+#define ZYGOTE_MAX_STAGES 64
+#define ZYGOTE_EXECUTABLE "/proc/self/exe"
+
+/**
+  * The shell's end of a zygote: a small helper process, started by re-executing the shell, so that
+  * none of the shell's memory is copied into it, which forks and execs commands on the shell's
+  * behalf. socket is -1 while no zygote is running. executable is the osh program to start it from,
+  * ZYGOTE_EXECUTABLE in osh itself, or NULL where there is none, as in a program embedding libosh
+  */
+typedef struct
+{
+	pid_t pid;
+	int socket;
+	const char *executable;
+} zygote_t;
+
+/**
+  * One stage of a pipeline to be launched by the zygote: the full path of the program, its
+  * arguments, and the descriptors to become its stdin, stdout and stderr
+  */
+typedef struct
+{
+	char *path;
+	char **arguments;
+	int fds[3];
+} launch_t;
+
+/**
+  * Starts a zygote, unless one is already running. The zygote is the shell's own executable, run
+  * with ZYGOTE_FLAG and the number of its end of a socketpair
+  * @param zygote the zygote
+  * @return a status code indicating whether an error occurred during execution of the function;
+  *         FORK_ERROR if the zygote could not be started, or there is no executable to start it from
+  */
+status_t start_zygote(zygote_t *zygote);
+
+/**
+  * Stops a zygote, if one is running, and waits for it to exit
+  * @param zygote the zygote
+  */
+void stop_zygote(zygote_t *zygote);
+
+/**
+  * Has the zygote launch a pipeline and waits until the zygote reports it done. The descriptors are
+  * passed over the socket with SCM_RIGHTS, along with one for the shell's current directory, so the
+  * stages start where the shell is. The stages' descriptors are closed here, whether or not they
+  * could be sent, so that no pipe is held open in the shell while its stages run
+  * @param zygote      the zygote
+  * @param stages      the stages, in pipeline order
+  * @param count       the number of stages, at most ZYGOTE_MAX_STAGES
+  * @param envp        the environment the stages are run with
+  * @param wait_status out param; the status of the last stage, as waitpid gives it
+  * @return a status code indicating whether an error occurred during execution of the function;
+  *         PIPE_ERROR if the request could not be sent, in which case nothing was launched, or
+  *         CHILD_FORK_ERR if the zygote could not fork the last stage
+  */
+status_t zygote_launch(zygote_t *zygote, launch_t *stages, size_t count, char **envp, int *wait_status);
+
+/**
+  * The zygote itself: serves launch requests from the shell, one at a time, until the shell closes
+  * its end of the socket
+  * @param socket the zygote's end of the socket
+  * @return the zygote's exit status
+  */
+int run_zygote(int socket);
+
+#endif
@@ -0,0 +1,131 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/arena.h"
+
+/**
+  * Adds a new block, with room for at least size bytes, to the front of the arena
+  * @param arena the arena to add the block to
+  * @param size  the number of bytes the block must have room for
+  * @return the block, or NULL if it could not be allocated
+  */
+arena_block_t *arena_add_block(arena_t *arena, size_t size);
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+	size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+	arena_block_t *block = arena->blocks;
+	if (block == NULL || block->size - block->used < size)
+	{
+		block = arena_add_block(arena, size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE);
+		if (block == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	void *memory = block->data + block->used;
+	block->used += size;
+	return memory;
+}
+
+char *arena_read_fd(arena_t *arena, int fd, size_t *length)
+{
+	//start in the free end of the current block if a read's worth fits there
+	arena_block_t *block = arena->blocks;
+	if (block == NULL || block->size - block->used < ARENA_READ_SIZE + 1)
+	{
+		block = arena_add_block(arena, ARENA_BLOCK_SIZE);
+		if (block == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	size_t start = block->used;
+	*length = 0;
+	while (1)
+	{
+		if (block->size - start - *length < ARENA_READ_SIZE + 1)
+		{
+			if (start > 0)
+			{
+				//move what has been read so far to a block of its own, which can then grow in place
+				arena_block_t *own = arena_add_block(arena, 4 * ARENA_BLOCK_SIZE + *length);
+				if (own == NULL)
+				{
+					return NULL;
+				}
+				memcpy(own->data, block->data + start, *length);
+				block = own;
+				start = 0;
+			}
+			else
+			{
+				size_t size = 2 * block->size;
+				arena_block_t *grown = realloc(block, sizeof *grown + size);
+				if (grown == NULL)
+				{
+					return NULL;
+				}
+				grown->size = size;
+				//an own block is always at the front of the list
+				arena->blocks = grown;
+				block = grown;
+			}
+		}
+
+		ssize_t result = read(fd, block->data + start + *length, block->size - start - *length - 1);
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result < 0)
+		{
+			return NULL;
+		}
+		if (result == 0)
+		{
+			break;
+		}
+		*length += result;
+	}
+
+	char *bytes = block->data + start;
+	bytes[*length] = '\0';
+	block->used = (start + *length + 1 + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+	if (block->used > block->size)
+	{
+		block->used = block->size;
+	}
+	return bytes;
+}
+
+void arena_free(arena_t *arena)
+{
+	arena_block_t *block = arena->blocks;
+	while (block != NULL)
+	{
+		arena_block_t *next = block->next;
+		free(block);
+		block = next;
+	}
+	arena->blocks = NULL;
+}
+
+arena_block_t *arena_add_block(arena_t *arena, size_t size)
+{
+	arena_block_t *block = malloc(sizeof *block + size);
+	if (block == NULL)
+	{
+		return NULL;
+	}
+
+	block->next = arena->blocks;
+	block->size = size;
+	block->used = 0;
+	arena->blocks = block;
+	return block;
+}
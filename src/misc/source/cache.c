@@ -0,0 +1,601 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/cache.h"
+
+#define CACHE_ENTRIES   "/entries"
+#define CACHE_OBJECTS   "/objects"
+#define CACHE_TEMPORARY "tmp."
+#define CACHE_BUFFER    (64 * 1024)
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME  1099511628211ULL
+
+/**
+  * One entry of the store, as eviction sees it: its file's name, the bytes it accounts for, its own
+  * and its objects', and its record
+  */
+typedef struct
+{
+	char name[32];
+	uint64_t cost;
+	cache_record_t record;
+} cache_entry_t;
+
+/**
+  * Adds a word to a key, with its NUL, so that no two lists of words run together into the same key,
+  * and then, if it names a file or directory, its device, inode, size and mtime
+  * @param key  the key
+  * @param word the word
+  */
+void add_cache_word(string_t *key, char *word);
+
+/**
+  * Finds the store's directory from $HOME, if that has not been done yet, and creates it and its
+  * entries and objects directories if they are not there
+  * @param cache the cache
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t open_cache(cache_t *cache);
+
+/**
+  * Continues a 64 bit FNV-1a hash over some bytes
+  * @param hash  the hash so far, FNV_OFFSET to start
+  * @param bytes the bytes
+  * @param size  the number of bytes
+  * @return the hash
+  */
+uint64_t cache_hash(uint64_t hash, const char *bytes, size_t size);
+
+/**
+  * Writes the path of an object of the store into a buffer
+  * @param cache  the cache
+  * @param hash   the hash of the object's contents
+  * @param size   the size of the object
+  * @param path   out param; the path
+  * @param length the size of the buffer
+  */
+void object_path(cache_t *cache, uint64_t hash, uint64_t size, char *path, size_t length);
+
+/**
+  * Copies everything in a descriptor into the store as an object, unless one with the same contents
+  * is already there. The object is written under a temporary name and then linked into place, so
+  * that another shell never sees half of it
+  * @param cache the cache
+  * @param from  the descriptor, read from its start
+  * @param hash  out param; the hash of the contents
+  * @param size  out param; the size of the contents
+  * @return a status code indicating whether an error occurred during execution of the function;
+  *         EXISTS_ERROR if an object with the same hash and size but other contents is there
+  */
+status_t store_object(cache_t *cache, int from, uint64_t *hash, uint64_t *size);
+
+/**
+  * Determines whether the object at a path holds exactly what a descriptor does, since FNV-1a is
+  * not collision resistant and two outputs can share a hash and size
+  * @param path the object's path
+  * @param from the descriptor, read from its start
+  * @param size the number of bytes in the descriptor
+  * @return nonzero if the contents are the same, zero if not or if the object could not be read
+  */
+int same_object(const char *path, int from, uint64_t size);
+
+/**
+  * Evicts the least recently used entries until what the rest account for is under the limit, then
+  * removes the objects that none of them use
+  * @param cache the cache
+  */
+void evict_cached(cache_t *cache);
+
+/**
+  * Counts the files in a directory of the store and the bytes they hold
+  * @param directory the directory
+  * @param files     out param; the number of files
+  * @param bytes     out param; the number of bytes
+  */
+void measure_cached(const char *directory, size_t *files, size_t *bytes);
+
+/**
+  * Returns the current time in nanoseconds, for when an entry was last used
+  * @return the time
+  */
+uint64_t cache_clock(void);
+
+/**
+  * Orders entries from the least to the most recently used, for qsort
+  * @param a the first entry
+  * @param b the second entry
+  * @return negative, zero or positive as a was used before, with, or after b
+  */
+int compare_cache_entries(const void *a, const void *b);
+
+status_t make_cache_key(command_t *command, char **inputs, size_t count, string_t *key)
+{
+	char directory[PATH_MAX];
+	if (getcwd(directory, sizeof directory) == NULL)
+	{
+		return CACHE_ERROR;
+	}
+
+	//the directory goes in by its path alone; with its mtime, any file made in it would change the key
+	string_view_t view = { directory, strlen(directory) + 1 };
+	string_concatenate_view(key, view);
+
+	command_t *stage;
+	for (stage = command; stage != NULL; stage = stage->pipe)
+	{
+		size_t i;
+		for (i = 0; i < stage->argc - 1; i++)
+		{
+			add_cache_word(key, stage->arguments[i]);
+		}
+		if (stage->input != NULL)
+		{
+			add_cache_word(key, "<");
+			add_cache_word(key, stage->input);
+		}
+		add_cache_word(key, "|");
+	}
+
+	size_t i;
+	for (i = 0; i < count; i++)
+	{
+		add_cache_word(key, inputs[i]);
+	}
+
+	return SUCCESS;
+}
+
+status_t find_cached(cache_t *cache, string_t *key, cache_record_t *record, unsigned short *hit)
+{
+	*hit = 0;
+	status_t error = open_cache(cache);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	char path[PATH_MAX];
+	snprintf(path, sizeof path, "%s%s/%016llx", cache->directory, CACHE_ENTRIES, (unsigned long long) cache_hash(FNV_OFFSET, key->array, key->elements));
+	int fd = open(path, O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+	{
+		cache->misses++;
+		return SUCCESS;
+	}
+
+	//the key is stored after the record, so a different key with the same hash is a miss
+	char *stored = malloc(key->elements + 1);
+	if (stored == NULL)
+	{
+		close(fd);
+		return MEMORY_ERROR;
+	}
+	unsigned short same = read(fd, record, sizeof *record) == sizeof *record && record->key_size == key->elements;
+	same = same && read(fd, stored, key->elements + 1) == (ssize_t) key->elements && memcmp(stored, key->array, key->elements) == 0;
+	free(stored);
+
+	//another shell may have evicted the objects since; that is a miss too
+	char object[PATH_MAX];
+	if (same)
+	{
+		object_path(cache, record->output_hash, record->output_size, object, sizeof object);
+		same = access(object, R_OK) == 0;
+		object_path(cache, record->error_hash, record->error_size, object, sizeof object);
+		same = same && access(object, R_OK) == 0;
+	}
+
+	//eviction goes by when each entry was last used
+	if (same)
+	{
+		record->used = cache_clock();
+		pwrite(fd, &record->used, sizeof record->used, offsetof(cache_record_t, used));
+		cache->hits++;
+		*hit = 1;
+	}
+	else
+	{
+		cache->misses++;
+	}
+
+	close(fd);
+	return SUCCESS;
+}
+
+status_t replay_cached(cache_t *cache, cache_record_t *record, int output, int error)
+{
+	uint64_t hashes[2] = { record->output_hash, record->error_hash };
+	uint64_t sizes[2] = { record->output_size, record->error_size };
+	int targets[2] = { output, error };
+	size_t i;
+	for (i = 0; i < 2; i++)
+	{
+		char path[PATH_MAX];
+		object_path(cache, hashes[i], sizes[i], path, sizeof path);
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			return CACHE_ERROR;
+		}
+
+		status_t copied = copy_cached(fd, targets[i]);
+		close(fd);
+		if (copied != SUCCESS)
+		{
+			return copied;
+		}
+	}
+
+	return SUCCESS;
+}
+
+status_t store_cached(cache_t *cache, string_t *key, int status, int output, int error)
+{
+	status_t result = open_cache(cache);
+	cache_record_t record = { cache_clock(), status, 0, 0, 0, 0, key->elements };
+	if (result == SUCCESS)
+	{
+		result = store_object(cache, output, &record.output_hash, &record.output_size);
+	}
+	if (result == SUCCESS)
+	{
+		result = store_object(cache, error, &record.error_hash, &record.error_size);
+	}
+
+	//output that collides with another object is left uncached rather than stored under its name
+	if (result == EXISTS_ERROR)
+	{
+		return SUCCESS;
+	}
+	if (result != SUCCESS)
+	{
+		return result;
+	}
+
+	//the entry is written whole under a temporary name and renamed over any older one
+	char temporary[PATH_MAX];
+	char path[PATH_MAX];
+	snprintf(temporary, sizeof temporary, "%s%s/%sXXXXXX", cache->directory, CACHE_ENTRIES, CACHE_TEMPORARY);
+	snprintf(path, sizeof path, "%s%s/%016llx", cache->directory, CACHE_ENTRIES, (unsigned long long) cache_hash(FNV_OFFSET, key->array, key->elements));
+	int fd = mkostemp(temporary, O_CLOEXEC);
+	if (fd < 0)
+	{
+		return CACHE_ERROR;
+	}
+	unsigned short written = write(fd, &record, sizeof record) == sizeof record && write(fd, key->array, key->elements) == (ssize_t) key->elements;
+	close(fd);
+	if (!written || rename(temporary, path) < 0)
+	{
+		unlink(temporary);
+		return CACHE_ERROR;
+	}
+
+	evict_cached(cache);
+	return SUCCESS;
+}
+
+status_t copy_cached(int from, int to)
+{
+	char buffer[CACHE_BUFFER];
+	off_t offset = 0;
+	ssize_t received;
+	while ((received = pread(from, buffer, sizeof buffer, offset)) > 0 || (received < 0 && errno == EINTR))
+	{
+		ssize_t sent = 0;
+		while (sent < received)
+		{
+			ssize_t wrote = write(to, buffer + sent, received - sent);
+			if (wrote < 0 && errno != EINTR)
+			{
+				return CACHE_ERROR;
+			}
+			sent += wrote > 0 ? wrote : 0;
+		}
+		offset += received > 0 ? received : 0;
+	}
+
+	return received < 0 ? CACHE_ERROR : SUCCESS;
+}
+
+status_t print_cache_stats(cache_t *cache)
+{
+	status_t error = open_cache(cache);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	char path[PATH_MAX];
+	size_t entries, objects, entry_bytes, object_bytes;
+	snprintf(path, sizeof path, "%s%s", cache->directory, CACHE_ENTRIES);
+	measure_cached(path, &entries, &entry_bytes);
+	snprintf(path, sizeof path, "%s%s", cache->directory, CACHE_OBJECTS);
+	measure_cached(path, &objects, &object_bytes);
+
+	fprintf(stdout, "Cache: %s\n", cache->directory);
+	fprintf(stdout, "Entries: %zu, objects: %zu\n", entries, objects);
+	fprintf(stdout, "Bytes: %zu of %zu\n", entry_bytes + object_bytes, cache->limit);
+	fprintf(stdout, "Hits: %zu, misses: %zu, evictions: %zu\n", cache->hits, cache->misses, cache->evictions);
+	return SUCCESS;
+}
+
+void add_cache_word(string_t *key, char *word)
+{
+	string_view_t view = { word, strlen(word) + 1 };
+	string_concatenate_view(key, view);
+
+	struct stat info;
+	char found = stat(word, &info) == 0;
+	view.start = &found;
+	view.length = 1;
+	string_concatenate_view(key, view);
+	if (found)
+	{
+		uint64_t identity[5] = { info.st_dev, info.st_ino, info.st_size, info.st_mtim.tv_sec, info.st_mtim.tv_nsec };
+		view.start = (char *) identity;
+		view.length = sizeof identity;
+		string_concatenate_view(key, view);
+	}
+}
+
+void clear_cache(cache_t *cache)
+{
+	free(cache->directory);
+	cache->directory = NULL;
+}
+
+status_t open_cache(cache_t *cache)
+{
+	if (cache->directory == NULL)
+	{
+		const char *home = getenv("HOME");
+		if (home == NULL || (cache->directory = malloc(strlen(home) + sizeof CACHE_DIRECTORY)) == NULL)
+		{
+			return CACHE_ERROR;
+		}
+		sprintf(cache->directory, "%s%s", home, CACHE_DIRECTORY);
+	}
+
+	char path[PATH_MAX];
+	const char *subdirectories[] = { "", CACHE_ENTRIES, CACHE_OBJECTS };
+	size_t i;
+	for (i = 0; i < sizeof subdirectories / sizeof *subdirectories; i++)
+	{
+		snprintf(path, sizeof path, "%s%s", cache->directory, subdirectories[i]);
+		if (mkdir(path, 0700) < 0 && errno != EEXIST)
+		{
+			return CACHE_ERROR;
+		}
+	}
+
+	return SUCCESS;
+}
+
+uint64_t cache_hash(uint64_t hash, const char *bytes, size_t size)
+{
+	size_t i;
+	for (i = 0; i < size; i++)
+	{
+		hash ^= (unsigned char) bytes[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+void object_path(cache_t *cache, uint64_t hash, uint64_t size, char *path, size_t length)
+{
+	snprintf(path, length, "%s%s/%016llx-%llu", cache->directory, CACHE_OBJECTS, (unsigned long long) hash, (unsigned long long) size);
+}
+
+status_t store_object(cache_t *cache, int from, uint64_t *hash, uint64_t *size)
+{
+	char temporary[PATH_MAX];
+	snprintf(temporary, sizeof temporary, "%s%s/%sXXXXXX", cache->directory, CACHE_OBJECTS, CACHE_TEMPORARY);
+	int fd = mkostemp(temporary, O_CLOEXEC);
+	if (fd < 0)
+	{
+		return CACHE_ERROR;
+	}
+
+	//the contents are hashed on the way through, so they are only read once
+	char buffer[CACHE_BUFFER];
+	*hash = FNV_OFFSET;
+	*size = 0;
+	ssize_t received;
+	unsigned short written = 1;
+	while (written && ((received = pread(from, buffer, sizeof buffer, *size)) > 0 || (received < 0 && errno == EINTR)))
+	{
+		if (received > 0)
+		{
+			*hash = cache_hash(*hash, buffer, received);
+			*size += received;
+			written = write(fd, buffer, received) == received;
+		}
+	}
+	close(fd);
+
+	//an object with the same name is only the same object if its bytes match, in which case the new
+	//copy is not needed
+	char path[PATH_MAX];
+	object_path(cache, *hash, *size, path, sizeof path);
+	status_t error = written && received == 0 && link(temporary, path) == 0 ? SUCCESS : CACHE_ERROR;
+	if (error != SUCCESS && written && received == 0 && errno == EEXIST)
+	{
+		error = same_object(path, from, *size) ? SUCCESS : EXISTS_ERROR;
+	}
+	unlink(temporary);
+	return error;
+}
+
+int same_object(const char *path, int from, uint64_t size)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return 0;
+	}
+
+	char stored[CACHE_BUFFER];
+	char buffer[CACHE_BUFFER];
+	uint64_t offset = 0;
+	int same = 1;
+	while (same && offset < size)
+	{
+		size_t wanted = size - offset < sizeof buffer ? size - offset : sizeof buffer;
+		ssize_t got = pread(fd, stored, wanted, offset);
+		ssize_t received = pread(from, buffer, wanted, offset);
+		if ((got < 0 && errno == EINTR) || (received < 0 && errno == EINTR))
+		{
+			continue;
+		}
+		same = got == (ssize_t) wanted && received == (ssize_t) wanted && memcmp(stored, buffer, wanted) == 0;
+		offset += wanted;
+	}
+
+	//the object must not hold anything past the end either
+	same = same && pread(fd, stored, 1, size) == 0;
+	close(fd);
+	return same;
+}
+
+void evict_cached(cache_t *cache)
+{
+	char path[PATH_MAX];
+	size_t entries, objects, entry_bytes, object_bytes;
+	snprintf(path, sizeof path, "%s%s", cache->directory, CACHE_ENTRIES);
+	measure_cached(path, &entries, &entry_bytes);
+	snprintf(path, sizeof path, "%s%s", cache->directory, CACHE_OBJECTS);
+	measure_cached(path, &objects, &object_bytes);
+	if (entry_bytes + object_bytes <= cache->limit)
+	{
+		return;
+	}
+
+	snprintf(path, sizeof path, "%s%s", cache->directory, CACHE_ENTRIES);
+	DIR *directory = opendir(path);
+	cache_entry_t *list = malloc((entries + 1) * sizeof *list);
+	if (directory == NULL || list == NULL)
+	{
+		if (directory != NULL)
+		{
+			closedir(directory);
+		}
+		free(list);
+		return;
+	}
+
+	//each entry is charged for its objects in full, so shared objects make this an overestimate,
+	//and getting it under the limit always gets the store under it
+	size_t count = 0;
+	uint64_t total = 0;
+	struct dirent *found;
+	while ((found = readdir(directory)) != NULL && count < entries + 1)
+	{
+		cache_entry_t *entry = list + count;
+		struct stat info;
+		int fd = found->d_name[0] == '.' || strncmp(found->d_name, CACHE_TEMPORARY, strlen(CACHE_TEMPORARY)) == 0 ? -1 : openat(dirfd(directory), found->d_name, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			continue;
+		}
+		if (fstat(fd, &info) == 0 && read(fd, &entry->record, sizeof entry->record) == sizeof entry->record && strlen(found->d_name) < sizeof entry->name)
+		{
+			strcpy(entry->name, found->d_name);
+			entry->cost = info.st_size + entry->record.output_size + entry->record.error_size;
+			total += entry->cost;
+			count++;
+		}
+		close(fd);
+	}
+
+	qsort(list, count, sizeof *list, compare_cache_entries);
+	size_t evicted = 0;
+	while (evicted < count && total > cache->limit)
+	{
+		if (unlinkat(dirfd(directory), list[evicted].name, 0) == 0)
+		{
+			cache->evictions++;
+		}
+		total -= list[evicted].cost;
+		evicted++;
+	}
+	closedir(directory);
+
+	//then the objects that none of the entries left use
+	snprintf(path, sizeof path, "%s%s", cache->directory, CACHE_OBJECTS);
+	directory = opendir(path);
+	while (directory != NULL && (found = readdir(directory)) != NULL)
+	{
+		unsigned long long hash, size;
+		if (sscanf(found->d_name, "%16llx-%llu", &hash, &size) != 2)
+		{
+			continue;
+		}
+
+		size_t i;
+		for (i = evicted; i < count; i++)
+		{
+			if ((list[i].record.output_hash == hash && list[i].record.output_size == size) || (list[i].record.error_hash == hash && list[i].record.error_size == size))
+			{
+				break;
+			}
+		}
+		if (i == count)
+		{
+			unlinkat(dirfd(directory), found->d_name, 0);
+		}
+	}
+	if (directory != NULL)
+	{
+		closedir(directory);
+	}
+	free(list);
+}
+
+void measure_cached(const char *directory, size_t *files, size_t *bytes)
+{
+	*files = 0;
+	*bytes = 0;
+	DIR *listing = opendir(directory);
+	if (listing == NULL)
+	{
+		return;
+	}
+
+	struct dirent *found;
+	while ((found = readdir(listing)) != NULL)
+	{
+		struct stat info;
+		if (found->d_name[0] != '.' && fstatat(dirfd(listing), found->d_name, &info, 0) == 0 && S_ISREG(info.st_mode))
+		{
+			(*files)++;
+			*bytes += info.st_size;
+		}
+	}
+	closedir(listing);
+}
+
+uint64_t cache_clock(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+int compare_cache_entries(const void *a, const void *b)
+{
+	uint64_t first = ((const cache_entry_t *) a)->record.used;
+	uint64_t second = ((const cache_entry_t *) b)->record.used;
+	return first < second ? -1 : first > second;
+}
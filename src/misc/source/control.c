@@ -0,0 +1,675 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/control.h"
+#include "../include/here_document.h"
+#include "../include/parse.h"
+
+#define TOKEN_END       0
+#define TOKEN_COMMAND   1
+#define TOKEN_SEPARATOR 2
+#define TOKEN_AND       3
+#define TOKEN_OR        4
+#define TOKEN_IF        5
+#define TOKEN_THEN      6
+#define TOKEN_ELIF      7
+#define TOKEN_ELSE      8
+#define TOKEN_FI        9
+#define TOKEN_WHILE    10
+#define TOKEN_UNTIL    11
+#define TOKEN_DO       12
+#define TOKEN_DONE     13
+#define TOKEN_FOR      14
+
+#define TOKEN_BIT(type) (1U << (type))
+
+/**
+  * The words that start or end a part of a compound statement, in the order of their tokens
+  */
+char *KEYWORDS[] = { "if", "then", "elif", "else", "fi", "while", "until", "do", "done", "for" };
+
+/**
+  * Walks through the text of a script one token at a time: a keyword where a command could start, a
+  * separator (a newline or ;), && or ||, or everything else up to the next of those, which is one
+  * command. token is the current token, text and length where it is, and position where the next
+  * one is looked for
+  */
+typedef struct
+{
+	const char *position;
+	unsigned short token;
+	const char *text;
+	size_t length;
+} lexer_t;
+
+/**
+  * Moves the lexer on to the next token
+  * @param lexer the lexer to be moved on
+  */
+void next_token(lexer_t *lexer);
+
+/**
+  * Finds how long the command at the start of text is: up to a newline, ;, && or || outside quotes
+  * and $(...), less any white space before it
+  * @param text the text, starting at the command
+  * @return the number of characters in the command
+  */
+size_t command_length(const char *text);
+
+/**
+  * Skips past any separators
+  * @param lexer the lexer to be moved on
+  */
+void skip_separators(lexer_t *lexer);
+
+/**
+  * Compiles a list of statements, up to one of the given tokens, which is left as the current token
+  * @param lexer       the lexer, at the start of the list
+  * @param terminators the tokens, as TOKEN_BITs, that can end the list
+  * @param list        out param; the first statement of the list, which may not be empty
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t compile_list(lexer_t *lexer, unsigned int terminators, script_node_t **list);
+
+/**
+  * Compiles a statement, and any others joined to it by && and ||
+  * @param lexer the lexer, at the start of the statement
+  * @param node  out param; the statement, set even if an error occurs so it can be freed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t compile_and_or(lexer_t *lexer, script_node_t **node);
+
+/**
+  * Compiles a single command, if, while, until or for
+  * @param lexer the lexer, at the start of the statement
+  * @param node  out param; the statement, set even if an error occurs so it can be freed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t compile_statement(lexer_t *lexer, script_node_t **node);
+
+/**
+  * Compiles an if, or the elif that continues one, through to its fi
+  * @param lexer the lexer, at the if or elif
+  * @param node  out param; the statement, set even if an error occurs so it can be freed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t compile_if(lexer_t *lexer, script_node_t **node);
+
+/**
+  * Compiles a while or until, through to its done
+  * @param lexer the lexer, at the while or until
+  * @param node  out param; the statement, set even if an error occurs so it can be freed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t compile_while(lexer_t *lexer, script_node_t **node);
+
+/**
+  * Compiles a for, through to its done
+  * @param lexer the lexer, at the for
+  * @param node  out param; the statement, set even if an error occurs so it can be freed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t compile_for(lexer_t *lexer, script_node_t **node);
+
+/**
+  * Parses a command into a node of its own, which keeps its own copy of the command's text
+  * @param node   the node the command is kept in
+  * @param text   the command
+  * @param length the number of characters in the command
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t compile_command(script_node_t *node, const char *text, size_t length);
+
+/**
+  * Allocates a node with nothing in it yet
+  * @param type the type of the node
+  * @return the node, or NULL if it could not be allocated
+  */
+script_node_t *new_node(unsigned short type);
+
+/**
+  * Runs a single statement, not those after it
+  * @param node        the statement to be run
+  * @param interpreter how to run it
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t run_node(script_node_t *node, interpreter_t *interpreter);
+
+/**
+  * Runs a for: expands its words once, then sets the variable to each and runs the body
+  * @param node        the for to be run
+  * @param interpreter how to run it
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t run_for(script_node_t *node, interpreter_t *interpreter);
+
+int is_compound(const char *line)
+{
+	lexer_t lexer = { line, TOKEN_END, line, 0 };
+	next_token(&lexer);
+	if (lexer.token >= TOKEN_IF)
+	{
+		return 1;
+	}
+
+	//the newline at the end of the line does not separate anything
+	for (; lexer.token != TOKEN_END; next_token(&lexer))
+	{
+		if (lexer.token == TOKEN_AND || lexer.token == TOKEN_OR || (lexer.token == TOKEN_SEPARATOR && lexer.text[0] == ';'))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int script_incomplete(const char *text)
+{
+	lexer_t lexer = { text, TOKEN_END, text, 0 };
+	size_t depth = 0;
+	unsigned short joined = 0;
+	for (next_token(&lexer); lexer.token != TOKEN_END; next_token(&lexer))
+	{
+		if (lexer.token == TOKEN_IF || lexer.token == TOKEN_WHILE || lexer.token == TOKEN_UNTIL || lexer.token == TOKEN_FOR)
+		{
+			depth++;
+		}
+		else if ((lexer.token == TOKEN_FI || lexer.token == TOKEN_DONE) && depth > 0)
+		{
+			depth--;
+		}
+
+		//a && or || at the end of a line carries on to the next
+		if (lexer.token != TOKEN_SEPARATOR)
+		{
+			joined = lexer.token == TOKEN_AND || lexer.token == TOKEN_OR;
+		}
+	}
+
+	return depth > 0 || joined;
+}
+
+status_t compile_script(const char *text, script_node_t **script)
+{
+	lexer_t lexer = { text, TOKEN_END, text, 0 };
+	next_token(&lexer);
+	status_t error = compile_list(&lexer, TOKEN_BIT(TOKEN_END), script);
+	if (error != SUCCESS)
+	{
+		free_script(*script);
+		*script = NULL;
+	}
+
+	return error;
+}
+
+status_t run_script(script_node_t *script, interpreter_t *interpreter)
+{
+	for (; script != NULL; script = script->next)
+	{
+		status_t error = run_node(script, interpreter);
+		if (error != SUCCESS)
+		{
+			return error;
+		}
+	}
+
+	return SUCCESS;
+}
+
+void free_script(script_node_t *script)
+{
+	while (script != NULL)
+	{
+		script_node_t *next = script->next;
+		free_script(script->condition);
+		free_script(script->body);
+		free_script(script->otherwise);
+		if (script->command.arguments != NULL)
+		{
+			free_linked_list(script->command.pipe);
+			free_branches(&script->command);
+			free(script->command.arguments);
+		}
+		free(script->text);
+		free(script->name);
+		free(script);
+		script = next;
+	}
+}
+
+void next_token(lexer_t *lexer)
+{
+	const char *p = lexer->position;
+	p += strspn(p, " \t");
+	lexer->text = p;
+
+	if (*p == '\0')
+	{
+		lexer->token = TOKEN_END;
+		lexer->length = 0;
+	}
+	else if (*p == '\n' || *p == ';')
+	{
+		lexer->token = TOKEN_SEPARATOR;
+		lexer->length = 1;
+	}
+	else if ((p[0] == '&' && p[1] == '&') || (p[0] == '|' && p[1] == '|'))
+	{
+		lexer->token = p[0] == '&' ? TOKEN_AND : TOKEN_OR;
+		lexer->length = 2;
+	}
+	else
+	{
+		//every token but a separator, && or || starts where a command could, so a keyword counts
+		//wherever it is found
+		size_t word = strcspn(p, " \t\n;");
+		lexer->token = TOKEN_COMMAND;
+		size_t i;
+		for (i = 0; i < sizeof KEYWORDS / sizeof *KEYWORDS; i++)
+		{
+			if (strlen(KEYWORDS[i]) == word && strncmp(p, KEYWORDS[i], word) == 0)
+			{
+				lexer->token = TOKEN_IF + i;
+				break;
+			}
+		}
+
+		lexer->length = lexer->token == TOKEN_COMMAND ? command_length(p) : word;
+	}
+
+	lexer->position = p + lexer->length;
+}
+
+size_t command_length(const char *text)
+{
+	char quote = '\0';
+	size_t depth = 0;
+	size_t i;
+	for (i = 0; text[i]; i++)
+	{
+		if (quote != '\0')
+		{
+			quote = text[i] == quote ? '\0' : quote;
+		}
+		else if (text[i] == '"' || text[i] == '\'')
+		{
+			quote = text[i];
+		}
+		else if (text[i] == '$' && text[i + 1] == '(')
+		{
+			depth++;
+			i++;
+		}
+		else if (depth > 0 && text[i] == '(')
+		{
+			depth++;
+		}
+		else if (depth > 0 && text[i] == ')')
+		{
+			depth--;
+		}
+		else if (depth == 0 && (text[i] == '\n' || text[i] == ';' || (text[i] == '&' && text[i + 1] == '&') || (text[i] == '|' && text[i + 1] == '|')))
+		{
+			break;
+		}
+	}
+
+	while (i > 0 && (text[i - 1] == ' ' || text[i - 1] == '\t'))
+	{
+		i--;
+	}
+
+	return i;
+}
+
+void skip_separators(lexer_t *lexer)
+{
+	while (lexer->token == TOKEN_SEPARATOR)
+	{
+		next_token(lexer);
+	}
+}
+
+status_t compile_list(lexer_t *lexer, unsigned int terminators, script_node_t **list)
+{
+	*list = NULL;
+	script_node_t **tail = list;
+	skip_separators(lexer);
+	while (!(terminators & TOKEN_BIT(lexer->token)))
+	{
+		if (lexer->token == TOKEN_END)
+		{
+			return FORMAT_ERROR;
+		}
+
+		status_t error = compile_and_or(lexer, tail);
+		if (error != SUCCESS)
+		{
+			return error;
+		}
+		tail = &(*tail)->next;
+
+		//statements must be separated, unless the list ends straight after one
+		if (lexer->token != TOKEN_SEPARATOR && !(terminators & TOKEN_BIT(lexer->token)))
+		{
+			return FORMAT_ERROR;
+		}
+		skip_separators(lexer);
+	}
+
+	return *list != NULL ? SUCCESS : FORMAT_ERROR;
+}
+
+status_t compile_and_or(lexer_t *lexer, script_node_t **node)
+{
+	status_t error = compile_statement(lexer, node);
+	while (error == SUCCESS && (lexer->token == TOKEN_AND || lexer->token == TOKEN_OR))
+	{
+		script_node_t *join = new_node(lexer->token == TOKEN_AND ? NODE_AND : NODE_OR);
+		if (join == NULL)
+		{
+			return MEMORY_ERROR;
+		}
+		join->condition = *node;
+		*node = join;
+
+		//the right side may be on the next line
+		next_token(lexer);
+		skip_separators(lexer);
+		error = compile_statement(lexer, &join->body);
+	}
+
+	return error;
+}
+
+status_t compile_statement(lexer_t *lexer, script_node_t **node)
+{
+	*node = NULL;
+	switch (lexer->token)
+	{
+		case TOKEN_IF:
+			return compile_if(lexer, node);
+		case TOKEN_WHILE:
+		case TOKEN_UNTIL:
+			return compile_while(lexer, node);
+		case TOKEN_FOR:
+			return compile_for(lexer, node);
+		case TOKEN_COMMAND:
+			break;
+		default:
+			return FORMAT_ERROR;
+	}
+
+	if ((*node = new_node(NODE_COMMAND)) == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+
+	status_t error = compile_command(*node, lexer->text, lexer->length);
+	next_token(lexer);
+	return error;
+}
+
+status_t compile_if(lexer_t *lexer, script_node_t **node)
+{
+	if ((*node = new_node(NODE_IF)) == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+
+	next_token(lexer);
+	status_t error = compile_list(lexer, TOKEN_BIT(TOKEN_THEN), &(*node)->condition);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	next_token(lexer);
+	error = compile_list(lexer, TOKEN_BIT(TOKEN_ELIF) | TOKEN_BIT(TOKEN_ELSE) | TOKEN_BIT(TOKEN_FI), &(*node)->body);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	//an elif is an if of its own, in place of the else, and the fi closes them both
+	if (lexer->token == TOKEN_ELIF)
+	{
+		return compile_if(lexer, &(*node)->otherwise);
+	}
+
+	if (lexer->token == TOKEN_ELSE)
+	{
+		next_token(lexer);
+		error = compile_list(lexer, TOKEN_BIT(TOKEN_FI), &(*node)->otherwise);
+		if (error != SUCCESS)
+		{
+			return error;
+		}
+	}
+
+	next_token(lexer);
+	return SUCCESS;
+}
+
+status_t compile_while(lexer_t *lexer, script_node_t **node)
+{
+	if ((*node = new_node(lexer->token == TOKEN_WHILE ? NODE_WHILE : NODE_UNTIL)) == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+
+	next_token(lexer);
+	status_t error = compile_list(lexer, TOKEN_BIT(TOKEN_DO), &(*node)->condition);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	next_token(lexer);
+	error = compile_list(lexer, TOKEN_BIT(TOKEN_DONE), &(*node)->body);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	next_token(lexer);
+	return SUCCESS;
+}
+
+status_t compile_for(lexer_t *lexer, script_node_t **node)
+{
+	if ((*node = new_node(NODE_FOR)) == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+
+	//for name in words is lexed as the keyword and then one command
+	next_token(lexer);
+	if (lexer->token != TOKEN_COMMAND)
+	{
+		return FORMAT_ERROR;
+	}
+
+	const char *text = lexer->text;
+	const char *end = text + lexer->length;
+	size_t name_length = strcspn(text, " \t");
+	name_length = text + name_length < end ? name_length : (size_t) (end - text);
+	if (((*node)->name = strndup(text, name_length)) == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+	if (!valid_variable_name((*node)->name))
+	{
+		return INVALID_VAR;
+	}
+
+	const char *in = text + name_length;
+	in += strspn(in, " \t");
+	if (end - in < 2 || strncmp(in, "in", 2) != 0 || (end - in > 2 && in[2] != ' ' && in[2] != '\t'))
+	{
+		return FORMAT_ERROR;
+	}
+
+	//with no words the loop runs no times, and there is no command to expand them from
+	const char *words = in + 2;
+	words += strspn(words, " \t");
+	if (words < end)
+	{
+		status_t error = compile_command(*node, words, end - words);
+		if (error != SUCCESS)
+		{
+			return error;
+		}
+	}
+
+	next_token(lexer);
+	skip_separators(lexer);
+	if (lexer->token != TOKEN_DO)
+	{
+		return FORMAT_ERROR;
+	}
+
+	next_token(lexer);
+	status_t error = compile_list(lexer, TOKEN_BIT(TOKEN_DONE), &(*node)->body);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	next_token(lexer);
+	return SUCCESS;
+}
+
+status_t compile_command(script_node_t *node, const char *text, size_t length)
+{
+	//parse_line expects the line as it was read, newline and all, and splits it in place
+	node->text = malloc(length + 2);
+	if (node->text == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+	memcpy(node->text, text, length);
+	strcpy(node->text + length, "\n");
+
+	status_t error = parse_line(node->text, length + 1, &node->command);
+	if (error != SUCCESS)
+	{
+		memset(&node->command, 0, sizeof node->command);
+		return error;
+	}
+
+	return has_here_document(&node->command) ? HEREDOC_ERROR : SUCCESS;
+}
+
+script_node_t *new_node(unsigned short type)
+{
+	script_node_t *node = calloc(1, sizeof *node);
+	if (node != NULL)
+	{
+		node->type = type;
+		node->command.here_document = -1;
+	}
+
+	return node;
+}
+
+status_t run_node(script_node_t *node, interpreter_t *interpreter)
+{
+	int *status = interpreter->expansion.status;
+	status_t error;
+	switch (node->type)
+	{
+		case NODE_COMMAND:
+			return interpreter->run(interpreter->expansion.context, &node->command);
+
+		case NODE_AND:
+		case NODE_OR:
+			error = run_node(node->condition, interpreter);
+			if (error != SUCCESS || (*status == 0) != (node->type == NODE_AND))
+			{
+				return error;
+			}
+			return run_node(node->body, interpreter);
+
+		case NODE_IF:
+			error = run_script(node->condition, interpreter);
+			if (error != SUCCESS)
+			{
+				return error;
+			}
+			if (*status == 0)
+			{
+				return run_script(node->body, interpreter);
+			}
+			if (node->otherwise != NULL)
+			{
+				return run_script(node->otherwise, interpreter);
+			}
+			*status = 0;
+			return SUCCESS;
+
+		case NODE_WHILE:
+		case NODE_UNTIL:
+		{
+			int last = 0;
+			while ((error = run_script(node->condition, interpreter)) == SUCCESS && (*status == 0) == (node->type == NODE_WHILE))
+			{
+				error = run_script(node->body, interpreter);
+				if (error != SUCCESS)
+				{
+					return error;
+				}
+				last = *status;
+			}
+			*status = last;
+			return error;
+		}
+
+		case NODE_FOR:
+			return run_for(node, interpreter);
+	}
+
+	return SUCCESS;
+}
+
+status_t run_for(script_node_t *node, interpreter_t *interpreter)
+{
+	*interpreter->expansion.status = 0;
+	if (node->command.arguments == NULL)
+	{
+		return SUCCESS;
+	}
+
+	//the words are expanded into an arena of the loop's own, which lasts as long as the loop does
+	arena_t arena = {0};
+	expansion_t expansion = interpreter->expansion;
+	expansion.arena = &arena;
+	command_t words;
+	status_t error = share_command(&words, &node->command);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	error = expand_command(&words, &expansion);
+	int last = 0;
+	size_t i;
+	for (i = 0; error == SUCCESS && i + 1 < words.argc; i++)
+	{
+		error = set_variable(interpreter->variables, node->name, words.arguments[i]);
+		if (error == SUCCESS)
+		{
+			error = run_script(node->body, interpreter);
+			last = *interpreter->expansion.status;
+		}
+	}
+
+	*interpreter->expansion.status = last;
+	free_linked_list(words.pipe);
+	free_branches(&words);
+	arena_free(&arena);
+	return error;
+}
@@ -0,0 +1,872 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/coreutils.h"
+
+/**
+  * The state of test as it works through its arguments: the arguments (not counting the name, or a
+  * closing ]), how many of them there are, which one is next, and the name to report errors with
+  */
+typedef struct
+{
+	char **arguments;
+	size_t count;
+	size_t position;
+	unsigned short error;
+	const char *name;
+} test_t;
+
+/**
+  * Runs echo
+  * @param arguments the arguments, not counting the name
+  * @return the exit status
+  */
+int echo_utility(char **arguments);
+
+/**
+  * Runs test or [
+  * @param arguments the arguments, not counting the name
+  * @param name      "test" or "["; [ must have ] as its last argument
+  * @return the exit status: 0 for true, 1 for false, 2 for an error
+  */
+int test_utility(char **arguments, const char *name);
+
+/**
+  * Runs printf
+  * @param arguments the arguments, not counting the name
+  * @return the exit status
+  */
+int printf_utility(char **arguments);
+
+/**
+  * Prints the escape sequence that starts just after a backslash
+  * @param s           the character after the backslash
+  * @param octal_digit nonzero if \NNN is an octal escape (printf's format), zero if only \0NNN is
+  *                    (echo -e and printf's %b)
+  * @param out         where the character is printed
+  * @param stop        out param; set to nonzero for \c, after which nothing more is printed
+  * @return the position just after the escape sequence
+  */
+const char *print_escape(const char *s, unsigned short octal_digit, FILE *out, unsigned short *stop);
+
+/**
+  * Prints a string with every escape sequence in it replaced, as echo -e does
+  * @param s           the string to be printed
+  * @param octal_digit as for print_escape
+  * @param out         where the string is printed
+  * @return nonzero if \c was found (and the rest was not printed), zero otherwise
+  */
+unsigned short print_escaped(const char *s, unsigned short octal_digit, FILE *out);
+
+/**
+  * Prints a string so that a shell would read it back as it is, for printf's %q: as it is if it has
+  * nothing special in it, otherwise in single quotes, each ' in it written as '\''
+  * @param s   the string to be printed
+  * @param out where the string is printed
+  */
+void print_quoted(const char *s, FILE *out);
+
+/**
+  * Prints a single pass through printf's format, taking arguments as its conversions need them
+  * @param format    the format
+  * @param arguments in/out param; the arguments left, moved past those used
+  * @param status    out param; set to 1 if an argument was not a valid number
+  * @return nonzero if printing must stop (\c, or an invalid conversion), zero otherwise
+  */
+unsigned short print_format(const char *format, char ***arguments, int *status);
+
+/**
+  * Converts one of printf's numeric arguments, which may also be a quote followed by a character
+  * @param argument the argument, or NULL if there are none left (which is zero)
+  * @param is_signed nonzero to convert to a signed number, zero for an unsigned one
+  * @param status   out param; set to 1 if the argument was not entirely a number
+  * @return the number, which the caller casts back to unsigned if is_signed is zero
+  */
+intmax_t printf_integer(const char *argument, unsigned short is_signed, int *status);
+
+/**
+  * Evaluates an expression of test's made of expressions joined by -o
+  * @param test the state of test
+  * @return nonzero if the expression is true, zero otherwise
+  */
+int test_or(test_t *test);
+
+/**
+  * Evaluates an expression of test's made of expressions joined by -a
+  * @param test the state of test
+  * @return nonzero if the expression is true, zero otherwise
+  */
+int test_and(test_t *test);
+
+/**
+  * Evaluates a single expression of test's, possibly negated with ! or in parentheses
+  * @param test the state of test
+  * @return nonzero if the expression is true, zero otherwise
+  */
+int test_primary(test_t *test);
+
+/**
+  * Evaluates test's expression from its position on when there are at most four arguments left, the
+  * way POSIX defines it, so that an operator can be an operand (test = = = is true, for instance)
+  * @param test  the state of test
+  * @param count the number of arguments left
+  * @return nonzero if the expression is true, zero otherwise
+  */
+int test_short(test_t *test, size_t count);
+
+/**
+  * Determines whether a word is one of test's unary operators
+  * @param word the word to be checked
+  * @return nonzero if it is, zero otherwise
+  */
+int is_unary_operator(const char *word);
+
+/**
+  * Determines whether a word is one of test's binary operators
+  * @param word the word to be checked
+  * @return nonzero if it is, zero otherwise
+  */
+int is_binary_operator(const char *word);
+
+/**
+  * Applies one of test's unary operators
+  * @param test     the state of test, for reporting errors
+  * @param operator the operator
+  * @param operand  the operand
+  * @return nonzero if it is true, zero otherwise
+  */
+int test_unary(test_t *test, const char *operator, const char *operand);
+
+/**
+  * Applies one of test's binary operators
+  * @param test     the state of test, for reporting errors
+  * @param left     the left operand
+  * @param operator the operator
+  * @param right    the right operand
+  * @return nonzero if it is true, zero otherwise
+  */
+int test_binary(test_t *test, const char *left, const char *operator, const char *right);
+
+/**
+  * Converts one of test's integer operands, which may have white space around it
+  * @param test    the state of test, whose error is set if the operand is not an integer
+  * @param operand the operand
+  * @return the integer, or zero if it is not one
+  */
+intmax_t test_integer(test_t *test, const char *operand);
+
+int is_coreutil(const char *name)
+{
+	return strcmp(name, "echo") == 0 || strcmp(name, "true") == 0 || strcmp(name, "false") == 0 || strcmp(name, "test") == 0 || strcmp(name, "[") == 0 || strcmp(name, "printf") == 0;
+}
+
+int run_coreutil(char **arguments)
+{
+	char *name = arguments[0];
+	if (strcmp(name, "echo") == 0)
+	{
+		return echo_utility(arguments + 1);
+	}
+	if (strcmp(name, "true") == 0)
+	{
+		return 0;
+	}
+	if (strcmp(name, "false") == 0)
+	{
+		return 1;
+	}
+	if (strcmp(name, "printf") == 0)
+	{
+		return printf_utility(arguments + 1);
+	}
+
+	return test_utility(arguments + 1, name);
+}
+
+int echo_utility(char **arguments)
+{
+	//options are only words made up entirely of n, e and E after the -
+	unsigned short newline = 1;
+	unsigned short escapes = 0;
+	for (; *arguments != NULL && (*arguments)[0] == '-' && (*arguments)[1] != '\0' && strspn(*arguments + 1, "neE") == strlen(*arguments + 1); arguments++)
+	{
+		const char *option;
+		for (option = *arguments + 1; *option; option++)
+		{
+			if (*option == 'n')
+			{
+				newline = 0;
+			}
+			else
+			{
+				escapes = *option == 'e';
+			}
+		}
+	}
+
+	for (; *arguments != NULL; arguments++)
+	{
+		if (escapes)
+		{
+			if (print_escaped(*arguments, 0, stdout))
+			{
+				return 0;
+			}
+		}
+		else
+		{
+			fputs(*arguments, stdout);
+		}
+
+		if (arguments[1] != NULL)
+		{
+			putchar(' ');
+		}
+	}
+
+	if (newline)
+	{
+		putchar('\n');
+	}
+	return 0;
+}
+
+int test_utility(char **arguments, const char *name)
+{
+	size_t count = 0;
+	while (arguments[count] != NULL)
+	{
+		count++;
+	}
+
+	if (strcmp(name, "[") == 0)
+	{
+		if (count == 0 || strcmp(arguments[count - 1], "]") != 0)
+		{
+			fprintf(stderr, "[: missing ']'\n");
+			return 2;
+		}
+		count--;
+	}
+
+	test_t test = { arguments, count, 0, 0, name };
+	if (count == 0)
+	{
+		return 1;
+	}
+
+	int result = count <= 4 ? test_short(&test, count) : test_or(&test);
+	if (!test.error && test.position < count)
+	{
+		fprintf(stderr, "%s: extra argument '%s'\n", name, arguments[test.position]);
+		test.error = 1;
+	}
+
+	return test.error ? 2 : !result;
+}
+
+int printf_utility(char **arguments)
+{
+	if (arguments[0] == NULL)
+	{
+		fprintf(stderr, "printf: missing operand\nTry 'printf --help' for more information.\n");
+		return 1;
+	}
+
+	//the format is used again for as long as there are arguments left, if it uses any at all
+	char *format = arguments[0];
+	arguments++;
+	int status = 0;
+	while (1)
+	{
+		char **before = arguments;
+		if (print_format(format, &arguments, &status) || arguments == before || *arguments == NULL)
+		{
+			break;
+		}
+	}
+
+	return status;
+}
+
+const char *print_escape(const char *s, unsigned short octal_digit, FILE *out, unsigned short *stop)
+{
+	const char *simple = "\\\\a\ab\be\033f\fn\nr\rt\tv\v";
+	const char *found;
+	if (*s != '\0' && (found = strchr(simple, *s)) != NULL && (found - simple) % 2 == 0)
+	{
+		putc(found[1], out);
+		return s + 1;
+	}
+
+	if (*s == 'c')
+	{
+		*stop = 1;
+		return s + 1;
+	}
+
+	if (*s == 'x' && strchr("0123456789abcdefABCDEF", s[1]) != NULL && s[1] != '\0')
+	{
+		unsigned int value = 0;
+		size_t i;
+		for (i = 1; i <= 2 && s[i] != '\0' && strchr("0123456789abcdefABCDEF", s[i]) != NULL; i++)
+		{
+			value = value * 16 + (s[i] <= '9' ? s[i] - '0' : (s[i] | 0x20) - 'a' + 10);
+		}
+		putc(value, out);
+		return s + i;
+	}
+
+	//\0NNN for echo and %b, \NNN for printf's format
+	if ((*s == '0' && !octal_digit) || (*s >= '0' && *s <= '7' && octal_digit))
+	{
+		const char *digits = octal_digit ? s : s + 1;
+		unsigned int value = 0;
+		size_t i;
+		for (i = 0; i < 3 && digits[i] >= '0' && digits[i] <= '7'; i++)
+		{
+			value = value * 8 + (digits[i] - '0');
+		}
+		putc(value & 0xff, out);
+		return digits + i;
+	}
+
+	//anything else is printed as it is, backslash and all
+	putc('\\', out);
+	return s;
+}
+
+unsigned short print_escaped(const char *s, unsigned short octal_digit, FILE *out)
+{
+	unsigned short stop = 0;
+	while (*s != '\0' && !stop)
+	{
+		const char *backslash = strchrnul(s, '\\');
+		fwrite(s, 1, backslash - s, out);
+		s = *backslash == '\\' ? print_escape(backslash + 1, octal_digit, out, &stop) : backslash;
+	}
+
+	return stop;
+}
+
+void print_quoted(const char *s, FILE *out)
+{
+	const char *safe = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789%+,-./:=@_";
+	if (*s != '\0' && strspn(s, safe) == strlen(s))
+	{
+		fputs(s, out);
+		return;
+	}
+
+	putc('\'', out);
+	for (; *s; s++)
+	{
+		if (*s == '\'')
+		{
+			fputs("'\\''", out);
+		}
+		else
+		{
+			putc(*s, out);
+		}
+	}
+	putc('\'', out);
+}
+
+unsigned short print_format(const char *format, char ***arguments, int *status)
+{
+	const char *s = format;
+	while (*s != '\0')
+	{
+		if (*s == '\\')
+		{
+			unsigned short stop = 0;
+			s = print_escape(s + 1, 1, stdout, &stop);
+			if (stop)
+			{
+				return 1;
+			}
+			continue;
+		}
+
+		if (*s != '%' || s[1] == '%')
+		{
+			putchar(*s);
+			s += *s == '%' ? 2 : 1;
+			continue;
+		}
+
+		//the flags, width and precision are copied into a format of their own, with any * replaced
+		//by the argument it stands for
+		char spec[64] = "%";
+		size_t length = 1;
+		s++;
+		size_t flags = strspn(s, "-+ #0");
+		if (flags > 8)
+		{
+			flags = 8;
+		}
+		memcpy(spec + length, s, flags);
+		length += flags;
+		s += flags;
+
+		unsigned short part;
+		for (part = 0; part < 2; part++)
+		{
+			if (part == 1)
+			{
+				if (*s != '.')
+				{
+					break;
+				}
+				spec[length++] = *s++;
+			}
+
+			if (*s == '*')
+			{
+				const char *argument = **arguments;
+				*arguments += argument != NULL;
+				length += snprintf(spec + length, sizeof spec - length, "%d", (int) printf_integer(argument, 1, status));
+				s++;
+			}
+			else
+			{
+				size_t digits = strspn(s, "0123456789");
+				digits = digits > 9 ? 9 : digits;
+				memcpy(spec + length, s, digits);
+				length += digits;
+				s += digits;
+			}
+		}
+
+		s += strspn(s, "hlLjzt");
+		char conversion = *s;
+		if (conversion == '\0' || strchr("sbqcdiouxXfFeEgGaA", conversion) == NULL)
+		{
+			fprintf(stderr, "printf: %%%c: invalid conversion specification\n", conversion);
+			*status = 1;
+			return 1;
+		}
+		s++;
+
+		const char *argument = **arguments;
+		*arguments += argument != NULL;
+		if (conversion == 's' || conversion == 'c' || conversion == 'b' || conversion == 'q')
+		{
+			//%c is the first character of its argument, which is printed as a string cut short
+			if (conversion == 'c')
+			{
+				char *dot = strchr(spec, '.');
+				length = dot != NULL ? (size_t) (dot - spec) : length;
+				strcpy(spec + length, ".1");
+				length += 2;
+			}
+
+			char *text = (char *) (argument != NULL ? argument : "");
+			char *expanded = NULL;
+			size_t expanded_length;
+			unsigned short stop = 0;
+			if (conversion == 'b')
+			{
+				FILE *memory = open_memstream(&expanded, &expanded_length);
+				if (memory != NULL)
+				{
+					stop = print_escaped(text, 0, memory);
+					fclose(memory);
+					text = expanded;
+				}
+			}
+			else if (conversion == 'q')
+			{
+				FILE *memory = open_memstream(&expanded, &expanded_length);
+				if (memory != NULL)
+				{
+					print_quoted(text, memory);
+					fclose(memory);
+					text = expanded;
+				}
+			}
+
+			strcpy(spec + length, "s");
+			printf(spec, text);
+			free(expanded);
+			if (stop)
+			{
+				return 1;
+			}
+		}
+		else if (conversion == 'd' || conversion == 'i')
+		{
+			strcpy(spec + length, "jd");
+			printf(spec, printf_integer(argument, 1, status));
+		}
+		else if (strchr("ouxX", conversion) != NULL)
+		{
+			spec[length] = 'j';
+			spec[length + 1] = conversion;
+			spec[length + 2] = '\0';
+			printf(spec, (uintmax_t) printf_integer(argument, 0, status));
+		}
+		else
+		{
+			long double value = 0;
+			if (argument != NULL)
+			{
+				char *end;
+				errno = 0;
+				value = strtold(argument, &end);
+				if (end == argument || *end != '\0')
+				{
+					fprintf(stderr, "printf: '%s': expected a numeric value\n", argument);
+					*status = 1;
+				}
+			}
+			spec[length] = 'L';
+			spec[length + 1] = conversion;
+			spec[length + 2] = '\0';
+			printf(spec, value);
+		}
+	}
+
+	return 0;
+}
+
+intmax_t printf_integer(const char *argument, unsigned short is_signed, int *status)
+{
+	if (argument == NULL)
+	{
+		return 0;
+	}
+
+	//'c or "c is the value of the character
+	if ((argument[0] == '\'' || argument[0] == '"') && argument[1] != '\0')
+	{
+		return (unsigned char) argument[1];
+	}
+
+	char *end;
+	errno = 0;
+	intmax_t value = is_signed ? strtoimax(argument, &end, 0) : (intmax_t) strtoumax(argument, &end, 0);
+	if (end == argument || *end != '\0')
+	{
+		fprintf(stderr, "printf: '%s': expected a numeric value\n", argument);
+		*status = 1;
+	}
+	else if (errno == ERANGE)
+	{
+		fprintf(stderr, "printf: '%s': %s\n", argument, strerror(errno));
+		*status = 1;
+	}
+
+	return value;
+}
+
+int test_or(test_t *test)
+{
+	int result = test_and(test);
+	while (!test->error && test->position < test->count && strcmp(test->arguments[test->position], "-o") == 0)
+	{
+		test->position++;
+		int right = test_and(test);
+		result = result || right;
+	}
+
+	return result;
+}
+
+int test_and(test_t *test)
+{
+	int result = test_primary(test);
+	while (!test->error && test->position < test->count && strcmp(test->arguments[test->position], "-a") == 0)
+	{
+		test->position++;
+		int right = test_primary(test);
+		result = result && right;
+	}
+
+	return result;
+}
+
+int test_primary(test_t *test)
+{
+	if (test->position >= test->count)
+	{
+		fprintf(stderr, "%s: argument expected\n", test->name);
+		test->error = 1;
+		return 0;
+	}
+
+	char **arguments = test->arguments + test->position;
+	size_t left = test->count - test->position;
+	if (strcmp(arguments[0], "!") == 0)
+	{
+		test->position++;
+		return !test_primary(test);
+	}
+
+	//a binary operator takes precedence, so that ( = ( compares two parentheses
+	if (left >= 3 && is_binary_operator(arguments[1]))
+	{
+		test->position += 3;
+		return test_binary(test, arguments[0], arguments[1], arguments[2]);
+	}
+
+	if (strcmp(arguments[0], "(") == 0)
+	{
+		test->position++;
+		int result = test_or(test);
+		if (!test->error && (test->position >= test->count || strcmp(test->arguments[test->position], ")") != 0))
+		{
+			fprintf(stderr, "%s: ')' expected\n", test->name);
+			test->error = 1;
+		}
+		test->position++;
+		return result;
+	}
+
+	if (left >= 2 && is_unary_operator(arguments[0]))
+	{
+		test->position += 2;
+		return test_unary(test, arguments[0], arguments[1]);
+	}
+
+	test->position++;
+	return arguments[0][0] != '\0';
+}
+
+int test_short(test_t *test, size_t count)
+{
+	char **arguments = test->arguments + test->position;
+	switch (count)
+	{
+		case 1:
+			test->position++;
+			return arguments[0][0] != '\0';
+
+		case 2:
+			if (strcmp(arguments[0], "!") == 0)
+			{
+				test->position++;
+				return !test_short(test, 1);
+			}
+			if (is_unary_operator(arguments[0]))
+			{
+				test->position += 2;
+				return test_unary(test, arguments[0], arguments[1]);
+			}
+			fprintf(stderr, "%s: '%s': unary operator expected\n", test->name, arguments[0]);
+			test->error = 1;
+			return 0;
+
+		case 3:
+			if (is_binary_operator(arguments[1]))
+			{
+				test->position += 3;
+				return test_binary(test, arguments[0], arguments[1], arguments[2]);
+			}
+			if (strcmp(arguments[0], "!") == 0)
+			{
+				test->position++;
+				return !test_short(test, 2);
+			}
+			if (strcmp(arguments[0], "(") == 0 && strcmp(arguments[2], ")") == 0)
+			{
+				test->position += 3;
+				return arguments[1][0] != '\0';
+			}
+			break;
+
+		case 4:
+			if (strcmp(arguments[0], "!") == 0)
+			{
+				test->position++;
+				return !test_short(test, 3);
+			}
+			if (strcmp(arguments[0], "(") == 0 && strcmp(arguments[3], ")") == 0)
+			{
+				test->position++;
+				int result = test_short(test, 2);
+				test->position++;
+				return result;
+			}
+			break;
+	}
+
+	return test_or(test);
+}
+
+int is_unary_operator(const char *word)
+{
+	return word[0] == '-' && word[1] != '\0' && word[2] == '\0' && strchr("bcdefghknprstuwxzGLOS", word[1]) != NULL;
+}
+
+int is_binary_operator(const char *word)
+{
+	const char *operators[] = { "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge", "-nt", "-ot", "-ef", "-a", "-o" };
+	size_t i;
+	for (i = 0; i < sizeof operators / sizeof *operators; i++)
+	{
+		if (strcmp(word, operators[i]) == 0)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int test_unary(test_t *test, const char *operator, const char *operand)
+{
+	switch (operator[1])
+	{
+		case 'n':
+			return operand[0] != '\0';
+		case 'z':
+			return operand[0] == '\0';
+		case 't':
+			return isatty(test_integer(test, operand));
+		case 'r':
+			return faccessat(AT_FDCWD, operand, R_OK, AT_EACCESS) == 0;
+		case 'w':
+			return faccessat(AT_FDCWD, operand, W_OK, AT_EACCESS) == 0;
+		case 'x':
+			return faccessat(AT_FDCWD, operand, X_OK, AT_EACCESS) == 0;
+	}
+
+	//the rest are about the file itself; -h and -L look at a link rather than what it points to
+	struct stat info;
+	unsigned short link = operator[1] == 'h' || operator[1] == 'L';
+	if ((link ? lstat(operand, &info) : stat(operand, &info)) < 0)
+	{
+		return 0;
+	}
+
+	switch (operator[1])
+	{
+		case 'e':
+			return 1;
+		case 'f':
+			return S_ISREG(info.st_mode);
+		case 'd':
+			return S_ISDIR(info.st_mode);
+		case 'b':
+			return S_ISBLK(info.st_mode);
+		case 'c':
+			return S_ISCHR(info.st_mode);
+		case 'p':
+			return S_ISFIFO(info.st_mode);
+		case 'S':
+			return S_ISSOCK(info.st_mode);
+		case 'h':
+		case 'L':
+			return S_ISLNK(info.st_mode);
+		case 's':
+			return info.st_size > 0;
+		case 'g':
+			return (info.st_mode & S_ISGID) != 0;
+		case 'u':
+			return (info.st_mode & S_ISUID) != 0;
+		case 'k':
+			return (info.st_mode & S_ISVTX) != 0;
+		case 'O':
+			return info.st_uid == geteuid();
+		case 'G':
+			return info.st_gid == getegid();
+	}
+
+	return 0;
+}
+
+int test_binary(test_t *test, const char *left, const char *operator, const char *right)
+{
+	if (strcmp(operator, "=") == 0 || strcmp(operator, "==") == 0)
+	{
+		return strcmp(left, right) == 0;
+	}
+	if (strcmp(operator, "!=") == 0)
+	{
+		return strcmp(left, right) != 0;
+	}
+	if (strcmp(operator, "<") == 0 || strcmp(operator, ">") == 0)
+	{
+		int comparison = strcoll(left, right);
+		return operator[0] == '<' ? comparison < 0 : comparison > 0;
+	}
+	if (strcmp(operator, "-a") == 0)
+	{
+		return left[0] != '\0' && right[0] != '\0';
+	}
+	if (strcmp(operator, "-o") == 0)
+	{
+		return left[0] != '\0' || right[0] != '\0';
+	}
+
+	if (strcmp(operator, "-nt") == 0 || strcmp(operator, "-ot") == 0 || strcmp(operator, "-ef") == 0)
+	{
+		struct stat left_info;
+		struct stat right_info;
+		int left_exists = stat(left, &left_info) == 0;
+		int right_exists = stat(right, &right_info) == 0;
+		if (operator[1] == 'e')
+		{
+			return left_exists && right_exists && left_info.st_dev == right_info.st_dev && left_info.st_ino == right_info.st_ino;
+		}
+
+		//a file that exists is newer than one that does not
+		int comparison;
+		if (!left_exists || !right_exists)
+		{
+			comparison = left_exists - right_exists;
+		}
+		else if (left_info.st_mtim.tv_sec != right_info.st_mtim.tv_sec)
+		{
+			comparison = left_info.st_mtim.tv_sec < right_info.st_mtim.tv_sec ? -1 : 1;
+		}
+		else
+		{
+			comparison = (left_info.st_mtim.tv_nsec > right_info.st_mtim.tv_nsec) - (left_info.st_mtim.tv_nsec < right_info.st_mtim.tv_nsec);
+		}
+		return operator[1] == 'n' ? comparison > 0 : comparison < 0;
+	}
+
+	intmax_t a = test_integer(test, left);
+	intmax_t b = test_integer(test, right);
+	const char *names[] = { "-eq", "-ne", "-lt", "-le", "-gt", "-ge" };
+	int results[] = { a == b, a != b, a < b, a <= b, a > b, a >= b };
+	size_t i;
+	for (i = 0; i < sizeof names / sizeof *names; i++)
+	{
+		if (strcmp(operator, names[i]) == 0)
+		{
+			return results[i];
+		}
+	}
+
+	return 0;
+}
+
+intmax_t test_integer(test_t *test, const char *operand)
+{
+	char *end;
+	errno = 0;
+	intmax_t value = strtoimax(operand, &end, 10);
+	end += strspn(end, " \t");
+	if (end == operand || *end != '\0' || strspn(operand, " \t") == strlen(operand) || errno == ERANGE)
+	{
+		if (!test->error)
+		{
+			fprintf(stderr, "%s: invalid integer '%s'\n", test->name, operand);
+		}
+		test->error = 1;
+		return 0;
+	}
+
+	return value;
+}
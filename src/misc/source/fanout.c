@@ -0,0 +1,208 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../include/fanout.h"
+
+/**
+  * Writes all of a buffer to a descriptor, continuing after short writes
+  * @param fd     the descriptor to write to
+  * @param data   the bytes to be written
+  * @param length the number of bytes to be written
+  * @return zero if the bytes could not all be written, nonzero otherwise
+  */
+int write_fully(int fd, const char *data, size_t length);
+
+/**
+  * Removes the branch at index from the array of open branches, closing it
+  * @param branches     the open branches
+  * @param num_branches the number of open branches; decremented
+  * @param index        the index of the branch to be dropped
+  */
+void drop_branch(int *branches, size_t *num_branches, size_t index);
+
+void distribute(int source, int *branches, size_t num_branches)
+{
+	//a branch that has gone away shows up as EPIPE, rather than killing the distributor
+	signal(SIGPIPE, SIG_IGN);
+
+	size_t *copied = malloc(num_branches * sizeof *copied);
+	char *buffer = malloc(FANOUT_CHUNK);
+	if (copied == NULL || buffer == NULL)
+	{
+		free(copied);
+		free(buffer);
+		while (num_branches > 0)
+		{
+			drop_branch(branches, &num_branches, 0);
+		}
+		close(source);
+		return;
+	}
+
+	while (num_branches > 0)
+	{
+		//the first branch decides how big the chunk is: whatever is available, as far as it fits
+		ssize_t length = 0;
+		if (num_branches > 1)
+		{
+			length = tee(source, branches[0], FANOUT_CHUNK, 0);
+			if (length < 0)
+			{
+				if (errno != EINTR)
+				{
+					drop_branch(branches, &num_branches, 0);
+				}
+				continue;
+			}
+		}
+		else
+		{
+			length = splice(source, NULL, branches[0], NULL, FANOUT_CHUNK, SPLICE_F_MOVE);
+			if (length < 0)
+			{
+				if (errno != EINTR)
+				{
+					drop_branch(branches, &num_branches, 0);
+				}
+				continue;
+			}
+		}
+
+		if (length == 0)
+		{
+			break;
+		}
+
+		if (num_branches == 1)
+		{
+			continue;
+		}
+
+		//duplicate the same chunk into every other branch but the last
+		unsigned short partial = 0;
+		size_t i;
+		copied[0] = length;
+		for (i = 1; i < num_branches - 1; i++)
+		{
+			ssize_t result;
+			do
+			{
+				result = tee(source, branches[i], length, 0);
+			} while (result < 0 && errno == EINTR);
+
+			//a branch that has gone away is marked to be dropped below
+			if (result < 0)
+			{
+				copied[i] = (size_t) -1;
+			}
+			else
+			{
+				copied[i] = result;
+				partial |= result < length;
+			}
+		}
+
+		size_t last = num_branches - 1;
+		if (!partial)
+		{
+			//the common case: hand the chunk itself to the last branch
+			size_t moved = 0;
+			while (moved < (size_t) length)
+			{
+				ssize_t result = splice(source, NULL, branches[last], NULL, length - moved, SPLICE_F_MOVE);
+				if (result < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				if (result <= 0)
+				{
+					//the last branch has gone away, so the rest of the chunk is thrown out
+					ssize_t discarded = read(source, buffer, length - moved);
+					copied[last] = (size_t) -1;
+					moved += discarded > 0 ? (size_t) discarded : length - moved;
+					break;
+				}
+				moved += result;
+			}
+		}
+		else
+		{
+			//some branch only took part of the chunk; read it out and write what is missing
+			size_t got = 0;
+			while (got < (size_t) length)
+			{
+				ssize_t result = read(source, buffer + got, length - got);
+				if (result < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				if (result <= 0)
+				{
+					break;
+				}
+				got += result;
+			}
+
+			copied[last] = 0;
+			for (i = 1; i < num_branches; i++)
+			{
+				if (copied[i] != (size_t) -1 && copied[i] < got && !write_fully(branches[i], buffer + copied[i], got - copied[i]))
+				{
+					copied[i] = (size_t) -1;
+				}
+			}
+		}
+
+		//drop the branches that have gone away, from the end so the indices stay good
+		for (i = num_branches; i-- > 1;)
+		{
+			if (copied[i] == (size_t) -1)
+			{
+				drop_branch(branches, &num_branches, i);
+			}
+		}
+	}
+
+	while (num_branches > 0)
+	{
+		drop_branch(branches, &num_branches, 0);
+	}
+	close(source);
+	free(copied);
+	free(buffer);
+}
+
+int write_fully(int fd, const char *data, size_t length)
+{
+	while (length > 0)
+	{
+		ssize_t written = write(fd, data, length);
+		if (written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (written <= 0)
+		{
+			return 0;
+		}
+		data += written;
+		length -= written;
+	}
+
+	return 1;
+}
+
+void drop_branch(int *branches, size_t *num_branches, size_t index)
+{
+	close(branches[index]);
+	size_t i;
+	for (i = index; i + 1 < *num_branches; i++)
+	{
+		branches[i] = branches[i + 1];
+	}
+	(*num_branches)--;
+}
@@ -0,0 +1,1046 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "../include/filter.h"
+
+#define FILTER_DEFAULT_LINES 10
+#define FILTER_MIN_OUTPUT    4096
+
+#define SWAR_ONES  0x0101010101010101ULL
+#define SWAR_LOW7  0x7f7f7f7f7f7f7f7fULL
+#define SWAR_HIGH  0x8080808080808080ULL
+
+/**
+  * The names the filters are run by, indexed by their types
+  */
+const char *FILTER_NAMES[] = { "@grep", "@wc", "@head", "@tail", NULL };
+
+/**
+  * A run of whole lines (only the last block of the input may end without a newline), handed from
+  * the reader to the first filter and from each filter to the next
+  */
+typedef struct block
+{
+	char *data;
+	size_t length;
+	size_t capacity;
+	size_t newlines;
+	struct block *next;
+} block_t;
+
+/**
+  * A short queue of blocks between two threads. The producer finishes it at the end of its output;
+  * the consumer closes it once it wants no more, after which pushes fail
+  */
+typedef struct
+{
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	block_t *head;
+	block_t *tail;
+	size_t queued;
+	int finished;
+	int closed;
+} channel_t;
+
+/**
+  * A filter's thread: where it reads from and writes to, the output it has yet to pass on, and
+  * what it has counted or kept so far
+  */
+typedef struct
+{
+	filter_t *filter;
+	channel_t *input;
+	channel_t *output;
+	int fd;
+	block_t *pending;
+	int stopped;
+	int status;
+	size_t selected;
+	size_t lines;
+	size_t words;
+	size_t bytes;
+	int in_word;
+	size_t remaining;
+	block_t *kept;
+	block_t *kept_tail;
+	size_t kept_newlines;
+} stage_t;
+
+/**
+  * Counts the newlines in a buffer eight bytes at a time: each word is compared with eight newlines
+  * by finding its zero bytes exactly, and the resulting high bits are counted
+  * @param data   the bytes to be counted
+  * @param length the number of bytes
+  * @return the number of newlines
+  */
+size_t count_newlines(const char *data, size_t length);
+
+/**
+  * Counts the words (runs of bytes other than space, \t, \n, \v, \f and \r) that start in a
+  * buffer, eight bytes at a time: the high bit of each byte is set where it is a space, and a word
+  * starts at each byte that is not a space but follows one
+  * @param data    the bytes to be counted
+  * @param length  the number of bytes
+  * @param in_word in/out param; whether the byte before the buffer was part of a word
+  * @return the number of words that start in the buffer
+  */
+size_t count_words(const char *data, size_t length, int *in_word);
+
+/**
+  * Allocates an empty block
+  * @param capacity the number of bytes the block can hold
+  * @return the block, or NULL if it could not be allocated
+  */
+block_t *new_block(size_t capacity);
+
+/**
+  * Frees a block
+  * @param block the block to be freed; may be NULL
+  */
+void free_block(block_t *block);
+
+/**
+  * Sets up an empty channel
+  * @param channel the channel
+  */
+void initialize_channel(channel_t *channel);
+
+/**
+  * Adds a block to a channel, waiting while the channel is full
+  * @param channel the channel
+  * @param block   the block, which the channel (or, if it has been closed, this function) frees
+  * @return nonzero if the block was queued, zero if the consumer has closed the channel
+  */
+int push_block(channel_t *channel, block_t *block);
+
+/**
+  * Takes the next block from a channel, waiting while the channel is empty
+  * @param channel the channel
+  * @return the block, or NULL once the channel is finished and drained
+  */
+block_t *pop_block(channel_t *channel);
+
+/**
+  * Marks the end of a channel's input, on the producer's side
+  * @param channel the channel
+  */
+void finish_channel(channel_t *channel);
+
+/**
+  * Marks that no more of a channel's input is wanted, on the consumer's side, and frees what is
+  * queued
+  * @param channel the channel
+  */
+void close_channel(channel_t *channel);
+
+/**
+  * Frees what is left of a channel
+  * @param channel the channel
+  */
+void destroy_channel(channel_t *channel);
+
+/**
+  * Appends bytes to a stage's pending output. If the bytes are the whole of the block being
+  * filtered, and nothing is pending, the block itself becomes the pending output
+  * @param stage  the stage
+  * @param block  the block being filtered
+  * @param data   the bytes to be output
+  * @param length the number of bytes
+  */
+void emit(stage_t *stage, block_t *block, const char *data, size_t length);
+
+/**
+  * Passes a stage's pending output to the next stage, or writes it if the stage is the last. A stage
+  * whose output is no longer wanted is stopped
+  * @param stage the stage
+  */
+void flush_stage(stage_t *stage);
+
+/**
+  * Writes all of a buffer to a descriptor, continuing after short writes
+  * @param fd     the descriptor to write to
+  * @param data   the bytes to be written
+  * @param length the number of bytes
+  * @return zero if the bytes could not all be written, nonzero otherwise
+  */
+int write_block(int fd, const char *data, size_t length);
+
+/**
+  * Selects the lines of a block that contain the pattern (or, with -v, those that do not)
+  * @param stage the @grep stage
+  * @param block the block
+  */
+void filter_grep(stage_t *stage, block_t *block);
+
+/**
+  * Counts the lines, words and bytes of a block
+  * @param stage the @wc stage
+  * @param block the block
+  */
+void filter_wc(stage_t *stage, block_t *block);
+
+/**
+  * Passes on the lines of a block until the limit is reached, then stops
+  * @param stage the @head stage
+  * @param block the block
+  */
+void filter_head(stage_t *stage, block_t *block);
+
+/**
+  * Keeps a block, along with as many of the blocks before it as are needed to hold the last lines
+  * @param stage the @tail stage
+  * @param block the block, which the stage takes
+  */
+void filter_tail(stage_t *stage, block_t *block);
+
+/**
+  * Outputs what a stage has been saving for the end of its input: the counts, or the last lines
+  * @param stage the stage
+  */
+void finish_stage(stage_t *stage);
+
+/**
+  * Runs a stage until its input ends or its output is no longer wanted
+  * @param argument the stage
+  * @return NULL
+  */
+void *run_stage(void *argument);
+
+/**
+  * Reads the input into blocks of whole lines and passes them to the first stage, until the input
+  * ends or the first stage stops
+  * @param input   the descriptor to read
+  * @param channel the first stage's input
+  */
+void read_input(int input, channel_t *channel);
+
+/**
+  * Reads a count of lines, such as the operand of -n
+  * @param text  the count
+  * @param count out param; the count
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t parse_count(const char *text, size_t *count);
+
+int is_filter(const char *name)
+{
+	if (name == NULL || name[0] != '@')
+	{
+		return 0;
+	}
+
+	size_t i;
+	for (i = 0; FILTER_NAMES[i] != NULL; i++)
+	{
+		if (strcmp(name, FILTER_NAMES[i]) == 0)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+status_t parse_filter(char **arguments, filter_t *filter)
+{
+	memset(filter, 0, sizeof *filter);
+	filter->limit = FILTER_DEFAULT_LINES;
+	for (filter->type = 0; FILTER_NAMES[filter->type] != NULL; filter->type++)
+	{
+		if (strcmp(arguments[0], FILTER_NAMES[filter->type]) == 0)
+		{
+			break;
+		}
+	}
+
+	if (FILTER_NAMES[filter->type] == NULL)
+	{
+		return ARGS_ERROR;
+	}
+
+	size_t i = 1;
+	while (arguments[i] != NULL && arguments[i][0] == '-' && arguments[i][1] != '\0')
+	{
+		char *option = arguments[i++];
+		if (strcmp(option, "--") == 0)
+		{
+			break;
+		}
+
+		//head and tail take -n N, -nN and the older -N
+		if (filter->type == FILTER_HEAD || filter->type == FILTER_TAIL)
+		{
+			const char *count = option + 1;
+			if (option[1] == 'n')
+			{
+				count = option[2] != '\0' ? option + 2 : arguments[i++];
+				if (count == NULL)
+				{
+					return ARGS_ERROR;
+				}
+			}
+
+			status_t error = parse_count(count, &filter->limit);
+			if (error != SUCCESS)
+			{
+				return error;
+			}
+			continue;
+		}
+
+		const char *flag;
+		for (flag = option + 1; *flag != '\0'; flag++)
+		{
+			if (filter->type == FILTER_GREP && *flag == 'F')
+			{
+				//the pattern is always a fixed string, so -F is only accepted
+				continue;
+			}
+			else if (filter->type == FILTER_GREP && *flag == 'v')
+			{
+				filter->invert = 1;
+			}
+			else if (filter->type == FILTER_GREP && *flag == 'c')
+			{
+				filter->count_only = 1;
+			}
+			else if (filter->type == FILTER_WC && *flag == 'l')
+			{
+				filter->lines = 1;
+			}
+			else if (filter->type == FILTER_WC && *flag == 'w')
+			{
+				filter->words = 1;
+			}
+			else if (filter->type == FILTER_WC && *flag == 'c')
+			{
+				filter->bytes = 1;
+			}
+			else
+			{
+				return ARGS_ERROR;
+			}
+		}
+	}
+
+	if (filter->type == FILTER_GREP)
+	{
+		if (arguments[i] == NULL)
+		{
+			return ARGS_ERROR;
+		}
+		filter->pattern = arguments[i++];
+		filter->pattern_length = strlen(filter->pattern);
+	}
+
+	if (filter->type == FILTER_WC && !filter->lines && !filter->words && !filter->bytes)
+	{
+		filter->lines = filter->words = filter->bytes = 1;
+	}
+
+	//a filter only ever reads the pipeline, never files
+	return arguments[i] == NULL ? SUCCESS : ARGS_ERROR;
+}
+
+int run_filters(filter_t *filters, size_t count, int input, int output)
+{
+	//a reader that has gone away shows up as EPIPE, rather than killing the filters
+	signal(SIGPIPE, SIG_IGN);
+
+	channel_t *channels = malloc(count * sizeof *channels);
+	stage_t *stages = calloc(count, sizeof *stages);
+	pthread_t *threads = malloc(count * sizeof *threads);
+	if (channels == NULL || stages == NULL || threads == NULL)
+	{
+		free(channels);
+		free(stages);
+		free(threads);
+		error_message(MEMORY_ERROR);
+		return 2;
+	}
+
+	size_t i;
+	for (i = 0; i < count; i++)
+	{
+		initialize_channel(channels + i);
+	}
+
+	size_t started;
+	for (started = 0; started < count; started++)
+	{
+		stage_t *stage = stages + started;
+		stage->filter = filters + started;
+		stage->input = channels + started;
+		stage->output = started + 1 < count ? channels + started + 1 : NULL;
+		stage->fd = output;
+		stage->remaining = stage->filter->limit;
+		if (pthread_create(threads + started, NULL, run_stage, stage) != 0)
+		{
+			break;
+		}
+	}
+
+	int status = 2;
+	if (started == count)
+	{
+		read_input(input, channels);
+	}
+	else
+	{
+		error_message(THREAD_ERROR);
+		close_channel(channels + started);
+	}
+	finish_channel(channels);
+
+	for (i = 0; i < started; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	if (started == count)
+	{
+		status = stages[count - 1].status;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		destroy_channel(channels + i);
+	}
+	free(channels);
+	free(stages);
+	free(threads);
+	return status;
+}
+
+size_t count_newlines(const char *data, size_t length)
+{
+	const uint64_t newlines = SWAR_ONES * '\n';
+	size_t count = 0;
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, data + i, sizeof word);
+		word ^= newlines;
+
+		//the high bit of each byte is set exactly where the byte was zero, with no carries between
+		//bytes, so the bits can be counted directly
+		uint64_t zeroes = ~(((word & SWAR_LOW7) + SWAR_LOW7) | word | SWAR_LOW7);
+		count += __builtin_popcountll(zeroes);
+	}
+
+	for (; i < length; i++)
+	{
+		count += data[i] == '\n';
+	}
+
+	return count;
+}
+
+size_t count_words(const char *data, size_t length, int *in_word)
+{
+	const uint64_t blanks = SWAR_ONES * ' ';
+	size_t count = 0;
+	uint64_t carry = *in_word ? 0 : 1;
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, data + i, sizeof word);
+
+		//blanks exactly as count_newlines finds newlines, and \t to \r as bytes above 8 and below 14,
+		//which only bytes under 0x80 can be
+		uint64_t blank = word ^ blanks;
+		blank = ~(((blank & SWAR_LOW7) + SWAR_LOW7) | blank | SWAR_LOW7);
+		uint64_t low = word & SWAR_LOW7;
+		uint64_t control = ((SWAR_ONES * (127 + 14) - low) & ~word & (low + SWAR_ONES * (127 - 8))) & SWAR_HIGH;
+		uint64_t spaces = blank | control;
+
+		//each byte's predecessor is the byte below it, or the last byte of the previous word
+		uint64_t follows_space = (spaces << 8) | (carry << 7);
+		count += __builtin_popcountll(~spaces & follows_space & SWAR_HIGH);
+		carry = spaces >> 63;
+	}
+
+	for (; i < length; i++)
+	{
+		char c = data[i];
+		int space = c == ' ' || (c >= '\t' && c <= '\r');
+		count += !space && carry;
+		carry = space;
+	}
+
+	*in_word = !carry;
+	return count;
+}
+
+block_t *new_block(size_t capacity)
+{
+	block_t *block = malloc(sizeof *block);
+	if (block == NULL)
+	{
+		return NULL;
+	}
+
+	block->data = malloc(capacity);
+	if (block->data == NULL)
+	{
+		free(block);
+		return NULL;
+	}
+
+	block->length = 0;
+	block->capacity = capacity;
+	block->newlines = 0;
+	block->next = NULL;
+	return block;
+}
+
+void free_block(block_t *block)
+{
+	if (block != NULL)
+	{
+		free(block->data);
+		free(block);
+	}
+}
+
+void initialize_channel(channel_t *channel)
+{
+	pthread_mutex_init(&channel->lock, NULL);
+	pthread_cond_init(&channel->changed, NULL);
+	channel->head = NULL;
+	channel->tail = NULL;
+	channel->queued = 0;
+	channel->finished = 0;
+	channel->closed = 0;
+}
+
+int push_block(channel_t *channel, block_t *block)
+{
+	pthread_mutex_lock(&channel->lock);
+	while (channel->queued >= FILTER_QUEUE && !channel->closed)
+	{
+		pthread_cond_wait(&channel->changed, &channel->lock);
+	}
+
+	if (channel->closed)
+	{
+		pthread_mutex_unlock(&channel->lock);
+		free_block(block);
+		return 0;
+	}
+
+	block->next = NULL;
+	if (channel->tail != NULL)
+	{
+		channel->tail->next = block;
+	}
+	else
+	{
+		channel->head = block;
+	}
+	channel->tail = block;
+	channel->queued++;
+	pthread_cond_broadcast(&channel->changed);
+	pthread_mutex_unlock(&channel->lock);
+	return 1;
+}
+
+block_t *pop_block(channel_t *channel)
+{
+	pthread_mutex_lock(&channel->lock);
+	while (channel->head == NULL && !channel->finished)
+	{
+		pthread_cond_wait(&channel->changed, &channel->lock);
+	}
+
+	block_t *block = channel->head;
+	if (block != NULL)
+	{
+		channel->head = block->next;
+		if (channel->head == NULL)
+		{
+			channel->tail = NULL;
+		}
+		channel->queued--;
+		pthread_cond_broadcast(&channel->changed);
+	}
+	pthread_mutex_unlock(&channel->lock);
+	return block;
+}
+
+void finish_channel(channel_t *channel)
+{
+	pthread_mutex_lock(&channel->lock);
+	channel->finished = 1;
+	pthread_cond_broadcast(&channel->changed);
+	pthread_mutex_unlock(&channel->lock);
+}
+
+void close_channel(channel_t *channel)
+{
+	pthread_mutex_lock(&channel->lock);
+	channel->closed = 1;
+	while (channel->head != NULL)
+	{
+		block_t *next = channel->head->next;
+		free_block(channel->head);
+		channel->head = next;
+	}
+	channel->tail = NULL;
+	channel->queued = 0;
+	pthread_cond_broadcast(&channel->changed);
+	pthread_mutex_unlock(&channel->lock);
+}
+
+void destroy_channel(channel_t *channel)
+{
+	while (channel->head != NULL)
+	{
+		block_t *next = channel->head->next;
+		free_block(channel->head);
+		channel->head = next;
+	}
+	pthread_mutex_destroy(&channel->lock);
+	pthread_cond_destroy(&channel->changed);
+}
+
+void emit(stage_t *stage, block_t *block, const char *data, size_t length)
+{
+	if (length == 0 || stage->stopped)
+	{
+		return;
+	}
+
+	//passing the whole block on saves copying it
+	if (stage->pending == NULL && block != NULL && data == block->data && length == block->length)
+	{
+		stage->pending = block;
+		return;
+	}
+
+	if (stage->pending == NULL || stage->pending->length + length > stage->pending->capacity)
+	{
+		size_t needed = (stage->pending != NULL ? stage->pending->length : 0) + length;
+		size_t capacity = stage->pending != NULL ? stage->pending->capacity * 2 : FILTER_MIN_OUTPUT;
+		while (capacity < needed)
+		{
+			capacity *= 2;
+		}
+
+		block_t *grown = new_block(capacity);
+		if (grown == NULL)
+		{
+			stage->stopped = 1;
+			return;
+		}
+
+		if (stage->pending != NULL)
+		{
+			memcpy(grown->data, stage->pending->data, stage->pending->length);
+			grown->length = stage->pending->length;
+			//the block being filtered is freed by the caller, so it must not be freed here as well
+			if (stage->pending != block)
+			{
+				free_block(stage->pending);
+			}
+		}
+		stage->pending = grown;
+	}
+
+	memcpy(stage->pending->data + stage->pending->length, data, length);
+	stage->pending->length += length;
+}
+
+void flush_stage(stage_t *stage)
+{
+	block_t *pending = stage->pending;
+	stage->pending = NULL;
+	if (pending == NULL)
+	{
+		return;
+	}
+
+	if (stage->output != NULL)
+	{
+		if (!push_block(stage->output, pending))
+		{
+			stage->stopped = 1;
+		}
+		return;
+	}
+
+	if (!write_block(stage->fd, pending->data, pending->length))
+	{
+		stage->stopped = 1;
+	}
+	free_block(pending);
+}
+
+int write_block(int fd, const char *data, size_t length)
+{
+	while (length > 0)
+	{
+		ssize_t written = write(fd, data, length);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return 0;
+		}
+
+		data += written;
+		length -= written;
+	}
+
+	return 1;
+}
+
+void filter_grep(stage_t *stage, block_t *block)
+{
+	filter_t *filter = stage->filter;
+	const char *position = block->data;
+	const char *end = block->data + block->length;
+	while (position < end)
+	{
+		const char *match = memmem(position, end - position, filter->pattern, filter->pattern_length);
+		if (match == NULL)
+		{
+			break;
+		}
+
+		//widen the match to the line it is on
+		const char *line = memrchr(position, '\n', match - position);
+		line = line != NULL ? line + 1 : position;
+		const char *line_end = memchr(match, '\n', end - match);
+		line_end = line_end != NULL ? line_end + 1 : end;
+
+		if (filter->invert)
+		{
+			//every line between the last match and this one is selected
+			size_t length = line - position;
+			stage->selected += count_newlines(position, length);
+			if (!filter->count_only)
+			{
+				emit(stage, block, position, length);
+			}
+		}
+		else
+		{
+			stage->selected++;
+			if (!filter->count_only)
+			{
+				emit(stage, block, line, line_end - line);
+			}
+		}
+
+		position = line_end;
+	}
+
+	if (filter->invert && position < end)
+	{
+		size_t length = end - position;
+		stage->selected += count_newlines(position, length) + (end[-1] != '\n');
+		if (!filter->count_only)
+		{
+			emit(stage, block, position, length);
+		}
+	}
+}
+
+void filter_wc(stage_t *stage, block_t *block)
+{
+	filter_t *filter = stage->filter;
+	stage->bytes += block->length;
+	if (filter->lines)
+	{
+		stage->lines += count_newlines(block->data, block->length);
+	}
+
+	if (filter->words)
+	{
+		stage->words += count_words(block->data, block->length, &stage->in_word);
+	}
+}
+
+void filter_head(stage_t *stage, block_t *block)
+{
+	const char *position = block->data;
+	const char *end = block->data + block->length;
+	while (stage->remaining > 0 && position < end)
+	{
+		const char *newline = memchr(position, '\n', end - position);
+		position = newline != NULL ? newline + 1 : end;
+		stage->remaining--;
+	}
+
+	emit(stage, block, block->data, position - block->data);
+	if (stage->remaining == 0)
+	{
+		stage->stopped = 1;
+	}
+}
+
+void filter_tail(stage_t *stage, block_t *block)
+{
+	block->newlines = count_newlines(block->data, block->length);
+	block->next = NULL;
+	if (stage->kept_tail != NULL)
+	{
+		stage->kept_tail->next = block;
+	}
+	else
+	{
+		stage->kept = block;
+	}
+	stage->kept_tail = block;
+	stage->kept_newlines += block->newlines;
+
+	//the oldest block can go once the others hold more newlines than there are lines to keep, since
+	//the first of the kept lines then starts after it
+	while (stage->kept != stage->kept_tail && stage->kept_newlines - stage->kept->newlines > stage->remaining)
+	{
+		block_t *oldest = stage->kept;
+		stage->kept = oldest->next;
+		stage->kept_newlines -= oldest->newlines;
+		free_block(oldest);
+	}
+}
+
+void finish_stage(stage_t *stage)
+{
+	filter_t *filter = stage->filter;
+	char line[96];
+	int length = 0;
+	if (filter->type == FILTER_GREP && filter->count_only)
+	{
+		length = snprintf(line, sizeof line, "%zu\n", stage->selected);
+	}
+	else if (filter->type == FILTER_WC)
+	{
+		//a single count is printed as it is; several are lined up, as wc does when reading a pipe
+		size_t counts[] = { stage->lines, stage->words, stage->bytes };
+		unsigned short wanted[] = { filter->lines, filter->words, filter->bytes };
+		int several = filter->lines + filter->words + filter->bytes > 1;
+		size_t i;
+		for (i = 0; i < sizeof counts / sizeof *counts; i++)
+		{
+			if (wanted[i])
+			{
+				length += snprintf(line + length, sizeof line - length, several ? "%s%7zu" : "%s%zu", length > 0 ? " " : "", counts[i]);
+			}
+		}
+		line[length++] = '\n';
+	}
+	else if (filter->type == FILTER_TAIL && stage->kept != NULL)
+	{
+		size_t total = 0;
+		block_t *block;
+		for (block = stage->kept; block != NULL; block = block->next)
+		{
+			total += block->length;
+		}
+
+		block_t *joined = new_block(total + 1);
+		if (joined != NULL)
+		{
+			for (block = stage->kept; block != NULL; block = block->next)
+			{
+				memcpy(joined->data + joined->length, block->data, block->length);
+				joined->length += block->length;
+			}
+
+			//the last line counts whether or not it ends with a newline; the start of the kept lines
+			//is just after the newline that ends the line before them
+			size_t position = joined->length;
+			if (position > 0 && joined->data[position - 1] == '\n')
+			{
+				position--;
+			}
+
+			size_t start = stage->remaining == 0 ? joined->length : 0;
+			size_t found;
+			for (found = 0; found < stage->remaining; found++)
+			{
+				const char *newline = memrchr(joined->data, '\n', position);
+				if (newline == NULL)
+				{
+					break;
+				}
+				position = newline - joined->data;
+				start = position + 1;
+			}
+
+			if (found < stage->remaining)
+			{
+				start = 0;
+			}
+			emit(stage, NULL, joined->data + start, joined->length - start);
+			free_block(joined);
+		}
+	}
+
+	if (length > 0)
+	{
+		emit(stage, NULL, line, length);
+	}
+	flush_stage(stage);
+}
+
+void *run_stage(void *argument)
+{
+	stage_t *stage = argument;
+	block_t *block;
+	while (!stage->stopped && (block = pop_block(stage->input)) != NULL)
+	{
+		switch (stage->filter->type)
+		{
+			case FILTER_GREP:
+				filter_grep(stage, block);
+				break;
+			case FILTER_WC:
+				filter_wc(stage, block);
+				break;
+			case FILTER_HEAD:
+				filter_head(stage, block);
+				break;
+			case FILTER_TAIL:
+				//the stage keeps the block
+				filter_tail(stage, block);
+				continue;
+		}
+
+		//the block is freed unless it was passed on as it was
+		int passed_on = stage->pending == block;
+		flush_stage(stage);
+		if (!passed_on)
+		{
+			free_block(block);
+		}
+	}
+
+	//whatever is before this stage has no one left to write to
+	close_channel(stage->input);
+
+	finish_stage(stage);
+
+	while (stage->kept != NULL)
+	{
+		block_t *next = stage->kept->next;
+		free_block(stage->kept);
+		stage->kept = next;
+	}
+
+	if (stage->filter->type == FILTER_GREP)
+	{
+		stage->status = stage->selected > 0 ? 0 : 1;
+	}
+
+	if (stage->output != NULL)
+	{
+		finish_channel(stage->output);
+	}
+	return NULL;
+}
+
+void read_input(int input, channel_t *channel)
+{
+	block_t *block = new_block(FILTER_BUFFER);
+	while (block != NULL)
+	{
+		if (block->length == block->capacity)
+		{
+			//a line longer than a block: the block grows until it holds it
+			char *grown = realloc(block->data, block->capacity * 2);
+			if (grown == NULL)
+			{
+				break;
+			}
+			block->data = grown;
+			block->capacity *= 2;
+		}
+
+		ssize_t length = read(input, block->data + block->length, block->capacity - block->length);
+		if (length < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (length <= 0)
+		{
+			//the last line need not end with a newline
+			if (block->length > 0)
+			{
+				push_block(channel, block);
+				block = NULL;
+			}
+			break;
+		}
+
+		//what is already waiting in the pipe is read into the same block, but whatever has arrived
+		//is passed on once the pipe is empty, up to the last whole line, so that a slow producer's
+		//lines are not held back; the rest starts the next block
+		block->length += length;
+		int waiting = 0;
+		if (block->length < block->capacity && ioctl(input, FIONREAD, &waiting) == 0 && waiting > 0)
+		{
+			continue;
+		}
+
+		const char *last = memrchr(block->data, '\n', block->length);
+		if (last == NULL)
+		{
+			continue;
+		}
+
+		size_t used = last + 1 - block->data;
+		size_t rest = block->length - used;
+		block_t *next = new_block(rest > FILTER_BUFFER ? rest * 2 : FILTER_BUFFER);
+		if (next != NULL)
+		{
+			memcpy(next->data, block->data + used, rest);
+			next->length = rest;
+		}
+		block->length = used;
+
+		if (!push_block(channel, block))
+		{
+			free_block(next);
+			return;
+		}
+		block = next;
+	}
+
+	free_block(block);
+}
+
+status_t parse_count(const char *text, size_t *count)
+{
+	if (*text < '0' || *text > '9')
+	{
+		return NUMBER_ERROR;
+	}
+
+	char *end;
+	errno = 0;
+	unsigned long long value = strtoull(text, &end, 10);
+	if (*end != '\0' || errno != 0)
+	{
+		return NUMBER_ERROR;
+	}
+
+	*count = (size_t) value;
+	return SUCCESS;
+}
@@ -0,0 +1,189 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../include/here_document.h"
+
+#define HERE_SEALS (F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+
+/**
+  * Reads the body of a single here-document into a new sealed memfd
+  * @param delimiter the line that ends the document
+  * @param read_line reads the lines of the document
+  * @param context   passed to read_line
+  * @return the memfd, or -1 if it could not be created or written
+  */
+int read_here_document(char *delimiter, line_reader_t read_line, void *context);
+
+/**
+  * Writes all of a buffer to the end of a document, continuing after short writes
+  * @param fd     the memfd holding the document
+  * @param data   the bytes to be written
+  * @param length the number of bytes to be written
+  * @return zero if the bytes could not all be written, nonzero otherwise
+  */
+int append_to_document(int fd, const char *data, size_t length);
+
+/**
+  * Seals a finished document so that neither the shell nor any command can change it, and moves
+  * back to its start
+  * @param fd the memfd holding the document
+  * @return zero if it could not be sealed, nonzero otherwise
+  */
+int seal_document(int fd);
+
+status_t read_here_documents(command_t *command, line_reader_t read_line, void *context)
+{
+	command_t *pipeline = command;
+	command_t *branch = command->fanout;
+	while (pipeline != NULL)
+	{
+		command_t *stage;
+		for (stage = pipeline; stage != NULL; stage = stage->pipe)
+		{
+			if (stage->here_delimiter == NULL)
+			{
+				continue;
+			}
+
+			stage->here_document = read_here_document(stage->here_delimiter, read_line, context);
+			if (stage->here_document < 0)
+			{
+				return HEREDOC_ERROR;
+			}
+		}
+
+		pipeline = branch;
+		branch = branch != NULL ? branch->next_branch : NULL;
+	}
+
+	return SUCCESS;
+}
+
+int make_here_string(char *word)
+{
+	int fd = memfd_create("here-string", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	if (!append_to_document(fd, word, strlen(word)) || !append_to_document(fd, "\n", 1) || !seal_document(fd))
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int has_here_document(command_t *command)
+{
+	command_t *pipeline = command;
+	command_t *branch = command->fanout;
+	while (pipeline != NULL)
+	{
+		command_t *stage;
+		for (stage = pipeline; stage != NULL; stage = stage->pipe)
+		{
+			if (stage->here_delimiter != NULL)
+			{
+				return 1;
+			}
+		}
+
+		pipeline = branch;
+		branch = branch != NULL ? branch->next_branch : NULL;
+	}
+
+	return 0;
+}
+
+void close_here_documents(command_t *command)
+{
+	command_t *pipeline = command;
+	command_t *branch = command->fanout;
+	while (pipeline != NULL)
+	{
+		command_t *stage;
+		for (stage = pipeline; stage != NULL; stage = stage->pipe)
+		{
+			if (stage->here_document >= 0)
+			{
+				close(stage->here_document);
+				stage->here_document = -1;
+			}
+		}
+
+		pipeline = branch;
+		branch = branch != NULL ? branch->next_branch : NULL;
+	}
+}
+
+int read_here_document(char *delimiter, line_reader_t read_line, void *context)
+{
+	int fd = memfd_create("here-document", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	//a document cut off by the end of the input keeps what was read of it, as other shells do
+	size_t delimiter_length = strlen(delimiter);
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t length;
+	while ((length = read_line(context, &line, &size)) >= 0)
+	{
+		size_t content = length > 0 && line[length - 1] == '\n' ? length - 1 : length;
+		if (content == delimiter_length && strncmp(line, delimiter, delimiter_length) == 0)
+		{
+			break;
+		}
+
+		if (!append_to_document(fd, line, length))
+		{
+			free(line);
+			close(fd);
+			return -1;
+		}
+	}
+	free(line);
+
+	if (!seal_document(fd))
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int append_to_document(int fd, const char *data, size_t length)
+{
+	while (length > 0)
+	{
+		ssize_t written = write(fd, data, length);
+		if (written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (written <= 0)
+		{
+			return 0;
+		}
+		data += written;
+		length -= written;
+	}
+
+	return 1;
+}
+
+int seal_document(int fd)
+{
+	return fcntl(fd, F_ADD_SEALS, HERE_SEALS) == 0 && lseek(fd, 0, SEEK_SET) == 0;
+}
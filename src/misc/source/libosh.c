@@ -0,0 +1,436 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/libosh.h"
+#include "../include/shell.h"
+
+#define CAPTURE_BUFFER (64 * 1024)
+
+/**
+  * Held by every entry point for as long as it runs. The shell's stdout, stderr and current directory
+  * are the program's own, so no two calls, in the same shell or not, may use them at once
+  */
+pthread_mutex_t library_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+  * An embedded shell, the callbacks its output goes to, stdout's first, and its current directory,
+  * which is the program's only while the shell runs a script
+  */
+struct osh_env
+{
+	shell_t *shell;
+	osh_output_t output[2];
+	void *context;
+	int cwd;
+};
+
+/**
+  * The output of a batch being captured: the read ends of the pipes now on stdout and stderr (-1
+  * for one without a callback), the program's own stdout and stderr, moved aside, and the pipes the
+  * batch asks the relay thread to drain over, and hears back on
+  */
+typedef struct
+{
+	osh_env_t *env;
+	int pipes[2];
+	int saved[2];
+	int request[2];
+	int reply[2];
+	pthread_t thread;
+	unsigned short running;
+} capture_t;
+
+/**
+  * Runs a script in the shell a line at a time, as initialize_shell runs the initialization file,
+  * reading any continuation lines from the script too
+  * @param environment the shell's environment
+  * @param text        the script
+  * @return a status code indicating whether an error occurred during execution of the function;
+  *         SHELL_EXIT if the script ran exit or quit
+  */
+status_t evaluate_text(environment_t *environment, const char *text);
+
+/**
+  * Swaps the program's current directory with the one held by cwd: the program moves to that
+  * directory, and cwd is given the directory the program was in. The program stays where it is if
+  * cwd does not hold a directory (-1) or cannot be moved to
+  * @param cwd in/out param; the descriptor of the directory to move to, then of the one moved from
+  */
+void swap_cwd(int *cwd);
+
+/**
+  * Puts pipes on stdout and stderr, for each that has a callback, and starts the thread relaying
+  * what comes through them to the callbacks. Does nothing if neither has one
+  * @param capture out param; the capture
+  * @param env     the shell
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t start_capture(capture_t *capture, osh_env_t *env);
+
+/**
+  * Waits until everything written so far has been passed to the callbacks, then has what comes next
+  * passed as the output of the next script. The commands of a script have all been waited for when
+  * it finishes, so all they wrote is in the pipes by then
+  * @param capture the capture
+  * @param script  the index of the next script
+  */
+void next_capture(capture_t *capture, size_t script);
+
+/**
+  * Passes what is left to the callbacks, stops the relay thread, and puts the program's own stdout
+  * and stderr back. Anything still running in the background gets SIGPIPE if it writes after this
+  * @param capture the capture
+  */
+void stop_capture(capture_t *capture);
+
+/**
+  * The relay thread: passes output to the callbacks as it arrives, and drains the pipes whenever the
+  * batch asks, until the request pipe closes
+  * @param argument the capture
+  * @return NULL
+  */
+void *relay_captured(void *argument);
+
+/**
+  * Reads from one of the capture's pipes and passes what was read to its callback
+  * @param capture the capture
+  * @param which   0 for stdout, 1 for stderr
+  * @param script  the index of the script the output belongs to
+  * @param drain   nonzero to read until the pipe is empty, zero to read once
+  */
+void deliver_captured(capture_t *capture, int which, size_t script, unsigned short drain);
+
+status_t osh_env_create(osh_env_t **env)
+{
+	osh_env_t *created = calloc(1, sizeof *created);
+	if (created == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+
+	pthread_mutex_lock(&library_lock);
+	status_t error = create_shell(&created->shell, environ);
+	pthread_mutex_unlock(&library_lock);
+	if (error != SUCCESS)
+	{
+		free(created);
+		return error;
+	}
+
+	//the zygote is osh run again, and the program embedding the shell is not osh
+	created->shell->zygote.executable = NULL;
+
+	//the shell starts out in the program's current directory, but cd only moves the shell
+	created->cwd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+	*env = created;
+	return SUCCESS;
+}
+
+void osh_env_destroy(osh_env_t *env)
+{
+	pthread_mutex_lock(&library_lock);
+	destroy_shell(env->shell);
+	pthread_mutex_unlock(&library_lock);
+	if (env->cwd >= 0)
+	{
+		close(env->cwd);
+	}
+	free(env);
+}
+
+void osh_set_output(osh_env_t *env, osh_output_t out, osh_output_t err, void *context)
+{
+	pthread_mutex_lock(&library_lock);
+	env->output[0] = out;
+	env->output[1] = err;
+	env->context = context;
+	pthread_mutex_unlock(&library_lock);
+}
+
+status_t osh_run(osh_env_t *env, const char *script, int *status)
+{
+	return osh_run_batch(env, &script, 1, status);
+}
+
+status_t osh_run_batch(osh_env_t *env, const char **scripts, size_t count, int *statuses)
+{
+	pthread_mutex_lock(&library_lock);
+	capture_t capture;
+	status_t error = start_capture(&capture, env);
+	if (error != SUCCESS)
+	{
+		pthread_mutex_unlock(&library_lock);
+		return error;
+	}
+
+	swap_cwd(&env->cwd);
+
+	environment_t *environment = &env->shell->environment;
+	size_t i;
+	for (i = 0; i < count && error == SUCCESS; i++)
+	{
+		error = evaluate_text(environment, scripts[i]);
+		if (statuses != NULL)
+		{
+			statuses[i] = environment->status;
+		}
+		next_capture(&capture, i + 1);
+	}
+
+	swap_cwd(&env->cwd);
+	stop_capture(&capture);
+	pthread_mutex_unlock(&library_lock);
+	return error;
+}
+
+status_t evaluate_text(environment_t *environment, const char *text)
+{
+	//every line eval_print is given ends with a newline, as it does from the terminal
+	size_t length = strlen(text);
+	char *copy = malloc(length + 1);
+	if (copy == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+	memcpy(copy, text, length);
+	if (length == 0 || copy[length - 1] != '\n')
+	{
+		copy[length++] = '\n';
+	}
+
+	FILE *input = fmemopen(copy, length, "r");
+	if (input == NULL)
+	{
+		free(copy);
+		return OPEN_ERROR;
+	}
+
+	//pick up any commands installed into or removed from the path since the last script
+	update_exec_index(environment->exec_index, environment->path);
+	FILE *outer = environment->input;
+	environment->input = input;
+
+	unsigned short cont = 1;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t chars_read;
+	while (cont && (chars_read = getline(&line, &size, input)) > 0)
+	{
+		cont = eval_print(line, chars_read, environment);
+	}
+
+	environment->input = outer;
+	free(line);
+	fclose(input);
+	free(copy);
+	return cont ? SUCCESS : SHELL_EXIT;
+}
+
+void swap_cwd(int *cwd)
+{
+	int current = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+	if (*cwd >= 0 && fchdir(*cwd) < 0)
+	{
+		if (current >= 0)
+		{
+			close(current);
+		}
+		return;
+	}
+
+	if (*cwd >= 0)
+	{
+		close(*cwd);
+	}
+	*cwd = current;
+}
+
+status_t start_capture(capture_t *capture, osh_env_t *env)
+{
+	capture->env = env;
+	capture->running = 0;
+	int i;
+	for (i = 0; i < 2; i++)
+	{
+		capture->pipes[i] = -1;
+		capture->saved[i] = -1;
+		capture->request[i] = -1;
+		capture->reply[i] = -1;
+	}
+	if (env->output[0] == NULL && env->output[1] == NULL)
+	{
+		return SUCCESS;
+	}
+
+	if (pipe2(capture->request, O_CLOEXEC) < 0 || pipe2(capture->reply, O_CLOEXEC) < 0)
+	{
+		stop_capture(capture);
+		return PIPE_ERROR;
+	}
+
+	//anything the program has buffered is its own output, so it goes out before the pipes go in
+	fflush(stdout);
+	fflush(stderr);
+	for (i = 0; i < 2; i++)
+	{
+		if (env->output[i] == NULL)
+		{
+			continue;
+		}
+
+		//only the read end is nonblocking; the commands write to the other end as they would to
+		//a terminal
+		int fds[2];
+		if (pipe2(fds, O_CLOEXEC) < 0)
+		{
+			stop_capture(capture);
+			return PIPE_ERROR;
+		}
+		capture->pipes[i] = fds[0];
+		fcntl(fds[0], F_SETFL, O_NONBLOCK);
+		capture->saved[i] = fcntl(STDOUT_FILENO + i, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+		int moved = capture->saved[i] >= 0 ? dup2(fds[1], STDOUT_FILENO + i) : -1;
+		close(fds[1]);
+		if (moved < 0)
+		{
+			stop_capture(capture);
+			return DUP_ERROR;
+		}
+	}
+
+	if (pthread_create(&capture->thread, NULL, relay_captured, capture) != 0)
+	{
+		stop_capture(capture);
+		return THREAD_ERROR;
+	}
+	capture->running = 1;
+	return SUCCESS;
+}
+
+void next_capture(capture_t *capture, size_t script)
+{
+	if (!capture->running)
+	{
+		return;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+	char done;
+	if (write(capture->request[1], &script, sizeof script) == sizeof script)
+	{
+		while (read(capture->reply[0], &done, 1) < 0 && errno == EINTR);
+	}
+}
+
+void stop_capture(capture_t *capture)
+{
+	fflush(stdout);
+	fflush(stderr);
+
+	//closing the request pipe has the relay drain the pipes one last time and return
+	if (capture->request[1] >= 0)
+	{
+		close(capture->request[1]);
+		capture->request[1] = -1;
+	}
+	if (capture->running)
+	{
+		pthread_join(capture->thread, NULL);
+		capture->running = 0;
+	}
+
+	int i;
+	for (i = 0; i < 2; i++)
+	{
+		if (capture->saved[i] >= 0)
+		{
+			dup2(capture->saved[i], STDOUT_FILENO + i);
+			close(capture->saved[i]);
+		}
+		if (capture->pipes[i] >= 0)
+		{
+			close(capture->pipes[i]);
+		}
+		if (capture->request[i] >= 0)
+		{
+			close(capture->request[i]);
+		}
+		if (capture->reply[i] >= 0)
+		{
+			close(capture->reply[i]);
+		}
+	}
+}
+
+void *relay_captured(void *argument)
+{
+	capture_t *capture = argument;
+	size_t script = 0;
+	struct pollfd polls[3] = { { capture->request[0], POLLIN, 0 }, { capture->pipes[0], POLLIN, 0 }, { capture->pipes[1], POLLIN, 0 } };
+	for (;;)
+	{
+		if (poll(polls, 3, -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+
+		int i;
+		for (i = 0; i < 2; i++)
+		{
+			if (polls[i + 1].revents != 0)
+			{
+				deliver_captured(capture, i, script, 0);
+			}
+		}
+
+		if (polls[0].revents != 0)
+		{
+			size_t next;
+			ssize_t received = read(capture->request[0], &next, sizeof next);
+			deliver_captured(capture, 0, script, 1);
+			deliver_captured(capture, 1, script, 1);
+			if (received != sizeof next)
+			{
+				break;
+			}
+			script = next;
+			while (write(capture->reply[1], "", 1) < 0 && errno == EINTR);
+		}
+	}
+
+	return NULL;
+}
+
+void deliver_captured(capture_t *capture, int which, size_t script, unsigned short drain)
+{
+	if (capture->pipes[which] < 0)
+	{
+		return;
+	}
+
+	char buffer[CAPTURE_BUFFER];
+	ssize_t received;
+	while ((received = read(capture->pipes[which], buffer, sizeof buffer)) > 0 || (received < 0 && errno == EINTR))
+	{
+		if (received > 0)
+		{
+			capture->env->output[which](capture->env->context, script, buffer, received);
+			if (!drain)
+			{
+				return;
+			}
+		}
+	}
+}
@@ -0,0 +1,572 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "../include/line_editor.h"
+
+#define CTRL_KEY(key) ((key) & 0x1f)
+#define ESCAPE    27
+#define BACKSPACE 127
+
+/**
+  * The state of a line being edited: the line itself and the cursor within it, what is currently
+  * displayed on the terminal after the prompt (so that only what changed needs to be redrawn), and
+  * the output that has been built up but not yet written
+  */
+typedef struct
+{
+	string_t line;
+	size_t cursor;
+	string_t displayed;
+	size_t displayed_cursor;
+	string_t output;
+	string_t saved;
+	size_t history_position;
+} editor_t;
+
+/**
+  * Reads a line with the terminal in raw mode, as described for edit_line
+  * @param environment the current environment, supplying the history and the completions
+  * @param prompt      the prompt to print before the line
+  * @param line        in/out param; the buffer the line is placed in, as with getline
+  * @param size        in/out param; the size of the buffer, as with getline
+  * @return the number of characters read, including the newline, or -1 on end of file
+  */
+ssize_t edit_raw_line(environment_t *environment, char *prompt, char **line, size_t *size);
+
+/**
+  * Appends to the editor's pending output whatever is needed to make the terminal show the line as it
+  * now is, redrawing only from the first character that differs from what is displayed
+  * @param editor the editor to be refreshed
+  */
+void refresh(editor_t *editor);
+
+/**
+  * Deletes the character at position from the line being edited
+  * @param editor   the editor whose line the character is deleted from
+  * @param position the position of the character to be deleted
+  */
+void delete_char(editor_t *editor, size_t position);
+
+/**
+  * Appends an escape sequence moving the cursor count columns in direction ('C' for right, 'D' for
+  * left) to the editor's pending output
+  * @param editor    the editor whose output is appended to
+  * @param count     the number of columns to move
+  * @param direction the final character of the escape sequence
+  */
+void move_cursor(editor_t *editor, size_t count, char direction);
+
+/**
+  * Writes all of the editor's pending output to the terminal in one write, then empties it
+  * @param editor the editor whose output is to be written
+  */
+void flush_output(editor_t *editor);
+
+/**
+  * Replaces the line being edited with the given characters, placing the cursor at the end
+  * @param editor the editor whose line is replaced
+  * @param chars  the new contents of the line
+  * @param length the number of characters
+  */
+void replace_line(editor_t *editor, char *chars, size_t length);
+
+/**
+  * Moves through the history by one command, up (older) if older is true and down otherwise
+  * @param editor  the editor whose line is replaced
+  * @param history the history to move through
+  * @param older   whether to move to an older command or a newer one
+  */
+void recall_history(editor_t *editor, history_t *history, unsigned short older);
+
+/**
+  * Completes the command name before the cursor as far as it can be completed unambiguously. If it
+  * cannot be completed any further and list is true, every possible completion is displayed
+  * @param editor     the editor whose line is completed
+  * @param completion the table of names to complete from
+  * @param prompt     the prompt, needed to redraw the line below a list of completions
+  * @param list       whether to display the possible completions if there is nothing to add
+  */
+void complete_line(editor_t *editor, completion_t *completion, char *prompt, unsigned short list);
+
+/**
+  * Reads the rest of an escape sequence and performs the action it represents
+  * @param editor      the editor the sequence applies to
+  * @param environment the current environment, supplying the history
+  */
+void handle_escape(editor_t *editor, environment_t *environment);
+
+ssize_t edit_line(environment_t *environment, char *prompt, char **line, size_t *size)
+{
+	if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO))
+	{
+		fprintf(stdout, "%s", prompt);
+		fflush(stdout);
+		return getline(line, size, stdin);
+	}
+
+	return edit_raw_line(environment, prompt, line, size);
+}
+
+ssize_t edit_raw_line(environment_t *environment, char *prompt, char **line, size_t *size)
+{
+	struct termios original;
+	if (tcgetattr(STDIN_FILENO, &original) < 0)
+	{
+		fprintf(stdout, "%s", prompt);
+		fflush(stdout);
+		return getline(line, size, stdin);
+	}
+
+	//read a key at a time, without echo; output processing is left on so "\n" still moves to the
+	//start of the next line
+	struct termios raw = original;
+	raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+	raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+	raw.c_cflag |= CS8;
+	raw.c_cc[VMIN] = 1;
+	raw.c_cc[VTIME] = 0;
+	tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+
+	editor_t editor;
+	string_initialize(&editor.line);
+	string_initialize(&editor.displayed);
+	string_initialize(&editor.output);
+	string_initialize(&editor.saved);
+	editor.cursor = 0;
+	editor.displayed_cursor = 0;
+	editor.history_position = 0;
+
+	//the prompt goes out in the same write as the first redraw
+	fflush(stdout);
+	string_concatenate_char_array(&editor.output, prompt);
+	flush_output(&editor);
+
+	ssize_t chars_read = -1;
+	unsigned short last_was_tab = 0;
+	unsigned short done = 0;
+	while (!done)
+	{
+		unsigned char key;
+		if (read(STDIN_FILENO, &key, 1) <= 0)
+		{
+			break;
+		}
+
+		unsigned short is_tab = 0;
+		switch (key)
+		{
+			case '\r':
+			case '\n':
+				chars_read = editor.line.elements + 1;
+				done = 1;
+				break;
+			case CTRL_KEY('d'):
+				if (editor.line.elements == 0)
+				{
+					done = 1;
+				}
+				else if (editor.cursor < editor.line.elements)
+				{
+					delete_char(&editor, editor.cursor);
+				}
+				break;
+			case CTRL_KEY('c'):
+				string_concatenate_char_array(&editor.output, "^C\n");
+				string_concatenate_char_array(&editor.output, prompt);
+				char_vector_clear(&editor.line);
+				char_vector_clear(&editor.displayed);
+				editor.cursor = 0;
+				editor.displayed_cursor = 0;
+				editor.history_position = 0;
+				break;
+			case BACKSPACE:
+			case CTRL_KEY('h'):
+				if (editor.cursor > 0)
+				{
+					editor.cursor--;
+					delete_char(&editor, editor.cursor);
+				}
+				break;
+			case CTRL_KEY('a'):
+				editor.cursor = 0;
+				break;
+			case CTRL_KEY('e'):
+				editor.cursor = editor.line.elements;
+				break;
+			case CTRL_KEY('b'):
+				editor.cursor -= editor.cursor > 0;
+				break;
+			case CTRL_KEY('f'):
+				editor.cursor += editor.cursor < editor.line.elements;
+				break;
+			case CTRL_KEY('k'):
+				editor.line.elements = editor.cursor;
+				break;
+			case CTRL_KEY('u'):
+				memmove(editor.line.array, editor.line.array + editor.cursor, editor.line.elements - editor.cursor);
+				editor.line.elements -= editor.cursor;
+				editor.cursor = 0;
+				break;
+			case CTRL_KEY('w'):
+			{
+				size_t start = editor.cursor;
+				while (start > 0 && editor.line.array[start - 1] == ' ')
+				{
+					start--;
+				}
+				while (start > 0 && editor.line.array[start - 1] != ' ')
+				{
+					start--;
+				}
+				memmove(editor.line.array + start, editor.line.array + editor.cursor, editor.line.elements - editor.cursor);
+				editor.line.elements -= editor.cursor - start;
+				editor.cursor = start;
+				break;
+			}
+			case CTRL_KEY('p'):
+				recall_history(&editor, environment->history, 1);
+				break;
+			case CTRL_KEY('n'):
+				recall_history(&editor, environment->history, 0);
+				break;
+			case '\t':
+				complete_line(&editor, environment->completion, prompt, last_was_tab);
+				is_tab = 1;
+				break;
+			case ESCAPE:
+				handle_escape(&editor, environment);
+				break;
+			default:
+				if (key >= ' ')
+				{
+					char_vector_insert(&editor.line, key, editor.cursor);
+					editor.cursor++;
+				}
+		}
+		last_was_tab = is_tab;
+
+		if (done)
+		{
+			//leave the cursor after the line, so the command's output starts on a line of its own
+			editor.cursor = editor.line.elements;
+			refresh(&editor);
+			char_vector_push_back(&editor.output, '\n');
+		}
+		else
+		{
+			refresh(&editor);
+		}
+		flush_output(&editor);
+	}
+
+	tcsetattr(STDIN_FILENO, TCSAFLUSH, &original);
+
+	if (chars_read >= 0)
+	{
+		if (*line == NULL || *size < (size_t) chars_read + 1)
+		{
+			char *tmp = realloc(*line, chars_read + 1);
+			if (tmp == NULL)
+			{
+				chars_read = -1;
+			}
+			else
+			{
+				*line = tmp;
+				*size = chars_read + 1;
+			}
+		}
+
+		if (chars_read >= 0)
+		{
+			memcpy(*line, editor.line.array, editor.line.elements);
+			(*line)[chars_read - 1] = '\n';
+			(*line)[chars_read] = '\0';
+		}
+	}
+
+	string_uninitialize(&editor.line);
+	string_uninitialize(&editor.displayed);
+	string_uninitialize(&editor.output);
+	string_uninitialize(&editor.saved);
+	return chars_read;
+}
+
+void refresh(editor_t *editor)
+{
+	//find how much of what is displayed is still correct
+	size_t same = 0;
+	size_t shorter = editor->line.elements < editor->displayed.elements ? editor->line.elements : editor->displayed.elements;
+	while (same < shorter && editor->line.array[same] == editor->displayed.array[same])
+	{
+		same++;
+	}
+
+	size_t position = editor->displayed_cursor;
+	if (same < editor->line.elements || same < editor->displayed.elements)
+	{
+		//go back to the first difference, and redraw from there
+		if (position > same)
+		{
+			move_cursor(editor, position - same, 'D');
+		}
+		else
+		{
+			move_cursor(editor, same - position, 'C');
+		}
+
+		string_view_t changed = { editor->line.array + same, editor->line.elements - same };
+		string_concatenate_view(&editor->output, changed);
+		if (editor->displayed.elements > editor->line.elements)
+		{
+			string_concatenate_char_array(&editor->output, "\x1b[K");
+		}
+		position = editor->line.elements;
+	}
+
+	if (position > editor->cursor)
+	{
+		move_cursor(editor, position - editor->cursor, 'D');
+	}
+	else
+	{
+		move_cursor(editor, editor->cursor - position, 'C');
+	}
+
+	char_vector_copy(&editor->displayed, &editor->line);
+	editor->displayed_cursor = editor->cursor;
+}
+
+void delete_char(editor_t *editor, size_t position)
+{
+	memmove(editor->line.array + position, editor->line.array + position + 1, editor->line.elements - position - 1);
+	editor->line.elements--;
+}
+
+void move_cursor(editor_t *editor, size_t count, char direction)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	//a single column is cheaper to move as a backspace, or by rewriting the character
+	if (count == 1 && direction == 'D')
+	{
+		char_vector_push_back(&editor->output, '\b');
+		return;
+	}
+
+	char sequence[32];
+	snprintf(sequence, sizeof sequence, "\x1b[%zu%c", count, direction);
+	string_concatenate_char_array(&editor->output, sequence);
+}
+
+void flush_output(editor_t *editor)
+{
+	size_t written = 0;
+	while (written < editor->output.elements)
+	{
+		ssize_t result = write(STDOUT_FILENO, editor->output.array + written, editor->output.elements - written);
+		if (result <= 0)
+		{
+			break;
+		}
+		written += result;
+	}
+
+	editor->output.elements = 0;
+}
+
+void replace_line(editor_t *editor, char *chars, size_t length)
+{
+	string_assign_from_char_array_with_size(&editor->line, chars, length);
+	editor->cursor = length;
+}
+
+void recall_history(editor_t *editor, history_t *history, unsigned short older)
+{
+	size_t available = history->num_commands < history->length ? history->num_commands : history->length;
+	if (older && editor->history_position < available)
+	{
+		//keep whatever was being typed, so that coming back down restores it
+		if (editor->history_position == 0)
+		{
+			char_vector_copy(&editor->saved, &editor->line);
+		}
+
+		editor->history_position++;
+		string_t recalled;
+		string_initialize(&recalled);
+		command_to_string(&history->commands[(history->num_commands - editor->history_position) % history->length], &recalled);
+		replace_line(editor, recalled.array, recalled.elements);
+		string_uninitialize(&recalled);
+	}
+	else if (!older && editor->history_position > 0)
+	{
+		editor->history_position--;
+		if (editor->history_position == 0)
+		{
+			replace_line(editor, editor->saved.array, editor->saved.elements);
+			return;
+		}
+
+		string_t recalled;
+		string_initialize(&recalled);
+		command_to_string(&history->commands[(history->num_commands - editor->history_position) % history->length], &recalled);
+		replace_line(editor, recalled.array, recalled.elements);
+		string_uninitialize(&recalled);
+	}
+}
+
+void complete_line(editor_t *editor, completion_t *completion, char *prompt, unsigned short list)
+{
+	//only command names are completed, so the cursor has to be in the first word
+	size_t i;
+	for (i = 0; i < editor->cursor; i++)
+	{
+		if (editor->line.array[i] == ' ')
+		{
+			char_vector_push_back(&editor->output, '\a');
+			return;
+		}
+	}
+
+	char *prefix = strndup(editor->line.array, editor->cursor);
+	if (prefix == NULL)
+	{
+		return;
+	}
+
+	size_t num;
+	char **names = find_completions(completion, prefix, &num);
+	if (num == 0)
+	{
+		char_vector_push_back(&editor->output, '\a');
+		free(prefix);
+		free(names);
+		return;
+	}
+
+	//everything the matches have in common can be filled in
+	size_t common = strlen(names[0]);
+	for (i = 1; i < num; i++)
+	{
+		size_t j = 0;
+		while (j < common && names[i][j] == names[0][j])
+		{
+			j++;
+		}
+		common = j;
+	}
+
+	if (common > editor->cursor)
+	{
+		for (i = editor->cursor; i < common; i++)
+		{
+			char_vector_insert(&editor->line, names[0][i], i);
+		}
+		editor->cursor = common;
+	}
+
+	if (num == 1)
+	{
+		char_vector_insert(&editor->line, ' ', editor->cursor);
+		editor->cursor++;
+	}
+	else if (common == strlen(prefix))
+	{
+		if (list)
+		{
+			//list the matches below the line, then draw the prompt and the line again beneath them
+			move_cursor(editor, editor->displayed.elements - editor->displayed_cursor, 'C');
+			char_vector_push_back(&editor->output, '\n');
+			for (i = 0; i < num; i++)
+			{
+				string_concatenate_char_array(&editor->output, names[i]);
+				string_concatenate_char_array(&editor->output, i == num - 1 ? "\n" : "  ");
+			}
+			string_concatenate_char_array(&editor->output, prompt);
+			char_vector_clear(&editor->displayed);
+			editor->displayed_cursor = 0;
+		}
+		else
+		{
+			char_vector_push_back(&editor->output, '\a');
+		}
+	}
+
+	for (i = 0; i < num; i++)
+	{
+		free(names[i]);
+	}
+	free(names);
+	free(prefix);
+}
+
+void handle_escape(editor_t *editor, environment_t *environment)
+{
+	unsigned char sequence[3];
+	if (read(STDIN_FILENO, sequence, 1) <= 0 || read(STDIN_FILENO, sequence + 1, 1) <= 0)
+	{
+		return;
+	}
+
+	if (sequence[0] == '[' && sequence[1] >= '0' && sequence[1] <= '9')
+	{
+		//sequences like ESC [ 3 ~ carry a number
+		if (read(STDIN_FILENO, sequence + 2, 1) <= 0 || sequence[2] != '~')
+		{
+			return;
+		}
+
+		switch (sequence[1])
+		{
+			case '1':
+			case '7':
+				editor->cursor = 0;
+				break;
+			case '4':
+			case '8':
+				editor->cursor = editor->line.elements;
+				break;
+			case '3':
+				if (editor->cursor < editor->line.elements)
+				{
+					delete_char(editor, editor->cursor);
+				}
+				break;
+		}
+		return;
+	}
+
+	if (sequence[0] != '[' && sequence[0] != 'O')
+	{
+		return;
+	}
+
+	switch (sequence[1])
+	{
+		case 'A':
+			recall_history(editor, environment->history, 1);
+			break;
+		case 'B':
+			recall_history(editor, environment->history, 0);
+			break;
+		case 'C':
+			editor->cursor += editor->cursor < editor->line.elements;
+			break;
+		case 'D':
+			editor->cursor -= editor->cursor > 0;
+			break;
+		case 'H':
+			editor->cursor = 0;
+			break;
+		case 'F':
+			editor->cursor = editor->line.elements;
+			break;
+	}
+}
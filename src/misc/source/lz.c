@@ -0,0 +1,225 @@
+#include <string.h>
+
+#include "../include/lz.h"
+
+#define MIN_MATCH     4
+#define LAST_LITERALS 5
+#define MAX_OFFSET    65535
+#define HASH_BITS     13
+
+/**
+  * Reads four bytes without regard to alignment
+  * @param p where the bytes are
+  * @return the bytes as an integer
+  */
+uint32_t read32(const unsigned char *p);
+
+/**
+  * Writes a length that did not fit in its four bits of the token, as bytes of 255 followed by the
+  * remainder
+  * @param out    where the length goes
+  * @param length what is left of the length once 15 has been taken off
+  * @return the position just after the length
+  */
+unsigned char *write_length(unsigned char *out, size_t length);
+
+/**
+  * Reads a length extended past its four bits of the token
+  * @param in     where the length's bytes start; advanced past them
+  * @param end    the end of the input
+  * @param length the length so far (15); added to
+  * @return zero if the input ran out in the middle of the length, nonzero otherwise
+  */
+int read_length(const unsigned char **in, const unsigned char *end, size_t *length);
+
+/**
+  * Writes one sequence: the token, the literals, and, if match_length is nonzero, the offset and
+  * the rest of the match length
+  * @param out          where the sequence goes
+  * @param literals     the literals
+  * @param num_literals the number of literals
+  * @param offset       how far back the match is
+  * @param match_length the length of the match, or zero for the last sequence
+  * @return the position just after the sequence
+  */
+unsigned char *write_sequence(unsigned char *out, const unsigned char *literals, size_t num_literals, size_t offset, size_t match_length);
+
+size_t lz_compress(const unsigned char *in, size_t length, unsigned char *out)
+{
+	uint32_t table[1 << HASH_BITS];
+	memset(table, 0, sizeof table);
+	unsigned char *start = out;
+	size_t anchor = 0;
+	size_t position = 1;
+
+	//matches stop short of the end, so the last few bytes are always literals
+	while (length > LAST_LITERALS + MIN_MATCH && position + MIN_MATCH + LAST_LITERALS <= length)
+	{
+		uint32_t sequence = read32(in + position);
+		uint32_t slot = (sequence * 2654435761U) >> (32 - HASH_BITS);
+		size_t candidate = table[slot];
+		table[slot] = position;
+
+		if (position - candidate > MAX_OFFSET || read32(in + candidate) != sequence)
+		{
+			position++;
+			continue;
+		}
+
+		size_t match_length = MIN_MATCH;
+		while (position + match_length + LAST_LITERALS < length && in[candidate + match_length] == in[position + match_length])
+		{
+			match_length++;
+		}
+
+		out = write_sequence(out, in + anchor, position - anchor, position - candidate, match_length);
+		position += match_length;
+		anchor = position;
+	}
+
+	out = write_sequence(out, in + anchor, length - anchor, 0, 0);
+	return out - start;
+}
+
+ssize_t lz_decompress(const unsigned char *in, size_t length, unsigned char *out, size_t capacity)
+{
+	const unsigned char *end = in + length;
+	size_t produced = 0;
+
+	while (in < end)
+	{
+		unsigned char token = *in++;
+		size_t num_literals = token >> 4;
+		if (num_literals == 15 && !read_length(&in, end, &num_literals))
+		{
+			return -1;
+		}
+
+		if (num_literals > (size_t) (end - in) || num_literals > capacity - produced)
+		{
+			return -1;
+		}
+		memcpy(out + produced, in, num_literals);
+		in += num_literals;
+		produced += num_literals;
+
+		//the last sequence has no match
+		if (in == end)
+		{
+			break;
+		}
+
+		if (end - in < 2)
+		{
+			return -1;
+		}
+		size_t offset = in[0] | (in[1] << 8);
+		in += 2;
+		size_t match_length = token & 0xf;
+		if (match_length == 15 && !read_length(&in, end, &match_length))
+		{
+			return -1;
+		}
+		match_length += MIN_MATCH;
+
+		if (offset == 0 || offset > produced || match_length > capacity - produced)
+		{
+			return -1;
+		}
+
+		//matches may overlap what they produce, so copy forwards a byte at a time
+		unsigned char *to = out + produced;
+		const unsigned char *from = to - offset;
+		size_t i;
+		for (i = 0; i < match_length; i++)
+		{
+			to[i] = from[i];
+		}
+		produced += match_length;
+	}
+
+	return produced;
+}
+
+uint32_t lz_checksum(const unsigned char *data, size_t length)
+{
+	uint32_t a = 1;
+	uint32_t b = 0;
+	while (length > 0)
+	{
+		//the largest run before the sums must be reduced to avoid overflowing
+		size_t run = length < 5552 ? length : 5552;
+		length -= run;
+		while (run-- > 0)
+		{
+			a += *data++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+
+	return (b << 16) | a;
+}
+
+uint32_t read32(const unsigned char *p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof value);
+	return value;
+}
+
+unsigned char *write_length(unsigned char *out, size_t length)
+{
+	while (length >= 255)
+	{
+		*out++ = 255;
+		length -= 255;
+	}
+	*out++ = length;
+	return out;
+}
+
+int read_length(const unsigned char **in, const unsigned char *end, size_t *length)
+{
+	unsigned char byte;
+	do
+	{
+		if (*in >= end)
+		{
+			return 0;
+		}
+		byte = *(*in)++;
+		*length += byte;
+	} while (byte == 255);
+
+	return 1;
+}
+
+unsigned char *write_sequence(unsigned char *out, const unsigned char *literals, size_t num_literals, size_t offset, size_t match_length)
+{
+	unsigned char *token = out++;
+	size_t extra_match = match_length > 0 ? match_length - MIN_MATCH : 0;
+	*token = (num_literals < 15 ? num_literals : 15) << 4;
+	if (num_literals >= 15)
+	{
+		out = write_length(out, num_literals - 15);
+	}
+	memcpy(out, literals, num_literals);
+	out += num_literals;
+
+	if (match_length == 0)
+	{
+		return out;
+	}
+
+	*token |= extra_match < 15 ? extra_match : 15;
+	*out++ = offset & 0xff;
+	*out++ = offset >> 8;
+	if (extra_match >= 15)
+	{
+		out = write_length(out, extra_match - 15);
+	}
+
+	return out;
+}
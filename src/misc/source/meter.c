@@ -0,0 +1,106 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/meter.h"
+
+/**
+  * Returns the current time in milliseconds
+  * @return the time in milliseconds
+  */
+int64_t meter_now_ms(void);
+
+/**
+  * Waits for fd to become ready for events, adding the time spent waiting to waited. Returns early
+  * every METER_INTERVAL_MS so that progress can be reported
+  * @param fd     the descriptor to wait on
+  * @param events the events to wait for
+  * @param waited the time waited on this side so far, in milliseconds; added to
+  */
+void meter_wait(int fd, short events, int64_t *waited);
+
+void run_meter(int in, int out, const char *from, const char *to, int report_fd, unsigned short live)
+{
+	uint64_t bytes = 0;
+	int64_t waited_in = 0;
+	int64_t waited_out = 0;
+	int64_t start = meter_now_ms();
+	int64_t last_report = start;
+
+	//a downstream stage that exits early should end the relay with a summary, not kill it
+	signal(SIGPIPE, SIG_IGN);
+
+	for (;;)
+	{
+		ssize_t moved = splice(in, NULL, out, NULL, METER_CHUNK, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (moved > 0)
+		{
+			bytes += moved;
+		}
+		else if (moved == 0)
+		{
+			break;
+		}
+		else if (errno == EAGAIN)
+		{
+			//find out which side is holding things up, and wait on that side
+			struct pollfd sides[2] = { { in, POLLIN, 0 }, { out, POLLOUT, 0 } };
+			poll(sides, 2, 0);
+			if (!(sides[0].revents & (POLLIN | POLLHUP)))
+			{
+				meter_wait(in, POLLIN, &waited_in);
+			}
+			else if (sides[1].revents & (POLLERR | POLLHUP))
+			{
+				break;
+			}
+			else
+			{
+				meter_wait(out, POLLOUT, &waited_out);
+			}
+		}
+		else if (errno != EINTR)
+		{
+			//the downstream stage has gone away
+			break;
+		}
+
+		int64_t now = meter_now_ms();
+		if (live && now - last_report >= METER_INTERVAL_MS)
+		{
+			dprintf(report_fd, "Meter %s -> %s: %llu bytes so far, %.1f MB/s\n", from, to,
+				(unsigned long long) bytes, bytes / ((now - start) / 1000.0) / 1e6);
+			last_report = now;
+		}
+	}
+
+	//the summary is written before out is closed, so that it comes out before the downstream stage
+	//sees end of file and finishes (and the shell prints its prompt)
+	double elapsed = (meter_now_ms() - start) / 1000.0;
+	dprintf(report_fd, "Meter %s -> %s: %llu bytes in %.2f s (%.1f MB/s), %s blocked writing %.2f s, %s blocked reading %.2f s\n",
+		from, to, (unsigned long long) bytes, elapsed, elapsed > 0 ? bytes / elapsed / 1e6 : 0.0,
+		from, waited_out / 1000.0, to, waited_in / 1000.0);
+	close(out);
+	close(in);
+}
+
+int64_t meter_now_ms(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void meter_wait(int fd, short events, int64_t *waited)
+{
+	struct pollfd side = { fd, events, 0 };
+	int64_t start = meter_now_ms();
+	poll(&side, 1, METER_INTERVAL_MS);
+	*waited += meter_now_ms() - start;
+}
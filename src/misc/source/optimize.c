@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/optimize.h"
+
+/**
+  * Determines whether a command runs cat, by name or by one of its usual paths
+  * @param command the command to be checked
+  * @return nonzero if the command runs cat, zero otherwise
+  */
+int is_cat(command_t *command);
+
+/**
+  * Determines whether the command takes its input from a file, a here-string or a here-document
+  * @param command the command to be checked
+  * @return nonzero if its input is redirected, zero otherwise
+  */
+int redirects_input(command_t *command);
+
+/**
+  * Determines whether the command redirects its output or its error output anywhere
+  * @param command the command to be checked
+  * @return nonzero if either is redirected, zero otherwise
+  */
+int redirects_output(command_t *command);
+
+/**
+  * Finds the single file a leading cat reads, if replacing it with a redirection would behave the
+  * same: the file must be a readable regular file, and cat must have no options and no other input
+  * @param command the cat command
+  * @return the name of the file, or NULL if the cat cannot be replaced
+  */
+char *cat_file(command_t *command);
+
+command_t *optimize_pipeline(command_t *command)
+{
+	command_t *head = command;
+
+	//cat file | tool is tool < file, one process and one copy through a pipe fewer
+	char *file;
+	if (head->pipe != NULL && !redirects_input(head->pipe) && (file = cat_file(head)) != NULL)
+	{
+		head->pipe->input = file;
+		//any branches the pipeline fans out to hang off its first stage, which is now the next one
+		head->pipe->fanout = head->fanout;
+		head = head->pipe;
+	}
+
+	//a bare cat between two stages copies one pipe to another and changes nothing; at the end of
+	//the pipeline it would not be equivalent, since the stage before it would no longer be writing
+	//to a pipe
+	command_t *previous = head;
+	while (previous->pipe != NULL && previous->pipe->pipe != NULL)
+	{
+		command_t *stage = previous->pipe;
+		if (is_cat(stage) && stage->argc == 2 && !redirects_input(stage) && !redirects_output(stage))
+		{
+			previous->pipe = stage->pipe;
+			free(stage);
+			continue;
+		}
+		previous = stage;
+	}
+
+	return head;
+}
+
+int is_cat(command_t *command)
+{
+	char *name = command->arguments[0];
+	return strcmp(name, "cat") == 0 || strcmp(name, "/bin/cat") == 0 || strcmp(name, "/usr/bin/cat") == 0;
+}
+
+int redirects_input(command_t *command)
+{
+	return command->input != NULL || command->here_string != NULL || command->here_delimiter != NULL;
+}
+
+int redirects_output(command_t *command)
+{
+	return command->output != NULL || command->error != NULL || command->error_to_output;
+}
+
+char *cat_file(command_t *command)
+{
+	if (!is_cat(command) || redirects_output(command))
+	{
+		return NULL;
+	}
+
+	//one for "cat", one for the file, one for NULL pointer; or cat < file
+	char *file;
+	if (command->argc == 3 && !redirects_input(command) && command->arguments[1][0] != '-')
+	{
+		file = command->arguments[1];
+	}
+	else if (command->argc == 2 && command->input != NULL)
+	{
+		file = command->input;
+	}
+	else
+	{
+		return NULL;
+	}
+
+	//cat would report a missing file and carry on, which a failed redirection would not
+	struct stat info;
+	if (stat(file, &info) < 0 || !S_ISREG(info.st_mode) || access(file, R_OK) < 0)
+	{
+		return NULL;
+	}
+
+	return file;
+}
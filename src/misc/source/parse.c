@@ -11,9 +11,10 @@
 void trim(char *line, size_t length);
 
 /**
-  * Splits the given line on the character delim, not splitting on quotes if retain_quotes is true,
-  * and returning an array of pointers INTO s. In other words, the function does not allocate new
-  * strings for the elements of the returned array, and s is destroyed upon a call to this function.
+  * Splits the given line on the character delim, not splitting on quotes or inside $(...) if
+  * retain_quotes is true, and returning an array of pointers INTO s. In other words, the function
+  * does not allocate new strings for the elements of the returned array, and s is destroyed upon a
+  * call to this function.
   * @param s             the string to split; this string is not constant over this function
   * @param delim         the character on which to split
   * @param retain_quotes if true, if a delim is found within quotes, the func will not split on it
@@ -33,6 +34,25 @@ char **split(char *s, char delim, unsigned short retain_quotes, size_t *number);
   */
 ssize_t find_str(char **arr, size_t length, char *str);
 
+/**
+  * Takes the redirections (<, >, >>, 2>, 2>&1, and &>, each but 2>&1 followed by a file name as its
+  * own argument, and <<< word and << delimiter, which may also be written <<<word and <<delimiter)
+  * out of a single command's arguments, recording them in the command instead. The remaining
+  * arguments are moved down to fill the gaps, and argc is updated to match. They are taken from left
+  * to right: a later redirection of the same stream replaces an earlier one, and 2>&1 sends stderr
+  * where stdout is going at that point on the line. The bodies of here-documents are not read here
+  * @param command the command, not yet split on pipes any further, whose arguments are searched
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t setup_redirections(command_t *command);
+
+/**
+  * Removes one pair of matching quotes surrounding a word, in place
+  * @param word the word to be unquoted
+  * @return the word, without its quotes
+  */
+char *unquote(char *word);
+
 status_t parse_line(char *line, size_t chars_read, command_t *command)
 {
 	//handle case of empty line
@@ -76,9 +96,15 @@ status_t parse_line(char *line, size_t chars_read, command_t *command)
 		command->arguments[command->argc - 1] = NULL;
 	}
 
-	status_t error = setup_pipes(command);
+	status_t error = setup_fanout(command);
+	if (error == SUCCESS)
+	{
+		error = setup_pipes(command);
+	}
+
 	if (error != SUCCESS)
 	{
+		free_branches(command);
 		free(command->arguments);
 		return error;
 	}
@@ -115,6 +141,7 @@ char **split(char *s, char delim, unsigned short retain_quotes, size_t *number)
 	*number = 0;
     char **ret_val = NULL;
 	unsigned short in_quotes = 0;
+	size_t depth = 0;
     char *start_pos = s;
     size_t i;
     for (i = 0; s[i]; i++)
@@ -124,7 +151,22 @@ char **split(char *s, char delim, unsigned short retain_quotes, size_t *number)
 			in_quotes = !in_quotes;
 		}
 
-		if ((s[i] == delim && !in_quotes) || (s[i + 1] == '\0'))
+		//a command substitution is one argument, whatever it has inside it
+		if (retain_quotes && s[i] == '$' && s[i + 1] == '(')
+		{
+			depth++;
+			i++;
+		}
+		else if (depth > 0 && s[i] == '(')
+		{
+			depth++;
+		}
+		else if (depth > 0 && s[i] == ')')
+		{
+			depth--;
+		}
+
+		if ((s[i] == delim && !in_quotes && depth == 0) || (s[i + 1] == '\0'))
 		{
 			//reallocate space for another element in the array
 			(*number)++;
@@ -194,6 +236,8 @@ status_t setup_pipes(command_t *command)
 			return MEMORY_ERROR;
 		}
 		pipe_command->arguments = command->arguments + pipe_pos + 1;
+		pipe_command->fanout = NULL;
+		pipe_command->next_branch = NULL;
 		pipe_command->argc = orig_argc - command->argc;
 		pipe_command->background = command->background;
 		status_t error = setup_pipes(pipe_command);
@@ -204,10 +248,208 @@ status_t setup_pipes(command_t *command)
 		}
 
 		command->pipe = pipe_command;
-		return SUCCESS;
+		return setup_redirections(command);
 	}
 	
 	//base case - no more pipes
 	command->pipe = NULL;
+	return setup_redirections(command);
+}
+
+status_t setup_fanout(command_t *command)
+{
+	command->fanout = NULL;
+	command->next_branch = NULL;
+
+	//do the - 1 to prevent find_str from looking at the NULL pointer
+	ssize_t fanout_pos = find_str(command->arguments, command->argc - 1, "|+");
+	if (fanout_pos < 0)
+	{
+		return SUCCESS;
+	}
+
+	//there must be a producer before the first |+
+	if (fanout_pos == 0)
+	{
+		return FORMAT_ERROR;
+	}
+
+	size_t orig_argc = command->argc;
+	command->argc = fanout_pos + 1;
+	command->arguments[fanout_pos] = NULL;
+
+	//each branch runs to the next |+, or to the end
+	command_t **link = &command->fanout;
+	char **start = command->arguments + fanout_pos + 1;
+	char **end = command->arguments + orig_argc - 1;
+	while (start <= end)
+	{
+		char **stop = start;
+		while (stop < end && strcmp(*stop, "|+") != 0)
+		{
+			stop++;
+		}
+
+		//an empty branch (|+ at the end, or two in a row) is not allowed
+		if (stop == start)
+		{
+			return FORMAT_ERROR;
+		}
+
+		command_t *branch = malloc(sizeof *branch);
+		if (branch == NULL)
+		{
+			return MEMORY_ERROR;
+		}
+		branch->arguments = start;
+		branch->argc = stop - start + 1;
+		branch->background = command->background;
+		branch->fanout = NULL;
+		branch->next_branch = NULL;
+		branch->pipe = NULL;
+		*link = branch;
+		link = &branch->next_branch;
+
+		unsigned short last = stop == end;
+		*stop = NULL;
+		status_t error = setup_pipes(branch);
+		if (error != SUCCESS)
+		{
+			return error;
+		}
+
+		if (last)
+		{
+			break;
+		}
+		start = stop + 1;
+	}
+
+	return SUCCESS;
+}
+
+status_t setup_redirections(command_t *command)
+{
+	command->input = NULL;
+	command->output = NULL;
+	command->error = NULL;
+	command->append = 0;
+	command->error_to_output = 0;
+	command->error_append = 0;
+	command->here_string = NULL;
+	command->here_delimiter = NULL;
+	command->here_document = -1;
+
+	//do the - 1 to leave the NULL pointer where it is
+	size_t kept = 0;
+	size_t i;
+	for (i = 0; i < command->argc - 1; i++)
+	{
+		char *argument = command->arguments[i];
+		if (strcmp(argument, "2>&1") == 0)
+		{
+			command->error = NULL;
+			command->error_to_output = ERROR_TO_OUTPUT;
+			continue;
+		}
+
+		char **target = NULL;
+		char *attached = NULL;
+		if (strcmp(argument, "<") == 0)
+		{
+			target = &command->input;
+		}
+		else if (strncmp(argument, "<<<", 3) == 0)
+		{
+			target = &command->here_string;
+			attached = argument[3] != '\0' ? argument + 3 : NULL;
+		}
+		else if (strncmp(argument, "<<", 2) == 0)
+		{
+			target = &command->here_delimiter;
+			attached = argument[2] != '\0' ? argument + 2 : NULL;
+		}
+		else if (strcmp(argument, ">") == 0 || strcmp(argument, ">>") == 0 || strcmp(argument, "&>") == 0)
+		{
+			//a 2>&1 before this keeps stderr where stdout was then: the file of an earlier > or >>,
+			//or, with none, wherever stdout was to begin with
+			if (command->error_to_output == ERROR_TO_OUTPUT && command->output != NULL)
+			{
+				command->error = command->output;
+				command->error_append = command->append;
+				command->error_to_output = 0;
+			}
+			else if (command->error_to_output == ERROR_TO_OUTPUT)
+			{
+				command->error_to_output = ERROR_TO_ORIGINAL;
+			}
+
+			target = &command->output;
+			command->append = strcmp(argument, ">>") == 0;
+			if (argument[0] == '&')
+			{
+				command->error = NULL;
+				command->error_to_output = ERROR_TO_OUTPUT;
+			}
+		}
+		else if (strcmp(argument, "2>") == 0)
+		{
+			target = &command->error;
+			command->error_append = 0;
+			command->error_to_output = 0;
+		}
+
+		if (target == NULL)
+		{
+			command->arguments[kept++] = argument;
+			continue;
+		}
+
+		//every redirection but 2>&1 needs a file name (or word, or delimiter) after it
+		if (attached == NULL)
+		{
+			if (i + 1 >= command->argc - 1)
+			{
+				return FORMAT_ERROR;
+			}
+			i++;
+			attached = command->arguments[i];
+		}
+
+		//stdin only comes from one place, so the last of <, <<< and << wins
+		if (target == &command->input || target == &command->here_string || target == &command->here_delimiter)
+		{
+			command->input = NULL;
+			command->here_string = NULL;
+			command->here_delimiter = NULL;
+		}
+		*target = target == &command->input ? attached : unquote(attached);
+
+		if (target == &command->here_delimiter && *command->here_delimiter == '\0')
+		{
+			return FORMAT_ERROR;
+		}
+	}
+
+	//there must still be a command left to run
+	if (kept == 0)
+	{
+		return FORMAT_ERROR;
+	}
+
+	command->arguments[kept] = NULL;
+	command->argc = kept + 1;
 	return SUCCESS;
 }
+
+char *unquote(char *word)
+{
+	size_t length = strlen(word);
+	if (length >= 2 && (word[0] == '"' || word[0] == '\'') && word[length - 1] == word[0])
+	{
+		word[length - 1] = '\0';
+		word++;
+	}
+
+	return word;
+}
@@ -0,0 +1,40 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "../include/pipe_size.h"
+
+int make_pipe(int fds[2], int flags, size_t size)
+{
+	if (pipe2(fds, flags) < 0)
+	{
+		return -1;
+	}
+
+	if (size > 0)
+	{
+		fcntl(fds[1], F_SETPIPE_SZ, (int) size);
+	}
+
+	return 0;
+}
+
+size_t auto_pipe_size(void)
+{
+	FILE *file = fopen(PIPE_MAX_SIZE_FILE, "re");
+	if (file == NULL)
+	{
+		return 0;
+	}
+
+	unsigned long max_size;
+	int read = fscanf(file, "%lu", &max_size);
+	fclose(file);
+	if (read != 1)
+	{
+		return 0;
+	}
+
+	return max_size < PIPE_AUTO_LIMIT ? max_size : PIPE_AUTO_LIMIT;
+}
@@ -0,0 +1,1032 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <linux/io_uring.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/lz.h"
+#include "../include/script_log.h"
+
+#define RECORD_PAD    0
+#define RECORD_HEADER 1
+#define RECORD_OUTPUT 2
+#define RECORD_END    3
+
+#define RECORD_SIZE(length) ((sizeof(log_record_t) + (length) + 15) & ~(size_t) 15)
+#define URING_ENTRIES 4
+
+/**
+  * The header of each record in the ring; the record's data follows it. The timestamp is the time the
+  * record was queued, in nanoseconds since the epoch. Records are kept 16 byte aligned, so that there
+  * is always room for a padding record at the end of the ring
+  */
+typedef struct
+{
+	uint32_t type;
+	uint32_t length;
+	uint64_t timestamp;
+} log_record_t;
+
+/**
+  * The function run by the log's writer thread; writes records until the log is stopped and the
+  * ring is empty
+  * @param arg the script_log_t
+  * @return always NULL
+  */
+void *log_writer(void *arg);
+
+/**
+  * Reserves room in the ring for a record with length bytes of data, waiting up to
+  * SCRIPT_LOG_WAIT_MS for room if necessary. The record is not visible to the writer until
+  * commit_record is called
+  * @param log    the log whose ring the record goes in
+  * @param type   the type of the record
+  * @param length the number of bytes of data in the record
+  * @return a pointer to where the data goes, or NULL if there was no room
+  */
+char *reserve_record(script_log_t *log, uint32_t type, size_t length);
+
+/**
+  * Makes the records reserved so far visible to the writer, waking it if it is waiting
+  * @param log      the log whose ring the records are in
+  * @param new_head the position just after the last record reserved
+  */
+void commit_record(script_log_t *log, size_t new_head);
+
+/**
+  * Adds a record's data to the block being gathered for a compressed log, writing out the block each
+  * time it fills up. A command's header always starts a new block, and a block takes the timestamp
+  * of the record its first byte came from
+  * @param log    the log whose block the data goes in
+  * @param record the record
+  */
+void add_to_block(script_log_t *log, log_record_t *record);
+
+/**
+  * Compresses and writes out the block being gathered, if it holds anything, storing it uncompressed
+  * if compressing does not make it smaller
+  * @param log the log whose block is to be written
+  */
+void flush_block(script_log_t *log);
+
+/**
+  * Stores a 32 bit value little endian
+  * @param p     where the value goes
+  * @param value the value to be stored
+  */
+void put32(unsigned char *p, uint32_t value);
+
+/**
+  * Loads a 32 bit little endian value
+  * @param p where the value is
+  * @return the value
+  */
+uint32_t get32(const unsigned char *p);
+
+/**
+  * Stores a 64 bit value little endian
+  * @param p     where the value goes
+  * @param value the value to be stored
+  */
+void put64(unsigned char *p, uint64_t value);
+
+/**
+  * Loads a 64 bit little endian value
+  * @param p where the value is
+  * @return the value
+  */
+uint64_t get64(const unsigned char *p);
+
+/**
+  * Writes a block of a compressed script file's output, with the block's time put before the command
+  * it starts (after the blank line that precedes every command)
+  * @param out    where the output goes
+  * @param block  the block's output
+  * @param length the number of bytes of output
+  * @param time   the block's time, in nanoseconds since the epoch
+  */
+void write_stamped_block(int out, const unsigned char *block, size_t length, uint64_t time);
+
+/**
+  * Writes all of a buffer to a descriptor, continuing after short writes
+  * @param fd     the descriptor to write to
+  * @param data   the bytes to be written
+  * @param length the number of bytes to be written
+  * @return zero if the bytes could not all be written, nonzero otherwise
+  */
+int write_buffer(int fd, const void *data, size_t length);
+
+/**
+  * Writes out the data described by iov, followed by an fsync if sync is true, using io_uring if it
+  * is available and writev otherwise
+  * @param log   the log whose file is written to
+  * @param iov   the data to be written
+  * @param count the number of elements in iov
+  * @param sync  whether to fsync the file after writing
+  */
+void write_batch(script_log_t *log, struct iovec *iov, size_t count, unsigned short sync);
+
+/**
+  * Writes out the data described by iov with writev, continuing after short writes
+  * @param fd    the file to write to
+  * @param iov   the data to be written; modified as the data is written
+  * @param count the number of elements in iov
+  * @param skip  the number of bytes at the start of iov that have already been written
+  */
+void write_all(int fd, struct iovec *iov, size_t count, size_t skip);
+
+/**
+  * Sets up an io_uring instance that can write at the file's current position
+  * @param uring out param; the instance to set up
+  * @return whether the instance could be set up
+  */
+unsigned short setup_uring(uring_t *uring);
+
+/**
+  * Submits a writev of iov, linked to an fsync if sync is true, and waits for it to complete
+  * @param uring   the instance to submit through
+  * @param fd      the file to write to
+  * @param iov     the data to be written
+  * @param count   the number of elements in iov
+  * @param sync    whether to fsync the file after writing
+  * @param written out param; the result of the writev (bytes written or a negative errno)
+  * @return whether the submission itself succeeded
+  */
+unsigned short uring_writev(uring_t *uring, int fd, struct iovec *iov, size_t count, unsigned short sync, ssize_t *written);
+
+/**
+  * Unmaps and closes an io_uring instance
+  * @param uring the instance to be torn down
+  */
+void teardown_uring(uring_t *uring);
+
+/**
+  * Returns the current time in nanoseconds, on the given clock
+  * @param clock the clock to read
+  * @return the time in nanoseconds
+  */
+uint64_t now_ns(clockid_t clock);
+
+status_t create_script_log(script_log_t **log, int fd, unsigned short sync_policy, unsigned short compress)
+{
+	script_log_t *new_log = calloc(1, sizeof *new_log);
+	if (new_log == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+
+	new_log->ring = malloc(SCRIPT_LOG_RING);
+	if (compress)
+	{
+		new_log->compress = 1;
+		new_log->block = malloc(SCRIPT_BLOCK);
+		new_log->packed = malloc(SCRIPT_BLOCK_HEADER + LZ_BOUND(SCRIPT_BLOCK));
+	}
+
+	if (new_log->ring == NULL || (compress && (new_log->block == NULL || new_log->packed == NULL)))
+	{
+		free(new_log->ring);
+		free(new_log->block);
+		free(new_log->packed);
+		free(new_log);
+		return MEMORY_ERROR;
+	}
+
+	if (compress)
+	{
+		unsigned char header[SCRIPT_FILE_HEADER];
+		memcpy(header, SCRIPT_FILE_MAGIC, 4);
+		put32(header + 4, SCRIPT_FILE_VERSION);
+		write_buffer(fd, header, sizeof header);
+	}
+
+	new_log->fd = fd;
+	new_log->sync_policy = sync_policy;
+	new_log->references = 1;
+	new_log->use_uring = setup_uring(&new_log->uring);
+	pthread_mutex_init(&new_log->lock, NULL);
+	pthread_cond_init(&new_log->has_records, NULL);
+	pthread_cond_init(&new_log->has_room, NULL);
+
+	if (pthread_create(&new_log->writer, NULL, log_writer, new_log) != 0)
+	{
+		if (new_log->use_uring)
+		{
+			teardown_uring(&new_log->uring);
+		}
+		pthread_mutex_destroy(&new_log->lock);
+		pthread_cond_destroy(&new_log->has_records);
+		pthread_cond_destroy(&new_log->has_room);
+		free(new_log->ring);
+		free(new_log->block);
+		free(new_log->packed);
+		free(new_log);
+		return THREAD_ERROR;
+	}
+
+	*log = new_log;
+	return SUCCESS;
+}
+
+void retain_script_log(script_log_t *log)
+{
+	pthread_mutex_lock(&log->lock);
+	log->references++;
+	pthread_mutex_unlock(&log->lock);
+}
+
+void release_script_log(script_log_t *log)
+{
+	pthread_mutex_lock(&log->lock);
+	log->references--;
+	if (log->references > 0)
+	{
+		pthread_mutex_unlock(&log->lock);
+		return;
+	}
+
+	//the writer empties the ring before it notices it has been stopped
+	log->stopping = 1;
+	pthread_cond_signal(&log->has_records);
+	pthread_mutex_unlock(&log->lock);
+	pthread_join(log->writer, NULL);
+
+	if (log->report)
+	{
+		print_script_log_stats(log);
+	}
+
+	if (log->use_uring)
+	{
+		teardown_uring(&log->uring);
+	}
+	close(log->fd);
+	pthread_mutex_destroy(&log->lock);
+	pthread_cond_destroy(&log->has_records);
+	pthread_cond_destroy(&log->has_room);
+	free(log->ring);
+	free(log->block);
+	free(log->packed);
+	free(log);
+}
+
+void set_script_log_sync(script_log_t *log, unsigned short sync_policy)
+{
+	pthread_mutex_lock(&log->lock);
+	log->sync_policy = sync_policy;
+	pthread_mutex_unlock(&log->lock);
+}
+
+void log_header(script_log_t *log, string_t *header)
+{
+	char *data = reserve_record(log, RECORD_HEADER, header->elements);
+	if (data == NULL)
+	{
+		__atomic_add_fetch(&log->dropped_bytes, header->elements, __ATOMIC_RELAXED);
+		return;
+	}
+
+	memcpy(data, header->array, header->elements);
+	commit_record(log, log->head + RECORD_SIZE(header->elements));
+}
+
+void log_output(script_log_t *log, int fd, size_t length)
+{
+	char *data = reserve_record(log, RECORD_OUTPUT, length);
+	char discard[4096];
+	size_t done = 0;
+	while (done < length)
+	{
+		//with no room in the ring, the bytes still have to be taken out of fd, but go nowhere
+		char *destination = data != NULL ? data + done : discard;
+		size_t wanted = data != NULL ? length - done : (length - done < sizeof discard ? length - done : sizeof discard);
+		ssize_t result = read(fd, destination, wanted);
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result <= 0)
+		{
+			break;
+		}
+		done += result;
+	}
+
+	if (data == NULL)
+	{
+		__atomic_add_fetch(&log->dropped_bytes, length, __ATOMIC_RELAXED);
+		return;
+	}
+
+	//if fewer bytes than expected arrived, shrink the record to what actually did; the writer steps
+	//over it by its length, so the head moves past no more than that
+	((log_record_t *) (data - sizeof(log_record_t)))->length = done;
+	commit_record(log, log->head + RECORD_SIZE(done));
+}
+
+void log_command_end(script_log_t *log)
+{
+	if (reserve_record(log, RECORD_END, 0) != NULL)
+	{
+		commit_record(log, log->head + RECORD_SIZE(0));
+	}
+}
+
+void print_script_log_stats(script_log_t *log)
+{
+	fprintf(stdout, "Script: %llu bytes written, %llu bytes dropped, %llu bytes backpressured (%s)\n",
+		(unsigned long long) __atomic_load_n(&log->written_bytes, __ATOMIC_RELAXED),
+		(unsigned long long) __atomic_load_n(&log->dropped_bytes, __ATOMIC_RELAXED),
+		(unsigned long long) __atomic_load_n(&log->backpressured_bytes, __ATOMIC_RELAXED),
+		log->use_uring ? "io_uring" : "writev");
+	if (log->compress)
+	{
+		fprintf(stdout, "Script: compressed to %llu bytes\n",
+			(unsigned long long) __atomic_load_n(&log->stored_bytes, __ATOMIC_RELAXED));
+	}
+}
+
+char *reserve_record(script_log_t *log, uint32_t type, size_t length)
+{
+	size_t size = RECORD_SIZE(length);
+	if (size > SCRIPT_LOG_RING / 2)
+	{
+		return NULL;
+	}
+
+	uint64_t deadline = 0;
+	size_t position, to_end, needed;
+	for (;;)
+	{
+		position = log->head % SCRIPT_LOG_RING;
+		to_end = SCRIPT_LOG_RING - position;
+		//a record never wraps; if it would, the rest of the ring is skipped with a padding record
+		needed = size + (to_end < size ? to_end : 0);
+		size_t tail = __atomic_load_n(&log->tail, __ATOMIC_ACQUIRE);
+		if (SCRIPT_LOG_RING - (log->head - tail) >= needed)
+		{
+			break;
+		}
+
+		//the ring is full; wait a little while for the writer to make room, but no longer
+		uint64_t now = now_ns(CLOCK_MONOTONIC);
+		if (deadline == 0)
+		{
+			deadline = now + SCRIPT_LOG_WAIT_MS * 1000000ULL;
+			__atomic_add_fetch(&log->backpressured_bytes, length, __ATOMIC_RELAXED);
+		}
+		else if (now >= deadline)
+		{
+			return NULL;
+		}
+
+		struct timespec until;
+		clock_gettime(CLOCK_REALTIME, &until);
+		until.tv_nsec += 1000000;
+		if (until.tv_nsec >= 1000000000L)
+		{
+			until.tv_sec++;
+			until.tv_nsec -= 1000000000L;
+		}
+
+		pthread_mutex_lock(&log->lock);
+		log->producer_waiting = 1;
+		pthread_cond_signal(&log->has_records);
+		pthread_cond_timedwait(&log->has_room, &log->lock, &until);
+		log->producer_waiting = 0;
+		pthread_mutex_unlock(&log->lock);
+	}
+
+	if (to_end < size)
+	{
+		log_record_t *pad = (log_record_t *) (log->ring + position);
+		pad->type = RECORD_PAD;
+		pad->length = to_end - sizeof *pad;
+		log->head += to_end;
+		position = 0;
+	}
+
+	log_record_t *record = (log_record_t *) (log->ring + position);
+	record->type = type;
+	record->length = length;
+	record->timestamp = now_ns(CLOCK_REALTIME);
+	return (char *) (record + 1);
+}
+
+void commit_record(script_log_t *log, size_t new_head)
+{
+	__atomic_store_n(&log->head, new_head, __ATOMIC_RELEASE);
+
+	pthread_mutex_lock(&log->lock);
+	if (log->writer_waiting)
+	{
+		pthread_cond_signal(&log->has_records);
+	}
+	pthread_mutex_unlock(&log->lock);
+}
+
+void *log_writer(void *arg)
+{
+	script_log_t *log = arg;
+	struct iovec iov[SCRIPT_LOG_BATCH];
+	log_record_t *records[SCRIPT_LOG_BATCH];
+	uint64_t last_sync = now_ns(CLOCK_MONOTONIC);
+	unsigned short unsynced = 0;
+
+	for (;;)
+	{
+		size_t head = __atomic_load_n(&log->head, __ATOMIC_ACQUIRE);
+		if (head == log->tail)
+		{
+			pthread_mutex_lock(&log->lock);
+			log->writer_waiting = 1;
+			unsigned short stopping = log->stopping;
+			int waited = 0;
+			if (!stopping && __atomic_load_n(&log->head, __ATOMIC_ACQUIRE) == log->tail)
+			{
+				if (log->block_length == 0)
+				{
+					pthread_cond_wait(&log->has_records, &log->lock);
+				}
+				else
+				{
+					//a partly gathered block is written out if no more output comes for a while
+					struct timespec until;
+					clock_gettime(CLOCK_REALTIME, &until);
+					until.tv_sec += SCRIPT_LOG_SYNC_MS / 1000;
+					waited = pthread_cond_timedwait(&log->has_records, &log->lock, &until);
+				}
+			}
+			log->writer_waiting = 0;
+			pthread_mutex_unlock(&log->lock);
+
+			if (waited == ETIMEDOUT)
+			{
+				flush_block(log);
+			}
+
+			if (stopping && __atomic_load_n(&log->head, __ATOMIC_ACQUIRE) == log->tail)
+			{
+				break;
+			}
+			continue;
+		}
+
+		//gather as many records as fit in one batch
+		size_t count = 0;
+		size_t bytes = 0;
+		unsigned short command_ended = 0;
+		size_t position = log->tail;
+		while (position != head && count < SCRIPT_LOG_BATCH)
+		{
+			log_record_t *record = (log_record_t *) (log->ring + position % SCRIPT_LOG_RING);
+			if (record->type == RECORD_PAD)
+			{
+				position += sizeof *record + record->length;
+				continue;
+			}
+
+			if (record->type == RECORD_END)
+			{
+				command_ended = 1;
+			}
+			else if (record->length > 0)
+			{
+				iov[count].iov_base = record + 1;
+				iov[count].iov_len = record->length;
+				records[count] = record;
+				bytes += record->length;
+				count++;
+			}
+			position += RECORD_SIZE(record->length);
+		}
+
+		unsigned short sync = 0;
+		unsigned short policy = __atomic_load_n(&log->sync_policy, __ATOMIC_RELAXED);
+		unsynced |= count > 0;
+		if (policy == SCRIPT_SYNC_COMMAND && command_ended && unsynced)
+		{
+			sync = 1;
+		}
+		else if (policy == SCRIPT_SYNC_INTERVAL && unsynced && now_ns(CLOCK_MONOTONIC) - last_sync >= SCRIPT_LOG_SYNC_MS * 1000000ULL)
+		{
+			sync = 1;
+		}
+
+		if (log->compress)
+		{
+			size_t i;
+			for (i = 0; i < count; i++)
+			{
+				add_to_block(log, records[i]);
+			}
+
+			if (command_ended)
+			{
+				flush_block(log);
+			}
+
+			if (sync)
+			{
+				write_batch(log, NULL, 0, 1);
+			}
+			__atomic_add_fetch(&log->written_bytes, bytes, __ATOMIC_RELAXED);
+		}
+		else if (count > 0 || sync)
+		{
+			write_batch(log, iov, count, sync);
+			__atomic_add_fetch(&log->written_bytes, bytes, __ATOMIC_RELAXED);
+		}
+
+		if (sync)
+		{
+			last_sync = now_ns(CLOCK_MONOTONIC);
+			unsynced = 0;
+		}
+
+		__atomic_store_n(&log->tail, position, __ATOMIC_RELEASE);
+		pthread_mutex_lock(&log->lock);
+		if (log->producer_waiting)
+		{
+			pthread_cond_signal(&log->has_room);
+		}
+		pthread_mutex_unlock(&log->lock);
+	}
+
+	flush_block(log);
+	if (unsynced && log->sync_policy != SCRIPT_SYNC_NONE)
+	{
+		fsync(log->fd);
+	}
+
+	return NULL;
+}
+
+status_t cat_script_log(int fd, int out, unsigned short timestamps)
+{
+	struct stat info;
+	if (fstat(fd, &info) < 0)
+	{
+		return OPEN_ERROR;
+	}
+
+	size_t size = info.st_size;
+	if (size == 0)
+	{
+		return SUCCESS;
+	}
+
+	unsigned char *file = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (file == MAP_FAILED)
+	{
+		return OPEN_ERROR;
+	}
+
+	//a script file that was not compressed is just the output
+	if (size < SCRIPT_FILE_HEADER || memcmp(file, SCRIPT_FILE_MAGIC, 4) != 0)
+	{
+		write_buffer(out, file, size);
+		munmap(file, size);
+		return SUCCESS;
+	}
+
+	unsigned char *block = malloc(SCRIPT_BLOCK);
+	if (block == NULL)
+	{
+		munmap(file, size);
+		return MEMORY_ERROR;
+	}
+
+	//version 1 files have the same blocks, without the time
+	size_t header_size = get32(file + 4) < 2 ? SCRIPT_BLOCK_HEADER_V1 : SCRIPT_BLOCK_HEADER;
+	size_t damaged = 0;
+	size_t position = SCRIPT_FILE_HEADER;
+	while (position < size)
+	{
+		const unsigned char *header = file + position;
+		size_t left = size - position;
+		unsigned short valid = left >= header_size && memcmp(header, SCRIPT_BLOCK_MAGIC, 4) == 0;
+		uint32_t raw = valid ? get32(header + 4) : 0;
+		size_t raw_length = raw & ~SCRIPT_BLOCK_COMMAND;
+		uint32_t stored = valid ? get32(header + 8) : 0;
+		size_t stored_length = stored & ~SCRIPT_BLOCK_STORED;
+		valid = valid && raw_length <= SCRIPT_BLOCK && stored_length <= left - header_size;
+
+		if (valid)
+		{
+			const unsigned char *data = header + header_size;
+			ssize_t length;
+			if (stored & SCRIPT_BLOCK_STORED)
+			{
+				length = stored_length == raw_length ? (ssize_t) raw_length : -1;
+				if (length >= 0)
+				{
+					memcpy(block, data, length);
+				}
+			}
+			else
+			{
+				length = lz_decompress(data, stored_length, block, SCRIPT_BLOCK);
+			}
+
+			valid = length == (ssize_t) raw_length && lz_checksum(block, raw_length) == get32(header + 12);
+		}
+
+		if (valid)
+		{
+			if (timestamps && header_size == SCRIPT_BLOCK_HEADER && (raw & SCRIPT_BLOCK_COMMAND))
+			{
+				write_stamped_block(out, block, raw_length, get64(header + 16));
+			}
+			else
+			{
+				write_buffer(out, block, raw_length);
+			}
+			position += header_size + stored_length;
+			continue;
+		}
+
+		//resynchronize at the next thing that looks like a block
+		damaged++;
+		unsigned char *next = memmem(file + position + 1, size - position - 1, SCRIPT_BLOCK_MAGIC, 4);
+		position = next == NULL ? size : (size_t) (next - file);
+	}
+
+	if (damaged > 0)
+	{
+		fprintf(stderr, "Warning: skipped %zu damaged block%s of the script file.\n", damaged, damaged == 1 ? "" : "s");
+	}
+
+	free(block);
+	munmap(file, size);
+	return SUCCESS;
+}
+
+void add_to_block(script_log_t *log, log_record_t *record)
+{
+	if (record->type == RECORD_HEADER)
+	{
+		flush_block(log);
+	}
+
+	const unsigned char *data = (const unsigned char *) (record + 1);
+	size_t length = record->length;
+	while (length > 0)
+	{
+		if (log->block_length == 0)
+		{
+			log->block_time = record->timestamp;
+			log->block_command = record->type == RECORD_HEADER && data == (const unsigned char *) (record + 1);
+		}
+
+		size_t room = SCRIPT_BLOCK - log->block_length;
+		size_t taken = length < room ? length : room;
+		memcpy(log->block + log->block_length, data, taken);
+		log->block_length += taken;
+		data += taken;
+		length -= taken;
+
+		if (log->block_length == SCRIPT_BLOCK)
+		{
+			flush_block(log);
+		}
+	}
+}
+
+void flush_block(script_log_t *log)
+{
+	if (!log->compress || log->block_length == 0)
+	{
+		return;
+	}
+
+	unsigned char *header = log->packed;
+	uint32_t stored = lz_compress(log->block, log->block_length, header + SCRIPT_BLOCK_HEADER);
+	if (stored >= log->block_length)
+	{
+		memcpy(header + SCRIPT_BLOCK_HEADER, log->block, log->block_length);
+		stored = log->block_length | SCRIPT_BLOCK_STORED;
+	}
+
+	memcpy(header, SCRIPT_BLOCK_MAGIC, 4);
+	put32(header + 4, log->block_length | (log->block_command ? SCRIPT_BLOCK_COMMAND : 0));
+	put32(header + 8, stored);
+	put32(header + 12, lz_checksum(log->block, log->block_length));
+	put64(header + 16, log->block_time);
+
+	struct iovec iov;
+	iov.iov_base = header;
+	iov.iov_len = SCRIPT_BLOCK_HEADER + (stored & ~SCRIPT_BLOCK_STORED);
+	write_batch(log, &iov, 1, 0);
+	__atomic_add_fetch(&log->stored_bytes, iov.iov_len, __ATOMIC_RELAXED);
+	log->block_length = 0;
+}
+
+void put32(unsigned char *p, uint32_t value)
+{
+	p[0] = value;
+	p[1] = value >> 8;
+	p[2] = value >> 16;
+	p[3] = value >> 24;
+}
+
+uint32_t get32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+void put64(unsigned char *p, uint64_t value)
+{
+	put32(p, value);
+	put32(p + 4, value >> 32);
+}
+
+uint64_t get64(const unsigned char *p)
+{
+	return get32(p) | ((uint64_t) get32(p + 4) << 32);
+}
+
+void write_stamped_block(int out, const unsigned char *block, size_t length, uint64_t time)
+{
+	char stamp[64];
+	time_t seconds = time / 1000000000ULL;
+	struct tm local;
+	size_t stamp_length = 0;
+	if (localtime_r(&seconds, &local) != NULL)
+	{
+		stamp_length = strftime(stamp, sizeof stamp, "[%Y-%m-%d %H:%M:%S", &local);
+	}
+	if (stamp_length > 0)
+	{
+		stamp_length += snprintf(stamp + stamp_length, sizeof stamp - stamp_length, ".%03u] ", (unsigned) (time % 1000000000ULL / 1000000));
+	}
+
+	size_t skip = length > 0 && block[0] == '\n';
+	write_buffer(out, block, skip);
+	write_buffer(out, stamp, stamp_length);
+	write_buffer(out, block + skip, length - skip);
+}
+
+int write_buffer(int fd, const void *data, size_t length)
+{
+	const char *bytes = data;
+	while (length > 0)
+	{
+		ssize_t written = write(fd, bytes, length);
+		if (written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (written <= 0)
+		{
+			return 0;
+		}
+		bytes += written;
+		length -= written;
+	}
+
+	return 1;
+}
+
+void write_batch(script_log_t *log, struct iovec *iov, size_t count, unsigned short sync)
+{
+	size_t total = 0;
+	size_t i;
+	for (i = 0; i < count; i++)
+	{
+		total += iov[i].iov_len;
+	}
+
+	if (log->use_uring)
+	{
+		ssize_t written;
+		if (uring_writev(&log->uring, log->fd, iov, count, sync, &written))
+		{
+			if (written >= 0 && (size_t) written == total)
+			{
+				return;
+			}
+
+			//a short write cancels the linked fsync, so finish both off the normal way
+			if (written >= 0)
+			{
+				write_all(log->fd, iov, count, written);
+				if (sync)
+				{
+					fsync(log->fd);
+				}
+				return;
+			}
+		}
+
+		//the kernel would not do it after all, so stop trying
+		teardown_uring(&log->uring);
+		log->use_uring = 0;
+	}
+
+	write_all(log->fd, iov, count, 0);
+	if (sync)
+	{
+		fsync(log->fd);
+	}
+}
+
+void write_all(int fd, struct iovec *iov, size_t count, size_t skip)
+{
+	while (count > 0)
+	{
+		//step over whatever has already been written
+		while (count > 0 && skip >= iov->iov_len)
+		{
+			skip -= iov->iov_len;
+			iov++;
+			count--;
+		}
+
+		if (count == 0)
+		{
+			return;
+		}
+
+		iov->iov_base = (char *) iov->iov_base + skip;
+		iov->iov_len -= skip;
+		ssize_t written = writev(fd, iov, count < IOV_MAX ? count : IOV_MAX);
+		if (written < 0 && errno == EINTR)
+		{
+			skip = 0;
+			continue;
+		}
+		if (written <= 0)
+		{
+			return;
+		}
+		skip = written;
+	}
+}
+
+unsigned short setup_uring(uring_t *uring)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof params);
+	uring->fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+	if (uring->fd < 0)
+	{
+		return 0;
+	}
+
+	//writes must go to the file's current position, like write(2) would
+	if (!(params.features & IORING_FEAT_RW_CUR_POS))
+	{
+		close(uring->fd);
+		return 0;
+	}
+
+	uring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	uring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (uring->cq_map_size > uring->sq_map_size)
+		{
+			uring->sq_map_size = uring->cq_map_size;
+		}
+		uring->cq_map_size = 0;
+	}
+
+	uring->sq_map = mmap(NULL, uring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQ_RING);
+	uring->cq_map = uring->sq_map;
+	if (uring->sq_map != MAP_FAILED && uring->cq_map_size > 0)
+	{
+		uring->cq_map = mmap(NULL, uring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_CQ_RING);
+	}
+	uring->sqes_map_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	uring->sqes_map = mmap(NULL, uring->sqes_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQES);
+	if (uring->sq_map == MAP_FAILED || uring->cq_map == MAP_FAILED || uring->sqes_map == MAP_FAILED)
+	{
+		if (uring->sq_map != MAP_FAILED)
+		{
+			munmap(uring->sq_map, uring->sq_map_size);
+		}
+		if (uring->cq_map != MAP_FAILED && uring->cq_map_size > 0)
+		{
+			munmap(uring->cq_map, uring->cq_map_size);
+		}
+		if (uring->sqes_map != MAP_FAILED)
+		{
+			munmap(uring->sqes_map, uring->sqes_map_size);
+		}
+		close(uring->fd);
+		return 0;
+	}
+
+	char *sq = uring->sq_map;
+	char *cq = uring->cq_map;
+	uring->sq_head = (unsigned *) (sq + params.sq_off.head);
+	uring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+	uring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+	uring->sq_array = (unsigned *) (sq + params.sq_off.array);
+	uring->cq_head = (unsigned *) (cq + params.cq_off.head);
+	uring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+	uring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+	uring->sqes = uring->sqes_map;
+	uring->cqes = cq + params.cq_off.cqes;
+	return 1;
+}
+
+unsigned short uring_writev(uring_t *uring, int fd, struct iovec *iov, size_t count, unsigned short sync, ssize_t *written)
+{
+	struct io_uring_sqe *sqes = uring->sqes;
+	struct io_uring_cqe *cqes = uring->cqes;
+	unsigned tail = *uring->sq_tail;
+	unsigned to_submit = 0;
+
+	if (count > 0)
+	{
+		unsigned index = tail & *uring->sq_mask;
+		struct io_uring_sqe *sqe = sqes + index;
+		memset(sqe, 0, sizeof *sqe);
+		sqe->opcode = IORING_OP_WRITEV;
+		sqe->fd = fd;
+		sqe->off = (uint64_t) -1;
+		sqe->addr = (uint64_t) (uintptr_t) iov;
+		sqe->len = count;
+		sqe->flags = sync ? IOSQE_IO_LINK : 0;
+		sqe->user_data = IORING_OP_WRITEV;
+		uring->sq_array[index] = index;
+		tail++;
+		to_submit++;
+	}
+
+	if (sync)
+	{
+		unsigned index = tail & *uring->sq_mask;
+		struct io_uring_sqe *sqe = sqes + index;
+		memset(sqe, 0, sizeof *sqe);
+		sqe->opcode = IORING_OP_FSYNC;
+		sqe->fd = fd;
+		sqe->user_data = IORING_OP_FSYNC;
+		uring->sq_array[index] = index;
+		tail++;
+		to_submit++;
+	}
+
+	__atomic_store_n(uring->sq_tail, tail, __ATOMIC_RELEASE);
+
+	*written = 0;
+	unsigned completed = 0;
+	unsigned submitted = 0;
+	while (completed < to_submit)
+	{
+		long result = syscall(__NR_io_uring_enter, uring->fd, to_submit - submitted, to_submit - completed, IORING_ENTER_GETEVENTS, NULL, 0);
+		if (result < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return 0;
+		}
+		submitted += result;
+
+		unsigned head = *uring->cq_head;
+		while (head != __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE))
+		{
+			struct io_uring_cqe *cqe = cqes + (head & *uring->cq_mask);
+			if (cqe->user_data == IORING_OP_WRITEV)
+			{
+				*written = cqe->res;
+			}
+			head++;
+			completed++;
+		}
+		__atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	//an error that says the operation itself is unsupported means io_uring should not be used
+	return !(*written == -EINVAL || *written == -EOPNOTSUPP);
+}
+
+void teardown_uring(uring_t *uring)
+{
+	munmap(uring->sqes_map, uring->sqes_map_size);
+	if (uring->cq_map_size > 0)
+	{
+		munmap(uring->cq_map, uring->cq_map_size);
+	}
+	munmap(uring->sq_map, uring->sq_map_size);
+	close(uring->fd);
+}
+
+uint64_t now_ns(clockid_t clock)
+{
+	struct timespec now;
+	clock_gettime(clock, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
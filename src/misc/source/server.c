@@ -0,0 +1,541 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../include/server.h"
+
+#define SERVER_BACKLOG  128
+#define SERVER_CHUNK    (64 * 1024)
+#define CLIENT_TIMES    "-t"
+
+/**
+  * Where a job's output is read from and passed on to
+  */
+typedef struct
+{
+	int connection;
+	int pipes[2];
+} relay_t;
+
+/**
+  * Writes all of a buffer to a descriptor, continuing after short writes
+  * @param fd     the descriptor
+  * @param data   the bytes to be written
+  * @param length the number of bytes
+  * @return zero if the bytes could not all be written, nonzero otherwise
+  */
+int write_exactly(int fd, const void *data, size_t length);
+
+/**
+  * Reads exactly length bytes from a descriptor
+  * @param fd     the descriptor
+  * @param data   out param; where the bytes are placed
+  * @param length the number of bytes
+  * @return zero if the descriptor ended or failed first, nonzero otherwise
+  */
+int read_exactly(int fd, void *data, size_t length);
+
+/**
+  * Sends one frame
+  * @param fd     the connection
+  * @param type   the frame's type
+  * @param data   the frame's payload
+  * @param length the payload's length, at most FRAME_MAX
+  * @return zero if the frame could not be sent, nonzero otherwise
+  */
+int write_frame(int fd, char type, const void *data, uint32_t length);
+
+/**
+  * Receives one frame
+  * @param fd     the connection
+  * @param type   out param; the frame's type
+  * @param data   out param; the frame's payload, NUL terminated, to be freed by the caller
+  * @param length out param; the payload's length
+  * @return zero if no whole frame could be received, nonzero otherwise
+  */
+int read_frame(int fd, char *type, char **data, uint32_t *length);
+
+/**
+  * Binds and listens on the server's socket. A socket left behind at the path by an earlier server
+  * is removed first; anything else there is left alone, and binding then fails
+  * @param path the path of the socket
+  * @return the listening socket, or -1 if it could not be set up
+  */
+int listen_on(const char *path);
+
+/**
+  * Serves one connection, as the worker forked for it: reads the command frame, runs the line with
+  * its output in pipes, which a thread passes back as it arrives, then sends the result
+  * @param connection the connection
+  * @param server     the server
+  * @return the worker's exit status
+  */
+int serve_job(int connection, server_t *server);
+
+/**
+  * Passes a job's output on to its client as it arrives, each pipe in frames of its own, until both
+  * pipes have ended; run as a thread of the worker while the worker runs the job
+  * @param argument the relay
+  * @return NULL
+  */
+void *relay_output(void *argument);
+
+/**
+  * Forgets a worker that has exited, making room for another
+  * @param workers the pids of the running workers
+  * @param running in/out param; the number of running workers
+  * @param pid     the pid of the worker that exited
+  */
+void forget_worker(pid_t *workers, size_t *running, pid_t pid);
+
+status_t run_server(const char *path, server_t *server)
+{
+	int listener = listen_on(path);
+	if (listener < 0)
+	{
+		return SOCKET_ERROR;
+	}
+
+	size_t limit = server->workers > 0 ? server->workers : 1;
+	pid_t *workers = malloc(limit * sizeof *workers);
+	if (workers == NULL)
+	{
+		close(listener);
+		return MEMORY_ERROR;
+	}
+
+	size_t running = 0;
+	while (1)
+	{
+		//a full pool takes no more jobs until one is done; the kernel holds on to new connections
+		pid_t pid;
+		while ((pid = waitpid(-1, NULL, running < limit ? WNOHANG : 0)) > 0 || (pid < 0 && errno == EINTR))
+		{
+			if (pid > 0)
+			{
+				forget_worker(workers, &running, pid);
+			}
+		}
+
+		int connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+		if (connection < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+			{
+				continue;
+			}
+			break;
+		}
+
+		server->refresh(server->context);
+		pid = fork();
+		if (pid == 0)
+		{
+			close(listener);
+			_exit(serve_job(connection, server));
+		}
+
+		close(connection);
+		if (pid > 0)
+		{
+			workers[running++] = pid;
+		}
+	}
+
+	free(workers);
+	close(listener);
+	unlink(path);
+	return SOCKET_ERROR;
+}
+
+int run_client(const char *path, char **words)
+{
+	int times = words[0] != NULL && strcmp(words[0], CLIENT_TIMES) == 0;
+	words += times;
+
+	size_t length = 0;
+	size_t i;
+	for (i = 0; words[i] != NULL; i++)
+	{
+		length += strlen(words[i]) + 1;
+	}
+
+	char *line = malloc(length + 1);
+	if (line == NULL)
+	{
+		error_message(MEMORY_ERROR);
+		return 2;
+	}
+
+	line[0] = '\0';
+	char *end = line;
+	for (i = 0; words[i] != NULL; i++)
+	{
+		end = stpcpy(end, words[i]);
+		if (words[i + 1] != NULL)
+		{
+			*end++ = ' ';
+		}
+	}
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof address);
+	address.sun_family = AF_UNIX;
+	int connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (connection < 0 || strlen(path) >= sizeof address.sun_path || end - line > FRAME_MAX)
+	{
+		free(line);
+		if (connection >= 0)
+		{
+			close(connection);
+		}
+		error_message(connection < 0 ? SOCKET_ERROR : ARGS_ERROR);
+		return 2;
+	}
+
+	strcpy(address.sun_path, path);
+	int sent = connect(connection, (struct sockaddr *) &address, sizeof address) == 0 && write_frame(connection, FRAME_COMMAND, line, end - line);
+	free(line);
+
+	int status = 2;
+	char type;
+	char *data;
+	uint32_t data_length;
+	while (sent && read_frame(connection, &type, &data, &data_length))
+	{
+		if (type == FRAME_STDOUT || type == FRAME_STDERR)
+		{
+			write_exactly(type == FRAME_STDOUT ? STDOUT_FILENO : STDERR_FILENO, data, data_length);
+		}
+		else if (type == FRAME_RESULT && data_length == sizeof(job_result_t))
+		{
+			job_result_t result;
+			memcpy(&result, data, sizeof result);
+			status = result.status;
+			if (times)
+			{
+				fprintf(stderr, "user %.3fs system %.3fs maxrss %lldKB\n", result.user_usec / 1e6, result.system_usec / 1e6, (long long) result.max_rss_kb);
+			}
+		}
+		free(data);
+	}
+
+	if (!sent)
+	{
+		error_message(SOCKET_ERROR);
+	}
+
+	close(connection);
+	return status;
+}
+
+int listen_on(const char *path)
+{
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof address);
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof address.sun_path)
+	{
+		return -1;
+	}
+	strcpy(address.sun_path, path);
+
+	struct stat info;
+	if (lstat(path, &info) == 0 && S_ISSOCK(info.st_mode))
+	{
+		unlink(path);
+	}
+
+	int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listener < 0)
+	{
+		return -1;
+	}
+
+	if (bind(listener, (struct sockaddr *) &address, sizeof address) < 0 || listen(listener, SERVER_BACKLOG) < 0)
+	{
+		close(listener);
+		return -1;
+	}
+
+	return listener;
+}
+
+int serve_job(int connection, server_t *server)
+{
+	char type;
+	char *line;
+	uint32_t length;
+	if (!read_frame(connection, &type, &line, &length))
+	{
+		return 1;
+	}
+
+	if (type != FRAME_COMMAND)
+	{
+		free(line);
+		return 1;
+	}
+
+	//the line is run as though it had been typed
+	char *typed = realloc(line, length + 2);
+	if (typed == NULL)
+	{
+		free(line);
+		return 1;
+	}
+	strcpy(typed + length, "\n");
+
+	relay_t relay = { connection, { -1, -1 } };
+	int output[2];
+	int errors[2];
+	pthread_t thread;
+	int nothing = open("/dev/null", O_RDWR);
+	if (nothing < 0 || pipe2(output, O_CLOEXEC) < 0)
+	{
+		free(typed);
+		return 1;
+	}
+	relay.pipes[0] = output[0];
+	if (pipe2(errors, O_CLOEXEC) < 0)
+	{
+		free(typed);
+		return 1;
+	}
+	relay.pipes[1] = errors[0];
+
+	if (dup2(nothing, STDIN_FILENO) < 0 || dup2(output[1], STDOUT_FILENO) < 0 || dup2(errors[1], STDERR_FILENO) < 0 || pthread_create(&thread, NULL, relay_output, &relay) != 0)
+	{
+		free(typed);
+		return 1;
+	}
+	close(output[1]);
+	close(errors[1]);
+
+	//the stages before the last of a pipeline are children of the last, so once it exits they are
+	//orphans; as their subreaper, the worker waits for them too, which brings their usage into the
+	//result
+	prctl(PR_SET_CHILD_SUBREAPER, 1);
+	int32_t status = server->run(server->context, typed);
+	free(typed);
+	fflush(stdout);
+	fflush(stderr);
+
+	//the relay sees the end of the output once the worker's copies of the pipes are gone too
+	dup2(nothing, STDOUT_FILENO);
+	dup2(nothing, STDERR_FILENO);
+	while (wait(NULL) > 0 || errno == EINTR);
+	pthread_join(thread, NULL);
+
+	struct rusage self;
+	struct rusage children;
+	getrusage(RUSAGE_SELF, &self);
+	getrusage(RUSAGE_CHILDREN, &children);
+	job_result_t result;
+	result.status = status;
+	result.user_usec = (self.ru_utime.tv_sec + children.ru_utime.tv_sec) * 1000000LL + self.ru_utime.tv_usec + children.ru_utime.tv_usec;
+	result.system_usec = (self.ru_stime.tv_sec + children.ru_stime.tv_sec) * 1000000LL + self.ru_stime.tv_usec + children.ru_stime.tv_usec;
+	result.max_rss_kb = self.ru_maxrss > children.ru_maxrss ? self.ru_maxrss : children.ru_maxrss;
+	write_frame(connection, FRAME_RESULT, &result, sizeof result);
+	close(connection);
+	return 0;
+}
+
+void *relay_output(void *argument)
+{
+	relay_t *relay = argument;
+	struct pollfd pipes[2] = { { relay->pipes[0], POLLIN, 0 }, { relay->pipes[1], POLLIN, 0 } };
+	char types[2] = { FRAME_STDOUT, FRAME_STDERR };
+	char *buffer = malloc(SERVER_CHUNK);
+	int open_pipes = 2;
+	while (buffer != NULL && open_pipes > 0)
+	{
+		if (poll(pipes, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+
+		size_t i;
+		for (i = 0; i < 2; i++)
+		{
+			if (pipes[i].fd < 0 || pipes[i].revents == 0)
+			{
+				continue;
+			}
+
+			ssize_t received = read(pipes[i].fd, buffer, SERVER_CHUNK);
+			if (received < 0 && errno == EINTR)
+			{
+				continue;
+			}
+
+			if (received <= 0)
+			{
+				close(pipes[i].fd);
+				pipes[i].fd = -1;
+				open_pipes--;
+				continue;
+			}
+
+			//once the client has gone, the pipes are closed, so the job sees EPIPE (or SIGPIPE)
+			//as it would writing to any reader that had gone
+			if (!write_frame(relay->connection, types[i], buffer, received))
+			{
+				size_t j;
+				for (j = 0; j < 2; j++)
+				{
+					if (pipes[j].fd >= 0)
+					{
+						close(pipes[j].fd);
+					}
+				}
+				open_pipes = 0;
+				break;
+			}
+		}
+	}
+
+	free(buffer);
+	return NULL;
+}
+
+void forget_worker(pid_t *workers, size_t *running, pid_t pid)
+{
+	//anything else, such as a background command the server's initialization file started, is
+	//not counted
+	size_t i;
+	for (i = 0; i < *running; i++)
+	{
+		if (workers[i] == pid)
+		{
+			workers[i] = workers[--*running];
+			return;
+		}
+	}
+}
+
+int write_frame(int fd, char type, const void *data, uint32_t length)
+{
+	//a peer that has gone shows up as EPIPE, rather than a SIGPIPE that would also end the job
+	char header[1 + sizeof length];
+	header[0] = type;
+	memcpy(header + 1, &length, sizeof length);
+	struct iovec vectors[2] = { { header, sizeof header }, { (void *) data, length } };
+	struct msghdr message = { NULL, 0, vectors, 2, NULL, 0, 0 };
+	size_t remaining = sizeof header + length;
+	while (remaining > 0)
+	{
+		ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return 0;
+		}
+
+		//after a short send, the vectors are moved past what went
+		remaining -= sent;
+		while (sent > 0 && message.msg_iovlen > 0)
+		{
+			size_t taken = (size_t) sent < message.msg_iov->iov_len ? (size_t) sent : message.msg_iov->iov_len;
+			message.msg_iov->iov_base = (char *) message.msg_iov->iov_base + taken;
+			message.msg_iov->iov_len -= taken;
+			sent -= taken;
+			if (message.msg_iov->iov_len == 0)
+			{
+				message.msg_iov++;
+				message.msg_iovlen--;
+			}
+		}
+	}
+
+	return 1;
+}
+
+int read_frame(int fd, char *type, char **data, uint32_t *length)
+{
+	char header[1 + sizeof *length];
+	if (!read_exactly(fd, header, sizeof header))
+	{
+		return 0;
+	}
+
+	*type = header[0];
+	memcpy(length, header + 1, sizeof *length);
+	if (*length > FRAME_MAX || (*data = malloc(*length + 1)) == NULL)
+	{
+		return 0;
+	}
+
+	if (!read_exactly(fd, *data, *length))
+	{
+		free(*data);
+		return 0;
+	}
+
+	(*data)[*length] = '\0';
+	return 1;
+}
+
+int write_exactly(int fd, const void *data, size_t length)
+{
+	const char *bytes = data;
+	while (length > 0)
+	{
+		ssize_t written = write(fd, bytes, length);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return 0;
+		}
+
+		bytes += written;
+		length -= written;
+	}
+
+	return 1;
+}
+
+int read_exactly(int fd, void *data, size_t length)
+{
+	char *bytes = data;
+	while (length > 0)
+	{
+		ssize_t received = read(fd, bytes, length);
+		if (received < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (received <= 0)
+		{
+			return 0;
+		}
+
+		bytes += received;
+		length -= received;
+	}
+
+	return 1;
+}
@@ -0,0 +1,2713 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../include/arena.h"
+#include "../include/cache.h"
+#include "../include/control.h"
+#include "../include/coreutils.h"
+#include "../include/fanout.h"
+#include "../include/filter.h"
+#include "../include/here_document.h"
+#include "../include/line_editor.h"
+#include "../include/meter.h"
+#include "../include/optimize.h"
+#include "../include/parse.h"
+#include "../include/pipe_size.h"
+#include "../include/shell.h"
+#include "../include/substitute.h"
+#include "../include/zygote.h"
+#include "../../types/include/alias.h"
+#include "../../types/include/command.h"
+#include "../../types/include/environment.h"
+#include "../../types/include/history.h"
+#include "../../types/include/jobs.h"
+#include "../../types/include/path.h"
+#include "../../types/include/status.h"
+#include "../../types/include/string_t.h"
+
+#define ASCII_0 48
+#define ASCII_9 57
+
+#define REDIRECT_PREALLOCATE_MIN (1024 * 1024)
+
+/**
+  * The names of the builtin commands, offered for completion along with the commands in the path
+  */
+char *BUILTINS[] = { "alias", "cd", "complete", "endscript", "exit", "history", "quit", "script", "scriptcat", "set", "unset", "export", "cache", "jobs", "wait" };
+
+/**
+  * Evaluates a line with control flow, or more than one pipeline joined by ;, && or ||. Lines are
+  * read to go with it until every block in it is closed, then the whole script is compiled once and
+  * run, so a loop does not parse its body again each time round
+  * @param line        the first line of the script
+  * @param environment the current environment in which to evaluate
+  * @return whether the program should continue executing
+  */
+unsigned short eval_compound(char *line, environment_t *environment);
+
+/**
+  * Runs one command of a compiled script as eval_print would run a line: expanded (a copy of it, so
+  * the compiled command can run again), then as a builtin or through execute_external
+  * @param context the current environment
+  * @param command the compiled command
+  * @return SHELL_EXIT for exit or quit, an error the command could not be set up to run with, or
+  *         SUCCESS once any other error has been reported
+  */
+status_t run_statement(void *context, command_t *command);
+
+/**
+  * Reports the error a forked child could not become its command with, and ends the child there, so
+  * that no error from a child ever reaches the shell's own code; _exit rather than exit, so that
+  * nothing buffered or registered with atexit by the shell, or by a program embedding it, runs a
+  * second time here
+  * @param error the error
+  */
+void exit_child(status_t error);
+
+/**
+  * Reads a line that continues the current command, such as a line of a here-document, from wherever
+  * the command itself came from: the initialization file, or else the line editor, with a prompt of
+  * "> "
+  * @param context the current environment
+  * @param line    in/out param; the buffer the line is placed in, as with getline
+  * @param size    in/out param; the size of the buffer, as with getline
+  * @return the number of characters read, or -1 at the end of the input
+  */
+ssize_t read_continuation_line(void *context, char **line, size_t *size);
+
+/**
+  * Runs the command line inside a $(...) in the child capture forks for it, with stdout already the
+  * capture pipe, through the same steps as eval_print: builtins run here, anything else through
+  * execute_external. Exits with the command's status rather than returning
+  * @param context the current environment
+  * @param text    the command line
+  */
+void run_substitution(void *context, char *text);
+
+/**
+  * Finds the value of a shell variable, for $name and ${name}
+  * @param context the current environment
+  * @param name    the name of the variable
+  * @return the value, or NULL if there is no such variable
+  */
+char *lookup_variable(void *context, char *name);
+
+/**
+  * Runs echo, true, false, test, [ or printf in the shell itself, with any redirections applied to
+  * the shell's own descriptors while it runs and then undone, and sets the exit status. Only a
+  * command with no pipes or branches, not in the background and with no script open, runs this way
+  * @param environment the current environment
+  * @param command     the command to be run
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t execute_in_process(environment_t *environment, command_t *command);
+
+/**
+  * Handles a cache command: "cache stats", or "cache [-i path]... command", which replays the
+  * stored stdout, stderr and exit status of the command if its key is in the store, and otherwise
+  * runs it through execute_external with stdout and stderr going to memfds, then copies those out
+  * and stores them. A command with output redirections, a fan-out, a here-document or here-string,
+  * or in the background, or any command while a script is open, is run without the cache
+  * @param environment the current environment, holding the cache
+  * @param command     the cache command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t cache_command(environment_t *environment, command_t *command);
+
+/**
+  * Determines whether the output of a command can be cached: it must all go to stdout and stderr,
+  * and come from nothing but its arguments and < files
+  * @param environment the current environment
+  * @param command     the command, without the cache prefix
+  * @return nonzero if it can, zero otherwise
+  */
+int is_cacheable(environment_t *environment, command_t *command);
+
+/**
+  * Has the zygote launch a foreground pipeline of programs, if one is running and the pipeline can
+  * go to it: no fan-out, script, meter or optimization, and every stage a program found in the
+  * path. The pipes and redirections are set up here, on the shell's own descriptors, which are put
+  * back afterwards, and passed to the zygote, which reports the last stage's exit status back
+  * @param environment the current environment in which to execute the command
+  * @param command     the command to be run
+  * @param launched    out param; whether the zygote took the command, rather than it being left to
+  *                    be forked as usual
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t zygote_execute(environment_t *environment, command_t *command, unsigned short *launched);
+
+/**
+  * Finds the program a command name runs, as the child's search would: the name itself if it holds
+  * a slash, otherwise the directory the index has it in, then each directory in the path
+  * @param environment the current environment, whose path and index are searched
+  * @param name        the command name
+  * @return the program's path, to be freed by the caller, or NULL if there is no such program
+  */
+char *find_program(environment_t *environment, const char *name);
+
+/**
+  * Determines whether a path names a regular file that can be executed
+  * @param path the path
+  * @return nonzero if it does, zero otherwise
+  */
+int is_program(const char *path);
+
+/**
+  * Perform the actual execution by the child process of the command
+  * @param environment the current environment in which to execute the command
+  * @param command     the command to be executed
+  * @param verbose_out where verbose output goes; kept separate so it does not end up in a script
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t child_execute(environment_t *environment, command_t *command, FILE *verbose_out);
+
+/**
+  * Runs a run of built in filters (@grep | @wc ...) in the calling child, from stdin to stdout
+  * @param command the first of the filters, the rest following it through pipe
+  * @return the exit status of the last filter, or 2 if one of them could not be parsed
+  */
+int filter_execute(command_t *command);
+
+/**
+  * Runs a command whose output fans out to several branches (producer |+ branch |+ branch). The
+  * calling (child) process forks the producer and every branch, each with a pipe of its own, and
+  * then stays behind to distribute the producer's output to them. It exits once the producer and
+  * all of the branches have, so that whoever waits for it waits for all of them
+  * @param environment the current environment in which to execute the command
+  * @param command     the producer, holding the branches in its fanout list
+  * @param verbose_out where verbose output goes
+  * @return a status code indicating whether an error occurred; only returns in a forked child, or
+  *         if the distribution could not be set up
+  */
+status_t fanout_execute(environment_t *environment, command_t *command, FILE *verbose_out);
+
+/**
+  * Applies a single command's redirections to the calling (child) process, opening each file and
+  * moving it onto stdin, stdout, or stderr with dup2. Output files are opened with O_CLOEXEC, so
+  * only the duplicated descriptors survive the exec. When a > target's final size is known (the
+  * command reads a large regular file through < and so will probably write about as much), the
+  * space is preallocated up front, without changing the file's size, to keep it from fragmenting
+  * @param command the command whose redirections are applied
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t apply_redirections(command_t *command);
+
+/**
+  * Opens a file for a redirection and moves it onto target, closing the original descriptor
+  * @param name   the name of the file
+  * @param flags  the flags to open the file with
+  * @param target the descriptor the file should end up on
+  * @return the descriptor, now target, or -1 if the file could not be opened or moved
+  */
+int redirect(char *name, int flags, int target);
+
+/**
+  * Handles a history command (one executed by !! or !integer), executing if possible and returning
+  * an error otherwise
+  * @param environment the current environment in which to execute the command
+  * @param command     the history command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t history_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a cd command, returning an error code if an error occurs
+  * @param command     the cd command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t cd_command(command_t *command);
+
+/**
+  * Handles an alias command (i.e., "alias [name] "command"), executing if possible and returning an
+  * error otherwise
+  * @param environment the current environment in which to execute the alias command 
+  * @param command     the alias command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t alias_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a complete command (i.e., "complete [prefix]"), printing every command, alias, and
+  * builtin that begins with prefix, one per line
+  * @param environment the current environment in which to complete
+  * @param command     the complete command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t complete_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles an alias execute command (i.e., the execution of a previously defined alias), executing
+  * of possible and returning an error otherwise
+  * @param environment the current environment in which to execute the aliased command
+  * @param command     the original command as given by the user
+  * @param alias       the aliased command
+  */
+status_t alias_execute_command(environment_t *environment, command_t *original, command_t *alias);
+
+/**
+  * Handles a script command (i.e., "script [-z] [scriptname]"), starting the script if possible and
+  * returning an error otherwise. Sets the appropriate variables in environment as needed. With -z,
+  * the script file is compressed, to be read back with scriptcat.
+  * @param environment the current environment in which to begin the script
+  * @param command     the script command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t script_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles an endscript command, ending the script and closing the file if possible, returning an
+  * error otherwise. Sets the appropriate variables in envrionment and closes files as needed.
+  * @param environment the current environment in which to end the script
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t endscript_command(environment_t *environment);
+
+/**
+  * Handles a scriptcat command (i.e., "scriptcat [-t] [scriptname]"), writing the output held in a
+  * script file, compressed or not, to stdout, with -t putting the time each command started before
+  * it in a compressed one
+  * @param command the scriptcat command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t scriptcat_command(command_t *command);
+
+/**
+  * Handles a "set", setting the correct variable in the environment if possible, returning an error
+  * otherwise.
+  * @param environment the current environment to set the variable into
+  * @param command     the set command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t set_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a "set path", setting the correct variable in the environment if possible, returning an error
+  * otherwise.
+  * @param environment the current environment to set the path variable into
+  * @param command     the set path command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t set_path_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a "set verbose", setting the correct variable in the environment if possible, returning an error
+  * otherwise.
+  * @param environment the current environment to set the verbose variable into
+  * @param command     the set verbose command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t set_verbose_command(environment_t *environment, command_t *command);
+
+
+status_t set_prompt_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a "set pipesize <bytes|auto>", setting the size of the buffer of every pipe the shell
+  * creates from then on (zero bytes meaning the kernel's default)
+  * @param environment the current environment to set the pipe size into
+  * @param command     the set pipesize command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t set_pipesize_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a "set cachesize <bytes>", setting how large the command cache's store may grow before
+  * the least recently used entries are evicted
+  * @param environment the current environment holding the cache
+  * @param command     the set cachesize command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t set_cachesize_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a "set joboutput <bytes>", setting how many bytes of output each background job started
+  * from then on keeps, the oldest being dropped once it writes more
+  * @param environment the current environment holding the jobs
+  * @param command     the set joboutput command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t set_joboutput_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a "set jobkeep <count>", setting how many finished jobs that have been reported are kept
+  * for jobs -o before the oldest are let go
+  * @param environment the current environment holding the jobs
+  * @param command     the set jobkeep command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t set_jobkeep_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a "set optimize on|off", turning the rewriting of pipelines into cheaper equivalents on or
+  * off
+  * @param environment the current environment to set the optimize variable into
+  * @param command     the set optimize command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t set_optimize_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a "set meter on|off", turning on or off the relays that measure the throughput between the
+  * stages of pipelines
+  * @param environment the current environment to set the meter variable into
+  * @param command     the set meter command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t set_meter_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a "set builtin-coreutils on|off", choosing whether echo, true, false, test, [ and printf
+  * run in the shell (or in the forked child of a pipeline, without an exec) or as the programs in
+  * the path
+  * @param environment the current environment to set the coreutils variable into
+  * @param command     the set builtin-coreutils command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t set_coreutils_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a "set zygote on|off", starting or stopping the zygote that launches commands for the
+  * shell
+  * @param environment the current environment holding the zygote
+  * @param command     the set zygote command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t set_zygote_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a "set scriptsync none|command|interval", choosing when script files are fsynced, both for
+  * the open script (if any) and for any started later
+  * @param environment the current environment to set the sync policy into
+  * @param command     the set scriptsync command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t set_scriptsync_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a "set name = value", setting a shell variable to the words after the =, joined by
+  * spaces, for any name the shell does not use for a setting of its own
+  * @param environment the current environment holding the variable
+  * @param command     the set command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t set_variable_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles an export command (i.e., "export [name[=value] ...]"), setting any values given and
+  * exporting each variable to the commands run from then on; with no names, prints the exported
+  * variables
+  * @param environment the current environment holding the variables
+  * @param command     the export command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t export_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles an unset command (i.e., "unset name ..."), removing each variable, exported or not
+  * @param environment the current environment holding the variables
+  * @param command     the unset command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t unset_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a jobs command (i.e., "jobs" or "jobs -o number"), listing the background jobs, or paging
+  * everything a job has output so far; a finished job is forgotten once its output has been shown
+  * @param environment the current environment holding the jobs
+  * @param command     the jobs command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t jobs_command(environment_t *environment, command_t *command);
+
+/**
+  * Handles a wait command (i.e., "wait" or "wait -o"), waiting for every background job to finish;
+  * with -o, then prints each job's output in the order the jobs were started, and forgets them
+  * @param environment the current environment holding the jobs
+  * @param command     the wait command to be executed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t wait_command(environment_t *environment, command_t *command);
+
+/**
+  * Shows a job's output through the pager ($PAGER, or less) when stdout is a terminal, and writes
+  * it straight to stdout otherwise, or if there is no pager in the path
+  * @param environment the current environment, whose path is searched for the pager
+  * @param job         the job
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t page_job_output(environment_t *environment, job_t *job);
+
+/**
+  * Converts a string pointed to by s to a size_t, setting *value on success and returning an error
+  * otherwise
+  * @param s     the string to be converted
+  * @param value out param; where the converted value will be placed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t convert(char *s, size_t *value);
+
+status_t create_shell(shell_t **shell, char **variables)
+{
+	shell_t *created = calloc(1, sizeof *created);
+	if (created == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+
+	created->history.length = HISTORY_LENGTH;
+	string_initialize(&created->prompt);
+	string_assign_from_char_array(&created->prompt, "osh> ");
+	initialize_completion(&created->completion);
+	created->exec_index.completion = &created->completion;
+	created->zygote = (zygote_t) { 0, -1, ZYGOTE_EXECUTABLE };
+	created->cache.limit = CACHE_LIMIT;
+	created->jobs.limit = JOBS_OUTPUT_LIMIT;
+	created->jobs.keep = JOBS_KEEP;
+	created->environment = (environment_t) { &created->path, &created->history, &created->aliases, NULL, 0, &created->prompt, &created->exec_index, &created->completion, &created->tee, SCRIPT_SYNC_NONE, 0, 0, 0, NULL, 0, &created->variables, &created->wildcards, 1, &created->zygote, &created->cache, &created->jobs };
+
+	status_t error = add_completions(&created->completion, BUILTINS, sizeof BUILTINS / sizeof *BUILTINS);
+	if (error == SUCCESS)
+	{
+		error = import_variables(&created->variables, variables);
+	}
+	if (error != SUCCESS)
+	{
+		destroy_shell(created);
+		return error;
+	}
+
+	*shell = created;
+	return SUCCESS;
+}
+
+void destroy_shell(shell_t *shell)
+{
+	clear_environment(&shell->environment);
+	free(shell);
+}
+
+unsigned short eval_print(char *line, size_t chars_read, environment_t *environment)
+{
+	//user wants to exit, return that indication to caller
+	if (strcmp(line, "exit\n") == 0 || strcmp(line, "quit\n") == 0)
+	{
+		return 0;
+	} 
+
+	if (is_compound(line))
+	{
+		return eval_compound(line, environment);
+	}
+
+	//parse the input and place the result in the given command
+	command_t command = {0};
+	status_t error = parse_line(line, chars_read, &command);
+	if (error != SUCCESS)
+	{
+		error_message(error);
+		return 1;
+	}
+
+	//the bodies of any here-documents follow the command line
+	error = read_here_documents(&command, read_continuation_line, environment);
+	if (error != SUCCESS)
+	{
+		error_message(error);
+		close_here_documents(&command);
+		free_linked_list(command.pipe);
+		free_branches(&command);
+		free(command.arguments);
+		return 1;
+	}
+
+	//then variables and substitutions are expanded; stages that change get new arguments arrays from
+	//the arena, so the array parse_line allocated is kept to be freed
+	arena_t arena = {0};
+	char **arguments = command.arguments;
+	expansion_t expansion = { &arena, run_substitution, lookup_variable, environment, &environment->status, environment->wildcards, &environment->pipe_size };
+	error = expand_command(&command, &expansion);
+	if (error != SUCCESS || command.argc <= 1)
+	{
+		//a line of expansions with no value has nothing to run, and keeps the status
+		if (error != SUCCESS)
+		{
+			error_message(error);
+		}
+		close_here_documents(&command);
+		free_linked_list(command.pipe);
+		free_branches(&command);
+		free(arguments);
+		arena_free(&arena);
+		return 1;
+	}
+
+	if (environment->verbose)
+	{
+		print_command(&command);
+		fprintf(stdout, "\n");
+	}
+
+	//if command is a builtin, let execute_builtin handle it, otherwise execute the external command
+	unsigned short is_builtin;
+	error = execute_builtin(environment, &command, &is_builtin);
+	if (!is_builtin)
+	{
+		error = execute_external(environment, &command);
+	}
+	else
+	{
+		environment->status = error != SUCCESS;
+	}
+
+	if (error != SUCCESS)
+	{
+		//forked children exit where they fail, so this is the shell's own error, such as the tee
+		//engine's pipe not being created, and the shell carries on
+		error_message(error);
+		close_here_documents(&command);
+		free_linked_list(command.pipe);
+		free_branches(&command);
+		free(arguments);
+		arena_free(&arena);
+		return 1;
+	}
+
+
+	//Only made it here if no errors occurred, so safe to free command.arguments
+	close_here_documents(&command);
+	free_linked_list(command.pipe);
+	free_branches(&command);
+	free(arguments);
+	arena_free(&arena);
+	return 1;
+}
+
+unsigned short eval_compound(char *line, environment_t *environment)
+{
+	size_t length = strlen(line);
+	char *text = malloc(length + 1);
+	if (text == NULL)
+	{
+		error_message(MEMORY_ERROR);
+		return 1;
+	}
+	memcpy(text, line, length + 1);
+
+	char *next = NULL;
+	size_t size = 0;
+	while (script_incomplete(text))
+	{
+		ssize_t chars_read = read_continuation_line(environment, &next, &size);
+		char *tmp = chars_read < 0 ? NULL : realloc(text, length + chars_read + 1);
+		if (tmp == NULL)
+		{
+			//the input ended partway through a block
+			error_message(chars_read < 0 ? FORMAT_ERROR : MEMORY_ERROR);
+			free(next);
+			free(text);
+			return 1;
+		}
+		text = tmp;
+		memcpy(text + length, next, chars_read + 1);
+		length += chars_read;
+	}
+	free(next);
+
+	//each command keeps its own copy of its part of the text
+	script_node_t *script;
+	status_t error = compile_script(text, &script);
+	free(text);
+	if (error != SUCCESS)
+	{
+		error_message(error);
+		return 1;
+	}
+
+	interpreter_t interpreter = { run_statement, { NULL, run_substitution, lookup_variable, environment, &environment->status, environment->wildcards, &environment->pipe_size }, environment->variables };
+	error = run_script(script, &interpreter);
+	free_script(script);
+	if (error == SHELL_EXIT)
+	{
+		return 0;
+	}
+
+	//forked children exit where they fail, so this is the shell's own error, and it carries on
+	if (error != SUCCESS)
+	{
+		error_message(error);
+	}
+
+	return 1;
+}
+
+status_t run_statement(void *context, command_t *command)
+{
+	environment_t *environment = context;
+	if (strcmp(command->arguments[0], "exit") == 0 || strcmp(command->arguments[0], "quit") == 0)
+	{
+		return SHELL_EXIT;
+	}
+
+	command_t copy;
+	status_t error = share_command(&copy, command);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	arena_t arena = {0};
+	expansion_t expansion = { &arena, run_substitution, lookup_variable, environment, &environment->status, environment->wildcards, &environment->pipe_size };
+	error = expand_command(&copy, &expansion);
+	if (error == SUCCESS && copy.argc > 1)
+	{
+		if (environment->verbose)
+		{
+			print_command(&copy);
+			fprintf(stdout, "\n");
+		}
+
+		unsigned short is_builtin;
+		error = execute_builtin(environment, &copy, &is_builtin);
+		if (!is_builtin)
+		{
+			error = execute_external(environment, &copy);
+		}
+		else
+		{
+			environment->status = error != SUCCESS;
+		}
+	}
+
+	free_linked_list(copy.pipe);
+	free_branches(&copy);
+	arena_free(&arena);
+
+	//a command that fails is reported, and the script carries on as it would after a nonzero status
+	if (error != SUCCESS)
+	{
+		error_message(error);
+		environment->status = environment->status == 0 ? 1 : environment->status;
+		return SUCCESS;
+	}
+
+	return error;
+}
+
+void exit_child(status_t error)
+{
+	error_message(error);
+	fflush(stdout);
+	_exit(1);
+}
+
+ssize_t read_continuation_line(void *context, char **line, size_t *size)
+{
+	environment_t *environment = context;
+	if (environment->input != NULL)
+	{
+		return getline(line, size, environment->input);
+	}
+
+	return edit_line(environment, "> ", line, size);
+}
+
+char *lookup_variable(void *context, char *name)
+{
+	environment_t *environment = context;
+	return get_variable(environment->variables, name);
+}
+
+void run_substitution(void *context, char *text)
+{
+	environment_t *environment = context;
+
+	//parse_line expects the line as it was read, newline and all
+	size_t length = strlen(text);
+	char *line = malloc(length + 2);
+	if (line == NULL)
+	{
+		_exit(1);
+	}
+	memcpy(line, text, length);
+	strcpy(line + length, "\n");
+
+	//the output is captured, so it is not also copied to any script
+	environment->script_log = NULL;
+	if (is_compound(line))
+	{
+		//there are no more lines to read, so the script must be whole
+		script_node_t *script = NULL;
+		status_t error = script_incomplete(line) ? FORMAT_ERROR : compile_script(line, &script);
+		if (error == SUCCESS)
+		{
+			interpreter_t interpreter = { run_statement, { NULL, run_substitution, lookup_variable, environment, &environment->status, environment->wildcards, &environment->pipe_size }, environment->variables };
+			error = run_script(script, &interpreter);
+		}
+
+		if (error != SUCCESS && error != SHELL_EXIT)
+		{
+			error_message(error);
+			environment->status = environment->status == 0 ? 1 : environment->status;
+		}
+		fflush(stdout);
+		_exit(environment->status);
+	}
+
+	command_t command = {0};
+	status_t error = parse_line(line, length + 1, &command);
+	if (error == LINE_EMPTY)
+	{
+		_exit(0);
+	}
+
+	arena_t arena = {0};
+	if (error == SUCCESS)
+	{
+		expansion_t expansion = { &arena, run_substitution, lookup_variable, environment, &environment->status, environment->wildcards, &environment->pipe_size };
+		error = expand_command(&command, &expansion);
+	}
+	if (error == SUCCESS && command.argc <= 1)
+	{
+		_exit(environment->status);
+	}
+
+	if (error == SUCCESS)
+	{
+		unsigned short is_builtin;
+		error = execute_builtin(environment, &command, &is_builtin);
+		if (!is_builtin)
+		{
+			//a forked stage that could not exec comes back here too, and exits like the others
+			error = execute_external(environment, &command);
+		}
+		else
+		{
+			environment->status = error != SUCCESS;
+		}
+	}
+
+	if (error != SUCCESS)
+	{
+		error_message(error);
+		environment->status = environment->status == 0 ? 1 : environment->status;
+	}
+	fflush(stdout);
+	_exit(environment->status);
+}
+
+status_t execute_builtin(environment_t *environment, command_t *command, unsigned short *is_builtin)
+{
+	//assume command is a builtin; if function makes it to end, then reset it
+	*is_builtin = 1;
+
+	if (strcmp(command->arguments[0], "history") == 0)
+	{
+		print_history(environment->history);
+		return SUCCESS;
+	}
+
+	if (command->arguments[0][0] == '!')
+	{
+		return history_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[0], "cd") == 0)
+	{
+		return cd_command(command);
+	}
+
+	if (strcmp(command->arguments[0], "alias") == 0)
+	{
+		return alias_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[0], "complete") == 0)
+	{
+		return complete_command(environment, command);
+	}
+
+	alias_t *alias;
+	//if the command is an alias, then execute it now
+	if ((alias =  find_alias(environment->aliases, command->arguments[0])) != NULL)
+	{
+		return alias_execute_command(environment, command, alias->command);
+	}
+
+	if (strcmp(command->arguments[0], "script") == 0)
+	{
+		return script_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[0], "endscript") == 0)
+	{
+		return endscript_command(environment);
+	}
+
+	if (strcmp(command->arguments[0], "scriptcat") == 0)
+	{
+		return scriptcat_command(command);
+	}
+
+	if (strcmp(command->arguments[0], "set") == 0)
+	{
+		return set_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[0], "export") == 0)
+	{
+		return export_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[0], "unset") == 0)
+	{
+		return unset_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[0], JOBS_COMMAND) == 0)
+	{
+		return jobs_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[0], WAIT_COMMAND) == 0)
+	{
+		return wait_command(environment, command);
+	}
+
+	//if made it to here, command is not a builtin
+	*is_builtin = 0;
+	return SUCCESS;
+}
+
+status_t execute_external(environment_t *environment, command_t *command)
+{
+	//cache is a prefix, so it ends up here like a command, and the status of what it runs is kept
+	if (strcmp(command->arguments[0], CACHE_COMMAND) == 0)
+	{
+		return cache_command(environment, command);
+	}
+
+	//a trivial builtin on its own needs no fork; output copied to a script goes through the tee
+	//engine's pipe, which only a child has, so that still forks
+	if (environment->coreutils && command->pipe == NULL && command->fanout == NULL && !command->background && environment->script_log == NULL && is_coreutil(command->arguments[0]))
+	{
+		return execute_in_process(environment, command);
+	}
+
+	//the child searches the index, so it must not be forked while the index is still being built
+	wait_exec_index(environment->exec_index);
+
+	unsigned short launched = 0;
+	status_t launch_error = zygote_execute(environment, command, &launched);
+	if (launched)
+	{
+		return launch_error;
+	}
+
+	//while a script is running, the command's output goes through a pipe to the tee engine, which
+	//copies it to both the terminal and the script log
+	int tee_fds[2];
+	tee_job_t *job = NULL;
+	if (environment->script_log != NULL)
+	{
+		status_t error = tee_command(environment->tee, environment->script_log, command, tee_fds, &job);
+		if (error != SUCCESS)
+		{
+			return error;
+		}
+	}
+
+	//a background job's stdout and stderr go to a pipe of its own, which a thread drains into a
+	//bounded ring kept for jobs -o and wait -o; with a script open, they go to the script as before
+	job_output_t *output = NULL;
+	int job_pipe = -1;
+	if (command->background && job == NULL)
+	{
+		status_t error = create_job_output(&output, environment->jobs->limit, environment->pipe_size, &job_pipe);
+		if (error != SUCCESS)
+		{
+			return error;
+		}
+	}
+
+	//anything still buffered would otherwise be written by the child as well
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		if (job != NULL)
+		{
+			close(tee_fds[0]);
+			close(tee_fds[1]);
+			wait_tee_job(environment->tee, job);
+		}
+		if (output != NULL)
+		{
+			close(job_pipe);
+			release_job_output(output);
+		}
+		add_to_history(environment->history, command);
+		return FORK_ERROR;
+	}
+	
+	if (pid == 0)
+	{
+		FILE *verbose_out = stdout;
+		if (job != NULL)
+		{
+			//don't write verbose output to the script file - write to actual stdout still
+			if ((verbose_out = fdopen(dup(STDOUT_FILENO), "w")) == NULL)
+			{
+				exit_child(DUP_ERROR);
+			}
+
+			if (dup2(tee_fds[0], STDOUT_FILENO) < 0 || dup2(tee_fds[1], STDERR_FILENO) < 0)
+			{
+				fclose(verbose_out);
+				exit_child(DUP2_ERROR);
+			}
+			close(tee_fds[0]);
+			close(tee_fds[1]);
+		}
+
+		//the pipe is close on exec, so only the copies on stdout and stderr reach the command; any
+		//redirections it has are applied after, and take precedence
+		if (output != NULL && (dup2(job_pipe, STDOUT_FILENO) < 0 || dup2(job_pipe, STDERR_FILENO) < 0))
+		{
+			exit_child(DUP2_ERROR);
+		}
+
+		//rewriting the pipeline in the child leaves the command the parent keeps (and records in the
+		//history and the script) as it was typed
+		if (environment->optimize)
+		{
+			command_t *optimized = optimize_pipeline(command);
+			if (environment->verbose)
+			{
+				string_t plan;
+				string_initialize(&plan);
+				command_to_string(optimized, &plan);
+				fprintf(verbose_out, "Optimized plan: %s\n", string_c_str(&plan));
+				fflush(verbose_out);
+				string_uninitialize(&plan);
+			}
+			command = optimized;
+		}
+
+		exit_child(child_execute(environment, command, verbose_out));
+	}
+	
+	//parent case - child process will either be replaced or will return (in the case of an error),
+	//so will never reach here
+	if (job != NULL)
+	{
+		close(tee_fds[0]);
+		close(tee_fds[1]);
+	}
+	//the thread sees the end of the pipe once the job, and whatever it started, has closed it
+	if (output != NULL)
+	{
+		close(job_pipe);
+	}
+
+	status_t error = add_to_history(environment->history, command);
+	//if it's now a background command, then don't wait for it
+	if (!command->background)
+	{
+		int status;
+		waitpid(pid, &status, 0);
+		environment->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+		if (job != NULL)
+		{
+			wait_tee_job(environment->tee, job);
+		}
+	}
+	else if (job != NULL)
+	{
+		detach_tee_job(environment->tee, job);
+	}
+	else
+	{
+		size_t number;
+		status_t job_error = add_job(environment->jobs, pid, output, command, &number);
+		if (job_error == SUCCESS)
+		{
+			printf("[%zu] %d\n", number, pid);
+		}
+		error = error == SUCCESS ? job_error : error;
+	}
+
+	return error;
+}
+
+status_t execute_in_process(environment_t *environment, command_t *command)
+{
+	//the shell's own descriptors are put back once the command is done
+	int saved[3];
+	int fd;
+	for (fd = 0; fd < 3; fd++)
+	{
+		saved[fd] = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+	}
+
+	//stdout must be empty before it is pointed anywhere else
+	fflush(stdout);
+	status_t error = apply_redirections(command);
+	if (error == SUCCESS)
+	{
+		environment->status = run_coreutil(command->arguments);
+	}
+	fflush(stdout);
+	fflush(stderr);
+
+	for (fd = 0; fd < 3; fd++)
+	{
+		if (saved[fd] >= 0)
+		{
+			dup2(saved[fd], fd);
+			close(saved[fd]);
+		}
+	}
+
+	//a redirection that fails here is not a child failing to exec, so the shell carries on
+	if (error != SUCCESS)
+	{
+		error_message(error);
+		environment->status = 1;
+	}
+
+	return add_to_history(environment->history, command);
+}
+
+status_t cache_command(environment_t *environment, command_t *command)
+{
+	//one for "cache", one for "stats", one for NULL pointer
+	if (command->argc == 3 && strcmp(command->arguments[1], CACHE_STATS) == 0)
+	{
+		environment->status = 0;
+		return print_cache_stats(environment->cache);
+	}
+
+	//the declared inputs come first, each after a -i, then the command
+	size_t first = 1;
+	while (first + 2 < command->argc - 1 && strcmp(command->arguments[first], CACHE_INPUT) == 0)
+	{
+		first += 2;
+	}
+	if (first >= command->argc - 1 || strcmp(command->arguments[first], CACHE_INPUT) == 0)
+	{
+		return ARGS_ERROR;
+	}
+
+	command_t inner = *command;
+	inner.arguments += first;
+	inner.argc -= first;
+	if (!is_cacheable(environment, &inner))
+	{
+		return execute_external(environment, &inner);
+	}
+
+	string_t key;
+	string_initialize(&key);
+	cache_record_t record;
+	unsigned short hit = 0;
+	status_t error = make_cache_key(&inner, command->arguments + 1, first - 1, &key);
+	if (error == SUCCESS)
+	{
+		error = find_cached(environment->cache, &key, &record, &hit);
+	}
+	if (error != SUCCESS || hit)
+	{
+		if (hit)
+		{
+			fflush(stdout);
+			error = replay_cached(environment->cache, &record, STDOUT_FILENO, STDERR_FILENO);
+			environment->status = record.status;
+			error = error == SUCCESS ? add_to_history(environment->history, &inner) : error;
+		}
+		string_uninitialize(&key);
+		return error;
+	}
+
+	//a miss: the command runs with its stdout and stderr in memory, as a child would see any file
+	int captured[2] = { memfd_create("cache_stdout", MFD_CLOEXEC), memfd_create("cache_stderr", MFD_CLOEXEC) };
+	int saved[2] = { fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10), fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 10) };
+	int fd;
+	fflush(stdout);
+	fflush(stderr);
+	for (fd = 0; fd < 2; fd++)
+	{
+		if (captured[fd] < 0 || saved[fd] < 0 || dup2(captured[fd], STDOUT_FILENO + fd) < 0)
+		{
+			error = DUP_ERROR;
+		}
+	}
+
+	if (error == SUCCESS)
+	{
+		error = execute_external(environment, &inner);
+		fflush(stdout);
+		fflush(stderr);
+	}
+
+	for (fd = 0; fd < 2; fd++)
+	{
+		if (saved[fd] >= 0)
+		{
+			dup2(saved[fd], STDOUT_FILENO + fd);
+			close(saved[fd]);
+		}
+	}
+
+	//what the command wrote is shown as it would have been, then kept
+	if (error == SUCCESS)
+	{
+		copy_cached(captured[0], STDOUT_FILENO);
+		copy_cached(captured[1], STDERR_FILENO);
+		error = store_cached(environment->cache, &key, environment->status, captured[0], captured[1]);
+	}
+
+	for (fd = 0; fd < 2; fd++)
+	{
+		if (captured[fd] >= 0)
+		{
+			close(captured[fd]);
+		}
+	}
+	string_uninitialize(&key);
+	return error;
+}
+
+int is_cacheable(environment_t *environment, command_t *command)
+{
+	if (command->background || command->fanout != NULL || environment->script_log != NULL)
+	{
+		return 0;
+	}
+
+	command_t *stage;
+	for (stage = command; stage != NULL; stage = stage->pipe)
+	{
+		if (stage->output != NULL || stage->error != NULL || stage->error_to_output || stage->here_string != NULL || stage->here_delimiter != NULL)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+status_t zygote_execute(environment_t *environment, command_t *command, unsigned short *launched)
+{
+	*launched = 0;
+	if (environment->zygote->socket < 0 || command->fanout != NULL || command->background || environment->script_log != NULL || environment->meter || environment->optimize)
+	{
+		return SUCCESS;
+	}
+
+	//builtins run in the child, without an exec, so only pipelines of programs go to the zygote
+	launch_t stages[ZYGOTE_MAX_STAGES];
+	size_t count = 0;
+	command_t *stage;
+	for (stage = command; stage != NULL; stage = stage->pipe, count++)
+	{
+		if (count == ZYGOTE_MAX_STAGES || is_filter(stage->arguments[0]) || (environment->coreutils && is_coreutil(stage->arguments[0])) || (stages[count].path = find_program(environment, stage->arguments[0])) == NULL)
+		{
+			while (count > 0)
+			{
+				free(stages[--count].path);
+			}
+			return SUCCESS;
+		}
+		stages[count].arguments = stage->arguments;
+		stages[count].fds[0] = stages[count].fds[1] = stages[count].fds[2] = -1;
+		if (environment->verbose)
+		{
+			fprintf(stdout, "Launching %s through the zygote\n", stages[count].path);
+		}
+	}
+
+	//each stage's descriptors are set up on the shell's own, as the child would set up its own, and
+	//copied off; the shell's are put back once they all have been
+	int saved[3];
+	int fd;
+	for (fd = 0; fd < 3; fd++)
+	{
+		saved[fd] = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+	}
+
+	fflush(stdout);
+	status_t error = SUCCESS;
+	int upstream = -1;
+	size_t i = 0;
+	for (stage = command; error == SUCCESS && stage != NULL; stage = stage->pipe, i++)
+	{
+		for (fd = 0; fd < 3; fd++)
+		{
+			dup2(saved[fd], fd);
+		}
+
+		int downstream[2] = { -1, -1 };
+		if (stage->pipe != NULL && make_pipe(downstream, O_CLOEXEC, environment->pipe_size) < 0)
+		{
+			error = PIPE_ERROR;
+			break;
+		}
+
+		if (upstream >= 0)
+		{
+			dup2(upstream, STDIN_FILENO);
+			close(upstream);
+		}
+		if (downstream[1] >= 0)
+		{
+			dup2(downstream[1], STDOUT_FILENO);
+			close(downstream[1]);
+		}
+		upstream = downstream[0];
+
+		error = apply_redirections(stage);
+		for (fd = 0; error == SUCCESS && fd < 3; fd++)
+		{
+			if ((stages[i].fds[fd] = fcntl(fd, F_DUPFD_CLOEXEC, 10)) < 0)
+			{
+				error = DUP_ERROR;
+			}
+		}
+	}
+
+	if (upstream >= 0)
+	{
+		close(upstream);
+	}
+	for (fd = 0; fd < 3; fd++)
+	{
+		if (saved[fd] >= 0)
+		{
+			dup2(saved[fd], fd);
+			close(saved[fd]);
+		}
+	}
+
+	int wait_status = 0;
+	status_t launch_error = SUCCESS;
+	if (error == SUCCESS)
+	{
+		char *no_variables[] = { NULL };
+		char **envp = environment->variables->envp != NULL ? environment->variables->envp : no_variables;
+		launch_error = zygote_launch(environment->zygote, stages, count, envp, &wait_status);
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		for (fd = 0; fd < 3; fd++)
+		{
+			if (error != SUCCESS && stages[i].fds[fd] >= 0)
+			{
+				close(stages[i].fds[fd]);
+			}
+		}
+		free(stages[i].path);
+	}
+
+	//nothing was launched, so the command is forked as usual; a zygote that cannot be reached is
+	//gone for good
+	if (launch_error == OPEN_ERROR || launch_error == MEMORY_ERROR || launch_error == PIPE_ERROR)
+	{
+		if (launch_error == PIPE_ERROR)
+		{
+			stop_zygote(environment->zygote);
+		}
+		return SUCCESS;
+	}
+
+	*launched = 1;
+	if (launch_error == READ_ERROR)
+	{
+		stop_zygote(environment->zygote);
+	}
+
+	//as with a builtin run in the shell, a stage that could not be set up is not a child failing to
+	//exec, so the shell carries on
+	error = error != SUCCESS ? error : launch_error;
+	if (error != SUCCESS)
+	{
+		error_message(error == CHILD_FORK_ERR ? FORK_ERROR : error);
+		environment->status = 1;
+	}
+	else
+	{
+		environment->status = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : 128 + WTERMSIG(wait_status);
+	}
+
+	return add_to_history(environment->history, command);
+}
+
+char *find_program(environment_t *environment, const char *name)
+{
+	char path[PATH_MAX];
+	if (strchr(name, '/') != NULL)
+	{
+		return is_program(name) ? strdup(name) : NULL;
+	}
+
+	ssize_t dir = find_executable(environment->exec_index, (char *) name);
+	if (dir >= 0)
+	{
+		snprintf(path, sizeof path, "%s%s", string_c_str(environment->path->dirs + dir), name);
+		if (is_program(path))
+		{
+			return strdup(path);
+		}
+	}
+
+	size_t i;
+	for (i = 0; i < environment->path->num_dirs; i++)
+	{
+		snprintf(path, sizeof path, "%s%s", string_c_str(environment->path->dirs + i), name);
+		if (is_program(path))
+		{
+			return strdup(path);
+		}
+	}
+
+	return NULL;
+}
+
+int is_program(const char *path)
+{
+	struct stat info;
+	return access(path, X_OK) == 0 && stat(path, &info) == 0 && S_ISREG(info.st_mode);
+}
+
+status_t child_execute(environment_t *environment, command_t *command, FILE *verbose_out)
+{
+	if ((environment->verbose || environment->meter) && verbose_out == stdout)
+	{
+		//keep verbose output and meter reports out of any pipe or file stdout is about to be pointed at
+		FILE *terminal = fdopen(dup(STDOUT_FILENO), "w");
+		verbose_out = terminal != NULL ? terminal : verbose_out;
+	}
+
+	if (command->fanout != NULL)
+	{
+		return fanout_execute(environment, command, verbose_out);
+	}
+
+	//this process runs the last stage, so that the shell, which waits for it, waits for the whole
+	//pipeline; the stages before it are forked off first, each doing the same with what is left
+	command_t *previous = NULL;
+	command_t *last = command;
+	while (last->pipe != NULL)
+	{
+		previous = last;
+		last = last->pipe;
+	}
+
+	//a run of built in filters at the end of the pipeline is one stage, run in this process as
+	//threads that hand blocks to one another rather than through pipes
+	command_t *filters_end = last;
+	if (is_filter(last->arguments[0]))
+	{
+		previous = NULL;
+		last = command;
+		command_t *stage;
+		for (stage = command; stage->pipe != NULL; stage = stage->pipe)
+		{
+			if (!is_filter(stage->arguments[0]))
+			{
+				previous = stage;
+				last = stage->pipe;
+			}
+		}
+	}
+
+	if (previous != NULL)
+	{
+		int upstream[2];
+		if (make_pipe(upstream, 0, environment->pipe_size) < 0)
+		{
+			return PIPE_ERROR;
+		}
+
+		//in meter mode, a relay sits between the two stages, with a pipe on either side of it
+		int downstream[2] = { upstream[0], -1 };
+		if (environment->meter)
+		{
+			if (make_pipe(downstream, 0, environment->pipe_size) < 0)
+			{
+				close(upstream[0]);
+				close(upstream[1]);
+				return PIPE_ERROR;
+			}
+
+			pid_t relay_pid = fork();
+			if (relay_pid < 0)
+			{
+				close(upstream[0]);
+				close(upstream[1]);
+				close(downstream[0]);
+				close(downstream[1]);
+				return CHILD_FORK_ERR;
+			}
+
+			if (relay_pid == 0)
+			{
+				close(upstream[1]);
+				close(downstream[0]);
+				run_meter(upstream[0], downstream[1], previous->arguments[0], last->arguments[0], fileno(verbose_out), environment->verbose);
+				_exit(0);
+			}
+
+			close(upstream[0]);
+		}
+
+		pid_t child_fork_pid = fork();
+		if (child_fork_pid < 0)
+		{
+			close(upstream[1]);
+			close(downstream[0]);
+			if (downstream[1] >= 0)
+			{
+				close(downstream[1]);
+			}
+			return CHILD_FORK_ERR;
+		}
+
+		if (child_fork_pid == 0)
+		{
+			close(downstream[0]);
+			if (downstream[1] >= 0)
+			{
+				close(downstream[1]);
+			}
+			dup2(upstream[1], STDOUT_FILENO);
+			close(upstream[1]);
+
+			//this copy of the pipeline ends at the previous stage
+			previous->pipe = NULL;
+			return child_execute(environment, command, verbose_out);
+		}
+
+		close(upstream[1]);
+		if (downstream[1] >= 0)
+		{
+			close(downstream[1]);
+		}
+		dup2(downstream[0], STDIN_FILENO);
+		close(downstream[0]);
+		command = last;
+	}
+
+	status_t error = apply_redirections(command);
+	if (error == SUCCESS && filters_end != command)
+	{
+		error = apply_redirections(filters_end);
+	}
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	if (is_filter(command->arguments[0]))
+	{
+		_exit(filter_execute(command));
+	}
+
+	//a trivial builtin runs in this child as it is, without an exec
+	if (environment->coreutils && is_coreutil(command->arguments[0]))
+	{
+		int status = run_coreutil(command->arguments);
+		fflush(stdout);
+		_exit(status);
+	}
+
+	//the table keeps envp up to date as variables change, so it is passed as it is
+	char *no_variables[] = { NULL };
+	char **envp = environment->variables->envp != NULL ? environment->variables->envp : no_variables;
+
+	//have child execute the desired program
+	//follow execvp rules - if the command contains a slash, try that full path by itself first
+	if (strchr(command->arguments[0], '/') != NULL)
+	{
+		if (environment->verbose)
+		{
+			fprintf(verbose_out, "Trying to execute at path %s\n", command->arguments[0]);
+		}
+
+		execve(command->arguments[0], command->arguments, envp);
+	}
+
+	//otherwise, the index knows which directory should hold the command, so try that one first
+	ssize_t dir = find_executable(environment->exec_index, command->arguments[0]);
+	if (dir >= 0)
+	{
+		string_concatenate_char_array(environment->path->dirs + dir, command->arguments[0]);
+		char *c_str = string_c_str(environment->path->dirs + dir);
+		if (environment->verbose)
+		{
+			fprintf(verbose_out, "Trying to execute at path %s\n", c_str);
+		}
+		execve(c_str, command->arguments, envp);
+		environment->path->dirs[dir].elements -= strlen(command->arguments[0]);
+	}
+
+	//if that does not work, then try appending the command to all of the directories in the
+	//path, in order, and then try to execute
+	size_t i;
+	for (i = 0; i < environment->path->num_dirs; i++)
+	{
+		string_concatenate_char_array(environment->path->dirs + i, command->arguments[0]);
+		char *c_str = string_c_str(environment->path->dirs + i);
+		if (environment->verbose)
+		{
+			fprintf(verbose_out, "Trying to execute at path %s\n", c_str);
+		}
+		execve(c_str, command->arguments, envp);
+	}
+
+	if (verbose_out != stdout)
+	{
+		fclose(verbose_out);
+	}
+
+	return EXEC_ERROR;
+}
+
+int filter_execute(command_t *command)
+{
+	size_t count = 0;
+	command_t *stage;
+	for (stage = command; stage != NULL; stage = stage->pipe)
+	{
+		count++;
+	}
+
+	filter_t *filters = malloc(count * sizeof *filters);
+	if (filters == NULL)
+	{
+		error_message(MEMORY_ERROR);
+		return 2;
+	}
+
+	size_t i = 0;
+	for (stage = command; stage != NULL; stage = stage->pipe)
+	{
+		status_t error = parse_filter(stage->arguments, filters + i++);
+		if (error != SUCCESS)
+		{
+			error_message(error);
+			free(filters);
+			return 2;
+		}
+	}
+
+	int status = run_filters(filters, count, STDIN_FILENO, STDOUT_FILENO);
+	free(filters);
+	return status;
+}
+
+status_t fanout_execute(environment_t *environment, command_t *command, FILE *verbose_out)
+{
+	size_t num_branches = 0;
+	command_t *branch;
+	for (branch = command->fanout; branch != NULL; branch = branch->next_branch)
+	{
+		num_branches++;
+	}
+
+	int *branch_fds = malloc(num_branches * sizeof *branch_fds);
+	pid_t *pids = malloc((num_branches + 1) * sizeof *pids);
+	if (branch_fds == NULL || pids == NULL)
+	{
+		free(branch_fds);
+		free(pids);
+		//the child must give up on the command, which only happens for the errors it exits on
+		return CHILD_FORK_ERR;
+	}
+
+	int source[2];
+	if (make_pipe(source, O_CLOEXEC, environment->pipe_size) < 0)
+	{
+		free(branch_fds);
+		free(pids);
+		return PIPE_ERROR;
+	}
+
+	//each branch gets a pipe of its own; the ones already made must not leak into the ones after
+	size_t started = 0;
+	for (branch = command->fanout; branch != NULL; branch = branch->next_branch)
+	{
+		int fds[2] = { -1, -1 };
+		if (make_pipe(fds, O_CLOEXEC, environment->pipe_size) < 0 || (pids[started] = fork()) < 0)
+		{
+			//the branches already started see end of file and finish on their own
+			if (fds[0] >= 0)
+			{
+				close(fds[0]);
+				close(fds[1]);
+			}
+			while (started > 0)
+			{
+				close(branch_fds[--started]);
+			}
+			close(source[0]);
+			close(source[1]);
+			free(branch_fds);
+			free(pids);
+			return CHILD_FORK_ERR;
+		}
+
+		if (pids[started] == 0)
+		{
+			while (started > 0)
+			{
+				close(branch_fds[--started]);
+			}
+			close(source[0]);
+			close(source[1]);
+			close(fds[1]);
+			dup2(fds[0], STDIN_FILENO);
+			close(fds[0]);
+			free(branch_fds);
+			free(pids);
+			return child_execute(environment, branch, verbose_out);
+		}
+
+		close(fds[0]);
+		branch_fds[started++] = fds[1];
+	}
+
+	pids[num_branches] = fork();
+	if (pids[num_branches] == 0)
+	{
+		while (started > 0)
+		{
+			close(branch_fds[--started]);
+		}
+		close(source[0]);
+		dup2(source[1], STDOUT_FILENO);
+		close(source[1]);
+		free(branch_fds);
+		free(pids);
+
+		//this copy of the command is only the producer
+		command->fanout = NULL;
+		return child_execute(environment, command, verbose_out);
+	}
+
+	//with no producer, closing the write end still gives the branches end of file
+	close(source[1]);
+	distribute(source[0], branch_fds, num_branches);
+
+	size_t i;
+	for (i = 0; i <= num_branches; i++)
+	{
+		if (pids[i] > 0)
+		{
+			int status;
+			waitpid(pids[i], &status, 0);
+		}
+	}
+
+	_exit(0);
+}
+
+status_t apply_redirections(command_t *command)
+{
+	//stderr is pointed at stdout before stdout itself moves, for a 2>&1 that came before the >
+	if (command->error_to_output == ERROR_TO_ORIGINAL && dup2(STDOUT_FILENO, STDERR_FILENO) < 0)
+	{
+		return DUP2_ERROR;
+	}
+
+	off_t expected_size = 0;
+	if (command->input != NULL)
+	{
+		int fd = redirect(command->input, O_RDONLY | O_CLOEXEC, STDIN_FILENO);
+		if (fd < 0)
+		{
+			return REDIRECT_ERROR;
+		}
+
+		struct stat info;
+		if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+		{
+			expected_size = info.st_size;
+		}
+	}
+	else if (command->here_string != NULL)
+	{
+		int fd = make_here_string(command->here_string);
+		if (fd < 0 || dup2(fd, STDIN_FILENO) < 0)
+		{
+			return REDIRECT_ERROR;
+		}
+		close(fd);
+	}
+	else if (command->here_delimiter != NULL)
+	{
+		//reopening the memfd gives this command an offset of its own, which matters when the same
+		//document (kept in the history) is being read by a background command too
+		char name[PATH_MAX];
+		if (command->here_document < 0)
+		{
+			strcpy(name, "/dev/null");
+		}
+		else
+		{
+			snprintf(name, sizeof name, "/proc/self/fd/%d", command->here_document);
+		}
+
+		if (redirect(name, O_RDONLY | O_CLOEXEC, STDIN_FILENO) < 0)
+		{
+			if (command->here_document < 0 || lseek(command->here_document, 0, SEEK_SET) < 0 || dup2(command->here_document, STDIN_FILENO) < 0)
+			{
+				return REDIRECT_ERROR;
+			}
+		}
+	}
+
+	if (command->output != NULL)
+	{
+		int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (command->append ? O_APPEND : O_TRUNC);
+		int fd = redirect(command->output, flags, STDOUT_FILENO);
+		if (fd < 0)
+		{
+			return REDIRECT_ERROR;
+		}
+
+		//FALLOC_FL_KEEP_SIZE reserves the blocks without the file appearing any longer than what has
+		//actually been written, so it does no harm if the guess is wrong
+		if (!command->append && expected_size >= REDIRECT_PREALLOCATE_MIN)
+		{
+			fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, expected_size);
+		}
+	}
+
+	if (command->error != NULL && redirect(command->error, O_WRONLY | O_CREAT | O_CLOEXEC | (command->error_append ? O_APPEND : O_TRUNC), STDERR_FILENO) < 0)
+	{
+		return REDIRECT_ERROR;
+	}
+
+	if (command->error_to_output == ERROR_TO_OUTPUT && dup2(STDOUT_FILENO, STDERR_FILENO) < 0)
+	{
+		return DUP2_ERROR;
+	}
+
+	return SUCCESS;
+}
+
+int redirect(char *name, int flags, int target)
+{
+	int fd = open(name, flags, 0666);
+	if (fd < 0 || fd == target)
+	{
+		//target was closed, so the file landed on it directly; it still has O_CLOEXEC, though
+		if (fd == target)
+		{
+			fcntl(fd, F_SETFD, 0);
+		}
+		return fd;
+	}
+
+	//dup2 does not carry O_CLOEXEC over to the new descriptor, so the original can be left to close
+	//itself at exec, but it is closed now to keep the child's table tidy
+	int result = dup2(fd, target);
+	close(fd);
+	return result;
+}
+
+status_t history_command(environment_t *environment, command_t *command)
+{
+	history_t *history = environment->history;
+	if (command->arguments[0][1] == '!')
+	{
+		if (history->num_commands >= 1)
+		{
+			command_t *old_command = &history->commands[(history->num_commands - 1) % history->length];
+			print_command(old_command);
+			fprintf(stdout, "\n");
+			return execute_external(environment, old_command);
+		}
+		else
+		{
+			return NO_COMMANDS;
+		}
+	}
+	else
+	{
+		size_t number;
+		status_t error = convert(command->arguments[0] + 1, &number);
+		if (error != SUCCESS)
+		{
+			return error;
+		}
+	
+		ssize_t min_number = (ssize_t) history->num_commands - (ssize_t) history->length + 1;
+		if ((number > history->num_commands) || (ssize_t) number < min_number || number == 0)
+		{
+			return NO_EXIST_ERROR;
+		}
+
+		size_t index = (number - 1) % history->length;
+		command_t *old_command = &history->commands[index];
+		print_command(old_command);
+		fprintf(stdout, "\n");
+		return execute_external(environment, old_command);
+	}
+}
+
+status_t cd_command(command_t *command)
+{
+	//one for "cd", one for the directory, one for the NULL pointer
+	if (command->argc < 3)
+	{
+		return ARGS_ERROR;
+	}
+
+	if (chdir(command->arguments[1]) < 0)
+	{
+		return CD_ERROR;
+	}
+
+	return SUCCESS;
+}
+
+status_t alias_command(environment_t *environment, command_t *command)
+{
+	//one for "alias", one for NULL pointer
+	if (command->argc == 2)
+	{
+		//print all the aliases
+		print_aliases(environment->aliases);
+		return SUCCESS;
+	}
+	
+	//one for "alias", one for the new name, one for the command, one for the NULL pointer
+	if (command->argc < 4)
+	{
+		return ARGS_ERROR;
+	}
+
+	//don't allow aliases that contain slahses - these will muddle with the search of the path
+	//variable
+	if (strchr(command->arguments[1], '/') != NULL)
+	{
+		return FORMAT_ERROR;
+	}
+
+	unsigned short is_new = find_alias(environment->aliases, command->arguments[1]) == NULL;
+	status_t error = add_alias(environment->aliases, command->arguments[1], command->arguments[2], command->argc > 4);
+	if (error == SUCCESS && is_new)
+	{
+		error = add_completion(environment->completion, command->arguments[1]);
+	}
+
+	return error;
+}
+
+status_t complete_command(environment_t *environment, command_t *command)
+{
+	//one for "complete", one for NULL pointer; with no prefix, everything is listed
+	char *prefix = command->argc > 2 ? command->arguments[1] : "";
+	size_t num;
+	char **names = find_completions(environment->completion, prefix, &num);
+	size_t i;
+	for (i = 0; i < num; i++)
+	{
+		fprintf(stdout, "%s\n", names[i]);
+		free(names[i]);
+	}
+	free(names);
+
+	return SUCCESS;
+}
+
+status_t alias_execute_command(environment_t *environment, command_t *original, command_t *alias)
+{
+	unsigned short redirected = original->input != NULL || original->here_string != NULL || original->here_delimiter != NULL || original->output != NULL || original->error != NULL || original->error_to_output;
+
+	//one for alias command and one for NULL pointer
+	if (original->argc == 2 && !original->background && !redirected)
+	{
+		return execute_external(environment, alias);
+	}
+
+	//the output of a piped alias comes from a stage the expansion below does not copy, so it cannot
+	//be redirected
+	if (alias->pipe != NULL && (original->output != NULL || original->error != NULL || original->error_to_output))
+	{
+		return FORMAT_ERROR;
+	}
+
+	command_t expanded;
+	expanded = *alias;
+	expanded.argc = original->argc - 2 + alias->argc;
+	expanded.arguments = malloc(expanded.argc * sizeof *expanded.arguments);
+	memcpy(expanded.arguments, alias->arguments, alias->argc * sizeof *alias->arguments);
+	size_t new_index, old_index = 1;
+	for (new_index = alias->argc - 1; new_index < expanded.argc; new_index++)
+	{
+		expanded.arguments[new_index] = original->arguments[old_index];
+		old_index++;
+	}
+
+	if (original->background)
+	{
+		expanded.background = 1;
+	}
+
+	//redirections given with the alias override those in its definition
+	if (original->input != NULL || original->here_string != NULL || original->here_delimiter != NULL)
+	{
+		expanded.input = original->input;
+		expanded.here_string = original->here_string;
+		expanded.here_delimiter = original->here_delimiter;
+		expanded.here_document = original->here_document;
+	}
+	if (original->output != NULL)
+	{
+		expanded.output = original->output;
+		expanded.append = original->append;
+	}
+	if (original->error != NULL || original->error_to_output)
+	{
+		expanded.error = original->error;
+		expanded.error_append = original->error_append;
+		expanded.error_to_output = original->error_to_output;
+	}
+
+	status_t error;/* = setup_pipes(&expanded);
+	if (error != SUCCESS)
+	{
+		return error;
+	}*/
+
+	error = execute_external(environment, &expanded);
+	free(expanded.arguments);
+	//free_linked_list(expanded.pipe);
+	
+	return error;
+}
+
+status_t script_command(environment_t *environment, command_t *command)
+{
+	if (environment->script_log != NULL)
+	{
+		return ALREADY_OPEN;
+	}
+
+	//one for "script", one for filename, one for NULL, and one more for -z
+	unsigned short compress = command->argc > 2 && strcmp(command->arguments[1], "-z") == 0;
+	if (command->argc < 3 + (size_t) compress)
+	{
+		return ARGS_ERROR;
+	}
+
+	//a compressed file must not keep the tail of whatever was there before, or it reads as damage
+	int flags = O_CREAT | O_WRONLY | O_CLOEXEC | (compress ? O_TRUNC : 0);
+	int fd = open(command->arguments[1 + compress], flags, 0600);
+	if (fd < 0)
+	{
+		return OPEN_ERROR;
+	}
+
+	status_t error = start_tee_engine(environment->tee);
+	if (error != SUCCESS)
+	{
+		close(fd);
+		return error;
+	}
+
+	//the log owns fd from here on, and closes it once everything has been written
+	error = create_script_log(&environment->script_log, fd, environment->script_sync, compress);
+	if (error != SUCCESS)
+	{
+		close(fd);
+		environment->script_log = NULL;
+	}
+
+	return error;
+}
+
+status_t endscript_command(environment_t *environment)
+{
+	if (environment->script_log == NULL)
+	{
+		return NOT_OPEN;
+	}
+
+	//background commands may still hold references, in which case the file is closed after them
+	environment->script_log->report = environment->verbose;
+	release_script_log(environment->script_log);
+	environment->script_log = NULL;
+	return SUCCESS;
+}
+
+status_t scriptcat_command(command_t *command)
+{
+	//one for "scriptcat", one for -t if given, one for filename, one for NULL
+	unsigned short timestamps = command->argc >= 4 && strcmp(command->arguments[1], "-t") == 0;
+	if (command->argc - timestamps < 3)
+	{
+		return ARGS_ERROR;
+	}
+
+	int fd = open(command->arguments[1 + timestamps], O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return OPEN_ERROR;
+	}
+
+	fflush(stdout);
+	status_t error = cat_script_log(fd, STDOUT_FILENO, timestamps);
+	close(fd);
+	return error;
+}
+
+status_t set_command(environment_t *environment, command_t *command)
+{
+	//"set" by itself lists the variables
+	if (command->argc == 2)
+	{
+		print_variables(environment->variables, 0);
+		return SUCCESS;
+	}
+
+	//one for "set", one for type, one for NULL pointer
+	if (command->argc < 3)
+	{
+		return ARGS_ERROR;
+	}
+
+	if (strcmp(command->arguments[1], "path") == 0)
+	{
+		status_t error = set_path_command(environment, command);
+		if (error == SUCCESS && environment->verbose)
+		{
+			print_path(environment->path);
+		}
+
+		return error;
+	}
+
+	if (strcmp(command->arguments[1], "verbose") == 0)
+	{
+		return set_verbose_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[1], "prompt") == 0)
+	{
+		return set_prompt_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[1], "pipesize") == 0)
+	{
+		return set_pipesize_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[1], "cachesize") == 0)
+	{
+		return set_cachesize_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[1], "joboutput") == 0)
+	{
+		return set_joboutput_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[1], "jobkeep") == 0)
+	{
+		return set_jobkeep_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[1], "optimize") == 0)
+	{
+		return set_optimize_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[1], "meter") == 0)
+	{
+		return set_meter_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[1], "scriptsync") == 0)
+	{
+		return set_scriptsync_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[1], "builtin-coreutils") == 0)
+	{
+		return set_coreutils_command(environment, command);
+	}
+
+	if (strcmp(command->arguments[1], "zygote") == 0)
+	{
+		return set_zygote_command(environment, command);
+	}
+
+	return set_variable_command(environment, command);
+}
+
+status_t set_variable_command(environment_t *environment, command_t *command)
+{
+	//one for "set", one for the name, one for "=", one for NULL pointer
+	if (!valid_variable_name(command->arguments[1]))
+	{
+		return INVALID_VAR;
+	}
+	if (command->argc < 4 || strcmp(command->arguments[2], "=") != 0)
+	{
+		return FORMAT_ERROR;
+	}
+
+	string_t value;
+	string_initialize(&value);
+	size_t i;
+	for (i = 3; command->arguments[i] != NULL; i++)
+	{
+		if (i > 3)
+		{
+			char_vector_push_back(&value, ' ');
+		}
+		string_concatenate_char_array(&value, command->arguments[i]);
+	}
+
+	status_t error = set_variable(environment->variables, command->arguments[1], string_c_str(&value));
+	string_uninitialize(&value);
+	return error;
+}
+
+status_t export_command(environment_t *environment, command_t *command)
+{
+	if (command->argc == 2)
+	{
+		print_variables(environment->variables, 1);
+		return SUCCESS;
+	}
+
+	size_t i;
+	for (i = 1; command->arguments[i] != NULL; i++)
+	{
+		//the name is cut off at the = in place, since the argument is not needed again
+		char *name = command->arguments[i];
+		char *equals = strchr(name, '=');
+		if (equals != NULL)
+		{
+			*equals = '\0';
+		}
+
+		if (!valid_variable_name(name))
+		{
+			return INVALID_VAR;
+		}
+
+		status_t error = equals != NULL ? set_variable(environment->variables, name, equals + 1) : SUCCESS;
+		if (error == SUCCESS)
+		{
+			error = export_variable(environment->variables, name);
+		}
+		if (error != SUCCESS)
+		{
+			return error;
+		}
+	}
+
+	return SUCCESS;
+}
+
+status_t unset_command(environment_t *environment, command_t *command)
+{
+	//one for "unset", one for a name, one for NULL pointer
+	if (command->argc < 3)
+	{
+		return ARGS_ERROR;
+	}
+
+	size_t i;
+	for (i = 1; command->arguments[i] != NULL; i++)
+	{
+		unset_variable(environment->variables, command->arguments[i]);
+	}
+
+	return SUCCESS;
+}
+
+status_t jobs_command(environment_t *environment, command_t *command)
+{
+	//one for "jobs", one for NULL pointer
+	if (command->argc == 2)
+	{
+		print_jobs(environment->jobs);
+		return SUCCESS;
+	}
+
+	//one for "jobs", one for "-o", one for the number, one for NULL pointer
+	if (command->argc != 4 || strcmp(command->arguments[1], JOBS_OUTPUT) != 0)
+	{
+		return ARGS_ERROR;
+	}
+
+	size_t number;
+	status_t error = convert(command->arguments[2], &number);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	update_jobs(environment->jobs);
+	job_t *job = find_job(environment->jobs, number);
+	if (job == NULL)
+	{
+		return JOB_ERROR;
+	}
+
+	//a job still running may have more to say, so it stays until it finishes and is shown again
+	error = page_job_output(environment, job);
+	if (error == SUCCESS && job->finished)
+	{
+		remove_job(environment->jobs, number);
+	}
+
+	return error;
+}
+
+status_t wait_command(environment_t *environment, command_t *command)
+{
+	unsigned short show = command->argc == 3 && strcmp(command->arguments[1], JOBS_OUTPUT) == 0;
+	if (command->argc != 2 && !show)
+	{
+		return ARGS_ERROR;
+	}
+
+	wait_jobs(environment->jobs);
+	if (!show)
+	{
+		return SUCCESS;
+	}
+
+	job_table_t *jobs = environment->jobs;
+	while (jobs->num_jobs > 0)
+	{
+		job_t *job = jobs->jobs;
+		printf("[%zu] Done (%d)\t%s\n", job->number, job->status, job->command);
+		status_t error = print_job_output(job, STDOUT_FILENO);
+		remove_job(jobs, job->number);
+		if (error != SUCCESS)
+		{
+			return error;
+		}
+	}
+
+	return SUCCESS;
+}
+
+status_t page_job_output(environment_t *environment, job_t *job)
+{
+	char *pager = get_variable(environment->variables, "PAGER");
+	char *path = isatty(STDOUT_FILENO) ? find_program(environment, pager != NULL && pager[0] != '\0' ? pager : JOBS_PAGER) : NULL;
+	if (path == NULL)
+	{
+		return print_job_output(job, STDOUT_FILENO);
+	}
+
+	//the ring is unwrapped into a snapshot, which the pager reads from the start
+	int snapshot = memfd_create(JOBS_PAGER, MFD_CLOEXEC);
+	status_t error = snapshot < 0 ? OPEN_ERROR : print_job_output(job, snapshot);
+	if (error != SUCCESS || lseek(snapshot, 0, SEEK_SET) < 0)
+	{
+		if (snapshot >= 0)
+		{
+			close(snapshot);
+		}
+		free(path);
+		return print_job_output(job, STDOUT_FILENO);
+	}
+
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		close(snapshot);
+		free(path);
+		return print_job_output(job, STDOUT_FILENO);
+	}
+
+	if (pid == 0)
+	{
+		if (dup2(snapshot, STDIN_FILENO) < 0)
+		{
+			_exit(1);
+		}
+
+		char *no_variables[] = { NULL };
+		char **envp = environment->variables->envp != NULL ? environment->variables->envp : no_variables;
+		char *arguments[] = { path, NULL };
+		execve(path, arguments, envp);
+		_exit(1);
+	}
+
+	int status;
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+	close(snapshot);
+	free(path);
+	return SUCCESS;
+}
+
+status_t set_path_command(environment_t *environment, command_t *command)
+{
+	//one for "set", one for "path", one for "=", one+ for path value, one for NULL pointer
+	if (command->argc < 5)
+	{
+		return ARGS_ERROR;
+	}
+
+	//next argument after "path" must be an equals sign
+	if (strcmp(command->arguments[2], "=") != 0)
+	{
+		return FORMAT_ERROR;
+	}
+
+	//next argument must begin with a left parenthesis and must be at least two characters long
+	//additionally, cannot have command of type set path = () (i.e., no empty path)
+	size_t first_length = strlen(command->arguments[3]);
+	if (command->arguments[3][0] != '(' || command->arguments[3][1] == ')' || first_length < 2)
+	{
+		return FORMAT_ERROR;
+	}
+
+	//last argument must end with a parenthesis and must also be at least two characters long
+	size_t last_length = strlen(command->arguments[command->argc - 2]);
+	if (command->arguments[command->argc - 2][last_length - 1] != ')' || last_length < 2)
+	{
+		return FORMAT_ERROR;
+	}
+
+	//an earlier build may still be reading the path's directories, which set_path is about to replace
+	wait_exec_index(environment->exec_index);
+	status_t error = set_path(environment->path, command, environment->verbose);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	return build_exec_index(environment->exec_index, environment->path);
+}
+
+status_t set_verbose_command(environment_t *environment, command_t *command)
+{
+	//one for "set", one for "verbose", one for "on/off", one for NULL pointer
+	if (command->argc < 4)
+	{
+		return ARGS_ERROR;
+	}
+
+	if (strcmp(command->arguments[2], "on") == 0)
+	{
+		environment->verbose = 1;
+		return SUCCESS;
+	}
+
+	if (strcmp(command->arguments[2], "off") == 0)
+	{
+		environment->verbose = 0;
+		return SUCCESS;
+	}
+
+	return FORMAT_ERROR;
+}
+
+status_t set_pipesize_command(environment_t *environment, command_t *command)
+{
+	//one for "set", one for "pipesize", one for the size, one for NULL pointer
+	if (command->argc < 4)
+	{
+		return ARGS_ERROR;
+	}
+
+	size_t size;
+	if (strcmp(command->arguments[2], "auto") == 0)
+	{
+		size = auto_pipe_size();
+	}
+	else
+	{
+		status_t error = convert(command->arguments[2], &size);
+		if (error != SUCCESS)
+		{
+			return error;
+		}
+
+		//F_SETPIPE_SZ takes an int
+		if (size > INT_MAX)
+		{
+			return NUMBER_ERROR;
+		}
+	}
+
+	environment->pipe_size = size;
+	environment->tee->pipe_size = size;
+	if (environment->verbose)
+	{
+		fprintf(stdout, "Pipe size: %zu bytes\n", size);
+	}
+
+	return SUCCESS;
+}
+
+status_t set_cachesize_command(environment_t *environment, command_t *command)
+{
+	//one for "set", one for "cachesize", one for the size, one for NULL pointer
+	if (command->argc < 4)
+	{
+		return ARGS_ERROR;
+	}
+
+	size_t size;
+	status_t error = convert(command->arguments[2], &size);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	environment->cache->limit = size;
+	if (environment->verbose)
+	{
+		fprintf(stdout, "Cache size: %zu bytes\n", size);
+	}
+
+	return SUCCESS;
+}
+
+status_t set_joboutput_command(environment_t *environment, command_t *command)
+{
+	//one for "set", one for "joboutput", one for the size, one for NULL pointer
+	if (command->argc < 4)
+	{
+		return ARGS_ERROR;
+	}
+
+	size_t size;
+	status_t error = convert(command->arguments[2], &size);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	//the ring needs somewhere to put the newest byte
+	if (size == 0)
+	{
+		return FORMAT_ERROR;
+	}
+
+	environment->jobs->limit = size;
+	if (environment->verbose)
+	{
+		fprintf(stdout, "Job output: %zu bytes\n", size);
+	}
+
+	return SUCCESS;
+}
+
+status_t set_jobkeep_command(environment_t *environment, command_t *command)
+{
+	//one for "set", one for "jobkeep", one for the count, one for NULL pointer
+	if (command->argc < 4)
+	{
+		return ARGS_ERROR;
+	}
+
+	size_t keep;
+	status_t error = convert(command->arguments[2], &keep);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	environment->jobs->keep = keep;
+	if (environment->verbose)
+	{
+		fprintf(stdout, "Jobs kept: %zu\n", keep);
+	}
+
+	return SUCCESS;
+}
+
+status_t set_optimize_command(environment_t *environment, command_t *command)
+{
+	//one for "set", one for "optimize", one for "on/off", one for NULL pointer
+	if (command->argc < 4)
+	{
+		return ARGS_ERROR;
+	}
+
+	if (strcmp(command->arguments[2], "on") == 0)
+	{
+		environment->optimize = 1;
+		return SUCCESS;
+	}
+
+	if (strcmp(command->arguments[2], "off") == 0)
+	{
+		environment->optimize = 0;
+		return SUCCESS;
+	}
+
+	return FORMAT_ERROR;
+}
+
+status_t set_meter_command(environment_t *environment, command_t *command)
+{
+	//one for "set", one for "meter", one for "on/off", one for NULL pointer
+	if (command->argc < 4)
+	{
+		return ARGS_ERROR;
+	}
+
+	if (strcmp(command->arguments[2], "on") == 0)
+	{
+		environment->meter = 1;
+		return SUCCESS;
+	}
+
+	if (strcmp(command->arguments[2], "off") == 0)
+	{
+		environment->meter = 0;
+		return SUCCESS;
+	}
+
+	return FORMAT_ERROR;
+}
+
+status_t set_coreutils_command(environment_t *environment, command_t *command)
+{
+	//one for "set", one for "builtin-coreutils", one for "on/off", one for NULL pointer
+	if (command->argc < 4)
+	{
+		return ARGS_ERROR;
+	}
+
+	if (strcmp(command->arguments[2], "on") == 0)
+	{
+		environment->coreutils = 1;
+		return SUCCESS;
+	}
+
+	if (strcmp(command->arguments[2], "off") == 0)
+	{
+		environment->coreutils = 0;
+		return SUCCESS;
+	}
+
+	return FORMAT_ERROR;
+}
+
+status_t set_zygote_command(environment_t *environment, command_t *command)
+{
+	//one for "set", one for "zygote", one for "on/off", one for NULL pointer
+	if (command->argc < 4)
+	{
+		return ARGS_ERROR;
+	}
+
+	if (strcmp(command->arguments[2], "on") == 0)
+	{
+		return start_zygote(environment->zygote);
+	}
+
+	if (strcmp(command->arguments[2], "off") == 0)
+	{
+		stop_zygote(environment->zygote);
+		return SUCCESS;
+	}
+
+	return FORMAT_ERROR;
+}
+
+status_t set_scriptsync_command(environment_t *environment, command_t *command)
+{
+	//one for "set", one for "scriptsync", one for the policy, one for NULL pointer
+	if (command->argc < 4)
+	{
+		return ARGS_ERROR;
+	}
+
+	char *policies[] = { "none", "command", "interval" };
+	unsigned short policy;
+	for (policy = 0; policy < sizeof policies / sizeof *policies; policy++)
+	{
+		if (strcmp(command->arguments[2], policies[policy]) == 0)
+		{
+			break;
+		}
+	}
+
+	if (policy == sizeof policies / sizeof *policies)
+	{
+		return FORMAT_ERROR;
+	}
+
+	environment->script_sync = policy;
+	if (environment->script_log != NULL)
+	{
+		set_script_log_sync(environment->script_log, policy);
+	}
+
+	return SUCCESS;
+}
+
+status_t set_prompt_command(environment_t *environment, command_t *command)
+{
+	//one for "set", one for "prompt", one for prompt, one for NULL pointer
+	if (command->argc < 4)
+	{
+		return ARGS_ERROR;
+	}
+
+	if (command->arguments[2][0] != '"')
+	{
+		return FORMAT_ERROR;
+	}
+	char *prompt_start = command->arguments[2] + 1;
+	size_t prompt_length = strlen(prompt_start);
+	//new prompt must be at least ""
+	//must also end in "
+	if (prompt_length < 1 || prompt_start[prompt_length - 1] != '"')
+	{
+		return FORMAT_ERROR;
+	}
+
+	prompt_length--;
+	prompt_start[prompt_length] = '\0';
+
+	string_assign_from_char_array(environment->prompt, prompt_start);
+
+	return SUCCESS;
+}
+
+status_t convert(char *s, size_t *value)
+{
+	*value = 0;
+	size_t length = strlen(s);
+	size_t power10;
+	size_t i;
+	for (i = length - 1, power10 = 1; i < SIZE_MAX; i--, power10 *= 10)
+	{
+		if (s[i] < ASCII_0 || s[i] > ASCII_9)
+		{
+			return NUMBER_ERROR;
+		}
+		*value += (s[i] - ASCII_0) * power10;
+	}
+
+	return SUCCESS;
+}
@@ -0,0 +1,487 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../include/pipe_size.h"
+#include "../include/substitute.h"
+
+/**
+  * Expands the arguments and redirection targets of a single stage, not following its pipes
+  * @param stage     the stage to be expanded
+  * @param expansion how to expand it
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t expand_stage(command_t *stage, expansion_t *expansion);
+
+/**
+  * Replaces every expansion in a single argument with its value
+  * @param argument  the argument to be expanded
+  * @param expansion how to expand it
+  * @param expanded  out param; the expanded argument, which may be a $(...)'s output itself
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t expand_argument(char *argument, expansion_t *expansion, char **expanded);
+
+/**
+  * Finds the next $ in text that starts an expansion: $(, ${, $?, or $ and a name
+  * @param text the text to be searched
+  * @return the $, or NULL if there is none
+  */
+char *find_expansion(char *text);
+
+/**
+  * Finds the ) that closes a $(, counting any parentheses in between
+  * @param text where to start looking, just after the $(
+  * @return the closing parenthesis, or NULL if there is none
+  */
+char *find_closing_paren(char *text);
+
+/**
+  * Copies part of a string into the arena, nul terminated
+  * @param arena  where the copy is kept
+  * @param text   the start of the part to be copied
+  * @param length the number of characters to copy
+  * @return the copy, or NULL if it could not be allocated
+  */
+char *arena_copy(arena_t *arena, const char *text, size_t length);
+
+/**
+  * Runs one substitution's command and captures its output
+  * @param text      the command line to run
+  * @param expansion how to run it, and where to keep the output
+  * @param length    out param; the length of the output, less any trailing newlines
+  * @return the output, or NULL if it could not be captured
+  */
+char *capture(char *text, expansion_t *expansion, size_t *length);
+
+/**
+  * Appends a word to a growing array of words, or, if it has wildcards and matches any paths, the
+  * paths it matches
+  * @param words     in/out param; the array, reallocated as needed
+  * @param count     in/out param; the number of words in the array
+  * @param capacity  in/out param; the number of words the array has room for
+  * @param word      the word to be appended or globbed
+  * @param expansion where the directory listings are cached and the paths kept
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t push_glob(char ***words, size_t *count, size_t *capacity, char *word, expansion_t *expansion);
+
+/**
+  * Determines whether an argument needs anything done to it: an expansion outside single quotes, or
+  * a wildcard outside any quotes
+  * @param argument  the argument to be checked
+  * @param expansion whether globbing is on at all
+  * @return nonzero if it needs expanding, zero otherwise
+  */
+int needs_expansion(char *argument, expansion_t *expansion);
+
+/**
+  * Appends a word to a growing array of words
+  * @param words    in/out param; the array, reallocated as needed
+  * @param count    in/out param; the number of words in the array
+  * @param capacity in/out param; the number of words the array has room for
+  * @param word     the word to be appended
+  * @return zero if there was no memory for it, nonzero otherwise
+  */
+int push_word(char ***words, size_t *count, size_t *capacity, char *word);
+
+status_t expand_command(command_t *command, expansion_t *expansion)
+{
+	command_t *pipeline = command;
+	command_t *branch = command->fanout;
+	while (pipeline != NULL)
+	{
+		command_t *stage;
+		for (stage = pipeline; stage != NULL; stage = stage->pipe)
+		{
+			status_t error = expand_stage(stage, expansion);
+			if (error != SUCCESS)
+			{
+				return error;
+			}
+
+			//a command made up only of expansions with no value runs nothing, but a stage of a
+			//pipeline cannot just disappear
+			if (stage->argc <= 1 && (stage != command || command->pipe != NULL || command->fanout != NULL))
+			{
+				return FORMAT_ERROR;
+			}
+		}
+
+		pipeline = branch;
+		branch = branch != NULL ? branch->next_branch : NULL;
+	}
+
+	return SUCCESS;
+}
+
+status_t expand_stage(command_t *stage, expansion_t *expansion)
+{
+	//redirection targets are expanded but never split
+	char **targets[] = { &stage->input, &stage->output, &stage->error, &stage->here_string };
+	size_t t;
+	for (t = 0; t < sizeof targets / sizeof *targets; t++)
+	{
+		if (*targets[t] != NULL && find_expansion(*targets[t]) != NULL)
+		{
+			status_t error = expand_argument(*targets[t], expansion, targets[t]);
+			if (error != SUCCESS)
+			{
+				return error;
+			}
+		}
+	}
+
+	//most stages have nothing to expand, and keep their arguments as they are
+	size_t i;
+	for (i = 0; stage->arguments[i] != NULL && !needs_expansion(stage->arguments[i], expansion); i++);
+	if (stage->arguments[i] == NULL)
+	{
+		return SUCCESS;
+	}
+
+	char **words = NULL;
+	size_t count = 0;
+	size_t capacity = 0;
+	for (i = 0; stage->arguments[i] != NULL; i++)
+	{
+		char *argument = stage->arguments[i];
+		if (argument[0] == '\'' || find_expansion(argument) == NULL)
+		{
+			//a quoted argument is never globbed
+			status_t error = MEMORY_ERROR;
+			if (argument[0] == '\'' || argument[0] == '"')
+			{
+				error = push_word(&words, &count, &capacity, argument) ? SUCCESS : MEMORY_ERROR;
+			}
+			else
+			{
+				error = push_glob(&words, &count, &capacity, argument, expansion);
+			}
+			if (error != SUCCESS)
+			{
+				free(words);
+				return error;
+			}
+			continue;
+		}
+
+		char *expanded;
+		status_t error = expand_argument(argument, expansion, &expanded);
+		if (error != SUCCESS)
+		{
+			free(words);
+			return error;
+		}
+
+		if (argument[0] == '"')
+		{
+			if (!push_word(&words, &count, &capacity, expanded))
+			{
+				free(words);
+				return MEMORY_ERROR;
+			}
+			continue;
+		}
+
+		//split on white space in place: each word is a pointer into the expanded argument, ended
+		//where the white space after it was
+		char *word = expanded;
+		while (*word)
+		{
+			word += strspn(word, " \t\n");
+			if (*word == '\0')
+			{
+				break;
+			}
+
+			char *end = word + strcspn(word, " \t\n");
+			unsigned short last = *end == '\0';
+			*end = '\0';
+			error = push_glob(&words, &count, &capacity, word, expansion);
+			if (error != SUCCESS)
+			{
+				free(words);
+				return error;
+			}
+			word = last ? end : end + 1;
+		}
+	}
+
+	char **arguments = arena_alloc(expansion->arena, (count + 1) * sizeof *arguments);
+	if (arguments == NULL)
+	{
+		free(words);
+		return MEMORY_ERROR;
+	}
+	if (count > 0)
+	{
+		memcpy(arguments, words, count * sizeof *arguments);
+	}
+	arguments[count] = NULL;
+	free(words);
+
+	stage->arguments = arguments;
+	stage->argc = count + 1;
+	return SUCCESS;
+}
+
+status_t expand_argument(char *argument, expansion_t *expansion, char **expanded)
+{
+	char *result = argument;
+	size_t position = 0;
+	char *dollar;
+	while ((dollar = find_expansion(result + position)) != NULL)
+	{
+		char *value;
+		size_t value_length;
+		char *end;
+		unsigned short captured = 0;
+		if (dollar[1] == '(')
+		{
+			end = find_closing_paren(dollar + 2);
+			if (end == NULL)
+			{
+				return FORMAT_ERROR;
+			}
+
+			//the command needs its own nul terminated copy, since the argument goes on past it
+			char *text = arena_copy(expansion->arena, dollar + 2, end - (dollar + 2));
+			if (text == NULL)
+			{
+				return MEMORY_ERROR;
+			}
+
+			value = capture(text, expansion, &value_length);
+			if (value == NULL)
+			{
+				return PIPE_ERROR;
+			}
+			captured = 1;
+		}
+		else if (dollar[1] == '?')
+		{
+			char number[16];
+			snprintf(number, sizeof number, "%d", *expansion->status);
+			value = arena_copy(expansion->arena, number, strlen(number));
+			if (value == NULL)
+			{
+				return MEMORY_ERROR;
+			}
+			value_length = strlen(value);
+			end = dollar + 1;
+		}
+		else
+		{
+			char *name = dollar + 1;
+			if (dollar[1] == '{')
+			{
+				name = dollar + 2;
+				end = strchr(name, '}');
+				if (end == NULL)
+				{
+					return FORMAT_ERROR;
+				}
+			}
+			else
+			{
+				for (end = name + 1; *end == '_' || (*end >= 'a' && *end <= 'z') || (*end >= 'A' && *end <= 'Z') || (*end >= '0' && *end <= '9'); end++);
+			}
+
+			name = arena_copy(expansion->arena, name, end - name);
+			if (name == NULL)
+			{
+				return MEMORY_ERROR;
+			}
+			value = expansion->lookup(expansion->context, name);
+			value = value == NULL ? "" : value;
+			value_length = strlen(value);
+
+			//a name runs up to the first character that cannot be part of one; ${name} to its brace
+			end = dollar[1] == '{' ? end : end - 1;
+		}
+
+		size_t prefix = dollar - result;
+		size_t rest = strlen(end + 1);
+		if (captured && prefix == 0 && rest == 0)
+		{
+			//the whole argument is the substitution, so it is just the output
+			result = value;
+		}
+		else
+		{
+			//a variable's value is always copied, since splitting writes into it
+			char *joined = arena_alloc(expansion->arena, prefix + value_length + rest + 1);
+			if (joined == NULL)
+			{
+				return MEMORY_ERROR;
+			}
+			memcpy(joined, result, prefix);
+			memcpy(joined + prefix, value, value_length);
+			memcpy(joined + prefix + value_length, end + 1, rest + 1);
+			result = joined;
+		}
+
+		//the value is never expanded again
+		position = prefix + value_length;
+	}
+
+	*expanded = result;
+	return SUCCESS;
+}
+
+char *find_expansion(char *text)
+{
+	for (; (text = strchr(text, '$')) != NULL; text++)
+	{
+		char next = text[1];
+		if (next == '(' || next == '{' || next == '?' || next == '_' || (next >= 'a' && next <= 'z') || (next >= 'A' && next <= 'Z'))
+		{
+			return text;
+		}
+	}
+
+	return NULL;
+}
+
+char *find_closing_paren(char *text)
+{
+	size_t depth = 1;
+	for (; *text; text++)
+	{
+		if (*text == '(')
+		{
+			depth++;
+		}
+		else if (*text == ')' && --depth == 0)
+		{
+			return text;
+		}
+	}
+
+	return NULL;
+}
+
+char *arena_copy(arena_t *arena, const char *text, size_t length)
+{
+	char *copy = arena_alloc(arena, length + 1);
+	if (copy != NULL)
+	{
+		memcpy(copy, text, length);
+		copy[length] = '\0';
+	}
+
+	return copy;
+}
+
+char *capture(char *text, expansion_t *expansion, size_t *length)
+{
+	int fds[2];
+	if (make_pipe(fds, O_CLOEXEC, *expansion->pipe_size) < 0)
+	{
+		return NULL;
+	}
+
+	//anything still buffered would otherwise be written by the child as well
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		close(fds[0]);
+		close(fds[1]);
+		return NULL;
+	}
+
+	if (pid == 0)
+	{
+		close(fds[0]);
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[1]);
+		expansion->run(expansion->context, text);
+		_exit(1);
+	}
+
+	close(fds[1]);
+	char *output = arena_read_fd(expansion->arena, fds[0], length);
+	close(fds[0]);
+
+	int wait_status;
+	while (waitpid(pid, &wait_status, 0) < 0 && errno == EINTR);
+	*expansion->status = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : 128 + WTERMSIG(wait_status);
+
+	if (output != NULL)
+	{
+		while (*length > 0 && output[*length - 1] == '\n')
+		{
+			output[--*length] = '\0';
+		}
+	}
+
+	return output;
+}
+
+status_t push_glob(char ***words, size_t *count, size_t *capacity, char *word, expansion_t *expansion)
+{
+	if (expansion->wildcards == NULL || !has_wildcards(word))
+	{
+		return push_word(words, count, capacity, word) ? SUCCESS : MEMORY_ERROR;
+	}
+
+	char **matches;
+	size_t num_matches;
+	status_t error = expand_wildcards(expansion->wildcards, expansion->arena, word, &matches, &num_matches);
+	if (error != SUCCESS)
+	{
+		return error;
+	}
+
+	//a pattern that matches nothing is left as it is
+	if (num_matches == 0)
+	{
+		return push_word(words, count, capacity, word) ? SUCCESS : MEMORY_ERROR;
+	}
+
+	size_t i;
+	for (i = 0; i < num_matches; i++)
+	{
+		if (!push_word(words, count, capacity, matches[i]))
+		{
+			return MEMORY_ERROR;
+		}
+	}
+
+	return SUCCESS;
+}
+
+int needs_expansion(char *argument, expansion_t *expansion)
+{
+	if (argument[0] == '\'')
+	{
+		return 0;
+	}
+
+	return find_expansion(argument) != NULL || (argument[0] != '"' && expansion->wildcards != NULL && has_wildcards(argument));
+}
+
+int push_word(char ***words, size_t *count, size_t *capacity, char *word)
+{
+	if (*count == *capacity)
+	{
+		size_t new_capacity = *capacity == 0 ? 16 : 2 * *capacity;
+		char **tmp = realloc(*words, new_capacity * sizeof *tmp);
+		if (tmp == NULL)
+		{
+			return 0;
+		}
+		*words = tmp;
+		*capacity = new_capacity;
+	}
+
+	(*words)[(*count)++] = word;
+	return 1;
+}
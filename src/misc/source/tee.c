@@ -0,0 +1,434 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/pipe_size.h"
+#include "../include/tee.h"
+
+/**
+  * The function run by the engine's thread; copies output until the engine is stopped
+  * @param arg the tee_engine_t
+  * @return always NULL
+  */
+void *tee_worker(void *arg);
+
+/**
+  * Copies whatever is available in the stream's source to its terminal and its job's script log
+  * @param stream the stream to be copied
+  * @return zero if the source has reached end of file, nonzero otherwise
+  */
+int pump_stream(tee_stream_t *stream);
+
+/**
+  * Moves exactly length bytes out of the pipe from into the descriptor to, splicing where the kernel
+  * allows it and copying through a buffer where it does not. If to cannot be written, the bytes are
+  * still taken out of the pipe, so that the pipes stay in step with each other
+  * @param from   the pipe to take the bytes from
+  * @param to     the descriptor to write the bytes to, or -1 to discard them
+  * @param length the number of bytes to move
+  */
+void move_bytes(int from, int to, size_t length);
+
+/**
+  * Finishes a stream that has reached end of file, closing its descriptors and finishing its job if
+  * it was the job's last stream. Must be called with the engine's lock held
+  * @param engine the engine the stream belongs to
+  * @param stream the stream to be finished
+  */
+void finish_stream(tee_engine_t *engine, tee_stream_t *stream);
+
+/**
+  * Frees a job and releases its script log
+  * @param job the job to be freed
+  */
+void free_tee_job(tee_job_t *job);
+
+/**
+  * Creates a stream copying to terminal for the given job, placing the descriptor the command should
+  * write to in write_fd
+  * @param job       the job the stream belongs to
+  * @param terminal  where the shell's copy of the stream goes
+  * @param pipe_size the size of the stream's pipes, or zero for the kernel's default
+  * @param write_fd  out param; the write end of the stream's pipe
+  * @return the new stream, or NULL if it could not be created
+  */
+tee_stream_t *create_stream(tee_job_t *job, int terminal, size_t pipe_size, int *write_fd);
+
+/**
+  * Closes a stream's descriptors and frees it
+  * @param stream the stream to be freed
+  */
+void free_stream(tee_stream_t *stream);
+
+status_t start_tee_engine(tee_engine_t *engine)
+{
+	if (engine->running)
+	{
+		return SUCCESS;
+	}
+
+	if (pipe2(engine->wakeup, O_CLOEXEC | O_NONBLOCK) < 0)
+	{
+		return PIPE_ERROR;
+	}
+
+	pthread_mutex_init(&engine->lock, NULL);
+	pthread_cond_init(&engine->finished, NULL);
+	engine->streams = NULL;
+	engine->pending = NULL;
+	engine->stopping = 0;
+	engine->owner = getpid();
+	if (pthread_create(&engine->thread, NULL, tee_worker, engine) != 0)
+	{
+		close(engine->wakeup[0]);
+		close(engine->wakeup[1]);
+		pthread_mutex_destroy(&engine->lock);
+		pthread_cond_destroy(&engine->finished);
+		return THREAD_ERROR;
+	}
+
+	engine->running = 1;
+	return SUCCESS;
+}
+
+status_t tee_command(tee_engine_t *engine, script_log_t *log, command_t *command, int fds[2], tee_job_t **job)
+{
+	tee_job_t *new_job = malloc(sizeof *new_job);
+	if (new_job == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+
+	new_job->log = log;
+	retain_script_log(log);
+
+	//the header matches what was written to script files before: the command on a line of its own
+	string_initialize(&new_job->header);
+	string_t command_string;
+	string_initialize(&command_string);
+	command_to_string(command, &command_string);
+	string_concatenate_char_array(&new_job->header, "\n");
+	string_concatenate(&new_job->header, &command_string);
+	string_concatenate_char_array(&new_job->header, "\n");
+	string_uninitialize(&command_string);
+	new_job->open_streams = 2;
+	new_job->done = 0;
+	new_job->detached = 0;
+
+	tee_stream_t *out = create_stream(new_job, STDOUT_FILENO, engine->pipe_size, fds);
+	tee_stream_t *err = out == NULL ? NULL : create_stream(new_job, STDERR_FILENO, engine->pipe_size, fds + 1);
+	if (err == NULL)
+	{
+		if (out != NULL)
+		{
+			close(fds[0]);
+			free_stream(out);
+		}
+		free_tee_job(new_job);
+		return PIPE_ERROR;
+	}
+
+	//jobs are queued in order, so that their headers reach the script file in the order the
+	//commands were run
+	pthread_mutex_lock(&engine->lock);
+	tee_stream_t **tail = &engine->pending;
+	while (*tail != NULL)
+	{
+		tail = &(*tail)->next;
+	}
+	out->next = err;
+	*tail = out;
+	pthread_mutex_unlock(&engine->lock);
+
+	//let the thread know it has new streams to look at
+	char wake = 0;
+	write(engine->wakeup[1], &wake, 1);
+
+	*job = new_job;
+	return SUCCESS;
+}
+
+void wait_tee_job(tee_engine_t *engine, tee_job_t *job)
+{
+	pthread_mutex_lock(&engine->lock);
+	while (!job->done)
+	{
+		pthread_cond_wait(&engine->finished, &engine->lock);
+	}
+	pthread_mutex_unlock(&engine->lock);
+
+	free_tee_job(job);
+}
+
+void detach_tee_job(tee_engine_t *engine, tee_job_t *job)
+{
+	pthread_mutex_lock(&engine->lock);
+	job->detached = 1;
+	unsigned short done = job->done;
+	pthread_mutex_unlock(&engine->lock);
+
+	if (done)
+	{
+		free_tee_job(job);
+	}
+}
+
+void stop_tee_engine(tee_engine_t *engine)
+{
+	if (!engine->running || engine->owner != getpid())
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&engine->lock);
+	engine->stopping = 1;
+	pthread_mutex_unlock(&engine->lock);
+	char wake = 0;
+	write(engine->wakeup[1], &wake, 1);
+	pthread_join(engine->thread, NULL);
+
+	//anything left over is abandoned
+	tee_stream_t *lists[2] = { engine->streams, engine->pending };
+	size_t i;
+	for (i = 0; i < 2; i++)
+	{
+		while (lists[i] != NULL)
+		{
+			tee_stream_t *next = lists[i]->next;
+			tee_job_t *job = lists[i]->job;
+			free_stream(lists[i]);
+			job->open_streams--;
+			if (job->open_streams == 0 && job->detached)
+			{
+				free_tee_job(job);
+			}
+			lists[i] = next;
+		}
+	}
+
+	close(engine->wakeup[0]);
+	close(engine->wakeup[1]);
+	pthread_mutex_destroy(&engine->lock);
+	pthread_cond_destroy(&engine->finished);
+	engine->running = 0;
+}
+
+void *tee_worker(void *arg)
+{
+	tee_engine_t *engine = arg;
+	struct pollfd *fds = NULL;
+	size_t capacity = 0;
+
+	pthread_mutex_lock(&engine->lock);
+	while (!engine->stopping)
+	{
+		//take on any newly registered streams, writing their jobs' headers before any output
+		while (engine->pending != NULL)
+		{
+			tee_stream_t *stream = engine->pending;
+			engine->pending = stream->next;
+			if (stream->job->header.elements > 0)
+			{
+				log_header(stream->job->log, &stream->job->header);
+				stream->job->header.elements = 0;
+			}
+			stream->next = engine->streams;
+			engine->streams = stream;
+		}
+		pthread_mutex_unlock(&engine->lock);
+
+		size_t num_fds = 1;
+		tee_stream_t *stream;
+		for (stream = engine->streams; stream != NULL; stream = stream->next)
+		{
+			num_fds++;
+		}
+
+		if (num_fds > capacity)
+		{
+			struct pollfd *tmp = realloc(fds, num_fds * sizeof *fds);
+			if (tmp == NULL)
+			{
+				pthread_mutex_lock(&engine->lock);
+				continue;
+			}
+			fds = tmp;
+			capacity = num_fds;
+		}
+
+		fds[0].fd = engine->wakeup[0];
+		fds[0].events = POLLIN;
+		size_t i = 1;
+		for (stream = engine->streams; stream != NULL; stream = stream->next, i++)
+		{
+			fds[i].fd = stream->source;
+			fds[i].events = POLLIN;
+		}
+
+		if (poll(fds, num_fds, -1) < 0)
+		{
+			pthread_mutex_lock(&engine->lock);
+			continue;
+		}
+
+		if (fds[0].revents)
+		{
+			char drain[64];
+			while (read(engine->wakeup[0], drain, sizeof drain) > 0);
+		}
+
+		tee_stream_t **link = &engine->streams;
+		for (i = 1; i < num_fds; i++)
+		{
+			stream = *link;
+			if (fds[i].revents && !pump_stream(stream))
+			{
+				*link = stream->next;
+				pthread_mutex_lock(&engine->lock);
+				finish_stream(engine, stream);
+				pthread_mutex_unlock(&engine->lock);
+				continue;
+			}
+			link = &stream->next;
+		}
+
+		pthread_mutex_lock(&engine->lock);
+	}
+	pthread_mutex_unlock(&engine->lock);
+
+	free(fds);
+	return NULL;
+}
+
+int pump_stream(tee_stream_t *stream)
+{
+	//duplicate what is in the source without consuming it, then send the duplicate to the terminal
+	//and the original to the script log
+	ssize_t length = tee(stream->source, stream->scratch[1], stream->chunk, SPLICE_F_NONBLOCK);
+	if (length == 0)
+	{
+		return 0;
+	}
+
+	if (length < 0)
+	{
+		return errno == EAGAIN || errno == EINTR;
+	}
+
+	move_bytes(stream->scratch[0], stream->terminal, length);
+	log_output(stream->job->log, stream->source, length);
+	return 1;
+}
+
+void move_bytes(int from, int to, size_t length)
+{
+	char buffer[4096];
+	while (length > 0)
+	{
+		ssize_t moved = to < 0 ? -1 : splice(from, NULL, to, NULL, length, SPLICE_F_MOVE);
+		if (moved > 0)
+		{
+			length -= moved;
+			continue;
+		}
+
+		if (moved < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		//the destination cannot be spliced to (or cannot be written at all), so fall back to
+		//copying, and drop the bytes if even that fails
+		ssize_t result = read(from, buffer, length < sizeof buffer ? length : sizeof buffer);
+		if (result <= 0)
+		{
+			return;
+		}
+		length -= result;
+
+		ssize_t written = 0;
+		while (to >= 0 && written < result)
+		{
+			ssize_t write_result = write(to, buffer + written, result - written);
+			if (write_result <= 0)
+			{
+				to = -1;
+				break;
+			}
+			written += write_result;
+		}
+	}
+}
+
+void finish_stream(tee_engine_t *engine, tee_stream_t *stream)
+{
+	tee_job_t *job = stream->job;
+	free_stream(stream);
+
+	job->open_streams--;
+	if (job->open_streams > 0)
+	{
+		return;
+	}
+
+	log_command_end(job->log);
+	job->done = 1;
+	if (job->detached)
+	{
+		free_tee_job(job);
+		return;
+	}
+
+	pthread_cond_broadcast(&engine->finished);
+}
+
+void free_tee_job(tee_job_t *job)
+{
+	release_script_log(job->log);
+	string_uninitialize(&job->header);
+	free(job);
+}
+
+tee_stream_t *create_stream(tee_job_t *job, int terminal, size_t pipe_size, int *write_fd)
+{
+	tee_stream_t *stream = malloc(sizeof *stream);
+	if (stream == NULL)
+	{
+		return NULL;
+	}
+
+	int source[2];
+	if (make_pipe(source, O_CLOEXEC, pipe_size) < 0)
+	{
+		free(stream);
+		return NULL;
+	}
+
+	if (make_pipe(stream->scratch, O_CLOEXEC, pipe_size) < 0)
+	{
+		close(source[0]);
+		close(source[1]);
+		free(stream);
+		return NULL;
+	}
+
+	stream->source = source[0];
+	stream->terminal = terminal;
+	stream->chunk = pipe_size > TEE_CHUNK ? pipe_size : TEE_CHUNK;
+	stream->job = job;
+	stream->next = NULL;
+	*write_fd = source[1];
+	return stream;
+}
+
+void free_stream(tee_stream_t *stream)
+{
+	close(stream->source);
+	close(stream->scratch[0]);
+	close(stream->scratch[1]);
+	free(stream);
+}
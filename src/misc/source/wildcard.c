@@ -0,0 +1,641 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../include/wildcard.h"
+
+#define RADIX_CUTOFF 32
+
+/**
+  * A directory entry as getdents64 returns it
+  */
+typedef struct
+{
+	ino64_t d_ino;
+	off64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+} linux_dirent64_t;
+
+/**
+  * A growing list of paths, each kept in the arena
+  */
+typedef struct
+{
+	char **paths;
+	size_t count;
+	size_t capacity;
+} path_list_t;
+
+/**
+  * Determines whether the first length characters of text have any wildcards
+  * @param text   the text to be checked
+  * @param length the number of characters to check
+  * @return nonzero if they do, zero otherwise
+  */
+int wildcards_in(const char *text, size_t length);
+
+/**
+  * Finds the ] that closes a set starting at a [, allowing a ] as the set's first character
+  * @param text   the text, starting at the [
+  * @param length the number of characters in text
+  * @return the index of the ], or 0 if there is none (so the [ is an ordinary character)
+  */
+size_t find_set_end(const char *text, size_t length);
+
+/**
+  * Finds the listing of a directory, from the cache if it holds an up to date one, or else by
+  * reading the directory, caching the result if it is safe to
+  * @param cache   the listing cache
+  * @param path    the directory
+  * @param scratch where a listing that cannot be cached is kept; the caller frees it if it is used
+  * @return the listing, or NULL if the directory could not be read
+  */
+wildcard_listing_t *get_listing(wildcard_cache_t *cache, const char *path, wildcard_listing_t *scratch);
+
+/**
+  * Reads the names in an open directory into a listing, a large batch at a time
+  * @param fd      the open directory
+  * @param listing out param; the listing the names are placed in
+  * @return zero if the directory could not be read, nonzero otherwise
+  */
+int read_listing(int fd, wildcard_listing_t *listing);
+
+/**
+  * Frees the memory held by a listing, leaving it empty
+  * @param listing the listing to be freed
+  */
+void free_listing(wildcard_listing_t *listing);
+
+/**
+  * Adds a path, made of a directory and a name and possibly a trailing /, to a list
+  * @param arena     where the path is kept
+  * @param list      the list the path is added to
+  * @param directory the directory the name is in, ending in / (or empty)
+  * @param name      the name
+  * @param length    the number of characters of name to use
+  * @param slash     if true, a / is added to the end
+  * @return zero if there was no memory for it, nonzero otherwise
+  */
+int add_path(arena_t *arena, path_list_t *list, const char *directory, const char *name, size_t length, unsigned short slash);
+
+/**
+  * Determines whether a path names a directory, using the type the directory listing gave if it can
+  * @param type the type from the listing
+  * @param path the path, used if the type does not say (a link, or a file system that does not tell)
+  * @return nonzero if it is a directory, zero otherwise
+  */
+int is_directory(unsigned char type, const char *path);
+
+/**
+  * Sorts strings by their characters from depth on, all of them being the same before depth
+  * @param strings the strings to be sorted
+  * @param scratch room for count strings
+  * @param count   the number of strings
+  * @param depth   the number of characters all of them share
+  */
+void radix_sort_from(char **strings, char **scratch, size_t count, size_t depth);
+
+int has_wildcards(char *word)
+{
+	return wildcards_in(word, strlen(word));
+}
+
+status_t expand_wildcards(wildcard_cache_t *cache, arena_t *arena, char *pattern, char ***matches, size_t *count)
+{
+	path_list_t current = { NULL, 0, 0 };
+	path_list_t next = { NULL, 0, 0 };
+	if (!add_path(arena, &current, "", pattern[0] == '/' ? "/" : "", pattern[0] == '/', 0))
+	{
+		return MEMORY_ERROR;
+	}
+
+	status_t error = SUCCESS;
+	unsigned short matched_any = 0;
+	char *component = pattern;
+	while (*component == '/')
+	{
+		component++;
+	}
+
+	while (*component != '\0' && current.count > 0)
+	{
+		char *end = strchrnul(component, '/');
+		char *following = end;
+		while (*following == '/')
+		{
+			following++;
+		}
+		size_t length = end - component;
+		//anything but the last component must be a directory, and so must the last with a / after it
+		unsigned short slash = *end == '/';
+
+		size_t i;
+		if (!wildcards_in(component, length))
+		{
+			for (i = 0; i < current.count && error == SUCCESS; i++)
+			{
+				if (!add_path(arena, &next, current.paths[i], component, length, slash))
+				{
+					error = MEMORY_ERROR;
+				}
+				//a name after a wildcard has to be checked; before one, the listing will tell
+				else if (*following == '\0' && matched_any && faccessat(AT_FDCWD, next.paths[next.count - 1], F_OK, AT_SYMLINK_NOFOLLOW) < 0)
+				{
+					next.count--;
+				}
+			}
+		}
+		else
+		{
+			wildcard_pattern_t compiled;
+			if (!compile_wildcard(component, length, &compiled))
+			{
+				next.count = 0;
+				current.count = 0;
+				break;
+			}
+			matched_any = 1;
+
+			for (i = 0; i < current.count && error == SUCCESS; i++)
+			{
+				wildcard_listing_t scratch = { 0 };
+				wildcard_listing_t *listing = get_listing(cache, current.paths[i][0] != '\0' ? current.paths[i] : ".", &scratch);
+				if (listing == NULL)
+				{
+					continue;
+				}
+
+				size_t j;
+				for (j = 0; j < listing->count && error == SUCCESS; j++)
+				{
+					char *name = listing->names + listing->offsets[j];
+					if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 || !match_wildcard(&compiled, name))
+					{
+						continue;
+					}
+
+					if (!add_path(arena, &next, current.paths[i], name, strlen(name), slash))
+					{
+						error = MEMORY_ERROR;
+					}
+					else if (slash && !is_directory(listing->types[j], next.paths[next.count - 1]))
+					{
+						next.count--;
+					}
+				}
+
+				if (listing == &scratch)
+				{
+					free_listing(&scratch);
+				}
+			}
+		}
+
+		path_list_t swap = current;
+		current = next;
+		next = swap;
+		next.count = 0;
+		component = following;
+	}
+
+	free(next.paths);
+	if (error != SUCCESS)
+	{
+		free(current.paths);
+		return error;
+	}
+
+	*count = current.count;
+	*matches = arena_alloc(arena, (current.count + 1) * sizeof **matches);
+	if (*matches == NULL)
+	{
+		free(current.paths);
+		return MEMORY_ERROR;
+	}
+	if (current.count > 0)
+	{
+		memcpy(*matches, current.paths, current.count * sizeof **matches);
+		radix_sort_strings(*matches, current.count);
+	}
+	free(current.paths);
+	return SUCCESS;
+}
+
+int compile_wildcard(const char *text, size_t length, wildcard_pattern_t *pattern)
+{
+	memset(pattern, 0, sizeof *pattern);
+	pattern->leading_dot = length > 0 && text[0] == '.';
+
+	size_t elements = 0;
+	size_t i;
+	for (i = 0; i < length; i++)
+	{
+		//a run of *s is the same as one
+		if (text[i] == '*' && elements > 0 && (pattern->stars & ((uint64_t) 1 << (elements - 1))))
+		{
+			continue;
+		}
+
+		if (elements >= WILDCARD_MAX_PATTERN)
+		{
+			return 0;
+		}
+		uint64_t bit = (uint64_t) 1 << elements;
+		elements++;
+
+		size_t set_end;
+		if (text[i] == '*')
+		{
+			pattern->stars |= bit;
+		}
+		else if (text[i] == '?')
+		{
+			size_t c;
+			for (c = 0; c < 256; c++)
+			{
+				pattern->matches[c] |= bit;
+			}
+		}
+		else if (text[i] == '[' && (set_end = find_set_end(text + i, length - i)) > 0)
+		{
+			unsigned char in_set[256] = { 0 };
+			size_t j = i + 1;
+			unsigned short negate = text[j] == '!' || text[j] == '^';
+			j += negate;
+			size_t first = j;
+			for (; j < i + set_end; j++)
+			{
+				unsigned char low = text[j];
+				//a - between two characters (not first or last in the set) is a range
+				if (j + 2 < i + set_end && text[j + 1] == '-' && (j > first || text[j] != ']'))
+				{
+					unsigned char high = text[j + 2];
+					size_t c;
+					for (c = low; c <= high; c++)
+					{
+						in_set[c] = 1;
+					}
+					j += 2;
+				}
+				else
+				{
+					in_set[low] = 1;
+				}
+			}
+
+			size_t c;
+			for (c = 0; c < 256; c++)
+			{
+				if (in_set[c] != negate)
+				{
+					pattern->matches[c] |= bit;
+				}
+			}
+			i += set_end;
+		}
+		else
+		{
+			pattern->matches[(unsigned char) text[i]] |= bit;
+		}
+	}
+
+	pattern->accept = (uint64_t) 1 << elements;
+	return 1;
+}
+
+int match_wildcard(wildcard_pattern_t *pattern, const char *name)
+{
+	//a hidden name is only matched by a pattern that starts with a .
+	if (name[0] == '.' && !pattern->leading_dot)
+	{
+		return 0;
+	}
+
+	//a * can match nothing, so reaching one reaches the element after it too
+	uint64_t state = 1;
+	state |= (state & pattern->stars) << 1;
+	for (; *name && state != 0; name++)
+	{
+		state = ((state & pattern->matches[(unsigned char) *name]) << 1) | (state & pattern->stars);
+		state |= (state & pattern->stars) << 1;
+	}
+
+	return (state & pattern->accept) != 0;
+}
+
+int radix_sort_strings(char **strings, size_t count)
+{
+	char **scratch = malloc(count * sizeof *scratch);
+	if (scratch == NULL)
+	{
+		return 0;
+	}
+
+	radix_sort_from(strings, scratch, count, 0);
+	free(scratch);
+	return 1;
+}
+
+void clear_wildcard_cache(wildcard_cache_t *cache)
+{
+	size_t i;
+	for (i = 0; i < WILDCARD_CACHE_SIZE; i++)
+	{
+		free_listing(&cache->listings[i]);
+	}
+	cache->clock = 0;
+}
+
+int wildcards_in(const char *text, size_t length)
+{
+	size_t i;
+	for (i = 0; i < length; i++)
+	{
+		if (text[i] == '*' || text[i] == '?' || (text[i] == '[' && find_set_end(text + i, length - i) > 0))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+size_t find_set_end(const char *text, size_t length)
+{
+	size_t i = 1;
+	if (i < length && (text[i] == '!' || text[i] == '^'))
+	{
+		i++;
+	}
+	//a ] straight after the [ (or the !) is part of the set
+	if (i < length && text[i] == ']')
+	{
+		i++;
+	}
+
+	for (; i < length; i++)
+	{
+		if (text[i] == ']')
+		{
+			return i;
+		}
+	}
+
+	return 0;
+}
+
+wildcard_listing_t *get_listing(wildcard_cache_t *cache, const char *path, wildcard_listing_t *scratch)
+{
+	int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return NULL;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) < 0)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	time_t now = time(NULL);
+	wildcard_listing_t *victim = &cache->listings[0];
+	size_t i;
+	for (i = 0; i < WILDCARD_CACHE_SIZE; i++)
+	{
+		wildcard_listing_t *listing = &cache->listings[i];
+		if (listing->names != NULL && listing->device == info.st_dev && listing->inode == info.st_ino)
+		{
+			if (listing->mtime.tv_sec == info.st_mtim.tv_sec && listing->mtime.tv_nsec == info.st_mtim.tv_nsec && now - listing->read_at < WILDCARD_CACHE_TTL)
+			{
+				listing->last_used = ++cache->clock;
+				close(fd);
+				return listing;
+			}
+
+			//out of date, so its slot is the one to reuse
+			free_listing(listing);
+		}
+
+		if (listing->names == NULL || (victim->names != NULL && listing->last_used < victim->last_used))
+		{
+			victim = listing;
+		}
+	}
+
+	if (!read_listing(fd, scratch))
+	{
+		close(fd);
+		free_listing(scratch);
+		return NULL;
+	}
+	close(fd);
+
+	scratch->device = info.st_dev;
+	scratch->inode = info.st_ino;
+	scratch->mtime = info.st_mtim;
+	scratch->read_at = now;
+	if (info.st_mtim.tv_sec >= now)
+	{
+		return scratch;
+	}
+
+	free_listing(victim);
+	*victim = *scratch;
+	victim->last_used = ++cache->clock;
+	return victim;
+}
+
+int read_listing(int fd, wildcard_listing_t *listing)
+{
+	char *buffer = malloc(WILDCARD_READ_SIZE);
+	if (buffer == NULL)
+	{
+		return 0;
+	}
+
+	size_t names_used = 0;
+	size_t names_capacity = 0;
+	size_t capacity = 0;
+	listing->count = 0;
+	while (1)
+	{
+		long result = syscall(SYS_getdents64, fd, buffer, WILDCARD_READ_SIZE);
+		if (result < 0)
+		{
+			free(buffer);
+			return 0;
+		}
+		if (result == 0)
+		{
+			break;
+		}
+
+		long position = 0;
+		while (position < result)
+		{
+			linux_dirent64_t *entry = (linux_dirent64_t *) (buffer + position);
+			position += entry->d_reclen;
+			size_t length = strlen(entry->d_name) + 1;
+
+			if (listing->count == capacity)
+			{
+				capacity = capacity == 0 ? 256 : 2 * capacity;
+				size_t *offsets = realloc(listing->offsets, capacity * sizeof *offsets);
+				if (offsets == NULL)
+				{
+					free(buffer);
+					return 0;
+				}
+				listing->offsets = offsets;
+
+				unsigned char *types = realloc(listing->types, capacity * sizeof *types);
+				if (types == NULL)
+				{
+					free(buffer);
+					return 0;
+				}
+				listing->types = types;
+			}
+
+			if (names_used + length > names_capacity)
+			{
+				names_capacity = names_capacity == 0 ? 16384 : 2 * names_capacity;
+				names_capacity = names_capacity < names_used + length ? names_used + length : names_capacity;
+				char *names = realloc(listing->names, names_capacity);
+				if (names == NULL)
+				{
+					free(buffer);
+					return 0;
+				}
+				listing->names = names;
+			}
+
+			memcpy(listing->names + names_used, entry->d_name, length);
+			listing->offsets[listing->count] = names_used;
+			listing->types[listing->count] = entry->d_type;
+			listing->count++;
+			names_used += length;
+		}
+	}
+
+	free(buffer);
+	//an empty directory still needs names to be non-NULL to count as a listing
+	if (listing->names == NULL && (listing->names = malloc(1)) == NULL)
+	{
+		return 0;
+	}
+	return 1;
+}
+
+void free_listing(wildcard_listing_t *listing)
+{
+	free(listing->names);
+	free(listing->offsets);
+	free(listing->types);
+	memset(listing, 0, sizeof *listing);
+}
+
+int add_path(arena_t *arena, path_list_t *list, const char *directory, const char *name, size_t length, unsigned short slash)
+{
+	if (list->count == list->capacity)
+	{
+		size_t capacity = list->capacity == 0 ? 64 : 2 * list->capacity;
+		char **paths = realloc(list->paths, capacity * sizeof *paths);
+		if (paths == NULL)
+		{
+			return 0;
+		}
+		list->paths = paths;
+		list->capacity = capacity;
+	}
+
+	size_t directory_length = strlen(directory);
+	char *path = arena_alloc(arena, directory_length + length + 2);
+	if (path == NULL)
+	{
+		return 0;
+	}
+	memcpy(path, directory, directory_length);
+	memcpy(path + directory_length, name, length);
+	path[directory_length + length] = '/';
+	path[directory_length + length + slash] = '\0';
+
+	list->paths[list->count++] = path;
+	return 1;
+}
+
+int is_directory(unsigned char type, const char *path)
+{
+	if (type == DT_DIR)
+	{
+		return 1;
+	}
+	if (type != DT_LNK && type != DT_UNKNOWN)
+	{
+		return 0;
+	}
+
+	struct stat info;
+	return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+void radix_sort_from(char **strings, char **scratch, size_t count, size_t depth)
+{
+	if (count < RADIX_CUTOFF)
+	{
+		size_t i;
+		for (i = 1; i < count; i++)
+		{
+			char *string = strings[i];
+			size_t j = i;
+			while (j > 0 && strcmp(strings[j - 1] + depth, string + depth) > 0)
+			{
+				strings[j] = strings[j - 1];
+				j--;
+			}
+			strings[j] = string;
+		}
+		return;
+	}
+
+	size_t counts[256] = { 0 };
+	size_t i;
+	for (i = 0; i < count; i++)
+	{
+		counts[(unsigned char) strings[i][depth]]++;
+	}
+
+	size_t starts[256];
+	size_t total = 0;
+	size_t c;
+	for (c = 0; c < 256; c++)
+	{
+		starts[c] = total;
+		total += counts[c];
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		scratch[starts[(unsigned char) strings[i][depth]]++] = strings[i];
+	}
+	memcpy(strings, scratch, count * sizeof *strings);
+
+	//the strings that have ended are all equal; every other bucket is sorted on the next character
+	size_t start = counts[0];
+	for (c = 1; c < 256; c++)
+	{
+		if (counts[c] > 1)
+		{
+			radix_sort_from(strings + start, scratch, counts[c], depth + 1);
+		}
+		start += counts[c];
+	}
+}
@@ -0,0 +1,461 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../include/zygote.h"
+
+#define ZYGOTE_MAX_FDS    (1 + 3 * ZYGOTE_MAX_STAGES)
+
+/**
+  * The fixed part of a launch request. It is followed by the payload: the number of arguments of
+  * each stage, as uint32_t, then each stage's path and arguments, then the environment, all NUL
+  * terminated. The current directory and each stage's stdin, stdout and stderr come with it as
+  * SCM_RIGHTS, in that order
+  */
+typedef struct
+{
+	uint32_t stages;
+	uint32_t variables;
+	uint32_t size;
+} request_t;
+
+/**
+  * The zygote's answer to a launch request, sent once the stages have all exited
+  */
+typedef struct
+{
+	int32_t launched;
+	int32_t status;
+} reply_t;
+
+/**
+  * Sends all of a buffer over a socket, continuing after short sends
+  * @param socket the socket
+  * @param data   the bytes to be sent
+  * @param length the number of bytes
+  * @return zero if the bytes could not all be sent, nonzero otherwise
+  */
+int send_fully(int socket, const void *data, size_t length);
+
+/**
+  * Receives exactly length bytes from a socket
+  * @param socket the socket
+  * @param data   out param; where the bytes are placed
+  * @param length the number of bytes
+  * @return zero if the socket closed or failed first, nonzero otherwise
+  */
+int receive_fully(int socket, void *data, size_t length);
+
+/**
+  * Points each entry of an array at the next of a run of NUL terminated strings in a payload
+  * @param strings  out param; the array, NULL terminated
+  * @param count    the number of strings
+  * @param position in/out param; where the strings start in the payload, then where they end
+  * @param end      the end of the payload
+  * @return zero if the payload ended first, nonzero otherwise
+  */
+int take_strings(char **strings, size_t count, char **position, char *end);
+
+/**
+  * Closes each stage's descriptors
+  * @param stages the stages
+  * @param count  the number of stages
+  */
+void close_stages(launch_t *stages, size_t count);
+
+/**
+  * Launches the stages of one request and waits for them, as the zygote
+  * @param request the request
+  * @param payload the request's payload
+  * @param fds     the descriptors that came with the request
+  * @return the reply to be sent
+  */
+reply_t serve_request(request_t *request, char *payload, int *fds);
+
+status_t start_zygote(zygote_t *zygote)
+{
+	if (zygote->socket >= 0)
+	{
+		return SUCCESS;
+	}
+	if (zygote->executable == NULL)
+	{
+		return FORK_ERROR;
+	}
+
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) < 0)
+	{
+		return FORK_ERROR;
+	}
+
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		close(sockets[0]);
+		close(sockets[1]);
+		return FORK_ERROR;
+	}
+
+	if (pid == 0)
+	{
+		//a new image, rather than this copy of the shell, so the zygote holds none of its memory
+		char socket_name[16];
+		snprintf(socket_name, sizeof socket_name, "%d", sockets[1]);
+		fcntl(sockets[1], F_SETFD, 0);
+		execl(zygote->executable, "osh", ZYGOTE_FLAG, socket_name, (char *) NULL);
+		_exit(127);
+	}
+
+	close(sockets[1]);
+	zygote->pid = pid;
+	zygote->socket = sockets[0];
+	return SUCCESS;
+}
+
+void stop_zygote(zygote_t *zygote)
+{
+	if (zygote->socket < 0)
+	{
+		return;
+	}
+
+	//the zygote exits once the socket closes; in a forked child of the shell, the zygote is not a
+	//child, so there is nothing to wait for
+	close(zygote->socket);
+	zygote->socket = -1;
+	waitpid(zygote->pid, NULL, 0);
+}
+
+status_t zygote_launch(zygote_t *zygote, launch_t *stages, size_t count, char **envp, int *wait_status)
+{
+	if (zygote->socket < 0 || count == 0 || count > ZYGOTE_MAX_STAGES)
+	{
+		close_stages(stages, count);
+		return PIPE_ERROR;
+	}
+
+	request_t request = { count, 0, count * sizeof(uint32_t) };
+	size_t i;
+	for (i = 0; i < count; i++)
+	{
+		request.size += strlen(stages[i].path) + 1;
+		char **argument;
+		for (argument = stages[i].arguments; *argument != NULL; argument++)
+		{
+			request.size += strlen(*argument) + 1;
+		}
+	}
+	for (i = 0; envp[i] != NULL; i++)
+	{
+		request.size += strlen(envp[i]) + 1;
+	}
+	request.variables = i;
+
+	char *payload = malloc(request.size);
+	if (payload == NULL)
+	{
+		close_stages(stages, count);
+		return MEMORY_ERROR;
+	}
+
+	char *position = payload + count * sizeof(uint32_t);
+	for (i = 0; i < count; i++)
+	{
+		size_t length = strlen(stages[i].path) + 1;
+		memcpy(position, stages[i].path, length);
+		position += length;
+
+		uint32_t argc = 0;
+		for (; stages[i].arguments[argc] != NULL; argc++)
+		{
+			length = strlen(stages[i].arguments[argc]) + 1;
+			memcpy(position, stages[i].arguments[argc], length);
+			position += length;
+		}
+		memcpy(payload + i * sizeof(uint32_t), &argc, sizeof argc);
+	}
+	for (i = 0; envp[i] != NULL; i++)
+	{
+		size_t length = strlen(envp[i]) + 1;
+		memcpy(position, envp[i], length);
+		position += length;
+	}
+
+	int fds[ZYGOTE_MAX_FDS];
+	fds[0] = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fds[0] < 0)
+	{
+		free(payload);
+		close_stages(stages, count);
+		return OPEN_ERROR;
+	}
+	for (i = 0; i < count; i++)
+	{
+		memcpy(fds + 1 + 3 * i, stages[i].fds, sizeof stages[i].fds);
+	}
+
+	//the descriptors travel with the fixed part, the rest follows on its own
+	size_t num_fds = 1 + 3 * count;
+	union
+	{
+		char buffer[CMSG_SPACE(ZYGOTE_MAX_FDS * sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	struct iovec vector = { &request, sizeof request };
+	struct msghdr message = { NULL, 0, &vector, 1, control.buffer, CMSG_SPACE(num_fds * sizeof(int)), 0 };
+	struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type = SCM_RIGHTS;
+	header->cmsg_len = CMSG_LEN(num_fds * sizeof(int));
+	memcpy(CMSG_DATA(header), fds, num_fds * sizeof(int));
+
+	ssize_t sent;
+	do
+	{
+		sent = sendmsg(zygote->socket, &message, MSG_NOSIGNAL);
+	} while (sent < 0 && errno == EINTR);
+
+	//the zygote has its own copies now, and a stage only sees the end of its input once every copy
+	//of the pipe's write end is closed, so these must not be held while the stages run
+	close(fds[0]);
+	close_stages(stages, count);
+
+	int whole = sent == sizeof request && send_fully(zygote->socket, payload, request.size);
+	free(payload);
+	if (sent <= 0)
+	{
+		return PIPE_ERROR;
+	}
+
+	reply_t reply;
+	if (!whole || !receive_fully(zygote->socket, &reply, sizeof reply))
+	{
+		return READ_ERROR;
+	}
+
+	*wait_status = reply.status;
+	return reply.launched ? SUCCESS : CHILD_FORK_ERR;
+}
+
+int run_zygote(int socket)
+{
+	//a ^C at the terminal is for the commands, not for the zygote, which is in the same group
+	signal(SIGINT, SIG_IGN);
+	signal(SIGQUIT, SIG_IGN);
+	fcntl(socket, F_SETFD, FD_CLOEXEC);
+
+	while (1)
+	{
+		request_t request;
+		union
+		{
+			char buffer[CMSG_SPACE(ZYGOTE_MAX_FDS * sizeof(int))];
+			struct cmsghdr align;
+		} control;
+		struct iovec vector = { &request, sizeof request };
+		struct msghdr message = { NULL, 0, &vector, 1, control.buffer, sizeof control.buffer, 0 };
+		ssize_t length = recvmsg(socket, &message, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+		if (length < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		int fds[ZYGOTE_MAX_FDS];
+		size_t num_fds = 0;
+		struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+		if (header != NULL && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS)
+		{
+			num_fds = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			memcpy(fds, CMSG_DATA(header), num_fds * sizeof(int));
+		}
+
+		//the shell has gone, or is not making sense
+		char *payload = NULL;
+		if (length != sizeof request || request.stages == 0 || request.stages > ZYGOTE_MAX_STAGES || num_fds != 1 + 3 * request.stages || (payload = malloc(request.size + 1)) == NULL || !receive_fully(socket, payload, request.size))
+		{
+			size_t i;
+			for (i = 0; i < num_fds; i++)
+			{
+				close(fds[i]);
+			}
+			free(payload);
+			return length == 0 ? 0 : 1;
+		}
+
+		//a payload that does not end with a NUL is caught by take_strings
+		payload[request.size] = '\0';
+		reply_t reply = serve_request(&request, payload, fds);
+		free(payload);
+		if (!send_fully(socket, &reply, sizeof reply))
+		{
+			return 1;
+		}
+	}
+}
+
+reply_t serve_request(request_t *request, char *payload, int *fds)
+{
+	reply_t reply = { 0, 0 };
+	char **arguments[ZYGOTE_MAX_STAGES] = { NULL };
+	char **envp = NULL;
+	char *end = payload + request->size;
+	char *position = payload + request->stages * sizeof(uint32_t);
+	int valid = position <= end;
+
+	//each stage's path is taken as its arguments' zeroth entry, so they are all in one array
+	size_t i;
+	for (i = 0; valid && i < request->stages; i++)
+	{
+		uint32_t argc;
+		memcpy(&argc, payload + i * sizeof(uint32_t), sizeof argc);
+		arguments[i] = malloc((argc + 2) * sizeof *arguments[i]);
+		valid = arguments[i] != NULL && take_strings(arguments[i], argc + 1, &position, end);
+	}
+
+	if (valid)
+	{
+		envp = malloc((request->variables + 1) * sizeof *envp);
+		valid = envp != NULL && take_strings(envp, request->variables, &position, end);
+	}
+
+	pid_t pids[ZYGOTE_MAX_STAGES];
+	size_t started = 0;
+	for (; valid && started < request->stages; started++)
+	{
+		pids[started] = fork();
+		if (pids[started] < 0)
+		{
+			break;
+		}
+
+		if (pids[started] == 0)
+		{
+			signal(SIGINT, SIG_DFL);
+			signal(SIGQUIT, SIG_DFL);
+			int *stage_fds = fds + 1 + 3 * started;
+			if (fchdir(fds[0]) < 0 || dup2(stage_fds[0], STDIN_FILENO) < 0 || dup2(stage_fds[1], STDOUT_FILENO) < 0 || dup2(stage_fds[2], STDERR_FILENO) < 0)
+			{
+				error_message(DUP2_ERROR);
+				_exit(1);
+			}
+
+			//everything else that came with the request is close on exec
+			execve(arguments[started][0], arguments[started] + 1, envp);
+			error_message(EXEC_ERROR);
+			_exit(1);
+		}
+	}
+
+	//the stages hold the only copies of the pipes now, so each sees the end of its input
+	for (i = 0; i < 1 + 3 * request->stages; i++)
+	{
+		close(fds[i]);
+	}
+
+	for (i = 0; i < started; i++)
+	{
+		int status;
+		while (waitpid(pids[i], &status, 0) < 0 && errno == EINTR);
+		if (i + 1 == request->stages)
+		{
+			reply.launched = 1;
+			reply.status = status;
+		}
+	}
+
+	for (i = 0; i < request->stages; i++)
+	{
+		free(arguments[i]);
+	}
+	free(envp);
+	return reply;
+}
+
+void close_stages(launch_t *stages, size_t count)
+{
+	size_t i;
+	for (i = 0; i < count; i++)
+	{
+		int fd;
+		for (fd = 0; fd < 3; fd++)
+		{
+			if (stages[i].fds[fd] >= 0)
+			{
+				close(stages[i].fds[fd]);
+				stages[i].fds[fd] = -1;
+			}
+		}
+	}
+}
+
+int take_strings(char **strings, size_t count, char **position, char *end)
+{
+	size_t i;
+	for (i = 0; i < count; i++)
+	{
+		if (*position >= end)
+		{
+			return 0;
+		}
+
+		strings[i] = *position;
+		*position += strlen(*position) + 1;
+	}
+
+	strings[count] = NULL;
+	return *position <= end;
+}
+
+int send_fully(int socket, const void *data, size_t length)
+{
+	const char *bytes = data;
+	while (length > 0)
+	{
+		ssize_t sent = send(socket, bytes, length, MSG_NOSIGNAL);
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return 0;
+		}
+
+		bytes += sent;
+		length -= sent;
+	}
+
+	return 1;
+}
+
+int receive_fully(int socket, void *data, size_t length)
+{
+	char *bytes = data;
+	while (length > 0)
+	{
+		ssize_t received = recv(socket, bytes, length, MSG_WAITALL);
+		if (received < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (received <= 0)
+		{
+			return 0;
+		}
+
+		bytes += received;
+		length -= received;
+	}
+
+	return 1;
+}
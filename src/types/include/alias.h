@@ -58,6 +58,13 @@ alias_t *find_alias(alias_table_t *table, char *alias);
   */
 void print_aliases(alias_table_t *table);
 
+/**
+  * Performs a hash of a string based on the djb2 algorithm - see http://www.cse.yorku.ca/~oz/hash.html
+  * @param str the string to be hashed
+  * @return the hash value of the string
+  */
+size_t hash(char *str);
+
 /**
   * Clears and frees the memory associated with the alias table
   * @param table the table to be cleared
@@ -4,10 +4,24 @@
 #include <stddef.h>
 
 #include "status.h"
+#include "string_t.h"
+
+#define ERROR_TO_OUTPUT   1
+#define ERROR_TO_ORIGINAL 2
 
 /**
   * A struct holding information about a command, including its command number, the arguments, the
-  * number of arguments, and whether it is to execute in the background.
+  * number of arguments, whether it is to execute in the background, and where its input, output,
+  * and error output are redirected (NULL for no redirection). append is set for >>, and error_append
+  * when stderr goes to a file stdout was sent to with >> before being moved on. Redirections take
+  * effect from left to right, so error_to_output is ERROR_TO_OUTPUT for a 2>&1 (or &>) after the
+  * last > or >>, which sends stderr wherever stdout ends up going, and ERROR_TO_ORIGINAL for one
+  * before any, which sends it where stdout was before its redirection. Input may instead
+  * come from a here-string (<<< word, kept in here_string) or a here-document (<< delimiter, kept in
+  * here_delimiter), whose body, once read, is held in the sealed memfd here_document (-1 until then);
+  * only one of input, here_string and here_delimiter is ever set. A command whose
+  * output fans out (producer |+ branch |+ branch) has fanout pointing at the first branch, itself
+  * possibly a pipeline, and each branch points at the next through next_branch.
   */
 typedef struct command_t
 {
@@ -16,6 +30,17 @@ typedef struct command_t
 	size_t argc;
 	unsigned short background;
 	struct command_t *pipe;
+	char *input;
+	char *output;
+	char *error;
+	unsigned short append;
+	unsigned short error_to_output;
+	unsigned short error_append;
+	char *here_string;
+	char *here_delimiter;
+	int here_document;
+	struct command_t *fanout;
+	struct command_t *next_branch;
 } command_t;
 
 /**
@@ -27,12 +52,30 @@ typedef struct command_t
   */
 status_t copy_command(command_t *destination, command_t *source);
 
+/**
+  * Copies the command, each stage along its pipes and each of its branches, but not the arguments
+  * arrays or the strings they point at, which the copy shares with source. Expanding the copy then
+  * leaves source as it was, so that source can be run again. The copy's stages and branches are
+  * freed with free_linked_list(destination->pipe) and free_branches(destination)
+  * @param destination where the new copy will be placed
+  * @param source      the command to copy
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t share_command(command_t *destination, command_t *source);
+
 /**
   * Prints the command with its arguments, all on one line, without a newline
   * @param command the command to be printed
   */
 void print_command(command_t *command);
 
+/**
+  * Places the command with its arguments into s, formatted as print_command would print it
+  * @param command the command to be formatted
+  * @param s       out param; the string the command is assigned to
+  */
+void command_to_string(command_t *command, string_t *s);
+
 /**
   * Frees all of the memory associated wtih the given command
   * @param command the command to be freed
@@ -40,9 +83,16 @@ void print_command(command_t *command);
 void free_command(command_t *command);
 
 /**
-  * Frees the linked list of commands along pipe, and ONLY the commands, starting with command
+  * Frees the linked list of commands along pipe, and ONLY the commands, starting with command, along
+  * with any branches any of them fan out to
   * @param command the head of the linked list with which to begin the freeing
   */
 void free_linked_list(command_t *command);
 
+/**
+  * Frees the commands a command fans out to, and ONLY the commands, as free_linked_list does
+  * @param command the command whose branches are to be freed
+  */
+void free_branches(command_t *command);
+
 #endif
@@ -0,0 +1,79 @@
+#ifndef __COMPLETION__H__
+#define __COMPLETION__H__
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "status.h"
+
+/**
+  * A sorted table of every name that can be completed as a command (executables in the path,
+  * aliases, and builtins). Each name carries a count of how many sources provide it, so that it
+  * only disappears once the last of them is removed. The table has its own lock, since it is filled
+  * in by a background thread while the shell is already accepting commands
+  */
+typedef struct
+{
+	char **names;
+	size_t *references;
+	size_t num_names;
+	size_t capacity;
+	pthread_mutex_t lock;
+} completion_t;
+
+/**
+  * Initializes an empty completion table
+  * @param table the table to be initialized
+  */
+void initialize_completion(completion_t *table);
+
+/**
+  * Adds one reference to each of the num names in names, inserting the names not yet in the table.
+  * Adding many names at once costs a single merge rather than one insertion per name
+  * @param table the table into which the names should be placed
+  * @param names the names to be added; they are copied, not kept
+  * @param num   the number of names
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t add_completions(completion_t *table, char **names, size_t num);
+
+/**
+  * Adds one reference to name, inserting it if it is not yet in the table
+  * @param table the table into which the name should be placed
+  * @param name  the name to be added
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t add_completion(completion_t *table, char *name);
+
+/**
+  * Removes one reference to each of the num names in names, taking out of the table the names that
+  * no longer have any references
+  * @param table the table from which the names should be removed
+  * @param names the names to be removed
+  * @param num   the number of names
+  */
+void remove_completions(completion_t *table, char **names, size_t num);
+
+/**
+  * Removes one reference to name, taking it out of the table if that was the last one
+  * @param table the table from which the name should be removed
+  * @param name  the name to be removed
+  */
+void remove_completion(completion_t *table, char *name);
+
+/**
+  * Finds every name in the table beginning with prefix, in sorted order
+  * @param table  the table to be searched
+  * @param prefix the prefix the names must begin with
+  * @param num    out param; the number of names found
+  * @return a newly allocated array of newly allocated names, or NULL if none were found
+  */
+char **find_completions(completion_t *table, char *prefix, size_t *num);
+
+/**
+  * Clears and frees all of the memory associated with the table
+  * @param table the table to be cleared
+  */
+void clear_completion(completion_t *table);
+
+#endif
@@ -1,23 +1,54 @@
 #ifndef __ENVIRONMENT__H__
 #define __ENVIRONMENT__H__
 
+#include <stdio.h>
+
 #include "alias.h"
+#include "completion.h"
+#include "exec_index.h"
 #include "history.h"
+#include "jobs.h"
 #include "path.h"
+#include "variables.h"
+#include "../../misc/include/cache.h"
+#include "../../misc/include/tee.h"
+#include "../../misc/include/wildcard.h"
+#include "../../misc/include/zygote.h"
 
 /**
   * Holds all of the information about the user's current environment, including their path
-  * variable, their history, their aliases, and any open script file, with plenty room for any more
-  * to come
+  * variable, their history, their aliases, any open script log, when it is synced, and the engine
+  * copying output to it, the index of the commands in the path, the names that can be completed,
+  * whether pipelines are optimized or metered, the size of the pipes the shell creates, the file
+  * commands are being read from (NULL for the terminal), which here-documents are read from as well,
+  * the exit status of the last command waited for, the shell's variables, the directory listings
+  * globs are matched against, whether echo, true, false, test and printf run without an exec, the
+  * zygote that launches commands when one is running, the command cache, and the background jobs
+  * whose output is being kept, with plenty room for any more to come
   */
 typedef struct
 {
 	path_t *path;
 	history_t *history;
 	alias_table_t *aliases;
-	int script_file;
+	script_log_t *script_log;
 	unsigned short verbose;
 	string_t *prompt;
+	exec_index_t *exec_index;
+	completion_t *completion;
+	tee_engine_t *tee;
+	unsigned short script_sync;
+	unsigned short optimize;
+	size_t pipe_size;
+	unsigned short meter;
+	FILE *input;
+	int status;
+	variable_table_t *variables;
+	wildcard_cache_t *wildcards;
+	unsigned short coreutils;
+	zygote_t *zygote;
+	cache_t *cache;
+	job_table_t *jobs;
 } environment_t;
 
 /**
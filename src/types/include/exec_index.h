@@ -0,0 +1,93 @@
+#ifndef __EXEC_INDEX__H__
+#define __EXEC_INDEX__H__
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "completion.h"
+#include "path.h"
+#include "status.h"
+
+#define EXEC_INDEX_BUCKETS 4096
+
+/**
+  * An entry in the executable index, recording that a file with the given name exists in the path
+  * directory at index dir. Also includes a next pointer for use in a linked-list/hash table
+  */
+typedef struct exec_entry_t
+{
+	char *name;
+	size_t dir;
+	struct exec_entry_t *next;
+} exec_entry_t;
+
+/**
+  * Information kept about each directory in the index: the inotify watch on it (or -1 if it could
+  * not be watched) and its last known modification time, used when there is no watch
+  */
+typedef struct
+{
+	int watch;
+	struct timespec mtime;
+} exec_dir_t;
+
+/**
+  * A hash table mapping command names to the path directories that contain them, kept up to date
+  * either by inotify or, failing that, by checking the modification time of each directory. Every
+  * name added to or removed from the index is passed on to the completion table, if there is one.
+  * The directories are read by a background thread, so the index may not be used (other than
+  * through wait_exec_index) until building is done
+  */
+typedef struct
+{
+	exec_entry_t *entries[EXEC_INDEX_BUCKETS];
+	exec_dir_t *dirs;
+	size_t num_dirs;
+	int inotify_fd;
+	completion_t *completion;
+	path_t *path;
+	pthread_t builder;
+	unsigned short building;
+} exec_index_t;
+
+/**
+  * Rebuilds the index from scratch to hold every file in the directories of path, setting up a watch
+  * on each directory so that the index can be updated incrementally afterwards. The directories are
+  * read on a background thread; this function returns as soon as that thread is started
+  * @param index the index to be built
+  * @param path  the path whose directories are to be indexed
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t build_exec_index(exec_index_t *index, path_t *path);
+
+/**
+  * Waits for the background thread started by build_exec_index, if there is one, to finish. Must be
+  * called before the index is used after a build, and in particular before forking
+  * @param index the index to wait for
+  */
+void wait_exec_index(exec_index_t *index);
+
+/**
+  * Applies any changes made to the path directories since the last call, without blocking (other than
+  * to wait for a build in progress). Meant to be called between commands
+  * @param index the index to be updated
+  * @param path  the path the index was built from
+  */
+void update_exec_index(exec_index_t *index, path_t *path);
+
+/**
+  * Finds the first directory in the path that contains a file with the given name
+  * @param index the index to be searched
+  * @param name  the name of the command
+  * @return the index of the directory in the path, or -1 if no directory contains the command
+  */
+ssize_t find_executable(exec_index_t *index, char *name);
+
+/**
+  * Clears and frees all of the memory and watches associated with the index
+  * @param index the index to be cleared
+  */
+void clear_exec_index(exec_index_t *index);
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef __JOBS__H__
+#define __JOBS__H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "command.h"
+#include "status.h"
+
+#define JOBS_COMMAND "jobs"
+#define WAIT_COMMAND "wait"
+#define JOBS_OUTPUT  "-o"
+#define JOBS_PAGER   "less"
+
+#define JOBS_OUTPUT_LIMIT (4 * 1024 * 1024)
+#define JOBS_KEEP         16
+#define JOBS_SETTLE_MS    100
+
+/**
+  * Where a background job's output is kept: the pipe its stdout and stderr both write to (so the
+  * two stay in the order they were written), and a memfd of limit bytes that a thread of its own
+  * splices the pipe into as a ring, keeping the last limit bytes. received counts every byte that has
+  * come through the pipe, which places the next one in the ring. The output is reference counted,
+  * since the thread may still be draining a job the table has let go of, and freed by whoever leaves
+  * it last
+  */
+typedef struct
+{
+	int memfd;
+	int pipe;
+	size_t limit;
+	uint64_t received;
+	unsigned short drained;
+	size_t references;
+	pthread_mutex_t lock;
+	pthread_cond_t finished;
+} job_output_t;
+
+/**
+  * A command run in the background: the number it is known by, its process, where its output is
+  * kept, the command as it was typed, and, once it has been reaped, its exit status and whether the
+  * shell has said so
+  */
+typedef struct
+{
+	size_t number;
+	pid_t pid;
+	job_output_t *output;
+	char *command;
+	unsigned short finished;
+	unsigned short notified;
+	int status;
+} job_t;
+
+/**
+  * The background jobs the shell is keeping the output of, in the order they were started, the
+  * number the next one gets, how many bytes of output each keeps, and how many finished jobs are kept
+  * before the oldest is let go
+  */
+typedef struct
+{
+	job_t *jobs;
+	size_t num_jobs;
+	size_t capacity;
+	size_t next_number;
+	size_t limit;
+	size_t keep;
+} job_table_t;
+
+/**
+  * Creates where a background job's output is kept, before it is forked, and starts the thread that
+  * drains it
+  * @param output    out param; the job's output, to be handed to add_job once the job is forked
+  * @param limit     the number of bytes of output to keep
+  * @param pipe_size the size of the pipe's buffer, as for make_pipe
+  * @param input     out param; the write end of the pipe, close on exec, which the child puts on its
+  *                  stdout and stderr and the parent closes once the child has been forked
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t create_job_output(job_output_t **output, size_t limit, size_t pipe_size, int *input);
+
+/**
+  * Lets go of a job's output; it is freed once its thread has drained the pipe too
+  * @param output the output
+  */
+void release_job_output(job_output_t *output);
+
+/**
+  * Adds a job that has just been forked to the table, which then owns its output. If more finished
+  * jobs than the table keeps are left, the oldest that have been reported are let go
+  * @param table   the table
+  * @param pid     the job's process
+  * @param output  the job's output, from create_job_output
+  * @param command the command being run
+  * @param number  out param; the number the job was given, or NULL
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t add_job(job_table_t *table, pid_t pid, job_output_t *output, command_t *command, size_t *number);
+
+/**
+  * Finds a job by its number
+  * @param table  the table
+  * @param number the job's number
+  * @return the job, or NULL if there is no such job
+  */
+job_t *find_job(job_table_t *table, size_t number);
+
+/**
+  * Reaps any jobs that have finished, without waiting for the rest
+  * @param table the table
+  */
+void update_jobs(job_table_t *table);
+
+/**
+  * Waits for every job in the table to finish
+  * @param table the table
+  */
+void wait_jobs(job_table_t *table);
+
+/**
+  * Reaps what has finished and prints a line for each job that has finished since the last call,
+  * with its status and how much output it left, then lets go of the oldest reported jobs past the
+  * number the table keeps
+  * @param table the table
+  */
+void notify_jobs(job_table_t *table);
+
+/**
+  * Prints each job's number, whether it is still running, how much output it wrote, and its command
+  * @param table the table
+  */
+void print_jobs(job_table_t *table);
+
+/**
+  * Writes what a job has output so far to the given descriptor, in the order it was written. If the
+  * job wrote more than its output keeps, a line saying how many bytes were dropped comes first. The
+  * memfd's pages are sent as they are, with sendfile. A running job's output is a snapshot, whose
+  * oldest bytes may already have been overwritten by the time they are sent
+  * @param job the job
+  * @param to  the descriptor to write to
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t print_job_output(job_t *job, int to);
+
+/**
+  * Removes a job from the table, letting go of its output; a job still running keeps writing to its
+  * pipe, whose thread drains it to the end before the output is freed
+  * @param table  the table
+  * @param number the job's number
+  */
+void remove_job(job_table_t *table, size_t number);
+
+/**
+  * Clears and frees the memory associated with the table, letting go of every job's output
+  * @param table the table to be cleared
+  */
+void clear_jobs(job_table_t *table);
+
+#endif
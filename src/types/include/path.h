@@ -1,27 +1,50 @@
 #ifndef __PATH__H__
 #define __PATH__H__
 
+#include <sys/types.h>
+
 #include "command.h"
 #include "status.h"
 #include "string_t.h"
 
+#define PATH_VALIDATE_THREADS    4
+#define PATH_VALIDATE_TIMEOUT_MS 2000
+#define PATH_SLOW_DIR_MS         100
+
+/**
+  * A cache entry recording an absolute directory that has already been validated, along with the
+  * device and inode it resolved to, so that a repeated set path only needs to stat it again
+  */
+typedef struct path_dir_info_t
+{
+	char *name;
+	dev_t device;
+	ino_t inode;
+	struct path_dir_info_t *next;
+} path_dir_info_t;
+
 /**
   * A struct to hold an array of the path directories, along with the number of direcotires in the
-  * path
+  * path and the cache of directories that have been validated so far
   */
 typedef struct
 {
     string_t *dirs;
     size_t num_dirs;
+    path_dir_info_t *validated;
 } path_t;
 
 /**
-  * Sets the given path appropriately, given a command from which it should be set
+  * Sets the given path appropriately, given a command from which it should be set. Directories are
+  * validated concurrently, those still matching the path's cache by a stat alone, and any directory
+  * that does not respond within PATH_VALIDATE_TIMEOUT_MS is left out of the path rather than
+  * blocking the shell
   * @param path    the path which is to be set
   * @param command the command from which the path is being set
+  * @param verbose if true, directories that are slow to validate or duplicated are reported
   * @return a status code indicating whether an error occurred during execution of the function
   */
-status_t set_path(path_t *path, command_t *command);
+status_t set_path(path_t *path, command_t *command, unsigned short verbose);
 
 /**
   * Resizes the path to hold num_dirs number of directories and initializes all of the string_t
@@ -30,6 +30,13 @@
 #define INVALID_VAR     20
 #define DIR_ERROR       21 
 #define PIPE_ERROR      22
+#define THREAD_ERROR    23
+#define REDIRECT_ERROR  24
+#define HEREDOC_ERROR   25
+#define SHELL_EXIT      26
+#define SOCKET_ERROR    27
+#define CACHE_ERROR     28
+#define JOB_ERROR       29
 
 /**
   * An error type. Returned from functions to indicate what type of error occurred; generally one of
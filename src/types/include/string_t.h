@@ -4,14 +4,32 @@
 MAKE_VECTOR_TYPE(char)
 typedef char_vector_t string_t;
 
+/**
+  * A non-owning view of length characters starting at start. The characters are NOT null
+  * terminated, and the view is only valid for as long as the buffer it points into
+  */
+typedef struct
+{
+	char *start;
+	size_t length;
+} string_view_t;
+
 void string_initialize(string_t *s);
 void string_uninitialize(string_t *s);
 void string_assign_from_char_array(string_t *s, char *arr);
 void string_assign_from_char_array_with_size(string_t *s, char *arr, size_t length);
+void string_assign_from_view(string_t *s, string_view_t view);
 void string_concatenate(string_t *a, string_t *b);
 void string_concatenate_char_array(string_t *s, char *arr);
+void string_concatenate_view(string_t *s, string_view_t view);
 string_t *string_split(string_t *s, char delim, size_t *num);
 char **string_split_as_c_strs(string_t *s, char delim, size_t *num);
+string_view_t *string_split_as_views(string_t *s, char delim, size_t *num);
+string_view_t *char_array_split_as_views(char *arr, size_t length, char delim, size_t *num);
 char *string_c_str(string_t *s);
 void string_getline(string_t *s, FILE *stream);
+
+string_view_t string_view_from_char_array(char *arr);
+int string_view_compare_char_array(string_view_t view, char *arr);
+char *string_view_strdup(string_view_t view);
 #endif
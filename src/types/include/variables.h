@@ -0,0 +1,102 @@
+#ifndef __VARIABLES__H__
+#define __VARIABLES__H__
+
+#include <stddef.h>
+
+#include "status.h"
+
+#define VARIABLE_BUCKETS 256
+
+/**
+  * Holds a shell variable as the string "name=value", which, if the variable is exported, is also
+  * the string its slot in the table's envp points at. Also includes the variable's slot in envp, and
+  * a next pointer for use in a linked-list/hash table
+  */
+typedef struct variable_t
+{
+	char *entry;
+	size_t name_length;
+	unsigned short exported;
+	size_t env_index;
+	struct variable_t *next;
+} variable_t;
+
+/**
+  * A hash table for the shell's variables, along with the envp array handed to every command, kept
+  * up to date as variables are set, exported, and unset: a change touches only the changed
+  * variable's slot, and unsetting one moves the last slot into its place. Launching a command never
+  * rebuilds it
+  */
+typedef struct
+{
+	variable_t *variable_entries[VARIABLE_BUCKETS];
+	char **envp;
+	size_t num_env;
+	size_t env_capacity;
+} variable_table_t;
+
+/**
+  * Determines whether name can be the name of a variable: a letter or underscore, followed by any
+  * number of letters, digits, and underscores
+  * @param name the name to be checked
+  * @return nonzero if it can, zero otherwise
+  */
+int valid_variable_name(char *name);
+
+/**
+  * Sets a variable, creating it if need be; if it is exported, its slot in envp is updated too
+  * @param table the table holding the variable
+  * @param name  the name of the variable
+  * @param value the variable's new value
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t set_variable(variable_table_t *table, char *name, char *value);
+
+/**
+  * Exports a variable, giving it a slot at the end of envp; a variable that does not exist yet is
+  * created, empty
+  * @param table the table holding the variable
+  * @param name  the name of the variable
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t export_variable(variable_table_t *table, char *name);
+
+/**
+  * Removes a variable, and its slot in envp if it was exported; does nothing if it does not exist
+  * @param table the table holding the variable
+  * @param name  the name of the variable
+  */
+void unset_variable(variable_table_t *table, char *name);
+
+/**
+  * Finds the value of a variable
+  * @param table the table holding the variable
+  * @param name  the name of the variable
+  * @return the value, or NULL if there is no such variable
+  */
+char *get_variable(variable_table_t *table, char *name);
+
+/**
+  * Adds every entry of an environment (such as the shell's own environ) as an exported variable. The
+  * environment is only read, never written to
+  * @param table the table the variables are added to
+  * @param envp  the NULL terminated array of "name=value" strings
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t import_variables(variable_table_t *table, char **envp);
+
+/**
+  * Prints the variables in the table, one "name = value" per line, or only the exported ones, as
+  * "export name=value"
+  * @param table         the table to be printed
+  * @param exported_only if true, only exported variables are printed
+  */
+void print_variables(variable_table_t *table, unsigned short exported_only);
+
+/**
+  * Clears and frees the memory associated with the variable table, envp included
+  * @param table the table to be cleared
+  */
+void clear_variables(variable_table_t *table);
+
+#endif
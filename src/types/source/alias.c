@@ -3,14 +3,8 @@
 #include <string.h>
 
 #include "../include/alias.h"
+#include "../../misc/include/here_document.h"
 #include "../../misc/include/parse.h"
-/**
-  * Performs a hash of a string based on the djb2 algorithm - see http://www.cse.yorku.ca/~oz/hash.html
-  * @param str the string to be hashed
-  * @return the hash value of the string
-  */
-size_t hash(char *str);
-
 /**
   * Performs a hash using the given hash function, then mods to fit the hash in the buckets of the
   * alias_table_t type
@@ -51,6 +45,15 @@ status_t add_alias(alias_table_t *table, char *name, char *command, unsigned sho
 		return error;
 	}
 
+	//there is no body to read for a here-document in a definition
+	if (has_here_document(&new_command))
+	{
+		free(new_command.arguments);
+		free_linked_list(new_command.pipe);
+		free_branches(&new_command);
+		return FORMAT_ERROR;
+	}
+
 	command_t *command_copy = malloc(sizeof *command_copy);
 	if (command_copy == NULL)
 	{
@@ -61,6 +64,7 @@ status_t add_alias(alias_table_t *table, char *name, char *command, unsigned sho
 	error = copy_command(command_copy, &new_command);
 	free(new_command.arguments);
 	free_linked_list(new_command.pipe);
+	free_branches(&new_command);
 	if (error != SUCCESS)
 	{
 		free_command(command_copy);
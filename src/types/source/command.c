@@ -1,10 +1,31 @@
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "../include/command.h"
 
-void print_single_command(command_t *command);
+/**
+  * Appends the pipeline starting at command, without any branches it fans out to, to s
+  * @param command the first command of the pipeline
+  * @param s       the string to which the pipeline is appended
+  */
+void pipeline_to_string(command_t *command, string_t *s);
+
+/**
+  * Appends the single command, not following any pipes, to s
+  * @param command the command to be appended
+  * @param s       the string to which the command is appended
+  */
+void single_command_to_string(command_t *command, string_t *s);
+
+/**
+  * Appends the command's redirections, if it has any, to s
+  * @param command the command whose redirections are appended
+  * @param s       the string to which the redirections are appended
+  */
+void redirections_to_string(command_t *command, string_t *s);
 
 status_t copy_command(command_t *destination, command_t *source)
 {
@@ -31,6 +52,34 @@ status_t copy_command(command_t *destination, command_t *source)
         }
     }
     new_array[i] = NULL;
+
+	char **redirections[] = { &destination->input, &destination->output, &destination->error, &destination->here_string, &destination->here_delimiter };
+	char *sources[] = { source->input, source->output, source->error, source->here_string, source->here_delimiter };
+	size_t k;
+	for (k = 0; k < 5; k++)
+	{
+		*redirections[k] = sources[k] == NULL ? NULL : strdup(sources[k]);
+		if (sources[k] != NULL && *redirections[k] == NULL)
+		{
+			size_t j;
+			for (j = 0; j < k; j++)
+			{
+				free(*redirections[j]);
+			}
+			for (j = 0; j < i; j++)
+			{
+				free(new_array[j]);
+			}
+			free(new_array);
+			return MEMORY_ERROR;
+		}
+	}
+	destination->append = source->append;
+	destination->error_to_output = source->error_to_output;
+	destination->error_append = source->error_append;
+
+	//the document is sealed, so the copy can share it; it is still there when run from the history
+	destination->here_document = source->here_document < 0 ? -1 : fcntl(source->here_document, F_DUPFD_CLOEXEC, 0);
 	
 	command_t *pipe = source->pipe;
 	if (pipe != NULL)
@@ -46,6 +95,15 @@ status_t copy_command(command_t *destination, command_t *source)
 			}
 			free(new_array);
 			free(pipe_copy);
+			free(destination->input);
+			free(destination->output);
+			free(destination->error);
+			free(destination->here_string);
+			free(destination->here_delimiter);
+			if (destination->here_document >= 0)
+			{
+				close(destination->here_document);
+			}
 			return error;
 		}
 
@@ -60,39 +118,179 @@ status_t copy_command(command_t *destination, command_t *source)
     destination->argc = source->argc;
     destination->background = source->background;
 
+	//branches are copied the same way as pipes, through the same recursion
+	command_t **copies[] = { &destination->fanout, &destination->next_branch };
+	command_t *originals[] = { source->fanout, source->next_branch };
+	destination->fanout = NULL;
+	destination->next_branch = NULL;
+	size_t b;
+	for (b = 0; b < 2; b++)
+	{
+		if (originals[b] == NULL)
+		{
+			continue;
+		}
+
+		command_t *branch_copy = malloc(sizeof *branch_copy);
+		status_t error = branch_copy == NULL ? MEMORY_ERROR : copy_command(branch_copy, originals[b]);
+		if (error != SUCCESS)
+		{
+			free(branch_copy);
+			free_command(destination);
+			return error;
+		}
+		*copies[b] = branch_copy;
+	}
+
     return SUCCESS;
 }
 
+status_t share_command(command_t *destination, command_t *source)
+{
+	*destination = *source;
+	destination->pipe = NULL;
+	destination->fanout = NULL;
+
+	//only the first stage of a pipeline fans out, so the others never have branches to copy
+	command_t **stage = &destination->pipe;
+	command_t *original;
+	for (original = source->pipe; original != NULL; original = original->pipe)
+	{
+		if ((*stage = malloc(sizeof **stage)) == NULL)
+		{
+			free_linked_list(destination->pipe);
+			destination->pipe = NULL;
+			return MEMORY_ERROR;
+		}
+		**stage = *original;
+		(*stage)->pipe = NULL;
+		(*stage)->fanout = NULL;
+		stage = &(*stage)->pipe;
+	}
+
+	command_t **branch = &destination->fanout;
+	for (original = source->fanout; original != NULL; original = original->next_branch)
+	{
+		status_t error = MEMORY_ERROR;
+		if ((*branch = malloc(sizeof **branch)) == NULL || (error = share_command(*branch, original)) != SUCCESS)
+		{
+			free(*branch);
+			*branch = NULL;
+			free_linked_list(destination->pipe);
+			free_branches(destination);
+			destination->pipe = NULL;
+			destination->fanout = NULL;
+			return error;
+		}
+		(*branch)->next_branch = NULL;
+		branch = &(*branch)->next_branch;
+	}
+
+	return SUCCESS;
+}
+
 void print_command(command_t *command)
 {
-	print_single_command(command);
+	string_t s;
+	string_initialize(&s);
+	command_to_string(command, &s);
+	fprintf(stdout, "%s", string_c_str(&s));
+	string_uninitialize(&s);
+}
+
+void command_to_string(command_t *command, string_t *s)
+{
+	char_vector_clear(s);
+	pipeline_to_string(command, s);
+	command_t *branch;
+	for (branch = command->fanout; branch != NULL; branch = branch->next_branch)
+	{
+		string_concatenate_char_array(s, " |+ ");
+		pipeline_to_string(branch, s);
+	}
+
+	if (command->background)
+	{
+		string_concatenate_char_array(s, " &");
+	}
+}
+
+void pipeline_to_string(command_t *command, string_t *s)
+{
+	single_command_to_string(command, s);
 	command_t *curr_command = command->pipe;
 	while (curr_command != NULL)
 	{
-		fprintf(stdout, " | ");
-		print_single_command(curr_command);
+		string_concatenate_char_array(s, " | ");
+		single_command_to_string(curr_command, s);
 		curr_command = curr_command->pipe;
 	}
 }
 
-void print_single_command(command_t *command)
+void single_command_to_string(command_t *command, string_t *s)
 {
-    if (command->argc < 1)
-    {
-        return;
-    }
+	if (command->argc < 1)
+	{
+		return;
+	}
 
-    fprintf(stdout, "%s", command->arguments[0]);
-    size_t j;
-    for (j = 1; command->arguments[j]; j++)
-    {
-        fprintf(stdout, " %s", command->arguments[j]);
-    }
+	string_concatenate_char_array(s, command->arguments[0]);
+	size_t j;
+	for (j = 1; command->arguments[j]; j++)
+	{
+		char_vector_push_back(s, ' ');
+		string_concatenate_char_array(s, command->arguments[j]);
+	}
 
-    if (command->background)
-    {
-        fprintf(stdout, " &");
-    }
+	redirections_to_string(command, s);
+}
+
+void redirections_to_string(command_t *command, string_t *s)
+{
+	if (command->input != NULL)
+	{
+		string_concatenate_char_array(s, " < ");
+		string_concatenate_char_array(s, command->input);
+	}
+
+	if (command->here_string != NULL)
+	{
+		string_concatenate_char_array(s, strchr(command->here_string, ' ') != NULL ? " <<< \"" : " <<< ");
+		string_concatenate_char_array(s, command->here_string);
+		if (strchr(command->here_string, ' ') != NULL)
+		{
+			char_vector_push_back(s, '"');
+		}
+	}
+
+	if (command->here_delimiter != NULL)
+	{
+		string_concatenate_char_array(s, " << ");
+		string_concatenate_char_array(s, command->here_delimiter);
+	}
+
+	//&> is written out as the equivalent > file 2>&1, and a 2>&1 that went before the > stays there
+	if (command->error_to_output == ERROR_TO_ORIGINAL)
+	{
+		string_concatenate_char_array(s, " 2>&1");
+	}
+
+	if (command->output != NULL)
+	{
+		string_concatenate_char_array(s, command->append ? " >> " : " > ");
+		string_concatenate_char_array(s, command->output);
+	}
+
+	if (command->error != NULL)
+	{
+		string_concatenate_char_array(s, command->error_append ? " 2>> " : " 2> ");
+		string_concatenate_char_array(s, command->error);
+	}
+
+	if (command->error_to_output == ERROR_TO_OUTPUT)
+	{
+		string_concatenate_char_array(s, " 2>&1");
+	}
 }
 
 void free_command(command_t *command)
@@ -103,11 +301,25 @@ void free_command(command_t *command)
         free(command->arguments[i]);
     }
     free(command->arguments);
+	free(command->input);
+	free(command->output);
+	free(command->error);
+	free(command->here_string);
+	free(command->here_delimiter);
+	if (command->here_document >= 0)
+	{
+		close(command->here_document);
+	}
 
-	if (command->pipe != NULL)
+	command_t *linked[] = { command->pipe, command->fanout, command->next_branch };
+	size_t i_linked;
+	for (i_linked = 0; i_linked < 3; i_linked++)
 	{
-		free_command(command->pipe);
-		free(command->pipe);
+		if (linked[i_linked] != NULL)
+		{
+			free_command(linked[i_linked]);
+			free(linked[i_linked]);
+		}
 	}
 }
 
@@ -116,7 +328,20 @@ void free_linked_list(command_t *command)
 	while (command != NULL)
 	{
 		command_t *next = command->pipe;
+		free_branches(command);
 		free(command);
 		command = next;
 	}
 }
+
+void free_branches(command_t *command)
+{
+	command_t *branch = command->fanout;
+	while (branch != NULL)
+	{
+		command_t *next = branch->next_branch;
+		free_linked_list(branch->pipe);
+		free(branch);
+		branch = next;
+	}
+}
@@ -0,0 +1,260 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/completion.h"
+
+/**
+  * Compares the two strings pointed to by a and b, for use with qsort
+  * @param a a pointer to the first string
+  * @param b a pointer to the second string
+  * @return less than, equal to, or greater than zero as with strcmp
+  */
+int compare_names(const void *a, const void *b);
+
+/**
+  * Finds the position of the first name in the table that is not less than name. Must be called
+  * with the table's lock held
+  * @param table the table to be searched
+  * @param name  the name to search for
+  * @return the index of the first name not less than name, or num_names if there is none
+  */
+size_t lower_bound(completion_t *table, char *name);
+
+void initialize_completion(completion_t *table)
+{
+	table->names = NULL;
+	table->references = NULL;
+	table->num_names = 0;
+	table->capacity = 0;
+	pthread_mutex_init(&table->lock, NULL);
+}
+
+status_t add_completions(completion_t *table, char **names, size_t num)
+{
+	if (num == 0)
+	{
+		return SUCCESS;
+	}
+
+	char **sorted = malloc(num * sizeof *sorted);
+	if (sorted == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+	memcpy(sorted, names, num * sizeof *sorted);
+	qsort(sorted, num, sizeof *sorted, compare_names);
+
+	pthread_mutex_lock(&table->lock);
+	size_t capacity = table->num_names + num;
+	char **merged_names = malloc(capacity * sizeof *merged_names);
+	size_t *merged_references = malloc(capacity * sizeof *merged_references);
+	if (merged_names == NULL || merged_references == NULL)
+	{
+		pthread_mutex_unlock(&table->lock);
+		free(merged_names);
+		free(merged_references);
+		free(sorted);
+		return MEMORY_ERROR;
+	}
+
+	//merge the two sorted lists; on a tie the existing name goes first, so that the new copy of it
+	//(and any duplicates among the new names) simply count as another reference
+	size_t i = 0, j = 0, k = 0;
+	while (i < table->num_names || j < num)
+	{
+		if (j == num || (i < table->num_names && strcmp(table->names[i], sorted[j]) <= 0))
+		{
+			merged_names[k] = table->names[i];
+			merged_references[k] = table->references[i];
+			i++;
+			k++;
+		}
+		else if (k > 0 && strcmp(merged_names[k - 1], sorted[j]) == 0)
+		{
+			merged_references[k - 1]++;
+			j++;
+		}
+		else
+		{
+			merged_names[k] = strdup(sorted[j]);
+			merged_references[k] = 1;
+			j++;
+			k += merged_names[k] != NULL;
+		}
+	}
+
+	free(table->names);
+	free(table->references);
+	table->names = merged_names;
+	table->references = merged_references;
+	table->num_names = k;
+	table->capacity = capacity;
+	pthread_mutex_unlock(&table->lock);
+
+	free(sorted);
+	return SUCCESS;
+}
+
+status_t add_completion(completion_t *table, char *name)
+{
+	pthread_mutex_lock(&table->lock);
+	size_t position = lower_bound(table, name);
+	if (position < table->num_names && strcmp(table->names[position], name) == 0)
+	{
+		table->references[position]++;
+		pthread_mutex_unlock(&table->lock);
+		return SUCCESS;
+	}
+
+	if (table->num_names == table->capacity)
+	{
+		size_t capacity = table->capacity == 0 ? 64 : 2 * table->capacity;
+		char **names = realloc(table->names, capacity * sizeof *names);
+		if (names == NULL)
+		{
+			pthread_mutex_unlock(&table->lock);
+			return MEMORY_ERROR;
+		}
+		table->names = names;
+
+		size_t *references = realloc(table->references, capacity * sizeof *references);
+		if (references == NULL)
+		{
+			pthread_mutex_unlock(&table->lock);
+			return MEMORY_ERROR;
+		}
+		table->references = references;
+		table->capacity = capacity;
+	}
+
+	char *copy = strdup(name);
+	if (copy == NULL)
+	{
+		pthread_mutex_unlock(&table->lock);
+		return MEMORY_ERROR;
+	}
+
+	size_t to_move = table->num_names - position;
+	memmove(table->names + position + 1, table->names + position, to_move * sizeof *table->names);
+	memmove(table->references + position + 1, table->references + position, to_move * sizeof *table->references);
+	table->names[position] = copy;
+	table->references[position] = 1;
+	table->num_names++;
+	pthread_mutex_unlock(&table->lock);
+
+	return SUCCESS;
+}
+
+void remove_completions(completion_t *table, char **names, size_t num)
+{
+	pthread_mutex_lock(&table->lock);
+	size_t i;
+	for (i = 0; i < num; i++)
+	{
+		size_t position = lower_bound(table, names[i]);
+		if (position < table->num_names && strcmp(table->names[position], names[i]) == 0)
+		{
+			table->references[position]--;
+		}
+	}
+
+	//then squeeze out every name left without references in a single pass
+	size_t kept = 0;
+	for (i = 0; i < table->num_names; i++)
+	{
+		if (table->references[i] == 0)
+		{
+			free(table->names[i]);
+			continue;
+		}
+
+		table->names[kept] = table->names[i];
+		table->references[kept] = table->references[i];
+		kept++;
+	}
+	table->num_names = kept;
+	pthread_mutex_unlock(&table->lock);
+}
+
+void remove_completion(completion_t *table, char *name)
+{
+	remove_completions(table, &name, 1);
+}
+
+char **find_completions(completion_t *table, char *prefix, size_t *num)
+{
+	*num = 0;
+	size_t prefix_length = strlen(prefix);
+
+	pthread_mutex_lock(&table->lock);
+	size_t start = lower_bound(table, prefix);
+	size_t end = start;
+	while (end < table->num_names && strncmp(table->names[end], prefix, prefix_length) == 0)
+	{
+		end++;
+	}
+
+	if (end == start)
+	{
+		pthread_mutex_unlock(&table->lock);
+		return NULL;
+	}
+
+	char **found = malloc((end - start) * sizeof *found);
+	if (found == NULL)
+	{
+		pthread_mutex_unlock(&table->lock);
+		return NULL;
+	}
+
+	size_t i;
+	for (i = start; i < end; i++)
+	{
+		found[*num] = strdup(table->names[i]);
+		*num += found[*num] != NULL;
+	}
+	pthread_mutex_unlock(&table->lock);
+
+	return found;
+}
+
+void clear_completion(completion_t *table)
+{
+	size_t i;
+	for (i = 0; i < table->num_names; i++)
+	{
+		free(table->names[i]);
+	}
+	free(table->names);
+	free(table->references);
+	table->names = NULL;
+	table->references = NULL;
+	table->num_names = 0;
+	table->capacity = 0;
+	pthread_mutex_destroy(&table->lock);
+}
+
+int compare_names(const void *a, const void *b)
+{
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+size_t lower_bound(completion_t *table, char *name)
+{
+	size_t low = 0;
+	size_t high = table->num_names;
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+		if (strcmp(table->names[middle], name) < 0)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low;
+}
@@ -1,16 +1,23 @@
-#include <unistd.h>
-
 #include "../include/environment.h"
 
 void clear_environment(environment_t *environment)
 {
+	//the index's builder thread may still be reading the path, so it is joined before the path goes
+	clear_exec_index(environment->exec_index);
+	clear_completion(environment->completion);
 	clear_path(environment->path);
 	clear_history(environment->history);
 	clear_aliases(environment->aliases);
-	if (environment->script_file >= 0)
+	clear_variables(environment->variables);
+	clear_wildcard_cache(environment->wildcards);
+	stop_tee_engine(environment->tee);
+	stop_zygote(environment->zygote);
+	clear_cache(environment->cache);
+	clear_jobs(environment->jobs);
+	if (environment->script_log != NULL)
 	{
-		close(environment->script_file);
+		release_script_log(environment->script_log);
 	}
-	environment->script_file = -1;
+	environment->script_log = NULL;
 	string_uninitialize(environment->prompt);
 }
@@ -0,0 +1,437 @@
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/alias.h"
+#include "../include/exec_index.h"
+
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#define EVENT_BUFFER_SIZE 4096
+
+/**
+  * Performs a hash using the given hash function, then mods to fit the hash in the buckets of the
+  * exec_index_t type
+  * @param name the command name to be hashed
+  */
+size_t exec_hash(char *name);
+
+/**
+  * Adds an entry for name in the directory dir, unless such an entry already exists. The caller is
+  * responsible for passing the new name on to the completion table
+  * @param index the index into which the entry should be placed
+  * @param name  the name of the file
+  * @param dir   the index of the directory in the path
+  * @return the new entry, or NULL if the entry already existed or could not be allocated
+  */
+exec_entry_t *add_exec_entry(exec_index_t *index, char *name, size_t dir);
+
+/**
+  * Removes the entry for name in the directory dir, if there is one
+  * @param index the index from which the entry should be removed
+  * @param name  the name of the file
+  * @param dir   the index of the directory in the path
+  */
+void remove_exec_entry(exec_index_t *index, char *name, size_t dir);
+
+/**
+  * Removes every entry belonging to the directory dir
+  * @param index the index from which the entries should be removed
+  * @param dir   the index of the directory in the path
+  */
+void remove_dir_entries(exec_index_t *index, size_t dir);
+
+/**
+  * Reads the directory dir of the path, adding an entry for every file in it and remembering its
+  * modification time
+  * @param index the index into which the entries should be placed
+  * @param path  the path the index is being built from
+  * @param dir   the index of the directory in the path
+  */
+void scan_dir(exec_index_t *index, path_t *path, size_t dir);
+
+/**
+  * The function run by the background thread started by build_exec_index; reads every directory
+  * @param arg the exec_index_t being built
+  * @return always NULL
+  */
+void *build_worker(void *arg);
+
+/**
+  * Reads every pending inotify event without blocking, applying each to the index
+  * @param index the index to be updated
+  * @param path  the path the index was built from
+  */
+void process_events(exec_index_t *index, path_t *path);
+
+/**
+  * Rescans, from scratch, any unwatched directory whose modification time has changed
+  * @param index the index to be updated
+  * @param path  the path the index was built from
+  */
+void check_mtimes(exec_index_t *index, path_t *path);
+
+status_t build_exec_index(exec_index_t *index, path_t *path)
+{
+	completion_t *completion = index->completion;
+	clear_exec_index(index);
+	index->completion = completion;
+	index->path = path;
+
+	//allocate one extra so that a built index never has NULL dirs, even with an empty path
+	index->dirs = malloc((path->num_dirs + 1) * sizeof *index->dirs);
+	if (index->dirs == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+	index->num_dirs = path->num_dirs;
+
+	//if inotify is not available, every directory just falls back to having its mtime checked
+	index->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	//set up the watches before reading so that nothing created in between is missed
+	size_t i;
+	for (i = 0; i < index->num_dirs; i++)
+	{
+		index->dirs[i].watch = -1;
+		index->dirs[i].mtime.tv_sec = 0;
+		index->dirs[i].mtime.tv_nsec = 0;
+		if (index->inotify_fd >= 0)
+		{
+			index->dirs[i].watch = inotify_add_watch(index->inotify_fd, string_c_str(path->dirs + i), WATCH_EVENTS);
+		}
+	}
+
+	//reading the directories is the slow part, so leave it to a background thread if possible
+	if (pthread_create(&index->builder, NULL, build_worker, index) == 0)
+	{
+		index->building = 1;
+	}
+	else
+	{
+		build_worker(index);
+	}
+
+	return SUCCESS;
+}
+
+void wait_exec_index(exec_index_t *index)
+{
+	if (index->building)
+	{
+		pthread_join(index->builder, NULL);
+		index->building = 0;
+	}
+}
+
+void update_exec_index(exec_index_t *index, path_t *path)
+{
+	wait_exec_index(index);
+
+	//an index never built has no inotify descriptor, only a zero for one (stdin)
+	if (index->dirs != NULL && index->inotify_fd >= 0)
+	{
+		process_events(index, path);
+	}
+
+	//processing the events may have started a rebuild, which has to finish before checking mtimes
+	wait_exec_index(index);
+
+	check_mtimes(index, path);
+}
+
+ssize_t find_executable(exec_index_t *index, char *name)
+{
+	//a command may be in several directories; the one earliest in the path wins
+	ssize_t found = -1;
+	exec_entry_t *entry = index->entries[exec_hash(name)];
+	while (entry != NULL)
+	{
+		if (strcmp(entry->name, name) == 0 && (found < 0 || entry->dir < (size_t) found))
+		{
+			found = entry->dir;
+		}
+
+		entry = entry->next;
+	}
+
+	return found;
+}
+
+void clear_exec_index(exec_index_t *index)
+{
+	wait_exec_index(index);
+	size_t i;
+	for (i = 0; i < index->num_dirs; i++)
+	{
+		remove_dir_entries(index, i);
+	}
+
+	//closing the inotify descriptor removes all of the watches along with it
+	if (index->dirs != NULL && index->inotify_fd >= 0)
+	{
+		close(index->inotify_fd);
+	}
+	index->inotify_fd = -1;
+
+	free(index->dirs);
+	index->dirs = NULL;
+	index->num_dirs = 0;
+}
+
+size_t exec_hash(char *name)
+{
+	return hash(name) % EXEC_INDEX_BUCKETS;
+}
+
+exec_entry_t *add_exec_entry(exec_index_t *index, char *name, size_t dir)
+{
+	size_t hash_val = exec_hash(name);
+	exec_entry_t *entry = index->entries[hash_val];
+	while (entry != NULL)
+	{
+		if (entry->dir == dir && strcmp(entry->name, name) == 0)
+		{
+			return NULL;
+		}
+		entry = entry->next;
+	}
+
+	exec_entry_t *new_entry = malloc(sizeof *new_entry);
+	if (new_entry == NULL)
+	{
+		return NULL;
+	}
+
+	new_entry->name = strdup(name);
+	if (new_entry->name == NULL)
+	{
+		free(new_entry);
+		return NULL;
+	}
+
+	new_entry->dir = dir;
+	new_entry->next = index->entries[hash_val];
+	index->entries[hash_val] = new_entry;
+	return new_entry;
+}
+
+void remove_exec_entry(exec_index_t *index, char *name, size_t dir)
+{
+	exec_entry_t **entry = &index->entries[exec_hash(name)];
+	while (*entry != NULL)
+	{
+		if ((*entry)->dir == dir && strcmp((*entry)->name, name) == 0)
+		{
+			exec_entry_t *to_be_freed = *entry;
+			*entry = to_be_freed->next;
+			if (index->completion != NULL)
+			{
+				remove_completion(index->completion, to_be_freed->name);
+			}
+			free(to_be_freed->name);
+			free(to_be_freed);
+			return;
+		}
+		entry = &(*entry)->next;
+	}
+}
+
+void remove_dir_entries(exec_index_t *index, size_t dir)
+{
+	//unlink the directory's entries into their own list first, so that the completion table can
+	//drop all of their names at once
+	exec_entry_t *removed = NULL;
+	size_t num_removed = 0;
+	size_t i;
+	for (i = 0; i < EXEC_INDEX_BUCKETS; i++)
+	{
+		exec_entry_t **entry = &index->entries[i];
+		while (*entry != NULL)
+		{
+			if ((*entry)->dir == dir)
+			{
+				exec_entry_t *to_be_removed = *entry;
+				*entry = to_be_removed->next;
+				to_be_removed->next = removed;
+				removed = to_be_removed;
+				num_removed++;
+			}
+			else
+			{
+				entry = &(*entry)->next;
+			}
+		}
+	}
+
+	char **names = malloc(num_removed * sizeof *names);
+	exec_entry_t *entry = removed;
+	for (i = 0; entry != NULL && names != NULL; i++, entry = entry->next)
+	{
+		names[i] = entry->name;
+	}
+
+	if (index->completion != NULL && names != NULL)
+	{
+		remove_completions(index->completion, names, num_removed);
+	}
+	free(names);
+
+	while (removed != NULL)
+	{
+		exec_entry_t *tmp = removed->next;
+		free(removed->name);
+		free(removed);
+		removed = tmp;
+	}
+}
+
+void scan_dir(exec_index_t *index, path_t *path, size_t dir)
+{
+	char *dir_name = string_c_str(path->dirs + dir);
+	struct stat info;
+	if (stat(dir_name, &info) == 0)
+	{
+		index->dirs[dir].mtime = info.st_mtim;
+	}
+
+	DIR *stream = opendir(dir_name);
+	if (stream == NULL)
+	{
+		return;
+	}
+
+	//remember the names added, so they can be given to the completion table in one go
+	char **added = NULL;
+	size_t num_added = 0;
+	size_t capacity = 0;
+	struct dirent *file;
+	while ((file = readdir(stream)) != NULL)
+	{
+		if (file->d_type == DT_DIR || strcmp(file->d_name, ".") == 0 || strcmp(file->d_name, "..") == 0)
+		{
+			continue;
+		}
+
+		exec_entry_t *entry = add_exec_entry(index, file->d_name, dir);
+		if (entry == NULL || index->completion == NULL)
+		{
+			continue;
+		}
+
+		if (num_added == capacity)
+		{
+			capacity = capacity == 0 ? 256 : 2 * capacity;
+			char **tmp = realloc(added, capacity * sizeof *added);
+			if (tmp == NULL)
+			{
+				continue;
+			}
+			added = tmp;
+		}
+		added[num_added] = entry->name;
+		num_added++;
+	}
+
+	closedir(stream);
+
+	if (index->completion != NULL)
+	{
+		add_completions(index->completion, added, num_added);
+	}
+	free(added);
+}
+
+void *build_worker(void *arg)
+{
+	exec_index_t *index = arg;
+	size_t i;
+	for (i = 0; i < index->num_dirs; i++)
+	{
+		scan_dir(index, index->path, i);
+	}
+
+	return NULL;
+}
+
+void process_events(exec_index_t *index, path_t *path)
+{
+	char buffer[EVENT_BUFFER_SIZE] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	ssize_t length;
+	while ((length = read(index->inotify_fd, buffer, sizeof buffer)) > 0)
+	{
+		char *position = buffer;
+		while (position < buffer + length)
+		{
+			struct inotify_event *event = (struct inotify_event *) position;
+			position += sizeof *event + event->len;
+
+			//if events were dropped, the index can no longer be trusted, so start over
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				build_exec_index(index, path);
+				return;
+			}
+
+			size_t dir;
+			for (dir = 0; dir < index->num_dirs && index->dirs[dir].watch != event->wd; dir++);
+			if (dir == index->num_dirs)
+			{
+				continue;
+			}
+
+			if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+			{
+				//the directory itself is gone; fall back to checking its mtime from now on
+				remove_dir_entries(index, dir);
+				index->dirs[dir].watch = -1;
+				index->dirs[dir].mtime.tv_sec = 0;
+				index->dirs[dir].mtime.tv_nsec = 0;
+			}
+			else if (event->len == 0 || (event->mask & IN_ISDIR))
+			{
+				continue;
+			}
+			else if (event->mask & (IN_CREATE | IN_MOVED_TO))
+			{
+				if (add_exec_entry(index, event->name, dir) != NULL && index->completion != NULL)
+				{
+					add_completion(index->completion, event->name);
+				}
+			}
+			else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+			{
+				remove_exec_entry(index, event->name, dir);
+			}
+		}
+	}
+}
+
+void check_mtimes(exec_index_t *index, path_t *path)
+{
+	size_t i;
+	for (i = 0; i < index->num_dirs; i++)
+	{
+		if (index->dirs[i].watch >= 0)
+		{
+			continue;
+		}
+
+		struct stat info;
+		if (stat(string_c_str(path->dirs + i), &info) < 0)
+		{
+			remove_dir_entries(index, i);
+			continue;
+		}
+
+		if (info.st_mtim.tv_sec != index->dirs[i].mtime.tv_sec || info.st_mtim.tv_nsec != index->dirs[i].mtime.tv_nsec)
+		{
+			remove_dir_entries(index, i);
+			scan_dir(index, path, i);
+		}
+	}
+}
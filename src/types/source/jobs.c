@@ -0,0 +1,533 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../misc/include/pipe_size.h"
+#include "../include/jobs.h"
+#include "../include/string_t.h"
+
+#define JOBS_NAME   "osh-job"
+#define JOBS_BUFFER (64 * 1024)
+#define JOBS_CHUNK  (1024 * 1024)
+
+/**
+  * Records how a job ended, from the status waitpid gave for it, and gives its thread a moment to
+  * drain what the job left in the pipe, so that the job is reported with all of its output
+  * @param job    the job
+  * @param status the wait status
+  */
+void finish_job(job_t *job, int status);
+
+/**
+  * The function run by each job's thread; splices the job's pipe into the ring until every writer
+  * has closed it, copying through userspace instead if the kernel will not splice into the memfd
+  * @param arg the job_output_t
+  * @return always NULL
+  */
+void *drain_job_output(void *arg);
+
+/**
+  * Waits at most JOBS_SETTLE_MS for a job's thread to drain the pipe; anything the job started that
+  * still holds the pipe open keeps it from being drained, and is not waited for any longer
+  * @param output the job's output
+  */
+void settle_job_output(job_output_t *output);
+
+/**
+  * Finds how many bytes have come through a job's pipe so far
+  * @param job the job
+  * @return the number of bytes, including any the ring has since dropped
+  */
+uint64_t job_received(job_t *job);
+
+/**
+  * Lets go of the oldest finished jobs that have been reported, until no more are left than the
+  * table keeps
+  * @param table the table
+  */
+void release_reported(job_table_t *table);
+
+/**
+  * Sends part of a job's ring with sendfile, from explicit offsets
+  * @param output the job's output
+  * @param to     the descriptor to write to
+  * @param offset where in the ring to start
+  * @param end    where to stop
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t send_job_range(job_output_t *output, int to, off_t offset, off_t end);
+
+/**
+  * Copies part of a job's ring with pread and write, for descriptors sendfile cannot write to
+  * @param output the job's output
+  * @param to     the descriptor to write to
+  * @param offset where in the ring to start
+  * @param end    where to stop
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t copy_job_output(job_output_t *output, int to, off_t offset, off_t end);
+
+/**
+  * Writes all of a buffer to a descriptor, continuing after short writes
+  * @param to     the descriptor to write to
+  * @param data   the bytes to be written
+  * @param length the number of bytes
+  * @return a status code indicating whether an error occurred during execution of the function
+  */
+status_t write_job_text(int to, const char *data, size_t length);
+
+status_t create_job_output(job_output_t **output, size_t limit, size_t pipe_size, int *input)
+{
+	job_output_t *created = malloc(sizeof *created);
+	if (created == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+
+	created->memfd = memfd_create(JOBS_NAME, MFD_CLOEXEC);
+	if (created->memfd < 0)
+	{
+		free(created);
+		return OPEN_ERROR;
+	}
+
+	int fds[2];
+	if (make_pipe(fds, O_CLOEXEC, pipe_size) < 0)
+	{
+		close(created->memfd);
+		free(created);
+		return PIPE_ERROR;
+	}
+
+	created->pipe = fds[0];
+	created->limit = limit;
+	created->received = 0;
+	created->drained = 0;
+	created->references = 2;
+	pthread_condattr_t attributes;
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(&created->finished, &attributes);
+	pthread_condattr_destroy(&attributes);
+	pthread_mutex_init(&created->lock, NULL);
+
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, drain_job_output, created) != 0)
+	{
+		close(fds[0]);
+		close(fds[1]);
+		close(created->memfd);
+		pthread_mutex_destroy(&created->lock);
+		pthread_cond_destroy(&created->finished);
+		free(created);
+		return THREAD_ERROR;
+	}
+	pthread_detach(thread);
+
+	*output = created;
+	*input = fds[1];
+	return SUCCESS;
+}
+
+void release_job_output(job_output_t *output)
+{
+	pthread_mutex_lock(&output->lock);
+	output->references--;
+	unsigned short last = output->references == 0;
+	pthread_mutex_unlock(&output->lock);
+	if (!last)
+	{
+		return;
+	}
+
+	close(output->memfd);
+	close(output->pipe);
+	pthread_mutex_destroy(&output->lock);
+	pthread_cond_destroy(&output->finished);
+	free(output);
+}
+
+status_t add_job(job_table_t *table, pid_t pid, job_output_t *output, command_t *command, size_t *number)
+{
+	if (table->num_jobs == table->capacity)
+	{
+		size_t capacity = table->capacity == 0 ? 8 : 2 * table->capacity;
+		job_t *jobs = realloc(table->jobs, capacity * sizeof *jobs);
+		if (jobs == NULL)
+		{
+			release_job_output(output);
+			return MEMORY_ERROR;
+		}
+		table->jobs = jobs;
+		table->capacity = capacity;
+	}
+
+	string_t text;
+	string_initialize(&text);
+	command_to_string(command, &text);
+	char *copy = strdup(string_c_str(&text));
+	string_uninitialize(&text);
+	if (copy == NULL)
+	{
+		release_job_output(output);
+		return MEMORY_ERROR;
+	}
+
+	//numbers start from 1 again once every job has been dealt with, as they do in other shells
+	if (table->num_jobs == 0)
+	{
+		table->next_number = 1;
+	}
+	table->jobs[table->num_jobs] = (job_t) { table->next_number, pid, output, copy, 0, 0, 0 };
+	table->num_jobs++;
+	if (number != NULL)
+	{
+		*number = table->next_number;
+	}
+	table->next_number++;
+	release_reported(table);
+	return SUCCESS;
+}
+
+job_t *find_job(job_table_t *table, size_t number)
+{
+	size_t i;
+	for (i = 0; i < table->num_jobs; i++)
+	{
+		if (table->jobs[i].number == number)
+		{
+			return table->jobs + i;
+		}
+	}
+
+	return NULL;
+}
+
+void finish_job(job_t *job, int status)
+{
+	job->finished = 1;
+	job->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+	settle_job_output(job->output);
+}
+
+void update_jobs(job_table_t *table)
+{
+	size_t i;
+	for (i = 0; i < table->num_jobs; i++)
+	{
+		job_t *job = table->jobs + i;
+		int status;
+		pid_t reaped;
+		while (!job->finished && ((reaped = waitpid(job->pid, &status, WNOHANG)) != 0))
+		{
+			if (reaped > 0)
+			{
+				finish_job(job, status);
+			}
+			else if (errno != EINTR)
+			{
+				//someone else reaped it, so all that is known is that it is gone
+				finish_job(job, 0);
+			}
+		}
+	}
+}
+
+void wait_jobs(job_table_t *table)
+{
+	size_t i;
+	for (i = 0; i < table->num_jobs; i++)
+	{
+		job_t *job = table->jobs + i;
+		int status;
+		pid_t reaped;
+		while (!job->finished && ((reaped = waitpid(job->pid, &status, 0)) > 0 || errno != EINTR))
+		{
+			finish_job(job, reaped > 0 ? status : 0);
+		}
+	}
+}
+
+void notify_jobs(job_table_t *table)
+{
+	update_jobs(table);
+	size_t i;
+	for (i = 0; i < table->num_jobs; i++)
+	{
+		job_t *job = table->jobs + i;
+		if (job->finished && !job->notified)
+		{
+			uint64_t received = job_received(job);
+			printf("[%zu] Done (%d), %llu bytes of output", job->number, job->status, (unsigned long long) received);
+			if (received > job->output->limit)
+			{
+				printf(", the last %zu kept", job->output->limit);
+			}
+			printf("\t%s\n", job->command);
+			job->notified = 1;
+		}
+	}
+	fflush(stdout);
+	release_reported(table);
+}
+
+void print_jobs(job_table_t *table)
+{
+	update_jobs(table);
+	size_t i;
+	for (i = 0; i < table->num_jobs; i++)
+	{
+		job_t *job = table->jobs + i;
+		unsigned long long received = job_received(job);
+		if (job->finished)
+		{
+			printf("[%zu] Done (%d)\t%llu bytes\t%s\n", job->number, job->status, received, job->command);
+			job->notified = 1;
+		}
+		else
+		{
+			printf("[%zu] Running\t%llu bytes\t%s\n", job->number, received, job->command);
+		}
+	}
+	release_reported(table);
+}
+
+void *drain_job_output(void *arg)
+{
+	job_output_t *output = arg;
+	char buffer[JOBS_BUFFER];
+	unsigned short copying = 0;
+	uint64_t received = 0;
+	for (;;)
+	{
+		size_t position = received % output->limit;
+		size_t room = output->limit - position;
+		ssize_t moved;
+		if (!copying)
+		{
+			loff_t offset = position;
+			moved = splice(output->pipe, NULL, output->memfd, &offset, room < JOBS_CHUNK ? room : JOBS_CHUNK, SPLICE_F_MOVE);
+			if (moved < 0 && errno != EINTR)
+			{
+				copying = 1;
+				continue;
+			}
+		}
+		else
+		{
+			//the bytes are taken out of the pipe even if they cannot be kept, so the job never blocks
+			moved = read(output->pipe, buffer, room < sizeof buffer ? room : sizeof buffer);
+			ssize_t written = 0;
+			while (moved > 0 && written < moved)
+			{
+				ssize_t wrote = pwrite(output->memfd, buffer + written, moved - written, position + written);
+				if (wrote < 0 && errno != EINTR)
+				{
+					break;
+				}
+				written += wrote > 0 ? wrote : 0;
+			}
+		}
+
+		if (moved < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (moved <= 0)
+		{
+			break;
+		}
+		received += moved;
+		__atomic_store_n(&output->received, received, __ATOMIC_RELEASE);
+	}
+
+	pthread_mutex_lock(&output->lock);
+	output->drained = 1;
+	pthread_cond_broadcast(&output->finished);
+	pthread_mutex_unlock(&output->lock);
+	release_job_output(output);
+	return NULL;
+}
+
+void settle_job_output(job_output_t *output)
+{
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_nsec += JOBS_SETTLE_MS * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+		deadline.tv_nsec %= 1000000000L;
+	}
+
+	pthread_mutex_lock(&output->lock);
+	while (!output->drained)
+	{
+		if (pthread_cond_timedwait(&output->finished, &output->lock, &deadline) == ETIMEDOUT)
+		{
+			break;
+		}
+	}
+	pthread_mutex_unlock(&output->lock);
+}
+
+uint64_t job_received(job_t *job)
+{
+	return __atomic_load_n(&job->output->received, __ATOMIC_ACQUIRE);
+}
+
+void release_reported(job_table_t *table)
+{
+	size_t reported = 0;
+	size_t i;
+	for (i = 0; i < table->num_jobs; i++)
+	{
+		reported += table->jobs[i].finished && table->jobs[i].notified;
+	}
+
+	//running jobs, and finished ones not yet reported, are always kept
+	i = 0;
+	while (reported > table->keep && i < table->num_jobs)
+	{
+		if (table->jobs[i].finished && table->jobs[i].notified)
+		{
+			remove_job(table, table->jobs[i].number);
+			reported--;
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+status_t print_job_output(job_t *job, int to)
+{
+	//stdout may still hold text that belongs before the output
+	fflush(stdout);
+
+	job_output_t *output = job->output;
+	uint64_t received = job_received(job);
+	if (received <= output->limit)
+	{
+		return send_job_range(output, to, 0, received);
+	}
+
+	//the ring has wrapped, so its oldest bytes start just after the newest
+	char note[96];
+	int length = snprintf(note, sizeof note, "[%llu bytes of earlier output dropped]\n", (unsigned long long) (received - output->limit));
+	off_t split = received % output->limit;
+	status_t error = write_job_text(to, note, length);
+	if (error == SUCCESS)
+	{
+		error = send_job_range(output, to, split, output->limit);
+	}
+	if (error == SUCCESS)
+	{
+		error = send_job_range(output, to, 0, split);
+	}
+
+	return error;
+}
+
+status_t send_job_range(job_output_t *output, int to, off_t offset, off_t end)
+{
+	while (offset < end)
+	{
+		ssize_t sent = sendfile(to, output->memfd, &offset, end - offset);
+		if (sent < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (sent < 0 && (errno == EINVAL || errno == ENOSYS))
+		{
+			return copy_job_output(output, to, offset, end);
+		}
+		if (sent <= 0)
+		{
+			return sent == 0 ? SUCCESS : JOB_ERROR;
+		}
+	}
+
+	return SUCCESS;
+}
+
+status_t copy_job_output(job_output_t *output, int to, off_t offset, off_t end)
+{
+	char buffer[JOBS_BUFFER];
+	while (offset < end)
+	{
+		size_t wanted = end - offset < (off_t) sizeof buffer ? (size_t) (end - offset) : sizeof buffer;
+		ssize_t received = pread(output->memfd, buffer, wanted, offset);
+		if (received < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (received <= 0)
+		{
+			return received == 0 ? SUCCESS : JOB_ERROR;
+		}
+
+		status_t error = write_job_text(to, buffer, received);
+		if (error != SUCCESS)
+		{
+			return error;
+		}
+		offset += received;
+	}
+
+	return SUCCESS;
+}
+
+status_t write_job_text(int to, const char *data, size_t length)
+{
+	size_t written = 0;
+	while (written < length)
+	{
+		ssize_t wrote = write(to, data + written, length - written);
+		if (wrote < 0 && errno != EINTR)
+		{
+			return JOB_ERROR;
+		}
+		written += wrote > 0 ? wrote : 0;
+	}
+
+	return SUCCESS;
+}
+
+void remove_job(job_table_t *table, size_t number)
+{
+	job_t *job = find_job(table, number);
+	if (job == NULL)
+	{
+		return;
+	}
+
+	release_job_output(job->output);
+	free(job->command);
+	size_t index = job - table->jobs;
+	memmove(job, job + 1, (table->num_jobs - index - 1) * sizeof *job);
+	table->num_jobs--;
+}
+
+void clear_jobs(job_table_t *table)
+{
+	size_t i;
+	for (i = 0; i < table->num_jobs; i++)
+	{
+		release_job_output(table->jobs[i].output);
+		free(table->jobs[i].command);
+	}
+	free(table->jobs);
+	table->jobs = NULL;
+	table->num_jobs = 0;
+	table->capacity = 0;
+}
@@ -1,63 +1,217 @@
-#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "../include/path.h"
 
 /**
-  * Given the name of a potential directory, this function tries to open it, and if it can, returns
-  * that the directory is accessible, otherwise that it is not
-  * @param dir the name of the directory of which to determine accessibility
+  * A single directory to be validated by the thread pool, along with the results of its validation.
+  * If known is set, device and inode start out as the ones cached for the directory
+  */
+typedef struct
+{
+    char *dir;
+    dev_t device;
+    ino_t inode;
+    unsigned short known;
+    unsigned short accessible;
+    unsigned short done;
+    long elapsed_ms;
+} validate_job_t;
+
+/**
+  * The state shared between set_path and the validation threads. Since the threads may outlive a
+  * set_path that timed out, the batch is reference counted and freed by whoever leaves it last
+  */
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    validate_job_t *jobs;
+    size_t num_jobs;
+    size_t next_job;
+    size_t num_done;
+    size_t references;
+} validate_batch_t;
+
+/**
+  * Given the name of a potential directory, determines whether it is a directory that can be
+  * searched for commands, without opening it. A directory that is still the one cached for the
+  * name only needs the stat; any other is checked for search permission too. On success, its
+  * device and inode are placed in the given params
+  * @param dir    the name of the directory of which to determine accessibility
+  * @param known  whether device and inode hold the ones cached for the name
+  * @param device in/out param; the device the directory resides on
+  * @param inode  in/out param; the inode of the directory
   * @return whether the directory is accessible or not
   */
-unsigned short dir_accessible(char *dir);
+unsigned short dir_accessible(char *dir, unsigned short known, dev_t *device, ino_t *inode);
+
+/**
+  * Validates every job in jobs concurrently, waiting at most PATH_VALIDATE_TIMEOUT_MS for all of
+  * them to finish. Jobs that have not finished when this function returns are marked as not done
+  * @param jobs     the jobs to be validated; results are placed back into this array
+  * @param num_jobs the number of jobs in the array
+  */
+void validate_dirs(validate_job_t *jobs, size_t num_jobs);
+
+/**
+  * The function run by each validation thread; takes jobs from the batch until none are left
+  * @param arg the validate_batch_t shared with set_path
+  * @return always NULL
+  */
+void *validate_worker(void *arg);
+
+/**
+  * Releases one reference to the batch, freeing it if that was the last reference. Must be called
+  * with the batch's lock held; the lock is released by this function
+  * @param batch the batch to be released
+  */
+void release_batch(validate_batch_t *batch);
+
+/**
+  * Returns the number of milliseconds elapsed on the monotonic clock since start
+  * @param start the time from which to measure
+  * @return the number of milliseconds elapsed since start
+  */
+long elapsed_since(struct timespec *start);
 
-status_t set_path(path_t *path, command_t *command)
+/**
+  * Finds the cache entry for the directory with the given name, if it has been validated before.
+  * Only absolute names are cached, since a relative one names a different directory after a cd
+  * @param path the path whose cache is to be searched
+  * @param name the name of the directory
+  * @return the cache entry for the directory, or NULL if the directory is not in the cache
+  */
+path_dir_info_t *find_validated(path_t *path, char *name);
+
+status_t set_path(path_t *path, command_t *command, unsigned short verbose)
 {
     //one for "set", one for "path", one for "=", one for NULL pointer
-    status_t error = resize_initialize_path(path, command->argc - 4);
-    if (error != SUCCESS)
+    size_t num_args = command->argc - 4;
+    char **names = malloc(num_args * sizeof *names);
+    path_dir_info_t **infos = calloc(num_args, sizeof *infos);
+    validate_job_t *jobs = calloc(num_args, sizeof *jobs);
+    if (names == NULL || infos == NULL || jobs == NULL)
     {
-        return error;
+        free(names);
+        free(infos);
+        free(jobs);
+        return MEMORY_ERROR;
     }
 
+    //adjust the arguments to deal with the parentheses; the ')' is put back before returning
     size_t last_length = strlen(command->arguments[command->argc - 2]);
-    size_t current_index = 0;
+    command->arguments[command->argc - 2][last_length - 1] = '\0';
     size_t i;
-    for (i = 0; i < path->num_dirs; i++)
+    for (i = 0; i < num_args; i++)
+    {
+        names[i] = command->arguments[i + 3] + (i == 0);
+    }
+
+    //every directory is stat'ed again, but one whose device and inode still match its cache entry
+    //is not checked any further
+    for (i = 0; i < num_args; i++)
+    {
+        jobs[i].dir = names[i];
+        infos[i] = names[i][0] == '/' ? find_validated(path, names[i]) : NULL;
+        if (infos[i] != NULL)
+        {
+            jobs[i].known = 1;
+            jobs[i].device = infos[i]->device;
+            jobs[i].inode = infos[i]->inode;
+        }
+    }
+
+    validate_dirs(jobs, num_args);
+
+    //record every accessible absolute directory in the cache, under the device and inode it has now
+    for (i = 0; i < num_args; i++)
     {
-        //adjust the argument to deal with the parentheses; do the num_dirs - 1 case first to handle
-        //the case of only one directory in the path correctly (otherwise, the ')' wouldn't be
-        //eliminated correctly)
-        char *argument = command->arguments[i + 3];
-        if (i == path->num_dirs - 1)
+        validate_job_t *job = jobs + i;
+        if (verbose && (!job->done || job->elapsed_ms >= PATH_SLOW_DIR_MS))
+        {
+            fprintf(stdout, "%s took %s%ld ms to validate\n", job->dir, job->done ? "" : "over ",
+                job->done ? job->elapsed_ms : (long) PATH_VALIDATE_TIMEOUT_MS);
+        }
+
+        if (!job->done || !job->accessible)
+        {
+            continue;
+        }
+
+        if (infos[i] != NULL)
+        {
+            infos[i]->device = job->device;
+            infos[i]->inode = job->inode;
+            continue;
+        }
+
+        if (names[i][0] != '/')
         {
-            argument[last_length - 1] = '\0';
+            continue;
         }
 
-        if (i == 0)
+        path_dir_info_t *info = malloc(sizeof *info);
+        if (info == NULL || (info->name = strdup(job->dir)) == NULL)
         {
-            argument++;
+            free(info);
+            continue;
         }
+        info->device = job->device;
+        info->inode = job->inode;
+        info->next = path->validated;
+        path->validated = info;
+    }
 
-        if (dir_accessible(argument))
+    status_t error = resize_initialize_path(path, num_args);
+    size_t current_index = 0;
+    for (i = 0; i < num_args && error == SUCCESS; i++)
+    {
+        if (!jobs[i].done || !jobs[i].accessible)
         {
-            string_assign_from_char_array(path->dirs + current_index, argument);
-            //add a backslash no matter what, because any number of slashes is equivalent to one
-            string_concatenate_char_array(path->dirs + current_index, "/");
-            current_index++;
+            fprintf(stderr, "Error: Could not add %s to the path.\n", names[i]);
+            continue;
         }
-        else
+
+        //a directory reachable under two names (e.g., through a symlink) only needs searching once
+        size_t j;
+        for (j = 0; j < i; j++)
         {
-            fprintf(stderr, "Error: Could not add %s to the path.\n", argument);
+            if (jobs[j].done && jobs[j].accessible && jobs[j].device == jobs[i].device && jobs[j].inode == jobs[i].inode)
+            {
+                break;
+            }
         }
 
-        if (i == path->num_dirs - 1)
+        if (j < i)
         {
-            argument[last_length - 1] = ')';
+            if (verbose)
+            {
+                fprintf(stdout, "%s is the same directory as %s; skipping it\n", names[i], names[j]);
+            }
+            continue;
         }
 
+        string_assign_from_char_array(path->dirs + current_index, names[i]);
+        //add a backslash no matter what, because any number of slashes is equivalent to one
+        string_concatenate_char_array(path->dirs + current_index, "/");
+        current_index++;
+    }
+
+    command->arguments[command->argc - 2][last_length - 1] = ')';
+    free(names);
+    free(infos);
+    free(jobs);
+    if (error != SUCCESS)
+    {
+        return error;
     }
 
     //uninitialize any strings that will now be unused (because directories could not be used in the
@@ -116,18 +270,202 @@ void clear_path(path_t *path)
         string_uninitialize(path->dirs + i);
     }
     free(path->dirs);
+
+    path_dir_info_t *info = path->validated;
+    while (info != NULL)
+    {
+        path_dir_info_t *next = info->next;
+        free(info->name);
+        free(info);
+        info = next;
+    }
+    path->validated = NULL;
 }
 
-unsigned short dir_accessible(char *dir)
+unsigned short dir_accessible(char *dir, unsigned short known, dev_t *device, ino_t *inode)
 {
-    DIR *test_dir;
-    if ((test_dir = opendir(dir)) == NULL)
+    struct stat info;
+    if (stat(dir, &info) < 0 || !S_ISDIR(info.st_mode))
     {
         return 0;
     }
-    else
+
+    if (known && info.st_dev == *device && info.st_ino == *inode)
     {
-        closedir(test_dir);
         return 1;
     }
+
+    //commands can only be found in a directory the user is allowed to search
+    if (faccessat(AT_FDCWD, dir, X_OK, AT_EACCESS) < 0)
+    {
+        return 0;
+    }
+
+    *device = info.st_dev;
+    *inode = info.st_ino;
+    return 1;
+}
+
+void validate_dirs(validate_job_t *jobs, size_t num_jobs)
+{
+    if (num_jobs == 0)
+    {
+        return;
+    }
+
+    validate_batch_t *batch = malloc(sizeof *batch);
+    if (batch == NULL)
+    {
+        return;
+    }
+
+    //the batch gets its own copy of the jobs, since threads that time out may still write to it
+    batch->jobs = malloc(num_jobs * sizeof *batch->jobs);
+    if (batch->jobs == NULL)
+    {
+        free(batch);
+        return;
+    }
+
+    size_t i;
+    for (i = 0; i < num_jobs; i++)
+    {
+        batch->jobs[i] = jobs[i];
+        batch->jobs[i].dir = strdup(jobs[i].dir);
+    }
+    batch->num_jobs = num_jobs;
+    batch->next_job = 0;
+    batch->num_done = 0;
+    batch->references = 1;
+
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&batch->finished, &attributes);
+    pthread_condattr_destroy(&attributes);
+    pthread_mutex_init(&batch->lock, NULL);
+
+    size_t num_threads = num_jobs < PATH_VALIDATE_THREADS ? num_jobs : PATH_VALIDATE_THREADS;
+    pthread_mutex_lock(&batch->lock);
+    for (i = 0; i < num_threads; i++)
+    {
+        pthread_t thread;
+        batch->references++;
+        if (pthread_create(&thread, NULL, validate_worker, batch) != 0)
+        {
+            batch->references--;
+            break;
+        }
+        pthread_detach(thread);
+    }
+    pthread_mutex_unlock(&batch->lock);
+
+    //if no thread could be started at all, the validation has to be done here instead
+    if (i == 0)
+    {
+        batch->references++;
+        validate_worker(batch);
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += PATH_VALIDATE_TIMEOUT_MS / 1000;
+    deadline.tv_nsec += (PATH_VALIDATE_TIMEOUT_MS % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&batch->lock);
+    while (batch->num_done < batch->num_jobs)
+    {
+        if (pthread_cond_timedwait(&batch->finished, &batch->lock, &deadline) == ETIMEDOUT)
+        {
+            break;
+        }
+    }
+
+    for (i = 0; i < num_jobs; i++)
+    {
+        char *dir = jobs[i].dir;
+        jobs[i] = batch->jobs[i];
+        jobs[i].dir = dir;
+    }
+
+    release_batch(batch);
+}
+
+void *validate_worker(void *arg)
+{
+    validate_batch_t *batch = arg;
+    pthread_mutex_lock(&batch->lock);
+    while (batch->next_job < batch->num_jobs)
+    {
+        validate_job_t *job = batch->jobs + batch->next_job;
+        batch->next_job++;
+        pthread_mutex_unlock(&batch->lock);
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        dev_t device = job->device;
+        ino_t inode = job->inode;
+        unsigned short accessible = job->dir != NULL && dir_accessible(job->dir, job->known, &device, &inode);
+        long elapsed_ms = elapsed_since(&start);
+
+        pthread_mutex_lock(&batch->lock);
+        job->device = device;
+        job->inode = inode;
+        job->accessible = accessible;
+        job->elapsed_ms = elapsed_ms;
+        job->done = 1;
+        batch->num_done++;
+        pthread_cond_signal(&batch->finished);
+    }
+
+    release_batch(batch);
+    return NULL;
+}
+
+void release_batch(validate_batch_t *batch)
+{
+    batch->references--;
+    unsigned short last = batch->references == 0;
+    pthread_mutex_unlock(&batch->lock);
+    if (!last)
+    {
+        return;
+    }
+
+    size_t i;
+    for (i = 0; i < batch->num_jobs; i++)
+    {
+        free(batch->jobs[i].dir);
+    }
+    free(batch->jobs);
+    pthread_mutex_destroy(&batch->lock);
+    pthread_cond_destroy(&batch->finished);
+    free(batch);
+}
+
+long elapsed_since(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+path_dir_info_t *find_validated(path_t *path, char *name)
+{
+    path_dir_info_t *info = path->validated;
+    while (info != NULL)
+    {
+        if (strcmp(info->name, name) == 0)
+        {
+            return info;
+        }
+        info = info->next;
+    }
+
+    return NULL;
 }
@@ -66,6 +66,26 @@ void error_message(status_t error_code)
 		case PIPE_ERROR:
 			fprintf(stderr, "Error: Could not create pipe.");
 			break;
+		case THREAD_ERROR:
+			fprintf(stderr, "Error: Could not start thread.");
+			break;
+		case REDIRECT_ERROR:
+			fprintf(stderr, "Error: Could not open file for redirection.");
+			break;
+		case HEREDOC_ERROR:
+			fprintf(stderr, "Error: Could not create here-document.");
+			break;
+		case SHELL_EXIT:
+			break;
+		case SOCKET_ERROR:
+			fprintf(stderr, "Error: Could not use the server's socket.");
+			break;
+		case CACHE_ERROR:
+			fprintf(stderr, "Error: Could not use the command cache.");
+			break;
+		case JOB_ERROR:
+			fprintf(stderr, "Error: No such background job, or its output could not be read.");
+			break;
 		default:
 			fprintf(stderr, "Error: Unknown error.");
 	}
@@ -22,6 +22,11 @@ void string_assign_from_char_array_with_size(string_t *s, char *arr, size_t leng
 	char_vector_assign_from_array(s, arr, length);
 }
 
+void string_assign_from_view(string_t *s, string_view_t view)
+{
+	char_vector_assign_from_array(s, view.start, view.length);
+}
+
 void string_concatenate(string_t *a, string_t *b)
 {
 	char_vector_size_at_least(a, a->elements + b->elements);
@@ -39,60 +44,99 @@ void string_concatenate_char_array(string_t *s, char *arr)
 	}
 }
 
+void string_concatenate_view(string_t *s, string_view_t view)
+{
+	char_vector_size_at_least(s, s->elements + view.length);
+	memcpy(s->array + s->elements, view.start, view.length);
+	s->elements += view.length;
+}
+
 string_t *string_split(string_t *s, char delim, size_t *num)
 {
-	string_t *ret_val = NULL;
-	*num = 0;
-	char *start_pos = s->array;
-	size_t i;
-	for (i = 0; i < s->elements; i++)
+	string_view_t *views = string_split_as_views(s, delim, num);
+	if (views == NULL)
+	{
+		return NULL;
+	}
+
+	string_t *ret_val = malloc(*num * sizeof *ret_val);
+	if (ret_val == NULL)
 	{
-		if (s->array[i] == delim)
-		{
-			(*num)++;
-			ret_val = realloc(ret_val, *num * sizeof *ret_val);
-			string_initialize(ret_val + *num - 1);
-
-			s->array[i] = '\0';
-			string_assign_from_char_array(ret_val + *num - 1, start_pos);
-			
-			s->array[i] = delim;
-			start_pos  = s->array + i + 1;
-		}
+		free(views);
+		return NULL;
 	}
 
-	(*num)++;
-	ret_val = realloc(ret_val, *num * sizeof *ret_val);
-	string_initialize(ret_val + *num - 1);
-	string_assign_from_char_array_with_size(ret_val + *num - 1, start_pos, s->array + i - start_pos);
+	size_t i;
+	for (i = 0; i < *num; i++)
+	{
+		string_initialize(ret_val + i);
+		string_assign_from_view(ret_val + i, views[i]);
+	}
 
+	free(views);
 	return ret_val;
 }
 
 char **string_split_as_c_strs(string_t *s, char delim, size_t *num)
 {
-	char **ret_val = NULL;
-	*num = 0;
-	char *start_pos = s->array;
+	string_view_t *views = string_split_as_views(s, delim, num);
+	if (views == NULL)
+	{
+		return NULL;
+	}
+
+	char **ret_val = malloc(*num * sizeof *ret_val);
+	if (ret_val == NULL)
+	{
+		free(views);
+		return NULL;
+	}
+
 	size_t i;
-	for (i = 0; i < s->elements; i++)
+	for (i = 0; i < *num; i++)
 	{
-		if (s->array[i] == delim)
-		{
-			(*num)++;
-			ret_val = realloc(ret_val, *num * sizeof *ret_val);
-			
-			s->array[i] = '\0';
-			ret_val[*num - 1] = strdup(start_pos);
-
-			s->array[i] = delim;
-			start_pos = s->array + i + 1;
-		}
+		ret_val[i] = string_view_strdup(views[i]);
 	}
 
-	(*num)++;
-	ret_val = realloc(ret_val, *num * sizeof *ret_val);
-	ret_val[*num - 1] = strndup(start_pos, s->array + i - start_pos);
+	free(views);
+	return ret_val;
+}
+
+string_view_t *string_split_as_views(string_t *s, char delim, size_t *num)
+{
+	return char_array_split_as_views(s->array, s->elements, delim, num);
+}
+
+string_view_t *char_array_split_as_views(char *arr, size_t length, char delim, size_t *num)
+{
+	//count the pieces first so that the result array only has to be allocated once
+	*num = 1;
+	char *end = arr + length;
+	char *pos = arr;
+	while (pos < end && (pos = memchr(pos, delim, end - pos)) != NULL)
+	{
+		(*num)++;
+		pos++;
+	}
+
+	string_view_t *ret_val = malloc(*num * sizeof *ret_val);
+	if (ret_val == NULL)
+	{
+		return NULL;
+	}
+
+	//then point each view at its piece of the original buffer; nothing is copied
+	char *start_pos = arr;
+	size_t i;
+	for (i = 0; i < *num - 1; i++)
+	{
+		char *delim_pos = memchr(start_pos, delim, end - start_pos);
+		ret_val[i].start = start_pos;
+		ret_val[i].length = delim_pos - start_pos;
+		start_pos = delim_pos + 1;
+	}
+	ret_val[i].start = start_pos;
+	ret_val[i].length = end - start_pos;
 
 	return ret_val;
 }
@@ -114,3 +158,26 @@ void string_getline(string_t *s, FILE *stream)
 		next_char = fgetc(stream);
 	}
 }
+
+string_view_t string_view_from_char_array(char *arr)
+{
+	string_view_t view = { arr, strlen(arr) };
+	return view;
+}
+
+int string_view_compare_char_array(string_view_t view, char *arr)
+{
+	int result = strncmp(view.start, arr, view.length);
+	if (result != 0)
+	{
+		return result;
+	}
+
+	//the view is a prefix of arr; they are only equal if arr ends here too
+	return arr[view.length] == '\0' ? 0 : -1;
+}
+
+char *string_view_strdup(string_view_t view)
+{
+	return strndup(view.start, view.length);
+}
@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/alias.h"
+#include "../include/variables.h"
+
+/**
+  * Finds the variable with the given name, along with the link pointing at it in its bucket
+  * @param table the table to be searched
+  * @param name  the name of the variable
+  * @param link  out param, may be NULL; the pointer to the variable in its bucket's list
+  * @return the variable, or NULL if there is no such variable
+  */
+variable_t *find_variable(variable_table_t *table, char *name, variable_t ***link);
+
+/**
+  * Builds the "name=value" string for a variable
+  * @param name  the name of the variable
+  * @param value the value of the variable
+  * @return the newly allocated string, or NULL if it could not be allocated
+  */
+char *make_entry(char *name, char *value);
+
+int valid_variable_name(char *name)
+{
+	if (!((*name >= 'a' && *name <= 'z') || (*name >= 'A' && *name <= 'Z') || *name == '_'))
+	{
+		return 0;
+	}
+
+	for (name++; *name; name++)
+	{
+		if (!((*name >= 'a' && *name <= 'z') || (*name >= 'A' && *name <= 'Z') || (*name >= '0' && *name <= '9') || *name == '_'))
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+status_t set_variable(variable_table_t *table, char *name, char *value)
+{
+	char *entry = make_entry(name, value);
+	if (entry == NULL)
+	{
+		return MEMORY_ERROR;
+	}
+
+	variable_t *variable = find_variable(table, name, NULL);
+	if (variable != NULL)
+	{
+		//only this variable's slot changes; the rest of envp stays as it is
+		if (variable->exported)
+		{
+			table->envp[variable->env_index] = entry;
+		}
+		free(variable->entry);
+		variable->entry = entry;
+		return SUCCESS;
+	}
+
+	variable = malloc(sizeof *variable);
+	if (variable == NULL)
+	{
+		free(entry);
+		return MEMORY_ERROR;
+	}
+
+	size_t hash_val = hash(name) % VARIABLE_BUCKETS;
+	variable->entry = entry;
+	variable->name_length = strlen(name);
+	variable->exported = 0;
+	variable->env_index = 0;
+	variable->next = table->variable_entries[hash_val];
+	table->variable_entries[hash_val] = variable;
+	return SUCCESS;
+}
+
+status_t export_variable(variable_table_t *table, char *name)
+{
+	variable_t *variable = find_variable(table, name, NULL);
+	if (variable == NULL)
+	{
+		status_t error = set_variable(table, name, "");
+		if (error != SUCCESS)
+		{
+			return error;
+		}
+		variable = find_variable(table, name, NULL);
+	}
+
+	if (variable->exported)
+	{
+		return SUCCESS;
+	}
+
+	//leave room for the NULL pointer at the end
+	if (table->num_env + 1 >= table->env_capacity)
+	{
+		size_t capacity = table->env_capacity == 0 ? 64 : 2 * table->env_capacity;
+		char **tmp = realloc(table->envp, capacity * sizeof *tmp);
+		if (tmp == NULL)
+		{
+			return MEMORY_ERROR;
+		}
+		table->envp = tmp;
+		table->env_capacity = capacity;
+	}
+
+	variable->exported = 1;
+	variable->env_index = table->num_env;
+	table->envp[table->num_env++] = variable->entry;
+	table->envp[table->num_env] = NULL;
+	return SUCCESS;
+}
+
+void unset_variable(variable_table_t *table, char *name)
+{
+	variable_t **link;
+	variable_t *variable = find_variable(table, name, &link);
+	if (variable == NULL)
+	{
+		return;
+	}
+
+	if (variable->exported)
+	{
+		//fill the hole with the last slot, and tell its variable where it went
+		char *last = table->envp[--table->num_env];
+		table->envp[variable->env_index] = last;
+		table->envp[table->num_env] = NULL;
+		if (last != variable->entry)
+		{
+			char *equals = strchr(last, '=');
+			*equals = '\0';
+			variable_t *moved = find_variable(table, last, NULL);
+			*equals = '=';
+			moved->env_index = variable->env_index;
+		}
+	}
+
+	*link = variable->next;
+	free(variable->entry);
+	free(variable);
+}
+
+char *get_variable(variable_table_t *table, char *name)
+{
+	variable_t *variable = find_variable(table, name, NULL);
+	return variable == NULL ? NULL : variable->entry + variable->name_length + 1;
+}
+
+status_t import_variables(variable_table_t *table, char **envp)
+{
+	for (; *envp != NULL; envp++)
+	{
+		char *equals = strchr(*envp, '=');
+		if (equals == NULL)
+		{
+			continue;
+		}
+
+		//the name is copied rather than cut off in place, since envp may be a host program's environ,
+		//whose strings may be read only or read by its other threads
+		char *name = strndup(*envp, equals - *envp);
+		if (name == NULL)
+		{
+			return MEMORY_ERROR;
+		}
+
+		status_t error = SUCCESS;
+		if (valid_variable_name(name))
+		{
+			error = set_variable(table, name, equals + 1);
+		}
+		if (error == SUCCESS && valid_variable_name(name))
+		{
+			error = export_variable(table, name);
+		}
+		free(name);
+		if (error != SUCCESS)
+		{
+			return error;
+		}
+	}
+
+	return SUCCESS;
+}
+
+void print_variables(variable_table_t *table, unsigned short exported_only)
+{
+	size_t i;
+	for (i = 0; i < VARIABLE_BUCKETS; i++)
+	{
+		variable_t *variable;
+		for (variable = table->variable_entries[i]; variable != NULL; variable = variable->next)
+		{
+			if (exported_only && variable->exported)
+			{
+				fprintf(stdout, "export %s\n", variable->entry);
+			}
+			else if (!exported_only)
+			{
+				fprintf(stdout, "%.*s = %s\n", (int) variable->name_length, variable->entry, variable->entry + variable->name_length + 1);
+			}
+		}
+	}
+}
+
+void clear_variables(variable_table_t *table)
+{
+	size_t i;
+	for (i = 0; i < VARIABLE_BUCKETS; i++)
+	{
+		variable_t *variable = table->variable_entries[i];
+		while (variable != NULL)
+		{
+			variable_t *next = variable->next;
+			free(variable->entry);
+			free(variable);
+			variable = next;
+		}
+		table->variable_entries[i] = NULL;
+	}
+
+	free(table->envp);
+	table->envp = NULL;
+	table->num_env = 0;
+	table->env_capacity = 0;
+}
+
+variable_t *find_variable(variable_table_t *table, char *name, variable_t ***link)
+{
+	size_t name_length = strlen(name);
+	variable_t **current = &table->variable_entries[hash(name) % VARIABLE_BUCKETS];
+	for (; *current != NULL; current = &(*current)->next)
+	{
+		if ((*current)->name_length == name_length && strncmp((*current)->entry, name, name_length) == 0)
+		{
+			if (link != NULL)
+			{
+				*link = current;
+			}
+			return *current;
+		}
+	}
+
+	return NULL;
+}
+
+char *make_entry(char *name, char *value)
+{
+	size_t name_length = strlen(name);
+	size_t value_length = strlen(value);
+	char *entry = malloc(name_length + value_length + 2);
+	if (entry == NULL)
+	{
+		return NULL;
+	}
+
+	memcpy(entry, name, name_length);
+	entry[name_length] = '=';
+	memcpy(entry + name_length + 1, value, value_length + 1);
+	return entry;
+}